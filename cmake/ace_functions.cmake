@@ -43,7 +43,7 @@ endfunction()
 
 function(convertBitmaps)
 	getToolPath(bitmap_conv TOOL_BITMAP_CONV)
-	set(options INTERLEAVED EHB)
+	set(options INTERLEAVED EHB BATCH)
 	set(oneValArgs TARGET PALETTE MASK_COLOR)
 	set(multiValArgs SOURCES DESTINATIONS MASKS)
 	cmake_parse_arguments(
@@ -73,6 +73,25 @@ function(convertBitmaps)
 		endif()
 	endif()
 
+	if(${convertBitmaps_BATCH})
+		# Convert all bitmaps in single tool run with shared palette, using manifest
+		set(palettePath ${convertBitmaps_PALETTE})
+		toAbsolute(palettePath)
+		if(${convertBitmaps_EHB})
+			set(manifestEhb "true")
+		else()
+			set(manifestEhb "false")
+		endif()
+		if(${convertBitmaps_INTERLEAVED})
+			set(manifestInterleaved "true")
+		else()
+			set(manifestInterleaved "false")
+		endif()
+		set(manifestEntries "")
+		set(batchOutputs "")
+		set(batchSources "")
+	endif()
+
 	MATH(EXPR srcCount "${srcCount}-1")
 	foreach(bitmap_idx RANGE ${srcCount}) # /path/file.png
 		list(GET convertBitmaps_SOURCES ${bitmap_idx} bitmapPath)
@@ -92,6 +111,18 @@ function(convertBitmaps)
 			endif()
 		endif()
 
+		if(${convertBitmaps_BATCH})
+			set(manifestEntry "\t\t{\"in\": \"${bitmapPath}\", \"out\": \"${outPath}\", \"interleaved\": ${manifestInterleaved}")
+			if(NOT "${convertBitmaps_MASK_COLOR} " STREQUAL " ")
+				string(APPEND manifestEntry ", \"maskColor\": \"${convertBitmaps_MASK_COLOR}\", \"mask\": \"${maskPath}\"")
+			endif()
+			string(APPEND manifestEntry "}")
+			list(APPEND manifestEntries "${manifestEntry}")
+			list(APPEND batchSources ${bitmapPath})
+			list(APPEND batchOutputs ${outPath} ${maskPath})
+			continue()
+		endif()
+
 		set(extraFlagsPerFile ${extraFlags})
 		if("${outPath} " STREQUAL " ")
 			list(APPEND extraFlagsPerFile -no)
@@ -115,6 +146,31 @@ function(convertBitmaps)
 		)
 		target_sources(${convertBitmaps_TARGET} PUBLIC ${outPath} ${maskPath})
 	endforeach()
+
+	if(${convertBitmaps_BATCH})
+		# Each call gets its own manifest, rewritten only if its content changes
+		get_property(manifestIdx TARGET ${convertBitmaps_TARGET} PROPERTY ACE_BITMAP_MANIFEST_COUNT)
+		if("${manifestIdx} " STREQUAL " ")
+			set(manifestIdx 0)
+		endif()
+		MATH(EXPR manifestIdxNext "${manifestIdx}+1")
+		set_property(TARGET ${convertBitmaps_TARGET} PROPERTY ACE_BITMAP_MANIFEST_COUNT ${manifestIdxNext})
+		set(manifestPath "${CMAKE_CURRENT_BINARY_DIR}/${convertBitmaps_TARGET}_bitmaps_${manifestIdx}.json")
+
+		string(REPLACE ";" ",\n" manifestEntries "${manifestEntries}")
+		file(WRITE "${manifestPath}.tmp"
+			"{\n\t\"palette\": \"${palettePath}\",\n\t\"ehb\": ${manifestEhb},\n\t\"bitmaps\": [\n${manifestEntries}\n\t]\n}\n"
+		)
+		configure_file("${manifestPath}.tmp" "${manifestPath}" COPYONLY)
+
+		add_custom_command(
+			OUTPUT ${batchOutputs}
+			COMMAND ${TOOL_BITMAP_CONV} -m ${manifestPath}
+			WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+			DEPENDS ${palettePath} ${batchSources} ${manifestPath}
+		)
+		target_sources(${convertBitmaps_TARGET} PUBLIC ${batchOutputs})
+	endif()
 endfunction()
 
 function(convertFont)
@@ -239,8 +295,8 @@ function(convertAudio)
 	getToolPath(audio_conv TOOL_AUDIO_CONV)
 	cmake_parse_arguments(
 		args
-		"STRICT;PTPLAYER;NORMALIZE;COMPRESS;"
-		"TARGET;SOURCE;DESTINATION;PAD_BYTES;DIVIDE_AMPLITUDE;CHECK_DIVIDED_AMPLITUDE"
+		"STRICT;PTPLAYER;NORMALIZE;COMPRESS;NTSC"
+		"TARGET;SOURCE;DESTINATION;PAD_BYTES;DIVIDE_AMPLITUDE;CHECK_DIVIDED_AMPLITUDE;SAMPLE_RATE;RESAMPLE_QUALITY;DITHER"
 		"" ${ARGN}
 	)
 
@@ -257,7 +313,19 @@ function(convertAudio)
 		set(argsOptional ${argsOptional} -c)
 	endif()
 	if(${args_PAD_BYTES})
-		set(argsOptional ${argsOptional} -pad ${args_PAD_BYTES})
+		set(argsOptional ${argsOptional} -fpad ${args_PAD_BYTES})
+	endif()
+	if(${args_SAMPLE_RATE})
+		set(argsOptional ${argsOptional} -r ${args_SAMPLE_RATE})
+	endif()
+	if(${args_NTSC})
+		set(argsOptional ${argsOptional} -ntsc)
+	endif()
+	if(NOT "${args_RESAMPLE_QUALITY}" STREQUAL "")
+		set(argsOptional ${argsOptional} -rq ${args_RESAMPLE_QUALITY})
+	endif()
+	if(NOT "${args_DITHER}" STREQUAL "")
+		set(argsOptional ${argsOptional} -dither ${args_DITHER})
 	endif()
 
 	if(${args_CHECK_DIVIDED_AMPLITUDE})
@@ -283,7 +351,7 @@ function(mergeMods)
 	set(cmdParams "")
 	cmake_parse_arguments(
 		args
-		"COMPRESS"
+		"COMPRESS;PACK_PATTERNS"
 		"SAMPLE_PACK;TARGET"
 		"SOURCES;DESTINATIONS" ${ARGN}
 	)
@@ -296,6 +364,10 @@ function(mergeMods)
 		list(APPEND cmdParams -c)
 	endif()
 
+	if(${args_PACK_PATTERNS})
+		list(APPEND cmdParams -pp)
+	endif()
+
 	list(LENGTH args_SOURCES srcCount)
 	list(LENGTH args_DESTINATIONS dstCount)
 	if(NOT ${srcCount} EQUAL ${dstCount})
@@ -328,8 +400,8 @@ function(packDirectory)
 	getToolPath(pak_tool TOOL_PAK_TOOL)
 	cmake_parse_arguments(
 		args
-		"COMPRESS"
-		"SOURCE_DIR;DEST_FILE;TARGET;REORDER_FILE"
+		"COMPRESS;OPTIMAL"
+		"SOURCE_DIR;DEST_FILE;TARGET;REORDER_FILE;CACHE_DIR;RESTART_INTERVAL;CODEC"
 		""
 		${ARGN}
 	)
@@ -338,12 +410,27 @@ function(packDirectory)
 	toAbsolute(args_DEST_FILE)
 	FILE(GLOB_RECURSE sourceDirFiles "${args_SOURCE_DIR}/*")
 
-	if(${args_COMPRESS})
+	if(${args_OPTIMAL})
+		set(argsOptional ${argsOptional} -c9)
+	elseif(${args_COMPRESS})
 		set(argsOptional ${argsOptional} -c)
 	endif()
 	if(NOT "${args_REORDER_FILE} " STREQUAL " ")
 		set(argsOptional ${argsOptional} -r ${args_REORDER_FILE})
 	endif()
+	if(NOT "${args_CODEC} " STREQUAL " ")
+		# lzss, lz4 or auto
+		set(argsOptional ${argsOptional} -codec ${args_CODEC})
+	endif()
+	if(NOT "${args_RESTART_INTERVAL} " STREQUAL " ")
+		# Interval in KiB, allows fast seeking in compressed files
+		set(argsOptional ${argsOptional} -rp ${args_RESTART_INTERVAL})
+	endif()
+	if(NOT "${args_CACHE_DIR} " STREQUAL " ")
+		# Compressed files are reused between builds if their contents didn't change
+		toAbsolute(args_CACHE_DIR)
+		set(argsOptional ${argsOptional} -cache ${args_CACHE_DIR})
+	endif()
 
 	add_custom_command(
 		OUTPUT ${args_DEST_FILE}
@@ -25,6 +25,10 @@ extern "C" {
 #define ACE_DEBUG_PTPLAYER
 #endif
 
+// If set, player counts work done in each tick, see ptplayerGetTickStats().
+// Must be set for whole project, e.g. in compiler flags.
+// #define PTPLAYER_TICK_STATS
+
 typedef struct _tPtplayerSfx {
 	UWORD *pData;       ///< Sample start in Chip RAM, even address.
 	UWORD uwWordLength; ///< Sample length in words.
@@ -50,20 +54,35 @@ typedef struct _tPtplayerMod {
 	UBYTE pArrangement[128]; ///< song arrangmenet list (pattern Table).
 	                         /// These list up to 128 pattern numbers
 	                         /// and the order they should be played in.
-	char pFileFormatTag[4];  ///< Should be "M.K." for 31-sample format.
+	char pFileFormatTag[4];  ///< Should be "M.K." for 31-sample format,
+	                         /// "ACEP" for patterns packed by mod_tool.
 	// MOD pattern/sample data follows
 
 	UBYTE *pPatterns;
 	UWORD *pSampleStarts[PTPLAYER_MOD_SAMPLE_COUNT];
 	ULONG ulPatternsSize;
 	UBYTE isOwningSamples;
+	UBYTE isPatternsPacked; ///< If set, pattern rows are decoded during playback.
 } tPtplayerMod;
 
 typedef struct tPtplayerSamplePack {
 	UBYTE ubSampleCount;
 	tPtplayerSfx pSamples[PTPLAYER_MOD_SAMPLE_COUNT];
+	ULONG ulSharedMask; ///< Bit set for samples using data of other ones.
 } tPtplayerSamplePack;
 
+#if defined(PTPLAYER_TICK_STATS)
+/**
+ * @brief Work done by the player in single tick, as CPU usage estimate.
+ * Doesn't include DMA restarts done in the following Timer B interrupt.
+ */
+typedef struct _tPtplayerTickStats {
+	UBYTE ubRows; ///< Pattern rows read.
+	UBYTE ubNotes; ///< Notes with period set.
+	UBYTE ubEffects; ///< Calls to effect handlers.
+} tPtplayerTickStats;
+#endif
+
 typedef void (*tPtplayerCbSongEnd)(void);
 typedef void (*tPtplayerCbE8)(UBYTE ubE8);
 
@@ -355,6 +374,15 @@ void ptplayerSamplePackDestroy(tPtplayerSamplePack *pSamplePack);
  */
 void ptplayerSetE8Callback(tPtplayerCbE8 cbOnE8);
 
+#if defined(PTPLAYER_TICK_STATS)
+/**
+ * @brief Returns work done by the player in last tick.
+ *
+ * @return Pointer to stats, valid until next tick.
+ */
+const tPtplayerTickStats *ptplayerGetTickStats(void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,7 @@ extern "C" {
 #include <ace/utils/extview.h>
 #include <ace/managers/viewport/camera.h>
 #include <ace/managers/viewport/scrollbuffer.h>
+#include <ace/utils/file.h>
 
 typedef ACE_TILEBUFFER_TILE_TYPE tTileBufferTileIndex;
 
@@ -264,6 +265,34 @@ void tileBufferSetTile(
 	tTileBufferManager *pManager, UWORD uwX, UWORD uwY, tTileBufferTileIndex Index
 );
 
+/**
+ * @brief Loads tile indices from map file generated by map_conv tool.
+ *
+ * Map size and tile index size must match the ones of tile buffer.
+ * Tiles aren't redrawn - call tileBufferRedrawAll() afterwards.
+ *
+ * @param pManager The tile manager to be used.
+ * @param szPath Path to map file.
+ * @return 1 on success, otherwise zero.
+ *
+ * @see tileBufferLoadMapFromFd()
+ */
+UBYTE tileBufferLoadMapFromPath(tTileBufferManager *pManager, const char *szPath);
+
+/**
+ * @brief Loads tile indices from map file generated by map_conv tool.
+ *
+ * Map data is read in one go, so it's best used on files inside pak, where
+ * it may be transparently decompressed.
+ *
+ * @param pManager The tile manager to be used.
+ * @param pFile Handle to map file. Will be closed on function return.
+ * @return 1 on success, otherwise zero.
+ *
+ * @see tileBufferLoadMapFromPath()
+ */
+UBYTE tileBufferLoadMapFromFd(tTileBufferManager *pManager, tFile *pFile);
+
 static inline UBYTE tileBufferGetRawCopperlistInstructionCountStart(UBYTE ubBpp) {
     return scrollBufferGetRawCopperlistInstructionCountStart(ubBpp);
 }
@@ -11,9 +11,20 @@ extern "C" {
 
 #include "file.h"
 
+/**
+ * @brief Default buffer size of files opened with DISK_FILE_MODE_READ_STREAM.
+ * Use diskFileOpenStream() to specify other size.
+ */
+#define DISK_FILE_STREAM_BUFFER_SIZE 4096
+
 typedef enum tDiskFileMode {
 	DISK_FILE_MODE_READ,
 	DISK_FILE_MODE_WRITE,
+	/**
+	 * Read with double buffering: diskFileStreamProcess() prefetches the data
+	 * in small steps, so that reads are served from memory.
+	 */
+	DISK_FILE_MODE_READ_STREAM,
 } tDiskFileMode;
 
 /**
@@ -28,6 +39,36 @@ typedef enum tDiskFileMode {
  */
 tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupted);
 
+/**
+ * @brief Opens the filesystem file for streamed reading while the OS is
+ * disabled, e.g. for loading level data during gameplay.
+ *
+ * The file uses two buffers of given size. While the game reads from
+ * the front one, diskFileStreamProcess() fills the back one. A read stalls
+ * for the disk only if both buffers are drained.
+ *
+ * @param szPath Path to file to be opened.
+ * @param uwBufferSize Size of each of two read buffers. Larger buffers allow
+ * reading more data without waiting for the disk.
+ * @return File handle on success, zero on failure.
+ *
+ * @see diskFileStreamProcess()
+ */
+tFile *diskFileOpenStream(const char *szPath, UWORD uwBufferSize);
+
+/**
+ * @brief Prefetches the next part of a file opened for streaming.
+ * Call it once per frame - the time taken is bounded by uwMaxBytes,
+ * plus OS enable/disable overhead.
+ *
+ * @param pFile File opened with diskFileOpenStream() or with
+ * DISK_FILE_MODE_READ_STREAM. Other files are ignored.
+ * @param uwMaxBytes Max number of bytes read from the disk in this call.
+ * @return Number of bytes prefetched. Zero if buffers are full or the end
+ * of the file was reached.
+ */
+UWORD diskFileStreamProcess(tFile *pFile, UWORD uwMaxBytes);
+
 /**
  * @brief Check whether file at given path exists and is not a directory.
  *
@@ -27,6 +27,7 @@ typedef ULONG (*tCbFileGetPos)(void *pData);
 typedef ULONG (*tCbFileGetSize)(void *pData);
 typedef UBYTE (*tCbFileIsEof)(void *pData);
 typedef void (*tCbFileFlush)(void *pData);
+typedef const UBYTE *(*tCbFileGetData)(void *pData);
 
 typedef struct tFileCallbacks {
 	tCbFileClose cbFileClose;
@@ -37,6 +38,11 @@ typedef struct tFileCallbacks {
 	tCbFileGetSize cbFileGetSize;
 	tCbFileIsEof cbFileIsEof;
 	tCbFileFlush cbFileFlush;
+	/**
+	 * Optional. Returns pointer to the whole file contents if they are
+	 * resident in memory, otherwise zero.
+	 */
+	tCbFileGetData cbFileGetData;
 } tFileCallbacks;
 
 typedef struct tFile {
@@ -69,6 +75,42 @@ LONG fileGetSize(tFile *pFile);
 
 void fileWriteStr(tFile *pFile, const char *szLine);
 
+/**
+ * @brief Checks whether the file contents are resident in memory, so that
+ * fileReadAll() returns them without copying.
+ *
+ * @param pFile File handle.
+ * @return 1 if file is memory-resident, otherwise 0.
+ */
+UBYTE fileIsResident(tFile *pFile);
+
+/**
+ * @brief Reads the rest of the file in one go, moving position to its end.
+ *
+ * For memory-resident files, e.g. opened with memFileOpen() or uncompressed
+ * subfiles of preloaded pak, returns pointer to their contents without
+ * copying anything. Otherwise allocates the buffer and reads the data into it.
+ * The returned data must be released with fileReadAllFree() before closing
+ * the file.
+ *
+ * @param pFile File handle.
+ * @param pSize Size of returned data.
+ * @return Pointer to file data, zero on failure or if no data is left.
+ *
+ * @see fileReadAllFree()
+ * @see fileIsResident()
+ */
+const UBYTE *fileReadAll(tFile *pFile, ULONG *pSize);
+
+/**
+ * @brief Releases the data returned by fileReadAll().
+ *
+ * @param pFile File handle passed to fileReadAll().
+ * @param pData Pointer returned by fileReadAll().
+ * @param ulSize Data size returned by fileReadAll().
+ */
+void fileReadAllFree(tFile *pFile, const UBYTE *pData, ULONG ulSize);
+
 #ifdef __cplusplus
 }
 #endif
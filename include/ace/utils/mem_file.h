@@ -0,0 +1,33 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_UTILS_MEM_FILE_H_
+#define _ACE_UTILS_MEM_FILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "file.h"
+
+#if !defined(ACE_FILE_USE_ONLY_DISK)
+
+/**
+ * @brief Opens the memory buffer as a file.
+ * Writes are limited to buffer size. The buffer isn't copied, so it must
+ * remain valid until the file is closed, and isn't freed by fileClose().
+ *
+ * @param pBuffer Buffer with file contents.
+ * @param ulSize Size of buffer, in bytes.
+ * @return File handle on success, zero on failure.
+ */
+tFile *memFileOpen(void *pBuffer, ULONG ulSize);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_UTILS_MEM_FILE_H_
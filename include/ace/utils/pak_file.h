@@ -11,29 +11,139 @@ extern "C" {
 
 
 #include "file.h"
+#include <ace/macros.h>
 
 #if !defined(ACE_FILE_USE_ONLY_DISK)
 
+/**
+ * @brief Entry table is sorted by ascending path checksum, allowing
+ * binary search of subfiles.
+ */
+#define PAK_FILE_FLAG_SORTED BV(0)
+
+/**
+ * @brief Each LZSS-compressed subfile starts with restart point index, allowing
+ * seeking without decompressing the whole preceding data.
+ */
+#define PAK_FILE_FLAG_RESTART_POINTS BV(1)
+
+/**
+ * @brief Codec used for storing subfile data.
+ */
+typedef enum tPakFileCodec {
+	PAK_FILE_CODEC_NONE, ///< Stored as-is.
+	PAK_FILE_CODEC_LZSS, ///< LZSS with 4 KiB window - better ratio.
+	PAK_FILE_CODEC_LZ4, ///< LZ4 in 4 KiB blocks - faster decoding.
+} tPakFileCodec;
+
+// Field order matches the one in pak file so that whole table is read at once
 typedef struct tPakFileEntry {
+	ULONG ulPathChecksum; // adler32
 	ULONG ulOffs;
 	ULONG ulSizeUncompressed;
 	ULONG ulSizeData;
-	ULONG ulPathChecksum; // adler32
+	UBYTE ubCodec; ///< See tPakFileCodec.
+	UBYTE pReserved[3];
 } tPakFileEntry;
 
 typedef struct tPakFile {
 	tFile *pFile;
 	void *pPrevReadSubfile;
 	UWORD uwFileCount;
+	UWORD uwFlags;
 	tPakFileEntry *pEntries;
+	UBYTE *pPreloaded; ///< Whole pak contents if preloaded, otherwise zero.
+	ULONG ulPreloadedSize;
 } tPakFile;
 
+/**
+ * @brief Calculates path hash used by pakFileGetFileByHash() from string
+ * literal, so that it may be folded to a constant by the compiler.
+ * Equivalent to adler32 checksum of the path, written in closed form:
+ * a = 1 + sum(c[i]), b = n + sum((n - i) * c[i]), both modulo 65521.
+ * Paths longer than 64 chars cause a compilation error.
+ *
+ * @param szLiteral Subfile path, as a string literal.
+ */
+#define PAK_FILE_PATH_HASH(szLiteral) (ULONG)( \
+	(sizeof(char[1 - 2 * (sizeof(szLiteral) > 65)]) * 0) + \
+	((((sizeof(szLiteral) - 1 + _PAK_FILE_HASH_SUM_B(szLiteral)) % 65521UL) << 16) | \
+	((1 + _PAK_FILE_HASH_SUM_A(szLiteral)) % 65521UL)) \
+)
+
+// Helpers for PAK_FILE_PATH_HASH
+#define _PAK_FILE_HASH_CHR(s, i) ((i) < sizeof(s) - 1 ? (ULONG)(UBYTE)(s)[(i) < sizeof(s) ? (i) : 0] : 0UL)
+#define _PAK_FILE_HASH_WGT(s, i) ((i) < sizeof(s) - 1 ? (ULONG)(sizeof(s) - 1 - (i)) : 0UL)
+#define _PAK_FILE_HASH_A4(s, i) ( \
+	_PAK_FILE_HASH_CHR(s, i) + _PAK_FILE_HASH_CHR(s, i + 1) + \
+	_PAK_FILE_HASH_CHR(s, i + 2) + _PAK_FILE_HASH_CHR(s, i + 3) \
+)
+#define _PAK_FILE_HASH_B4(s, i) ( \
+	_PAK_FILE_HASH_WGT(s, i) * _PAK_FILE_HASH_CHR(s, i) + \
+	_PAK_FILE_HASH_WGT(s, i + 1) * _PAK_FILE_HASH_CHR(s, i + 1) + \
+	_PAK_FILE_HASH_WGT(s, i + 2) * _PAK_FILE_HASH_CHR(s, i + 2) + \
+	_PAK_FILE_HASH_WGT(s, i + 3) * _PAK_FILE_HASH_CHR(s, i + 3) \
+)
+#define _PAK_FILE_HASH_SUM_A(s) ( \
+	_PAK_FILE_HASH_A4(s, 0) + _PAK_FILE_HASH_A4(s, 4) + _PAK_FILE_HASH_A4(s, 8) + \
+	_PAK_FILE_HASH_A4(s, 12) + _PAK_FILE_HASH_A4(s, 16) + _PAK_FILE_HASH_A4(s, 20) + \
+	_PAK_FILE_HASH_A4(s, 24) + _PAK_FILE_HASH_A4(s, 28) + _PAK_FILE_HASH_A4(s, 32) + \
+	_PAK_FILE_HASH_A4(s, 36) + _PAK_FILE_HASH_A4(s, 40) + _PAK_FILE_HASH_A4(s, 44) + \
+	_PAK_FILE_HASH_A4(s, 48) + _PAK_FILE_HASH_A4(s, 52) + _PAK_FILE_HASH_A4(s, 56) + \
+	_PAK_FILE_HASH_A4(s, 60) \
+)
+#define _PAK_FILE_HASH_SUM_B(s) ( \
+	_PAK_FILE_HASH_B4(s, 0) + _PAK_FILE_HASH_B4(s, 4) + _PAK_FILE_HASH_B4(s, 8) + \
+	_PAK_FILE_HASH_B4(s, 12) + _PAK_FILE_HASH_B4(s, 16) + _PAK_FILE_HASH_B4(s, 20) + \
+	_PAK_FILE_HASH_B4(s, 24) + _PAK_FILE_HASH_B4(s, 28) + _PAK_FILE_HASH_B4(s, 32) + \
+	_PAK_FILE_HASH_B4(s, 36) + _PAK_FILE_HASH_B4(s, 40) + _PAK_FILE_HASH_B4(s, 44) + \
+	_PAK_FILE_HASH_B4(s, 48) + _PAK_FILE_HASH_B4(s, 52) + _PAK_FILE_HASH_B4(s, 56) + \
+	_PAK_FILE_HASH_B4(s, 60) \
+)
+
 tPakFile *pakFileOpen(const char *szPath, UBYTE isUninterrupted);
 
 void pakFileClose(tPakFile *pPakFile);
 
+/**
+ * @brief Loads the whole pak file into memory, so that further subfile
+ * reads don't access the disk. Uncompressed subfiles become memory-resident
+ * and may be accessed without copying via pakFileGetData() or fileReadAll().
+ *
+ * @param pPakFile Pak file to be preloaded.
+ * @return 1 on success, otherwise 0 - pak remains usable from disk.
+ */
+UBYTE pakFilePreload(tPakFile *pPakFile);
+
+/**
+ * @brief Calculates the path hash of given subfile path at runtime.
+ * For constant paths, use PAK_FILE_PATH_HASH() instead.
+ */
+ULONG pakFileGetPathHash(const char *szInternalPath);
+
 tFile *pakFileGetFile(tPakFile *pPakFile, const char *szInternalPath);
 
+/**
+ * @brief Opens the subfile with given path hash.
+ *
+ * @param pPakFile Pak file containing the subfile.
+ * @param ulPathHash Hash of subfile path, e.g. PAK_FILE_PATH_HASH("foo.bm").
+ * @return Subfile handle on success, otherwise zero.
+ */
+tFile *pakFileGetFileByHash(tPakFile *pPakFile, ULONG ulPathHash);
+
+/**
+ * @brief Returns pointer to contents of an uncompressed subfile of
+ * preloaded pak, without copying anything.
+ *
+ * @param pPakFile Pak file preloaded with pakFilePreload().
+ * @param ulPathHash Hash of subfile path, e.g. PAK_FILE_PATH_HASH("foo.bm").
+ * @param pSize Size of the subfile.
+ * @return Pointer to subfile contents, zero if subfile doesn't exist,
+ * is compressed or pak isn't preloaded. Use pakFileGetFileByHash() then.
+ */
+const UBYTE *pakFileGetData(tPakFile *pPakFile, ULONG ulPathHash, ULONG *pSize);
+
 #endif
 
 #ifdef __cplusplus
@@ -16,6 +16,7 @@
 #include "test/lines.h"
 #include "test/buffer_scroll.h"
 #include "test/twister.h"
+#include "test/pak.h"
 
 tStateManager *g_pGameStateManager = 0;
 tState g_pTestStates[TEST_STATE_COUNT] = {
@@ -29,6 +30,7 @@ tState g_pTestStates[TEST_STATE_COUNT] = {
     [TEST_STATE_INTERLEAVED] = {.cbCreate = gsTestInterleavedCreate, .cbLoop = gsTestInterleavedLoop, .cbDestroy = gsTestInterleavedDestroy},
     [TEST_STATE_BUFFER_SCROLL] = {.cbCreate = gsTestBufferScrollCreate, .cbLoop = gsTestBufferScrollLoop, .cbDestroy = gsTestBufferScrollDestroy},
     [TEST_STATE_TWISTER] = {.cbCreate = gsTestTwisterCreate, .cbLoop = gsTestTwisterLoop, .cbDestroy = gsTestTwisterDestroy},
+    [TEST_STATE_PAK] = {.cbCreate = gsTestPakCreate, .cbLoop = gsTestPakLoop, .cbDestroy = gsTestPakDestroy},
 };
 
 #define GENERIC_MAIN_LOOP_CONDITION gameIsRunning() && g_pGameStateManager->pCurrent
@@ -22,6 +22,7 @@ typedef enum tTestState {
 	TEST_STATE_INTERLEAVED,
 	TEST_STATE_BUFFER_SCROLL,
 	TEST_STATE_TWISTER,
+	TEST_STATE_PAK,
 	TEST_STATE_COUNT
 } tTestState;
 
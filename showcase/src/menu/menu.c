@@ -52,7 +52,7 @@ void gsMenuCreate(void) {
 
 	// Prepare menu lists
 	s_pMenuList = menuListCreate(
-		160, 100, 10, 2,
+		160, 100, TEST_STATE_COUNT, 2,
 		s_pMenuFont, FONT_HCENTER|FONT_COOKIE|FONT_SHADOW,
 		1, 2, 3,
 		s_pMenuBfr->pBack
@@ -218,6 +218,7 @@ void menuShowTests(void) {
 	menuListSetEntry(s_pMenuList, TEST_STATE_INTERLEAVED, MENULIST_ENABLED, "Interleaved bitmaps");
 	menuListSetEntry(s_pMenuList, TEST_STATE_BUFFER_SCROLL, MENULIST_ENABLED, "Scroll buffer wrap");
 	menuListSetEntry(s_pMenuList, TEST_STATE_TWISTER, MENULIST_ENABLED, "Twister");
+	menuListSetEntry(s_pMenuList, TEST_STATE_PAK, MENULIST_ENABLED, "Pak read speed");
 	s_ubMenuType = MENU_TESTS;
 
 	// Redraw list
@@ -0,0 +1,159 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "test/pak.h"
+#include <ace/managers/key.h>
+#include <ace/managers/system.h>
+#include <ace/managers/timer.h>
+#include <ace/managers/viewport/simplebuffer.h>
+#include <ace/utils/extview.h>
+#include <ace/utils/font.h>
+#include <ace/utils/pak_file.h>
+#include "game.h"
+
+// Paks are generated from showcase's data dir by CMake if ACE tools are built
+#define PAK_PATH_RAW "data/bench_raw.pak"
+#define PAK_PATH_COMPRESSED "data/bench_compressed.pak"
+#define PAK_SMALL_READ_SIZE 64
+
+typedef struct tPakBenchResult {
+	ULONG ulBytes;
+	ULONG ulTicks;
+	UBYTE isOk;
+} tPakBenchResult;
+
+static tView *s_pView;
+static tVPort *s_pVPort;
+static tSimpleBufferManager *s_pBfr;
+static tFont *s_pFont;
+static tTextBitMap *s_pTextBitMap;
+
+static const char *s_pBenchFiles[] = {
+	"32c_pal.bm", "32c_pal_interleaved.bm", "blitToSmall.bm", "fonts/silkscreen.fnt"
+};
+
+/**
+ * @brief Reads all bench files from given pak, measuring only the read time.
+ *
+ * @param szPakPath Path to pak file.
+ * @param ulReadSize Size of single fileRead() call, zero reads whole file at once.
+ * @param pResult Result of the benchmark.
+ */
+static void testPakBench(
+	const char *szPakPath, ULONG ulReadSize, tPakBenchResult *pResult
+) {
+	pResult->ulBytes = 0;
+	pResult->ulTicks = 0;
+	pResult->isOk = 0;
+
+	tPakFile *pPak = pakFileOpen(szPakPath, 1);
+	if(!pPak) {
+		return;
+	}
+
+	for(UBYTE i = 0; i < ARRAY_SIZE(s_pBenchFiles); ++i) {
+		tFile *pFile = pakFileGetFile(pPak, s_pBenchFiles[i]);
+		if(!pFile) {
+			continue;
+		}
+		ULONG ulSize = fileGetSize(pFile);
+		ULONG ulChunkSize = ulReadSize ? ulReadSize : ulSize;
+		UBYTE *pBuffer = memAllocFast(ulSize);
+
+		ULONG ulStart = timerGetPrec();
+		for(ULONG ulPos = 0; ulPos < ulSize; ulPos += ulChunkSize) {
+			fileRead(pFile, &pBuffer[ulPos], MIN(ulChunkSize, ulSize - ulPos));
+		}
+		pResult->ulTicks += timerGetDelta(ulStart, timerGetPrec());
+		pResult->ulBytes += ulSize;
+
+		memFree(pBuffer, ulSize);
+		fileClose(pFile);
+	}
+
+	pakFileClose(pPak);
+	pResult->isOk = 1;
+}
+
+static void testPakDrawResult(
+	UWORD uwY, const char *szLabel, const tPakBenchResult *pResult
+) {
+	char szLine[60];
+	if(!pResult->isOk) {
+		sprintf(szLine, "%s: no pak", szLabel);
+	}
+	else if(!pResult->ulTicks) {
+		sprintf(szLine, "%s: no data", szLabel);
+	}
+	else {
+		// timerGetPrec(): one tick equals 0.4us on PAL, so 1 byte/tick ~ 2441 KB/s
+		ULONG ulSpeed = (pResult->ulBytes * 2441) / pResult->ulTicks;
+		sprintf(
+			szLine, "%s: %lu KB/s (%lu bytes)", szLabel, ulSpeed, pResult->ulBytes
+		);
+	}
+	fontDrawStr(
+		s_pFont, s_pBfr->pBack, 160, uwY, szLine, 1,
+		FONT_HCENTER | FONT_COOKIE, s_pTextBitMap
+	);
+}
+
+void gsTestPakCreate(void) {
+	// Prepare view & viewport
+	s_pView = viewCreate(0, TAG_DONE);
+	s_pVPort = vPortCreate(0,
+		TAG_VPORT_VIEW, s_pView,
+		TAG_VPORT_BPP, SHOWCASE_BPP,
+		TAG_DONE
+	);
+	s_pBfr = simpleBufferCreate(0,
+		TAG_SIMPLEBUFFER_VPORT, s_pVPort,
+		TAG_SIMPLEBUFFER_BITMAP_FLAGS, BMF_CLEAR,
+		TAG_DONE
+	);
+	s_pVPort->pPalette[0] = 0x000;
+	s_pVPort->pPalette[1] = 0xAAA;
+	s_pVPort->pPalette[2] = 0x666;
+	s_pVPort->pPalette[3] = 0xFFF;
+
+	s_pFont = fontCreateFromPath("data/fonts/silkscreen.fnt");
+	s_pTextBitMap = fontCreateTextBitMap(320, s_pFont->uwHeight);
+
+	// Run benchmarks while OS is still alive, since they need disk access
+	tPakBenchResult sRaw, sCompressed, sCompressedSmall;
+	testPakBench(PAK_PATH_RAW, 0, &sRaw);
+	testPakBench(PAK_PATH_COMPRESSED, 0, &sCompressed);
+	testPakBench(PAK_PATH_COMPRESSED, PAK_SMALL_READ_SIZE, &sCompressedSmall);
+
+	fontDrawStr(
+		s_pFont, s_pBfr->pBack, 160, 40, "Pak read speed", 3,
+		FONT_HCENTER | FONT_COOKIE, s_pTextBitMap
+	);
+	testPakDrawResult(80, "Raw, whole files", &sRaw);
+	testPakDrawResult(100, "Compressed, whole files", &sCompressed);
+	testPakDrawResult(120, "Compressed, 64-byte reads", &sCompressedSmall);
+	fontDrawStr(
+		s_pFont, s_pBfr->pBack, 160, 200, "Press ESC to go back", 2,
+		FONT_HCENTER | FONT_COOKIE, s_pTextBitMap
+	);
+
+	// Display view with its viewports
+	systemUnuse();
+	viewLoad(s_pView);
+}
+
+void gsTestPakLoop(void) {
+	if(keyUse(KEY_ESCAPE)) {
+		stateChange(g_pGameStateManager, &g_pTestStates[TEST_STATE_MENU]);
+		return;
+	}
+	vPortWaitForEnd(s_pVPort);
+}
+
+void gsTestPakDestroy(void) {
+	systemUse();
+	fontDestroyTextBitMap(s_pTextBitMap);
+	fontDestroy(s_pFont);
+	viewDestroy(s_pView);
+}
@@ -37,7 +37,7 @@
 
 //---------------------------------------------------------------------- DEFINES
 
-#define PTPLAYER_SUPPORTED_SAMPLEPACK_VERSION 2
+#define PTPLAYER_SUPPORTED_SAMPLEPACK_VERSION 4
 
 /**
  * @brief Minimum safe CIA timer ticks count after which Paula channel regs can
@@ -65,6 +65,18 @@
 #define MOD_BYTES_PER_NOTE 4
 // Length of single pattern.
 #define MOD_PATTERN_BYTE_SIZE (MOD_ROWS_IN_PATTERN * MOD_NOTES_PER_ROW * MOD_BYTES_PER_NOTE)
+// Length of single pattern row, also mt_PatternPos step.
+#define MOD_ROW_BYTE_SIZE (MOD_NOTES_PER_ROW * MOD_BYTES_PER_NOTE)
+
+// File format tag of MODs with patterns packed by mod_tool.
+#define MOD_PACKED_TAG "ACEP"
+
+// Packed row starts with byte holding 2-bit mode of each note, first note
+// in lowest bits. Data of notes follows in order.
+#define MOD_PACKED_NOTE_EMPTY 0 // All zeros, no data.
+#define MOD_PACKED_NOTE_FULL 1 // 4 bytes of raw note.
+#define MOD_PACKED_NOTE_CMD 2 // 2 bytes of uwCmd, uwNote is zero.
+#define MOD_PACKED_NOTE_REPEAT 3 // Same as in previous row, no data.
 
 // Size of period table.
 #define MOD_PERIOD_TABLE_LENGTH 36
@@ -92,8 +104,14 @@ typedef struct _tModVoice {
 			UWORD uwNote; // [instrumentHi:4] [period:12]
 			union {
 				struct {
+#if defined(PTPLAYER_HOST_LITTLE_ENDIAN)
+					// Host builds (e.g. mod_render tool) keep notes in native endian
+					UBYTE ubCmdLo;
+					UBYTE ubCmdHi;
+#else
 					UBYTE ubCmdHi; // [instrumentLo:4] [cmdNo:4]
 					UBYTE ubCmdLo; // [cmdArg:8] - special effects data
+#endif
 				};
 				UWORD uwCmd; // [instrumentLo:4] [cmdNo:4] [cmdArg:8]
 			};
@@ -102,6 +120,17 @@ typedef struct _tModVoice {
 	};
 } tModVoice;
 
+/**
+ * @brief Position in packed pattern data along with decoded row.
+ * Packed rows may refer to previous ones, so they're decoded in sequence.
+ */
+typedef struct _tPatternCursor {
+	const UBYTE *pNext; ///< Next packed row to be decoded.
+	UWORD uwPatternPos; ///< Position of decoded row, same units as mt_PatternPos.
+	UBYTE ubSongPos; ///< Position in arrangement, 0xFF if nothing is decoded.
+	tModVoice pRow[MOD_NOTES_PER_ROW]; ///< Decoded row.
+} tPatternCursor;
+
 typedef struct _tChannelStatus {
 	tModVoice sVoice;
 
@@ -990,6 +1019,15 @@ static UBYTE mt_SongPos; ///< Position in arrangement.
 static UBYTE mt_PattDelTime;
 static UBYTE mt_PattDelTime2;
 static UBYTE mt_SilCntValid;
+static tPatternCursor s_sPatternCursor; ///< Used by player when patterns are packed.
+static tModVoice s_pCurrentVoices[MOD_NOTES_PER_ROW]; ///< For ptplayerGetCurrentVoices().
+
+#if defined(PTPLAYER_TICK_STATS)
+static tPtplayerTickStats s_sTickStats;
+#define TICK_STATS_ADD(field) ++s_sTickStats.field
+#else
+#define TICK_STATS_ADD(field) do {} while(0)
+#endif
 
 /**
  * Each player loop generates this from scratch.
@@ -1124,6 +1162,71 @@ static inline UBYTE findPeriod(const UWORD *pPeriods, UWORD uwNote) {
 	return MOD_PERIOD_TABLE_LENGTH - 1;
 }
 
+static void patternCursorDecodeRow(tPatternCursor *pCursor) {
+	const UBYTE *pData = pCursor->pNext;
+	UBYTE ubModes = *(pData++);
+	for(UBYTE ubVoice = 0; ubVoice < MOD_NOTES_PER_ROW; ++ubVoice) {
+		tModVoice *pVoice = &pCursor->pRow[ubVoice];
+		switch(ubModes & 3) {
+			case MOD_PACKED_NOTE_EMPTY:
+				pVoice->ulData = 0;
+				break;
+			case MOD_PACKED_NOTE_FULL:
+				pVoice->uwNote = (pData[0] << 8) | pData[1];
+				pVoice->uwCmd = (pData[2] << 8) | pData[3];
+				pData += 4;
+				break;
+			case MOD_PACKED_NOTE_CMD:
+				pVoice->uwNote = 0;
+				pVoice->uwCmd = (pData[0] << 8) | pData[1];
+				pData += 2;
+				break;
+			case MOD_PACKED_NOTE_REPEAT:
+				break;
+		}
+		ubModes >>= 2;
+	}
+	pCursor->pNext = pData;
+}
+
+/**
+ * @brief Returns pattern row at given position.
+ * For packed patterns, the row is decoded using given cursor. Moving forward
+ * within same arrangement position decodes only the rows in between,
+ * otherwise pattern is decoded again from its first row.
+ *
+ * @param pCursor Cursor to be used for packed patterns.
+ * @param ubSongPos Position in arrangement.
+ * @param uwPatternPos Position in pattern, same units as mt_PatternPos.
+ * @return Pointer to row's voices.
+ */
+static const tModVoice *getPatternRow(
+	tPatternCursor *pCursor, UBYTE ubSongPos, UWORD uwPatternPos
+) {
+	UBYTE *pPatterns = s_pCurrentMod->pPatterns;
+	UBYTE ubPatternIdx = s_pCurrentMod->pArrangement[ubSongPos];
+	if(!s_pCurrentMod->isPatternsPacked) {
+		return (const tModVoice*)&pPatterns[ubPatternIdx * MOD_PATTERN_BYTE_SIZE + uwPatternPos];
+	}
+
+	if(pCursor->ubSongPos != ubSongPos || pCursor->uwPatternPos > uwPatternPos) {
+		// Packed data starts with offset of each pattern
+		const ULONG *pOffsets = (const ULONG*)pPatterns;
+		pCursor->pNext = &pPatterns[pOffsets[ubPatternIdx]];
+		pCursor->ubSongPos = ubSongPos;
+		pCursor->uwPatternPos = 0;
+		for(UBYTE ubVoice = 0; ubVoice < MOD_NOTES_PER_ROW; ++ubVoice) {
+			pCursor->pRow[ubVoice].ulData = 0;
+		}
+		patternCursorDecodeRow(pCursor);
+	}
+	while(pCursor->uwPatternPos < uwPatternPos) {
+		patternCursorDecodeRow(pCursor);
+		pCursor->uwPatternPos += MOD_ROW_BYTE_SIZE;
+	}
+	return pCursor->pRow;
+}
+
 static void ptSongStep(void) {
 	mt_PatternPos = mt_PBreakPos;
 	mt_PBreakPos = 0;
@@ -1198,6 +1301,7 @@ void moreBlockedFx(
 		logWrite("ERR: blmorefx_tab index out of range: cmd %hu -> %hu\n", uwCmd, uwCmd >> 8);
 	}
 #endif
+	TICK_STATS_ADD(ubEffects);
 	blmorefx_tab[ubCmdIdx](uwCmd, pChannelData, pChannelReg);
 }
 
@@ -1229,6 +1333,9 @@ static void checkmorefx(
 		logWrite("ERR: morefx_tab index out of range: cmd %hu\n", uwCmd);
 	}
 #endif
+	if(uwCmd || uwCmdArg) {
+		TICK_STATS_ADD(ubEffects);
+	}
 	morefx_tab[uwCmd](uwCmdArg, pChannelData, pChannelReg);
 }
 
@@ -1330,6 +1437,8 @@ static void mt_playvoice(
 		checkmorefx(uwCmd, uwCmdArg, pChannelData, pChannelReg);
 	}
 	else if(uwMaskedCmdE == 0x0E50) {
+		TICK_STATS_ADD(ubNotes);
+		TICK_STATS_ADD(ubEffects);
 		set_finetune(uwCmd, uwCmdArg, uwMaskedCmdE, pVoice, pChannelData, pChannelReg);
 	}
 	else {
@@ -1338,6 +1447,10 @@ static void mt_playvoice(
 			logWrite("ERR: prefx_tab index out of range: cmd %hu\n", uwCmd);
 		}
 #endif
+		TICK_STATS_ADD(ubNotes);
+		if(uwCmd || uwCmdArg) {
+			TICK_STATS_ADD(ubEffects);
+		}
 		prefx_tab[uwCmd](
 			uwCmd, uwCmdArg, uwMaskedCmdE, pVoice, pChannelData, pChannelReg
 		);
@@ -1364,6 +1477,7 @@ static void mt_checkfx(
 			// Channel is blocked, only check some E-commands
 			UWORD uwCmd = pChannelData->sVoice.uwCmd & 0x0FFF;
 			if((uwCmd & 0xF00) == 0xE00) {
+				TICK_STATS_ADD(ubEffects);
 				blocked_e_cmds(uwCmd, pChannelData, pChannelReg);
 			}
 			return;
@@ -1389,6 +1503,7 @@ static void mt_checkfx(
 			logWrite("ERR: fx_tab index out of range: cmd %hhu\n", ubCmdIndex);
 		}
 #endif
+		TICK_STATS_ADD(ubEffects);
 		fx_tab[ubCmdIndex](pChannelData->sVoice.ubCmdLo, pChannelData, pChannelReg);
 	}
 }
@@ -1397,6 +1512,9 @@ static void mt_sfxonly(void);
 static void mt_music(void);
 
 static void intPlay() {
+#if defined(PTPLAYER_TICK_STATS)
+	s_sTickStats = (tPtplayerTickStats){0};
+#endif
 	// it was a TA interrupt, do music when enabled
 	if(mt_Enable) {
 		mt_music();
@@ -1572,11 +1690,10 @@ static void mt_music(void) {
 		mt_Counter = 0;
 		if(mt_PattDelTime2 <= 0) {
 			// determine pointer to current pattern line
-			UBYTE *pPatternData = s_pCurrentMod->pPatterns;
-			UBYTE *pArrangement = s_pCurrentMod->pArrangement;
-			UBYTE ubPatternIdx = pArrangement[mt_SongPos];
-			UBYTE *pCurrentPattern = &pPatternData[ubPatternIdx * 1024];
-			tModVoice *pLineVoices = (tModVoice*)&pCurrentPattern[mt_PatternPos];
+			const tModVoice *pLineVoices = getPatternRow(
+				&s_sPatternCursor, mt_SongPos, mt_PatternPos
+			);
+			TICK_STATS_ADD(ubRows);
 			printVoices(pLineVoices);
 
 			// play new note for each channel, apply some effects
@@ -1701,6 +1818,7 @@ static void mt_reset(void) {
 	mt_PBreakPos = 0;
 	mt_PBreakFlag = 0;
 	mt_PosJumpFlag = 0;
+	s_sPatternCursor.ubSongPos = 0xFF;
 
 #if defined(PTPLAYER_USE_AUDIO_INT_HANDLERS)
 	// Set all channels as done in case of waiting for sfx before any have been
@@ -2777,6 +2895,67 @@ static void ptplayerSfxDecompress(
 	}
 }
 
+/**
+ * @brief Decompresses block DPCM data used by .sfx and sample pack version 3.
+ * Each block starts with header byte: upper 2 bits select mode, lower 6 bits
+ * hold sample count minus one.
+ */
+static void ptplayerSfxDecompressBlocks(
+	const UBYTE *pCompressed, UBYTE *pDecompressed, ULONG ulDecompressedSize
+) {
+	const UBYTE *pDecompressedEnd = &pDecompressed[ulDecompressedSize];
+	UBYTE ubSample = 0;
+	while(pDecompressed < pDecompressedEnd) {
+		UBYTE ubHeader = *(pCompressed++);
+		UWORD uwCount = ubHeader & 0x3F;
+		switch(ubHeader >> 6) {
+			case 0: {
+				// Repeat previous sample
+				do {
+					*(pDecompressed++) = ubSample;
+				} while(uwCount--);
+			} break;
+			case 1: {
+				// 2-bit deltas, starting from the highest bits
+				BYTE bPacked = 0;
+				UBYTE ubLeft = 0;
+				do {
+					if(!ubLeft) {
+						bPacked = *(pCompressed++);
+						ubLeft = 4;
+					}
+					ubSample += bPacked >> 6;
+					bPacked <<= 2;
+					--ubLeft;
+					*(pDecompressed++) = ubSample;
+				} while(uwCount--);
+			} break;
+			case 2: {
+				// 4-bit deltas, starting from the high nibble
+				BYTE bPacked = 0;
+				UBYTE ubLeft = 0;
+				do {
+					if(!ubLeft) {
+						bPacked = *(pCompressed++);
+						ubLeft = 2;
+					}
+					ubSample += bPacked >> 4;
+					bPacked <<= 4;
+					--ubLeft;
+					*(pDecompressed++) = ubSample;
+				} while(uwCount--);
+			} break;
+			default: {
+				// Raw samples
+				do {
+					ubSample = *(pCompressed++);
+					*(pDecompressed++) = ubSample;
+				} while(uwCount--);
+			} break;
+		}
+	}
+}
+
 void ptplayerProcess(void) {
 #if defined(PTPLAYER_DEFER_INTERRUPTS)
 	if(s_isPendingPlay) {
@@ -2795,12 +2974,17 @@ void ptplayerProcess(void) {
 }
 
 const tModVoice *ptplayerGetCurrentVoices(void) {
-	UBYTE *pPatternData = s_pCurrentMod->pPatterns;
-	UBYTE *pArrangement = s_pCurrentMod->pArrangement;
-	UBYTE ubPatternIdx = pArrangement[mt_SongPos];
-	UBYTE *pCurrentPattern = &pPatternData[ubPatternIdx * 1024];
-	tModVoice *pLineVoices = (tModVoice*)&pCurrentPattern[mt_PatternPos];
-	return pLineVoices;
+	if(!s_pCurrentMod->isPatternsPacked) {
+		return getPatternRow(&s_sPatternCursor, mt_SongPos, mt_PatternPos);
+	}
+
+	// Decode on cursor's copy so that player's one stays intact
+	g_pCustom->intena = INTF_INTEN;
+	tPatternCursor sCursor = s_sPatternCursor;
+	const tModVoice *pLineVoices = getPatternRow(&sCursor, mt_SongPos, mt_PatternPos);
+	memcpy(s_pCurrentVoices, pLineVoices, sizeof(s_pCurrentVoices));
+	g_pCustom->intena = INTF_SETCLR | INTF_INTEN;
+	return s_pCurrentVoices;
 }
 
 void ptplayerGetVoiceProgress(UWORD *pCurr, UWORD *pMax) {
@@ -2864,23 +3048,59 @@ tPtplayerMod *ptplayerModCreateFromFd(tFile *pFileMod) {
 	logWrite("Pattern count: %hhu\n", ubPatternCount);
 
 	// Read pattern data
-	pMod->ulPatternsSize = (ubPatternCount * MOD_PATTERN_BYTE_SIZE);
+	pMod->isPatternsPacked = !memcmp(
+		pMod->pFileFormatTag, MOD_PACKED_TAG, sizeof(pMod->pFileFormatTag)
+	);
+	if(pMod->isPatternsPacked) {
+		fileRead(pFileMod, &pMod->ulPatternsSize, sizeof(pMod->ulPatternsSize));
+		logWrite("Packed pattern data size: %lu\n", pMod->ulPatternsSize);
+		if(pMod->ulPatternsSize < ubPatternCount * sizeof(ULONG)) {
+			logWrite("ERR: Packed pattern data too short\n");
+			goto fail;
+		}
+	}
+	else {
+		pMod->ulPatternsSize = (ubPatternCount * MOD_PATTERN_BYTE_SIZE);
+	}
 	pMod->pPatterns = memAllocFast(pMod->ulPatternsSize);
 	if(!pMod->pPatterns) {
 		logWrite("ERR: Couldn't allocate memory for pattern data");
 		goto fail;
 	}
-	fileRead(pFileMod, pMod->pPatterns, pMod->ulPatternsSize);
+	ULONG ulSampleStartPos = fileGetPos(pFileMod) + pMod->ulPatternsSize;
+
+	// Memory-resident pattern & sample data may be copied without going through reads
+	ULONG ulDataSize = 0;
+	const UBYTE *pData = fileIsResident(pFileMod) ? fileReadAll(pFileMod, &ulDataSize) : 0;
+	if(pData) {
+		if(ulDataSize < pMod->ulPatternsSize) {
+			logWrite("ERR: Pattern data too short: %lu\n", ulDataSize);
+			fileReadAllFree(pFileMod, pData, ulDataSize);
+			goto fail;
+		}
+		memcpy(pMod->pPatterns, pData, pMod->ulPatternsSize);
+	}
+	else {
+		fileRead(pFileMod, pMod->pPatterns, pMod->ulPatternsSize);
+	}
 
 	// Read sample data
-	ULONG ulSampleStartPos = fileGetPos(pFileMod);
 	ULONG ulSamplesSize = lSize - ulSampleStartPos;
 	if(ulSamplesSize) {
+		ULONG ulDataPos = pMod->ulPatternsSize;
 		for(UBYTE ubSampleIndex = 0; ubSampleIndex < PTPLAYER_MOD_SAMPLE_COUNT; ++ubSampleIndex) {
 			ULONG ulSampleDataLength = pMod->pSampleHeaders[ubSampleIndex].uwLength * sizeof(UWORD);
 			if(ulSampleDataLength) {
 				pMod->pSampleStarts[ubSampleIndex] = memAllocChip(ulSampleDataLength);
-				fileRead(pFileMod, pMod->pSampleStarts[ubSampleIndex], ulSampleDataLength);
+				if(pData) {
+					// Truncated file leaves the rest of sample uninitialized, same as read
+					ULONG ulCopySize = MIN(ulSampleDataLength, ulDataSize - ulDataPos);
+					memcpy(pMod->pSampleStarts[ubSampleIndex], &pData[ulDataPos], ulCopySize);
+					ulDataPos += ulCopySize;
+				}
+				else {
+					fileRead(pFileMod, pMod->pSampleStarts[ubSampleIndex], ulSampleDataLength);
+				}
 			}
 		}
 		pMod->isOwningSamples = 1;
@@ -2890,6 +3110,7 @@ tPtplayerMod *ptplayerModCreateFromFd(tFile *pFileMod) {
 		logWrite("MOD has no samples - be sure to pass sample pack to ptplayer\n");
 	}
 
+	fileReadAllFree(pFileMod, pData, ulDataSize);
 	fileClose(pFileMod);
 	logBlockEnd("ptplayerModCreateFromFd()");
 	return pMod;
@@ -2952,7 +3173,7 @@ tPtplayerSfx *ptplayerSfxCreateFromFd(tFile *pFileSfx, UBYTE isFast)
 	}
 	UBYTE ubVersion;
 	fileRead(pFileSfx, &ubVersion, sizeof(ubVersion));
-	if(ubVersion == 2) {
+	if(ubVersion == 2 || ubVersion == 3) {
 		fileRead(pFileSfx, &pSfx->uwWordLength, sizeof(pSfx->uwWordLength));
 		ULONG ulByteSize = pSfx->uwWordLength * sizeof(UWORD);
 
@@ -2972,10 +3193,18 @@ tPtplayerSfx *ptplayerSfxCreateFromFd(tFile *pFileSfx, UBYTE isFast)
 		}
 
 		if(ulCompressedSize) {
-			UBYTE *pCompressed = memAllocFast(ulByteSize);
+			UBYTE *pCompressed = memAllocFast(ulCompressedSize);
+			if(!pCompressed) {
+				goto fail;
+			}
 			fileRead(pFileSfx, pCompressed, ulCompressedSize);
-			ptplayerSfxDecompress(pCompressed, (UBYTE*)pSfx->pData, ulByteSize);
-			memFree(pCompressed, ulByteSize);
+			if(ubVersion == 2) {
+				ptplayerSfxDecompress(pCompressed, (UBYTE*)pSfx->pData, ulByteSize);
+			}
+			else {
+				ptplayerSfxDecompressBlocks(pCompressed, (UBYTE*)pSfx->pData, ulByteSize);
+			}
+			memFree(pCompressed, ulCompressedSize);
 		}
 		else {
 			fileRead(pFileSfx, pSfx->pData, ulByteSize);
@@ -3122,30 +3351,23 @@ void ptplayerSfxPlay(
 		mt_chan[2].n_freecnt = 0;
 		mt_chan[3].n_freecnt = 0;
 
-		// get pattern pointer
-		UBYTE *pPatterns = s_pCurrentMod->pPatterns;
-
+		// Look ahead on cursor's copy so that player's one stays intact
+		tPatternCursor sCursor = s_sPatternCursor;
 		UBYTE ubSongPos = mt_SongPos;
 		UWORD uwPatternPos = mt_PatternPos;
 		UBYTE isEnd = 0;
-		UBYTE *pPatternStart = &pPatterns[
-			s_pCurrentMod->pArrangement[ubSongPos] * MOD_PATTERN_BYTE_SIZE
-		];
-		tModVoice *pPatternEnd = (tModVoice*)(pPatternStart + MOD_PATTERN_BYTE_SIZE);
-		tModVoice *pPatternPos = (tModVoice*)(pPatternStart + uwPatternPos);
 		do {
 			UBYTE ubFreeChannelCnt = 4;
+			const tModVoice *pRow = getPatternRow(&sCursor, ubSongPos, uwPatternPos);
 
 			for(UBYTE ubChannel = 0; ubChannel < 4; ++ubChannel) {
 				if(!pMusicOnly[ubChannel]) {
 					++mt_chan[ubChannel].n_freecnt;
-					if(pPatternPos->uwNote) {
+					if(pRow[ubChannel].uwNote) {
 						// The channel at current pattern pos has new note so it's not free
 						pMusicOnly[ubChannel] = 1;
 					}
 				}
-				// Skip to next channel
-				++pPatternPos;
 				ubFreeChannelCnt -= pMusicOnly[ubChannel];
 			}
 
@@ -3153,18 +3375,14 @@ void ptplayerSfxPlay(
 			// otherwise break after 8 pattern steps
 			isEnd = (ubFreeChannelCnt != 0 || --ubSteps == 0);
 
-			// End of pattern reached? Then load next pattern pointer
-			if(!isEnd && pPatternPos >= pPatternEnd) {
+			// End of pattern reached? Then go to next pattern
+			uwPatternPos += MOD_ROW_BYTE_SIZE;
+			if(!isEnd && uwPatternPos >= MOD_PATTERN_BYTE_SIZE) {
 				uwPatternPos = 0;
 				ubSongPos = (mt_SongPos + 1) & 127;
 				if(ubSongPos >= s_pCurrentMod->ubArrangementLength) {
 					ubSongPos = 0;
 				}
-				pPatternStart = &pPatterns[
-					s_pCurrentMod->pArrangement[ubSongPos] * MOD_PATTERN_BYTE_SIZE
-				];
-				pPatternEnd = (tModVoice*)(pPatternStart + MOD_PATTERN_BYTE_SIZE);
-				pPatternPos = (tModVoice*)pPatternStart;
 			}
 		} while(!isEnd);
 		mt_SilCntValid = 1;
@@ -3309,11 +3527,31 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples)
 	}
 	logWrite("Addr: %p\n", pSamplePack);
 	fileRead(pFileSamples, &pSamplePack->ubSampleCount, sizeof(pSamplePack->ubSampleCount));
+	if(pSamplePack->ubSampleCount > PTPLAYER_MOD_SAMPLE_COUNT) {
+		logWrite("ERR: Too many samples: %hhu\n", pSamplePack->ubSampleCount);
+		pSamplePack->ubSampleCount = 0;
+		goto fail;
+	}
 
+	// Samples may use data of other ones, even stored later in file.
+	// Store their source index and offset, resolving them after load.
+	UBYTE pSourceIndices[PTPLAYER_MOD_SAMPLE_COUNT];
+	UWORD pSourceOffsets[PTPLAYER_MOD_SAMPLE_COUNT];
 	for(UBYTE i = 0; i < pSamplePack->ubSampleCount; ++i) {
 		tPtplayerSfx *pSample = &pSamplePack->pSamples[i];
-		ULONG ulCompressedLength;
 		fileRead(pFileSamples, &pSample->uwWordLength, sizeof(pSample->uwWordLength));
+		fileRead(pFileSamples, &pSourceIndices[i], sizeof(pSourceIndices[i]));
+		if(pSourceIndices[i] != i) {
+			if(pSourceIndices[i] >= pSamplePack->ubSampleCount) {
+				logWrite("ERR: Sample %hhu uses data of invalid index: %hhu\n", i, pSourceIndices[i]);
+				goto fail;
+			}
+			fileRead(pFileSamples, &pSourceOffsets[i], sizeof(pSourceOffsets[i]));
+			pSamplePack->ulSharedMask |= BV(i);
+			continue;
+		}
+
+		ULONG ulCompressedLength;
 		fileRead(pFileSamples, &ulCompressedLength, sizeof(ulCompressedLength));
 		pSample->pData = memAllocChip(pSample->uwWordLength * sizeof(UWORD));
 		if(!pSample->pData) {
@@ -3325,7 +3563,7 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples)
 				goto fail;
 			}
 			fileRead(pFileSamples, pCompressed, ulCompressedLength);
-			ptplayerSfxDecompress(pCompressed, (UBYTE*)pSample->pData, pSample->uwWordLength * sizeof(UWORD));
+			ptplayerSfxDecompressBlocks(pCompressed, (UBYTE*)pSample->pData, pSample->uwWordLength * sizeof(UWORD));
 			memFree(pCompressed, ulCompressedLength);
 		}
 		else {
@@ -3333,6 +3571,20 @@ tPtplayerSamplePack *ptplayerSampleDataCreateFromFd(tFile *pFileSamples)
 		}
 	}
 
+	for(UBYTE i = 0; i < pSamplePack->ubSampleCount; ++i) {
+		if(pSamplePack->ulSharedMask & BV(i)) {
+			const tPtplayerSfx *pSource = &pSamplePack->pSamples[pSourceIndices[i]];
+			if(
+				(pSamplePack->ulSharedMask & BV(pSourceIndices[i])) ||
+				pSourceOffsets[i] + pSamplePack->pSamples[i].uwWordLength > pSource->uwWordLength
+			) {
+				logWrite("ERR: Sample %hhu has invalid data source\n", i);
+				goto fail;
+			}
+			pSamplePack->pSamples[i].pData = &pSource->pData[pSourceOffsets[i]];
+		}
+	}
+
 	fileClose(pFileSamples);
 	systemUnuse();
 	logBlockEnd("ptplayerSampleDataCreateFromFd()");
@@ -3344,7 +3596,7 @@ fail:
 	if(pSamplePack) {
 		for(UBYTE i = 0; i < pSamplePack->ubSampleCount; ++i) {
 			tPtplayerSfx *pSample = &pSamplePack->pSamples[i];
-			if(pSample->pData) {
+			if(pSample->pData && !(pSamplePack->ulSharedMask & BV(i))) {
 				memFree(pSample->pData, pSample->uwWordLength * sizeof(UWORD));
 			}
 		}
@@ -3359,8 +3611,10 @@ fail:
 void ptplayerSamplePackDestroy(tPtplayerSamplePack *pSamplePack) {
 	logBlockBegin("ptplayerSamplePackDestroy(pSamplePack: %p)", pSamplePack);
 	for(UBYTE i = 0; i < pSamplePack->ubSampleCount; ++i) {
-		tPtplayerSfx *pSample = &pSamplePack->pSamples[i];
-		memFree(pSample->pData, pSample->uwWordLength * sizeof(UWORD));
+		if(!(pSamplePack->ulSharedMask & BV(i))) {
+			tPtplayerSfx *pSample = &pSamplePack->pSamples[i];
+			memFree(pSample->pData, pSample->uwWordLength * sizeof(UWORD));
+		}
 	}
 	memFree(pSamplePack, sizeof(*pSamplePack));
 	logBlockEnd("ptplayerSamplePackDestroy()");
@@ -3369,3 +3623,9 @@ void ptplayerSamplePackDestroy(tPtplayerSamplePack *pSamplePack) {
 void ptplayerSetE8Callback(tPtplayerCbE8 cbOnE8) {
 	s_cbOnE8 = cbOnE8;
 }
+
+#if defined(PTPLAYER_TICK_STATS)
+const tPtplayerTickStats *ptplayerGetTickStats(void) {
+	return &s_sTickStats;
+}
+#endif
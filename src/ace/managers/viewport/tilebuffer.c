@@ -6,6 +6,7 @@
 #include <ace/macros.h>
 #include <ace/managers/blit.h>
 #include <ace/managers/system.h>
+#include <ace/utils/disk_file.h>
 #include <ace/utils/tag.h>
 #include <proto/exec.h> // Bartman's compiler needs this
 
@@ -24,6 +25,17 @@ static UBYTE shiftFromPowerOfTwo(UWORD uwPot) {
 
 #define BLIT_WORDS_NON_INTERLEAVED_BIT (0b1 << 5) // tileSize is UBYTE, top bit of width is definitely free
 
+static void tileBufferFreeTileData(tTileBufferManager *pManager) {
+	if(pManager->pTileData) {
+		memFree(
+			pManager->pTileData[0], pManager->uTileBounds.uwX *
+			pManager->uTileBounds.uwY * sizeof(pManager->pTileData[0][0])
+		);
+		memFree(pManager->pTileData, pManager->uTileBounds.uwX * sizeof(pManager->pTileData[0]));
+		pManager->pTileData = 0;
+	}
+}
+
 static void tileBufferResetRedrawState(
 	tRedrawState *pState, WORD wStartX, WORD wEndX, WORD wStartY, WORD wEndY
 ) {
@@ -201,14 +213,10 @@ fail:
 }
 
 void tileBufferDestroy(tTileBufferManager *pManager) {
-	UWORD uwCol;
 	logBlockBegin("tileBufferDestroy(pManager: %p)", pManager);
 
 	// Free tile data
-	for(uwCol = pManager->uTileBounds.uwX; uwCol--;) {
-		memFree(pManager->pTileData[uwCol], pManager->uTileBounds.uwY * sizeof(pManager->pTileData[uwCol][0]));
-	}
-	memFree(pManager->pTileData, pManager->uTileBounds.uwX * sizeof(pManager->pTileData[0]));
+	tileBufferFreeTileData(pManager);
 
 	// Free tile offset lookup table
 	if(pManager->pTileSetOffsets) {
@@ -238,13 +246,7 @@ void tileBufferReset(
 	);
 
 	// Free old tile data
-	if(pManager->pTileData) {
-		for(UWORD uwCol = pManager->uTileBounds.uwX; uwCol--;) {
-			memFree(pManager->pTileData[uwCol], pManager->uTileBounds.uwY * sizeof(pManager->pTileData[uwCol][0]));
-		}
-		memFree(pManager->pTileData, pManager->uTileBounds.uwX * sizeof(pManager->pTileData[0]));
-		pManager->pTileData = 0;
-	}
+	tileBufferFreeTileData(pManager);
 
 	// Free old tile offset lookup table
 	if(pManager->pTileSetOffsets) {
@@ -255,9 +257,14 @@ void tileBufferReset(
 	pManager->uTileBounds.uwX = uwTileX;
 	pManager->uTileBounds.uwY = uwTileY;
 	if(uwTileX && uwTileY) {
+		// Columns are stored one after another so that whole map may be
+		// loaded with a single read - see tileBufferLoadMapFromFd()
 		pManager->pTileData = memAllocFast(uwTileX * sizeof(pManager->pTileData[0]));
-		for(UWORD uwCol = uwTileX; uwCol--;) {
-			pManager->pTileData[uwCol] = memAllocFastClear(uwTileY * sizeof(pManager->pTileData[uwCol][0]));
+		pManager->pTileData[0] = memAllocFastClear(
+			uwTileX * uwTileY * sizeof(pManager->pTileData[0][0])
+		);
+		for(UWORD uwCol = 1; uwCol < uwTileX; ++uwCol) {
+			pManager->pTileData[uwCol] = &pManager->pTileData[0][uwCol * uwTileY];
 		}
 	}
 
@@ -841,3 +848,63 @@ void tileBufferSetTile(
  	pManager->pTileData[uwX][uwY] = Index;
 	tileBufferInvalidateTile(pManager, uwX, uwY);
 }
+
+UBYTE tileBufferLoadMapFromPath(tTileBufferManager *pManager, const char *szPath) {
+	return tileBufferLoadMapFromFd(
+		pManager, diskFileOpen(szPath, DISK_FILE_MODE_READ, 1)
+	);
+}
+
+UBYTE tileBufferLoadMapFromFd(tTileBufferManager *pManager, tFile *pFile) {
+	systemUse();
+	logBlockBegin(
+		"tileBufferLoadMapFromFd(pManager: %p, pFile: %p)", pManager, pFile
+	);
+	if(!pFile) {
+		logWrite("ERR: Null file handle\n");
+		logBlockEnd("tileBufferLoadMapFromFd()");
+		systemUnuse();
+		return 0;
+	}
+
+	// Read header
+	UWORD uwTileX, uwTileY;
+	UBYTE ubIndexSize, ubVersion;
+	fileRead(pFile, &uwTileX, sizeof(uwTileX));
+	fileRead(pFile, &uwTileY, sizeof(uwTileY));
+	fileRead(pFile, &ubIndexSize, sizeof(ubIndexSize));
+	fileRead(pFile, &ubVersion, sizeof(ubVersion));
+	fileSeek(pFile, 2 * sizeof(UBYTE), SEEK_CUR); // Skip flags and reserved byte
+
+	UBYTE isOk = 0;
+	if(ubVersion != 0) {
+		logWrite("ERR: Unknown file version: %hhu\n", ubVersion);
+	}
+	else if(ubIndexSize != sizeof(tTileBufferTileIndex)) {
+		logWrite(
+			"ERR: Tile index size mismatch: %hhu, expected %hhu\n",
+			ubIndexSize, (UBYTE)sizeof(tTileBufferTileIndex)
+		);
+	}
+	else if(
+		uwTileX != pManager->uTileBounds.uwX || uwTileY != pManager->uTileBounds.uwY
+	) {
+		logWrite(
+			"ERR: Map size mismatch: %hux%hu, expected %hux%hu\n",
+			uwTileX, uwTileY, pManager->uTileBounds.uwX, pManager->uTileBounds.uwY
+		);
+	}
+	else {
+		// Columns are contiguous, so whole map goes in one read
+		ULONG ulDataSize = (ULONG)uwTileX * uwTileY * sizeof(tTileBufferTileIndex);
+		isOk = (fileRead(pFile, pManager->pTileData[0], ulDataSize) == ulDataSize);
+		if(!isOk) {
+			logWrite("ERR: Map data too short\n");
+		}
+	}
+	fileClose(pFile);
+
+	logBlockEnd("tileBufferLoadMapFromFd()");
+	systemUnuse();
+	return isOk;
+}
@@ -286,6 +286,22 @@ tBitMap *bitmapCreateFromFd(tFile *pFile, UBYTE isFast) {
 		return 0;
 	}
 
+	// Memory-resident bitplane data may be copied without going through reads
+	ULONG ulPlaneSize = (uwWidth >> 3) * uwHeight;
+	ULONG ulDataSize = 0;
+	const UBYTE *pData = fileIsResident(pFile) ? fileReadAll(pFile, &ulDataSize) : 0;
+	if(pData && ulDataSize < ulPlaneSize * ubPlaneCount) {
+		logWrite(
+			"ERR: Bitplane data too short: %lu < %lu\n",
+			ulDataSize, ulPlaneSize * ubPlaneCount
+		);
+		fileReadAllFree(pFile, pData, ulDataSize);
+		fileClose(pFile);
+		logBlockEnd("bitmapCreateFromFd()");
+		systemUnuse();
+		return 0;
+	}
+
 	// Init bitmap
 	UBYTE ubBitmapFlags = 0;
 	if(isFast) {
@@ -295,14 +311,25 @@ tBitMap *bitmapCreateFromFd(tFile *pFile, UBYTE isFast) {
 		pBitMap = bitmapCreate(
 			uwWidth, uwHeight, ubPlaneCount, ubBitmapFlags | BMF_INTERLEAVED
 		);
-		fileRead(pFile, pBitMap->Planes[0], (uwWidth >> 3) * uwHeight * ubPlaneCount);
+		if(pData) {
+			memcpy(pBitMap->Planes[0], pData, ulPlaneSize * ubPlaneCount);
+		}
+		else {
+			fileRead(pFile, pBitMap->Planes[0], ulPlaneSize * ubPlaneCount);
+		}
 	}
 	else {
 		pBitMap = bitmapCreate(uwWidth, uwHeight, ubPlaneCount, ubBitmapFlags);
 		for (i = 0; i != ubPlaneCount; ++i) {
-			fileRead(pFile, pBitMap->Planes[i], (uwWidth >> 3) * uwHeight);
+			if(pData) {
+				memcpy(pBitMap->Planes[i], &pData[ulPlaneSize * i], ulPlaneSize);
+			}
+			else {
+				fileRead(pFile, pBitMap->Planes[i], ulPlaneSize);
+			}
 		}
 	}
+	fileReadAllFree(pFile, pData, ulDataSize);
 	fileClose(pFile);
 
 	logWrite(
@@ -13,10 +13,14 @@
 typedef struct tDiskFileData {
 	FILE *pFileHandle;
 	tDiskFileMode eMode;
-	UBYTE pBuffer[DISK_FILE_BUFFER_SIZE];
+	UBYTE *pBuffer;
+	UWORD uwBufferSize;
 	UWORD uwBufferFill;
 	UWORD uwBufferReadPos;
 	UBYTE isUninterrupted;
+	// Streaming only: data prefetched right after pBuffer's contents
+	UBYTE *pBackBuffer;
+	UWORD uwBackBufferFill;
 } tDiskFileData;
 
 #if !defined(ACE_FILE_USE_ONLY_DISK)
@@ -75,73 +79,93 @@ DISKFILE_PRIVATE void diskFileClose(void *pData) {
 	}
 
 	fclose(pDiskFileData->pFileHandle);
+	if(pDiskFileData->pBackBuffer) {
+		memFree(pDiskFileData->pBackBuffer, pDiskFileData->uwBufferSize);
+	}
+	memFree(pDiskFileData->pBuffer, pDiskFileData->uwBufferSize);
 	memFree(pDiskFileData, sizeof(*pDiskFileData));
 	fileAccessDisable();
 }
 
+static void diskFileBufferSwap(tDiskFileData *pDiskFileData) {
+	UBYTE *pFront = pDiskFileData->pBuffer;
+	pDiskFileData->pBuffer = pDiskFileData->pBackBuffer;
+	pDiskFileData->pBackBuffer = pFront;
+	pDiskFileData->uwBufferFill = pDiskFileData->uwBackBufferFill;
+	pDiskFileData->uwBufferReadPos = 0;
+	pDiskFileData->uwBackBufferFill = 0;
+}
+
+static void diskFileBufferDiscard(tDiskFileData *pDiskFileData) {
+	pDiskFileData->uwBufferReadPos = 0;
+	pDiskFileData->uwBufferFill = 0;
+	pDiskFileData->uwBackBufferFill = 0;
+}
+
 DISKFILE_PRIVATE ULONG diskFileRead(void *pData, void *pDest, ULONG ulSize) {
 	tDiskFileData *pDiskFileData = (tDiskFileData*)pData;
 	UBYTE *pDestBytes = (UBYTE*)pDest;
 	ULONG ulReadCount = 0;
 
-	if(pDiskFileData->eMode != DISK_FILE_MODE_READ) {
+	if(pDiskFileData->eMode == DISK_FILE_MODE_WRITE) {
 		logWrite("ERR: Attempting to read file not opened for read\n");
 	}
 
-	// copy some data from buffer
-	UWORD uwReadyBytes = pDiskFileData->uwBufferFill - pDiskFileData->uwBufferReadPos;
-	UWORD uwBytesToCopy = MIN(uwReadyBytes, ulSize);
-	if(uwBytesToCopy) {
-		for(UWORD i = 0; i < uwBytesToCopy; ++i) {
-			*(pDestBytes++) = pDiskFileData->pBuffer[pDiskFileData->uwBufferReadPos + i];
+	while(ulSize) {
+		// copy some data from buffer
+		UWORD uwReadyBytes = pDiskFileData->uwBufferFill - pDiskFileData->uwBufferReadPos;
+		UWORD uwBytesToCopy = MIN(uwReadyBytes, ulSize);
+		if(uwBytesToCopy) {
+			memcpy(
+				pDestBytes, &pDiskFileData->pBuffer[pDiskFileData->uwBufferReadPos],
+				uwBytesToCopy
+			);
+			pDestBytes += uwBytesToCopy;
+			ulReadCount += uwBytesToCopy;
+			pDiskFileData->uwBufferReadPos += uwBytesToCopy;
+			ulSize -= uwBytesToCopy;
+			if(!ulSize) {
+				break;
+			}
 		}
-		ulReadCount += uwBytesToCopy;
-		pDiskFileData->uwBufferReadPos += uwBytesToCopy;
-		ulSize -= uwBytesToCopy;
-	}
 
-	if(ulSize && ulSize > DISK_FILE_BUFFER_SIZE) {
-		// if remaining data is bigger than buffer, read rest directly
-		if(!pDiskFileData->isUninterrupted) {
-			fileAccessEnable();
+		if(pDiskFileData->uwBackBufferFill) {
+			// Continue with data prefetched by diskFileStreamProcess()
+			diskFileBufferSwap(pDiskFileData);
+			continue;
 		}
-		ULONG ulReadPartSize = fread(pDestBytes, ulSize, 1, pDiskFileData->pFileHandle);
-		pDestBytes += ulReadPartSize;
-		ulReadCount += ulReadPartSize;
-		ulSize -= ulReadPartSize;
 
+		// Nothing buffered - read from the disk, which stalls the caller
 		if(!pDiskFileData->isUninterrupted) {
-			fileAccessDisable();
+			fileAccessEnable();
 		}
-	}
-
-	if(ulSize) {
-		// if not, fill the buffer and read remaining data from buffer
-		if(pDiskFileData->uwBufferFill == pDiskFileData->uwBufferReadPos) {
-			if(!pDiskFileData->isUninterrupted) {
-				fileAccessEnable();
-			}
-
-			pDiskFileData->uwBufferFill = fread(
-				pDiskFileData->pBuffer, DISK_FILE_BUFFER_SIZE, 1,
+		ULONG ulReadPartSize;
+		if(ulSize > pDiskFileData->uwBufferSize) {
+			// if remaining data is bigger than buffer, read rest directly
+			ulReadPartSize = fread(pDestBytes, ulSize, 1, pDiskFileData->pFileHandle);
+			pDestBytes += ulReadPartSize;
+			ulReadCount += ulReadPartSize;
+			ulSize = 0;
+			// Buffer no longer holds data right before the current position
+			pDiskFileData->uwBufferFill = 0;
+			pDiskFileData->uwBufferReadPos = 0;
+		}
+		else {
+			// if not, fill the buffer and read remaining data from buffer
+			ulReadPartSize = fread(
+				pDiskFileData->pBuffer, pDiskFileData->uwBufferSize, 1,
 				pDiskFileData->pFileHandle
 			);
-
-			if(!pDiskFileData->isUninterrupted) {
-				fileAccessDisable();
-			}
+			pDiskFileData->uwBufferFill = ulReadPartSize;
 			pDiskFileData->uwBufferReadPos = 0;
 		}
+		if(!pDiskFileData->isUninterrupted) {
+			fileAccessDisable();
+		}
 
-		uwReadyBytes = pDiskFileData->uwBufferFill - pDiskFileData->uwBufferReadPos;
-		uwBytesToCopy = MIN(uwReadyBytes, ulSize);
-		if(uwBytesToCopy) {
-			for(UWORD i = 0; i < uwBytesToCopy; ++i) {
-				*(pDestBytes++) = pDiskFileData->pBuffer[i];
-			}
-			ulReadCount += uwBytesToCopy;
-			ulSize -= uwBytesToCopy;
-			pDiskFileData->uwBufferReadPos += uwBytesToCopy;
+		if(!ulReadPartSize) {
+			// End of file
+			break;
 		}
 	}
 
@@ -156,7 +180,7 @@ DISKFILE_PRIVATE ULONG diskFileWrite(void *pData, const void *pSrc, ULONG ulSize
 		logWrite("ERR: Attempting to write file not opened for write\n");
 	}
 
-	if(pDiskFileData->uwBufferFill + ulSize < DISK_FILE_BUFFER_SIZE) {
+	if(pDiskFileData->uwBufferFill + ulSize < pDiskFileData->uwBufferSize) {
 		memcpy(&pDiskFileData->pBuffer[pDiskFileData->uwBufferFill], pSrc, ulSize);
 		pDiskFileData->uwBufferFill += ulSize;
 		ulWritten = ulSize;
@@ -208,7 +232,7 @@ DISKFILE_PRIVATE ULONG diskFileSeek(void *pData, LONG lPos, WORD wMode) {
 
 	if(wMode == SEEK_CUR && (
 		(lPos > 0 && lPos < pDiskFileData->uwBufferFill - pDiskFileData->uwBufferReadPos) ||
-		(lPos < pDiskFileData->uwBufferReadPos)
+		(lPos <= 0 && -lPos < pDiskFileData->uwBufferReadPos)
 	)) {
 		pDiskFileData->uwBufferReadPos += lPos;
 		return 0;
@@ -225,10 +249,9 @@ DISKFILE_PRIVATE ULONG diskFileSeek(void *pData, LONG lPos, WORD wMode) {
 	}
 
 	ULONG ulResult = fseek(pDiskFileData->pFileHandle, lPos, wMode);
-	if(pDiskFileData->uwBufferFill) {
+	if(pDiskFileData->uwBufferFill || pDiskFileData->uwBackBufferFill) {
 		logWrite("WARN: slow - read buffer discard\n");
-		pDiskFileData->uwBufferReadPos = 0;
-		pDiskFileData->uwBufferFill = 0;
+		diskFileBufferDiscard(pDiskFileData);
 	}
 
 	if(!pDiskFileData->isUninterrupted) {
@@ -247,6 +270,7 @@ DISKFILE_PRIVATE ULONG diskFileGetPos(void *pData) {
 
 	ULONG ulResult = ftell(pDiskFileData->pFileHandle);
 	ulResult -= pDiskFileData->uwBufferFill - pDiskFileData->uwBufferReadPos;
+	ulResult -= pDiskFileData->uwBackBufferFill;
 
 	if(!pDiskFileData->isUninterrupted) {
 		fileAccessDisable();
@@ -288,7 +312,7 @@ DISKFILE_PRIVATE UBYTE diskFileIsEof(void *pData) {
 
 	UBYTE isEof = (
 		(pDiskFileData->uwBufferReadPos == pDiskFileData->uwBufferFill) &&
-		feof(pDiskFileData->pFileHandle)
+		!pDiskFileData->uwBackBufferFill && feof(pDiskFileData->pFileHandle)
 	);
 
 	if(!pDiskFileData->isUninterrupted) {
@@ -314,11 +338,10 @@ DISKFILE_PRIVATE void diskFileFlush(void *pData) {
 
 //------------------------------------------------------------------- PUBLIC FNS
 
-tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupted) {
-	logBlockBegin(
-		"diskFileOpen(szPath: '%s', eMode: %d, isUninterrupted: %hhu)",
-		szPath, eMode, isUninterrupted
-	);
+static tFile *diskFileOpenWithBuffer(
+	const char *szPath, tDiskFileMode eMode, UWORD uwBufferSize,
+	UBYTE isUninterrupted
+) {
 	// TODO check if disk is read protected when szMode has 'a'/'r'/'x'
 	// TODO: disable buffering in a/w/x modes
 	fileAccessEnable();
@@ -332,9 +355,15 @@ tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupt
 		tDiskFileData *pData = memAllocFast(sizeof(*pData));
 		pData->pFileHandle = pFileHandle;
 		pData->eMode = eMode;
+		pData->uwBufferSize = uwBufferSize;
+		pData->pBuffer = memAllocFast(uwBufferSize);
 		pData->uwBufferFill = 0;
 		pData->uwBufferReadPos = 0;
 		pData->isUninterrupted = isUninterrupted;
+		pData->pBackBuffer = (
+			eMode == DISK_FILE_MODE_READ_STREAM ? memAllocFast(uwBufferSize) : 0
+		);
+		pData->uwBackBufferFill = 0;
 #if defined(ACE_FILE_USE_ONLY_DISK) // TODO: verify if still viable
 		pFile = (tFile*)pData;
 #else
@@ -347,10 +376,97 @@ tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupt
 			fileAccessDisable();
 		}
 	}
+	return pFile;
+}
+
+tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupted) {
+	logBlockBegin(
+		"diskFileOpen(szPath: '%s', eMode: %d, isUninterrupted: %hhu)",
+		szPath, eMode, isUninterrupted
+	);
+	tFile *pFile = diskFileOpenWithBuffer(
+		szPath, eMode, (
+			eMode == DISK_FILE_MODE_READ_STREAM ?
+			DISK_FILE_STREAM_BUFFER_SIZE : DISK_FILE_BUFFER_SIZE
+		), isUninterrupted
+	);
 	logBlockEnd("diskFileOpen()");
 	return pFile;
 }
 
+tFile *diskFileOpenStream(const char *szPath, UWORD uwBufferSize) {
+	logBlockBegin(
+		"diskFileOpenStream(szPath: '%s', uwBufferSize: %hu)", szPath, uwBufferSize
+	);
+	tFile *pFile = 0;
+	if(!uwBufferSize) {
+		logWrite("ERR: Stream buffer size must be non-zero\n");
+	}
+	else {
+		pFile = diskFileOpenWithBuffer(
+			szPath, DISK_FILE_MODE_READ_STREAM, uwBufferSize, 0
+		);
+	}
+	logBlockEnd("diskFileOpenStream()");
+	return pFile;
+}
+
+UWORD diskFileStreamProcess(tFile *pFile, UWORD uwMaxBytes) {
+#if defined(ACE_FILE_USE_ONLY_DISK)
+	tDiskFileData *pDiskFileData = (tDiskFileData*)pFile;
+#else
+	if(pFile->pCallbacks != &s_sDiskFileCallbacks) {
+		// Not a disk file, nothing to prefetch
+		return 0;
+	}
+	tDiskFileData *pDiskFileData = (tDiskFileData*)pFile->pData;
+#endif
+	if(pDiskFileData->eMode != DISK_FILE_MODE_READ_STREAM) {
+		return 0;
+	}
+
+	if(pDiskFileData->uwBufferReadPos == pDiskFileData->uwBufferFill) {
+		if(pDiskFileData->uwBackBufferFill) {
+			// Front buffer is drained - promote prefetched data right away,
+			// so that the next prefetch has the whole back buffer to fill
+			diskFileBufferSwap(pDiskFileData);
+		}
+		else {
+			// Nothing buffered at all - the data is needed soon, so fill
+			// the front buffer first
+			pDiskFileData->uwBufferFill = 0;
+			pDiskFileData->uwBufferReadPos = 0;
+		}
+	}
+
+	UBYTE *pDst;
+	UWORD *pFill;
+	if(!pDiskFileData->uwBufferFill) {
+		pDst = pDiskFileData->pBuffer;
+		pFill = &pDiskFileData->uwBufferFill;
+	}
+	else {
+		pDst = pDiskFileData->pBackBuffer;
+		pFill = &pDiskFileData->uwBackBufferFill;
+	}
+
+	UWORD uwReadSize = MIN(uwMaxBytes, pDiskFileData->uwBufferSize - *pFill);
+	if(!uwReadSize) {
+		// Both buffers are full
+		return 0;
+	}
+
+	if(!pDiskFileData->isUninterrupted) {
+		fileAccessEnable();
+	}
+	UWORD uwRead = fread(&pDst[*pFill], uwReadSize, 1, pDiskFileData->pFileHandle);
+	if(!pDiskFileData->isUninterrupted) {
+		fileAccessDisable();
+	}
+	*pFill += uwRead;
+	return uwRead;
+}
+
 UBYTE diskFileExists(const char *szPath) {
 	fileAccessEnable();
 	UBYTE isExisting = 0;
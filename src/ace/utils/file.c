@@ -5,6 +5,7 @@
 #include <ace/utils/file.h>
 #include <stdarg.h>
 #include <ace/managers/system.h>
+#include <ace/managers/memory.h>
 #include <ace/managers/log.h>
 
 void fileWriteStr(tFile *pFile, const char *szLine) {
@@ -49,6 +50,11 @@ void fileFlush(tFile *pFile) {
 	diskFileFlush(pFile);
 }
 
+static const UBYTE *fileGetResidentData(UNUSED_ARG tFile *pFile) {
+	// Disk files are never memory-resident
+	return 0;
+}
+
 #else
 void fileClose(tFile *pFile) {
 	logWrite("Closing file %p\n", pFile);
@@ -111,4 +117,60 @@ void fileFlush(tFile *pFile) {
 	}
 	pFile->pCallbacks->cbFileFlush(pFile->pData);
 }
+
+static const UBYTE *fileGetResidentData(tFile *pFile) {
+	if(!pFile->pCallbacks->cbFileGetData) {
+		return 0;
+	}
+	return pFile->pCallbacks->cbFileGetData(pFile->pData);
+}
 #endif
+
+UBYTE fileIsResident(tFile *pFile) {
+	if(!pFile) {
+		logWrite("ERR: Null file handle\n");
+		return 0;
+	}
+	return fileGetResidentData(pFile) != 0;
+}
+
+const UBYTE *fileReadAll(tFile *pFile, ULONG *pSize) {
+	*pSize = 0;
+	if(!pFile) {
+		logWrite("ERR: Null file handle\n");
+		return 0;
+	}
+
+	ULONG ulPos = fileGetPos(pFile);
+	ULONG ulSize = fileGetSize(pFile) - ulPos;
+	if(!ulSize) {
+		return 0;
+	}
+
+	const UBYTE *pResident = fileGetResidentData(pFile);
+	if(pResident) {
+		fileSeek(pFile, 0, FILE_SEEK_END);
+		*pSize = ulSize;
+		return &pResident[ulPos];
+	}
+
+	UBYTE *pData = memAllocFast(ulSize);
+	if(!pData) {
+		logWrite("ERR: Couldn't allocate %lu bytes for file contents\n", ulSize);
+		return 0;
+	}
+	ULONG ulRead = fileRead(pFile, pData, ulSize);
+	if(ulRead != ulSize) {
+		logWrite("ERR: Read %lu bytes instead of %lu\n", ulRead, ulSize);
+		memFree(pData, ulSize);
+		return 0;
+	}
+	*pSize = ulSize;
+	return pData;
+}
+
+void fileReadAllFree(tFile *pFile, const UBYTE *pData, ULONG ulSize) {
+	if(pData && !fileGetResidentData(pFile)) {
+		memFree((UBYTE*)pData, ulSize);
+	}
+}
@@ -49,13 +49,39 @@ tFont *fontCreateFromFd(tFile *pFontFile) {
 		pFont, pFont->uwWidth, pFont->ubChars, pFont->uwHeight
 	);
 
-	pFont->pCharOffsets = memAllocFast(sizeof(UWORD) * pFont->ubChars);
-	fileRead(pFontFile, pFont->pCharOffsets, sizeof(UWORD) * pFont->ubChars);
-
+	ULONG ulOffsetsSize = sizeof(UWORD) * pFont->ubChars;
+	pFont->pCharOffsets = memAllocFast(ulOffsetsSize);
 	pFont->pRawData = bitmapCreate(pFont->uwWidth, pFont->uwHeight, 1, 0);
 #ifdef AMIGA
 	UWORD uwPlaneByteSize = ((pFont->uwWidth+15)/16) * 2 * pFont->uwHeight;
-	fileRead(pFontFile, pFont->pRawData->Planes[0], uwPlaneByteSize);
+	ULONG ulDataSize = 0;
+	const UBYTE *pData = (
+		fileIsResident(pFontFile) ? fileReadAll(pFontFile, &ulDataSize) : 0
+	);
+	if(pData && ulDataSize < ulOffsetsSize + uwPlaneByteSize) {
+		logWrite(
+			"ERR: Font data too short: %lu < %lu\n",
+			ulDataSize, ulOffsetsSize + uwPlaneByteSize
+		);
+		fileReadAllFree(pFontFile, pData, ulDataSize);
+		bitmapDestroy(pFont->pRawData);
+		memFree(pFont->pCharOffsets, ulOffsetsSize);
+		memFree(pFont, sizeof(tFont));
+		fileClose(pFontFile);
+		logBlockEnd("fontCreateFromFd()");
+		return 0;
+	}
+
+	if(pData) {
+		// Copy straight from memory-resident file
+		memcpy(pFont->pCharOffsets, pData, ulOffsetsSize);
+		memcpy(pFont->pRawData->Planes[0], &pData[ulOffsetsSize], uwPlaneByteSize);
+	}
+	else {
+		fileRead(pFontFile, pFont->pCharOffsets, ulOffsetsSize);
+		fileRead(pFontFile, pFont->pRawData->Planes[0], uwPlaneByteSize);
+	}
+	fileReadAllFree(pFontFile, pData, ulDataSize);
 #else
 	logWrite("ERR: Unimplemented\n");
 	memFree(pFont, sizeof(tFont));
@@ -0,0 +1,149 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <ace/utils/mem_file.h>
+#include <string.h>
+#include <ace/managers/memory.h>
+#include <ace/managers/log.h>
+
+#if !defined(ACE_FILE_USE_ONLY_DISK)
+
+typedef struct tMemFileData {
+	UBYTE *pBuffer;
+	ULONG ulSize;
+	ULONG ulPos;
+} tMemFileData;
+
+static void memFileClose(void *pData);
+static ULONG memFileRead(void *pData, void *pDest, ULONG ulSize);
+static ULONG memFileWrite(void *pData, const void *pSrc, ULONG ulSize);
+static ULONG memFileSeek(void *pData, LONG lPos, WORD wMode);
+static ULONG memFileGetPos(void *pData);
+static ULONG memFileGetSize(void *pData);
+static UBYTE memFileIsEof(void *pData);
+static void memFileFlush(UNUSED_ARG void *pData);
+static const UBYTE *memFileGetData(void *pData);
+
+static const tFileCallbacks s_sMemFileCallbacks = {
+	.cbFileClose = memFileClose,
+	.cbFileRead = memFileRead,
+	.cbFileWrite = memFileWrite,
+	.cbFileSeek = memFileSeek,
+	.cbFileGetPos = memFileGetPos,
+	.cbFileGetSize = memFileGetSize,
+	.cbFileIsEof = memFileIsEof,
+	.cbFileFlush = memFileFlush,
+	.cbFileGetData = memFileGetData,
+};
+
+//------------------------------------------------------------------ PRIVATE FNS
+
+static void memFileClose(void *pData) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	memFree(pMemFileData, sizeof(*pMemFileData));
+}
+
+static ULONG memFileRead(void *pData, void *pDest, ULONG ulSize) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	ULONG ulRemaining = pMemFileData->ulSize - pMemFileData->ulPos;
+	if(ulRemaining < ulSize) {
+		ulSize = ulRemaining;
+	}
+	memcpy(pDest, &pMemFileData->pBuffer[pMemFileData->ulPos], ulSize);
+	pMemFileData->ulPos += ulSize;
+	return ulSize;
+}
+
+static ULONG memFileWrite(void *pData, const void *pSrc, ULONG ulSize) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	ULONG ulRemaining = pMemFileData->ulSize - pMemFileData->ulPos;
+	if(ulRemaining < ulSize) {
+		logWrite(
+			"ERR: Memory file %p full, writing %lu bytes instead of %lu\n",
+			pMemFileData, ulRemaining, ulSize
+		);
+		ulSize = ulRemaining;
+	}
+	memcpy(&pMemFileData->pBuffer[pMemFileData->ulPos], pSrc, ulSize);
+	pMemFileData->ulPos += ulSize;
+	return ulSize;
+}
+
+static ULONG memFileSeek(void *pData, LONG lPos, WORD wMode) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	if(wMode == FILE_SEEK_SET) {
+		pMemFileData->ulPos = lPos;
+	}
+	else if(wMode == FILE_SEEK_CURRENT) {
+		pMemFileData->ulPos += lPos;
+	}
+	else if(wMode == FILE_SEEK_END) {
+		pMemFileData->ulPos = pMemFileData->ulSize + lPos;
+	}
+
+	if(pMemFileData->ulPos > pMemFileData->ulSize) {
+		logWrite("ERR: Seek position %lu out of range %lu for memFile data %p\n",
+			pMemFileData->ulPos, pMemFileData->ulSize, pMemFileData
+		);
+		pMemFileData->ulPos = pMemFileData->ulSize;
+		return 0;
+	}
+	return 1;
+}
+
+static ULONG memFileGetPos(void *pData) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	return pMemFileData->ulPos;
+}
+
+static ULONG memFileGetSize(void *pData) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	return pMemFileData->ulSize;
+}
+
+static UBYTE memFileIsEof(void *pData) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	return pMemFileData->ulPos >= pMemFileData->ulSize;
+}
+
+static void memFileFlush(UNUSED_ARG void *pData) {
+	// no-op
+}
+
+static const UBYTE *memFileGetData(void *pData) {
+	tMemFileData *pMemFileData = (tMemFileData*)pData;
+
+	return pMemFileData->pBuffer;
+}
+
+//------------------------------------------------------------------- PUBLIC FNS
+
+tFile *memFileOpen(void *pBuffer, ULONG ulSize) {
+	logBlockBegin("memFileOpen(pBuffer: %p, ulSize: %lu)", pBuffer, ulSize);
+	if(!pBuffer) {
+		logWrite("ERR: Null buffer\n");
+		logBlockEnd("memFileOpen()");
+		return 0;
+	}
+
+	tMemFileData *pData = memAllocFast(sizeof(*pData));
+	pData->pBuffer = pBuffer;
+	pData->ulSize = ulSize;
+	pData->ulPos = 0;
+
+	tFile *pFile = memAllocFast(sizeof(*pFile));
+	pFile->pCallbacks = &s_sMemFileCallbacks;
+	pFile->pData = pData;
+	logBlockEnd("memFileOpen()");
+	return pFile;
+}
+
+#endif // !defined(ACE_FILE_USE_ONLY_DISK)
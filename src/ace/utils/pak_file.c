@@ -5,12 +5,33 @@
 #include <ace/utils/pak_file.h>
 #include <string.h>
 #include <ace/utils/disk_file.h>
+#include <ace/utils/mem_file.h>
 #include <ace/managers/memory.h>
 #include <ace/managers/log.h>
 
 #if !defined(ACE_FILE_USE_ONLY_DISK)
 #define ADLER32_MODULO 65521
 
+// Pak file layout, all values big endian:
+// - UWORD file count. If zero, it's followed by:
+//   - UWORD version, up to PAK_FILE_VERSION,
+//   - UWORD flags - see PAK_FILE_FLAG_*,
+//   - UWORD actual file count.
+// - for each file: ULONG path checksum, offset, uncompressed size, data size.
+//   Since version 2, followed by UBYTE codec and 3 reserved bytes.
+// - subfile data. If PAK_FILE_FLAG_RESTART_POINTS is set, each LZSS subfile
+//   starts with ULONG restart interval. If it's non-zero, it's followed
+//   by ULONG packed stream offset of each restart point. Data between restart
+//   points is packed separately, so unpacking may start at any of them.
+//   LZ4 subfiles consist of PAK_FILE_LZ4_BLOCK_SIZE blocks, each prefixed by
+//   UWORD packed size. Block with packed size equal to unpacked one is raw.
+// Legacy paks start directly with the non-zero file count and have no flags.
+// Before version 2, subfiles with data size different than uncompressed one
+// use LZSS, others are stored as-is.
+#define PAK_FILE_VERSION 2
+#define PAK_FILE_ENTRY_SIZE_V1 (4 * sizeof(ULONG))
+#define PAK_FILE_LZ4_BLOCK_SIZE 4096
+
 typedef UBYTE (*tCbCompressReadByte)(UBYTE *pOut, void *pData);
 
 typedef enum tCompressUnpackStateKind {
@@ -24,19 +45,26 @@ typedef enum tCompressUnpackStateKind {
 #define UNPACKER_CTL_BITS 8
 #define UNPACKER_RLE_CTL_BYTES 2
 #define UNPACKER_RLE_MAX_LENGTH (15 + 3)
-#define UNPACKER_PACKED_BUFFER_SIZE (UNPACKER_CTL_BITS * UNPACKER_RLE_CTL_BYTES + (UNPACKER_CTL_BITS / 8))
-#define UNPACKER_UNPACKED_BUFFER_SIZE (UNPACKER_CTL_BITS * UNPACKER_RLE_MAX_LENGTH)
+// Max packed/unpacked size of single ctl byte with all its sequences
+#define UNPACKER_GROUP_PACKED_SIZE (UNPACKER_CTL_BITS * UNPACKER_RLE_CTL_BYTES + (UNPACKER_CTL_BITS / 8))
+#define UNPACKER_GROUP_UNPACKED_SIZE (UNPACKER_CTL_BITS * UNPACKER_RLE_MAX_LENGTH)
+// Packed data is refilled in big blocks to reduce calls to underlying file
+#define UNPACKER_PACKED_BUFFER_SIZE 512
+#define UNPACKER_UNPACKED_BUFFER_SIZE UNPACKER_GROUP_UNPACKED_SIZE
 
 typedef struct tCompressUnpacker {
 	void *pSubfileData;
 	ULONG ulCompressedSize;
 	ULONG ulUncompressedSize;
 	ULONG ulUnpackedCount;
+	ULONG ulRestartInterval; // Zero if stream has no restart points
+	ULONG ulBlockEnd; // Unpacked position at which next restart point starts
 	UWORD uwLookupPos;
 
 	UBYTE ubUnpackedChunkPos;
 	UBYTE ubUnpackedChunkSize;
 	UBYTE *pPackedCurrent;
+	UBYTE *pPackedEnd;
 	UBYTE pLookup[0x1000];
 	UBYTE pUnpacked[UNPACKER_UNPACKED_BUFFER_SIZE];
 	UBYTE pPacked[UNPACKER_PACKED_BUFFER_SIZE];
@@ -48,9 +76,23 @@ typedef struct tPakFileSubfileData {
 	ULONG ulPos;
 } tPakFileSubfileData;
 
+typedef struct tPakFileLz4Data {
+	tFile *pSubfile;
+	ULONG ulSizeUncompressed;
+	ULONG ulPos;
+	ULONG ulBlockPos; ///< Unpacked position of block in pBlock.
+	ULONG ulNextBlockPos; ///< Unpacked position of next block in subfile.
+	UWORD uwBlockFill; ///< Number of valid bytes in pBlock.
+	UBYTE pBlock[PAK_FILE_LZ4_BLOCK_SIZE];
+	UBYTE pPacked[PAK_FILE_LZ4_BLOCK_SIZE];
+} tPakFileLz4Data;
+
 typedef struct tPakFileCompressedData {
 	tCompressUnpacker sUnpacker;
 	tFile *pSubfile;
+	ULONG ulStreamOffs; ///< Size of restart point index preceding packed stream.
+	ULONG *pRestartOffsets; ///< Packed stream offsets of restart points.
+	UWORD uwRestartCount;
 } tPakFileCompressedData;
 
 static void pakSubfileClose(void *pData);
@@ -61,6 +103,7 @@ static ULONG pakSubfileGetPos(void *pData);
 static ULONG pakSubfileGetSize(void *pData);
 static UBYTE pakSubfileIsEof(void *pData);
 static void pakSubfileFlush(UNUSED_ARG void *pData);
+static const UBYTE *pakSubfileGetData(void *pData);
 
 static void pakCompressedClose(void *pData);
 static ULONG pakCompressedRead(void *pData, void *pDest, ULONG ulSize);
@@ -71,6 +114,15 @@ static ULONG pakCompressedGetSize(void *pData);
 static UBYTE pakCompressedIsEof(void *pData);
 static void pakCompressedFlush(UNUSED_ARG void *pData);
 
+static void pakLz4Close(void *pData);
+static ULONG pakLz4Read(void *pData, void *pDest, ULONG ulSize);
+static ULONG pakLz4Write(UNUSED_ARG void *pData, UNUSED_ARG const void *pSrc, UNUSED_ARG ULONG ulSize);
+static ULONG pakLz4Seek(void *pData, LONG lPos, WORD wMode);
+static ULONG pakLz4GetPos(void *pData);
+static ULONG pakLz4GetSize(void *pData);
+static UBYTE pakLz4IsEof(void *pData);
+static void pakLz4Flush(UNUSED_ARG void *pData);
+
 static const tFileCallbacks s_sPakSubfileCallbacks = {
 	.cbFileClose = pakSubfileClose,
 	.cbFileRead = pakSubfileRead,
@@ -80,6 +132,7 @@ static const tFileCallbacks s_sPakSubfileCallbacks = {
 	.cbFileGetSize = pakSubfileGetSize,
 	.cbFileIsEof = pakSubfileIsEof,
 	.cbFileFlush = pakSubfileFlush,
+	.cbFileGetData = pakSubfileGetData,
 };
 
 static const tFileCallbacks s_sPakCompressedCallbacks = {
@@ -93,21 +146,50 @@ static const tFileCallbacks s_sPakCompressedCallbacks = {
 	.cbFileFlush = pakCompressedFlush,
 };
 
+static const tFileCallbacks s_sPakLz4Callbacks = {
+	.cbFileClose = pakLz4Close,
+	.cbFileRead = pakLz4Read,
+	.cbFileWrite = pakLz4Write,
+	.cbFileSeek = pakLz4Seek,
+	.cbFileGetPos = pakLz4GetPos,
+	.cbFileGetSize = pakLz4GetSize,
+	.cbFileIsEof = pakLz4IsEof,
+	.cbFileFlush = pakLz4Flush,
+};
+
 //------------------------------------------------------------------ PRIVATE FNS
 
-void compressUnpackerInit(
-	tCompressUnpacker *pUnpacker, ULONG ulCompressedSize, size_t ulUncompressedSize,
-	void *pSubfileData
-) {
-	pUnpacker->ulUnpackedCount = 0;
-	pUnpacker->uwLookupPos = 0;
+/**
+ * @brief Resets the unpacker so that it continues from given unpacked position.
+ * Position must be either zero or one of restart points and the subfile must
+ * be already positioned at corresponding packed data.
+ */
+static void compressUnpackerRestart(tCompressUnpacker *pUnpacker, ULONG ulUnpackedPos) {
+	pUnpacker->ulUnpackedCount = ulUnpackedPos;
+	pUnpacker->uwLookupPos = ulUnpackedPos & 0xfff;
 	pUnpacker->ubUnpackedChunkPos = 0;
 	pUnpacker->ubUnpackedChunkSize = 0;
+	pUnpacker->pPackedCurrent = &pUnpacker->pPacked[0];
+	pUnpacker->pPackedEnd = &pUnpacker->pPacked[0];
+
+	pUnpacker->ulBlockEnd = pUnpacker->ulUncompressedSize;
+	if(
+		pUnpacker->ulRestartInterval &&
+		pUnpacker->ulUncompressedSize - ulUnpackedPos > pUnpacker->ulRestartInterval
+	) {
+		pUnpacker->ulBlockEnd = ulUnpackedPos + pUnpacker->ulRestartInterval;
+	}
+}
 
+void compressUnpackerInit(
+	tCompressUnpacker *pUnpacker, ULONG ulCompressedSize, size_t ulUncompressedSize,
+	ULONG ulRestartInterval, void *pSubfileData
+) {
 	pUnpacker->ulCompressedSize = ulCompressedSize;
 	pUnpacker->ulUncompressedSize = ulUncompressedSize;
+	pUnpacker->ulRestartInterval = ulRestartInterval;
 	pUnpacker->pSubfileData = pSubfileData;
-	pUnpacker->pPackedCurrent = &pUnpacker->pPacked[UNPACKER_PACKED_BUFFER_SIZE];
+	compressUnpackerRestart(pUnpacker, 0);
 }
 
 static void rleTableWrite(UBYTE *pTable, UWORD *pPos, UBYTE ubData) {
@@ -126,6 +208,130 @@ static UBYTE rleTableRead(const UBYTE *pTable, UWORD *pPos) {
 	return ubData;
 }
 
+/**
+ * @brief Decodes whole ctl groups straight into given buffer, as long as they
+ * are guaranteed to fit in it. Must be called only after previously decoded
+ * chunk was fully consumed.
+ *
+ * @param pUnpacker Unpacker to be used.
+ * @param pOut Destination buffer.
+ * @param ulOutSize Size of destination buffer.
+ * @return Number of decoded bytes, zero if there is no more data to decode.
+ */
+static ULONG compressUnpackerDecode(
+	tCompressUnpacker *pUnpacker, UBYTE *pOut, ULONG ulOutSize
+) {
+	UBYTE *pOutStart = pOut;
+	UBYTE *pPackedCurrent = pUnpacker->pPackedCurrent;
+	UBYTE *pPackedEnd = pUnpacker->pPackedEnd;
+	ULONG ulDecodedPos = pUnpacker->ulUnpackedCount;
+
+	while(ulDecodedPos < pUnpacker->ulUncompressedSize) {
+		if(ulDecodedPos == pUnpacker->ulBlockEnd) {
+			// Crossing restart point - next block starts with new ctl byte, which
+			// is already pointed by pPackedCurrent. Lookup table needs no reset
+			// since the block doesn't reference any data before it.
+			pUnpacker->ulBlockEnd += MIN(
+				pUnpacker->ulRestartInterval,
+				pUnpacker->ulUncompressedSize - pUnpacker->ulBlockEnd
+			);
+		}
+
+		// Don't decode past the end of current block - remaining ctl bits are
+		// padding. This also prevents producing garbage past the end of file.
+		ULONG ulBlockRemaining = pUnpacker->ulBlockEnd - ulDecodedPos;
+		ULONG ulOutRemaining = ulOutSize - (pOut - pOutStart);
+		UBYTE *pGroupEnd;
+		if(ulBlockRemaining < UNPACKER_GROUP_UNPACKED_SIZE && ulBlockRemaining <= ulOutRemaining) {
+			pGroupEnd = pOut + ulBlockRemaining;
+		}
+		else if(ulOutRemaining >= UNPACKER_GROUP_UNPACKED_SIZE) {
+			pGroupEnd = pOut + UNPACKER_GROUP_UNPACKED_SIZE;
+		}
+		else {
+			// Next group might not fit
+			break;
+		}
+
+		if(pPackedEnd - pPackedCurrent < UNPACKER_GROUP_PACKED_SIZE) {
+			// Move unparsed bytes to beginning, fill up the packed buffer.
+			// Read might return 0 if only unparsed bytes are remaining to process
+			UBYTE *pDst = &pUnpacker->pPacked[0];
+			while(pPackedCurrent < pPackedEnd) {
+				*(pDst++) = *(pPackedCurrent++);
+			}
+			pPackedCurrent = &pUnpacker->pPacked[0];
+			pPackedEnd = pDst + pakSubfileRead(
+				pUnpacker->pSubfileData, pDst,
+				&pUnpacker->pPacked[UNPACKER_PACKED_BUFFER_SIZE] - pDst
+			);
+			if(pPackedCurrent == pPackedEnd) {
+				logWrite("ERR: Unexpected end of packed data\n");
+				break;
+			}
+		}
+
+		// Decode next group of data
+		UBYTE *pGroupStart = pOut;
+		UBYTE ubCtl = *(pPackedCurrent++);
+		UBYTE ubBits = UNPACKER_CTL_BITS;
+		while(ubBits--) {
+			if(ubCtl & 1) {
+				UBYTE ubRawByte = *(pPackedCurrent++);
+				rleTableWrite(pUnpacker->pLookup, &pUnpacker->uwLookupPos, ubRawByte);
+				*(pOut++) = ubRawByte;
+			}
+			else {
+				UBYTE ubHi = *(pPackedCurrent++);
+				UBYTE ubLo = *(pPackedCurrent++);
+				ULONG ulRleCtl = (ubHi << 8) | ubLo;
+
+				UWORD uwRleLength = (ulRleCtl & 0xF) + 3;
+				UWORD uwRlePos = ulRleCtl >> 4;
+				while(uwRleLength--) {
+					UBYTE ubRawByte = rleTableRead(pUnpacker->pLookup, &uwRlePos);
+					rleTableWrite(pUnpacker->pLookup, &pUnpacker->uwLookupPos, ubRawByte);
+					*(pOut++) = ubRawByte;
+				}
+			}
+			if(pPackedCurrent == pPackedEnd) {
+				// TODO: optimize packing so that there are always 8 bits to process
+				// at the end - would allow removing this cmp.
+				// Might be impossible for some files? E.g. one with no RLE sequences -
+				// perhaps don't ever use compression for them.
+				break;
+			}
+			if(pOut >= pGroupEnd) {
+				break;
+			}
+			ubCtl >>= 1;
+		}
+		ulDecodedPos += pOut - pGroupStart;
+	}
+
+	pUnpacker->pPackedCurrent = pPackedCurrent;
+	pUnpacker->pPackedEnd = pPackedEnd;
+	return pOut - pOutStart;
+}
+
+/**
+ * @brief Decodes next chunk of data into unpacked buffer. Must be called only
+ * after previous chunk was fully consumed.
+ *
+ * @return 0 on success, -1 if there is no more data to decode.
+ */
+static WORD compressUnpackerDecodeChunk(tCompressUnpacker *pUnpacker) {
+	ULONG ulDecoded = compressUnpackerDecode(
+		pUnpacker, pUnpacker->pUnpacked, UNPACKER_UNPACKED_BUFFER_SIZE
+	);
+	if(!ulDecoded) {
+		return -1;
+	}
+	pUnpacker->ubUnpackedChunkSize = ulDecoded;
+	pUnpacker->ubUnpackedChunkPos = 0;
+	return 0;
+}
+
 static WORD compressUnpackerReadNext(tCompressUnpacker *pUnpacker, UBYTE *pOut, ULONG ulReadSize) {
 	UBYTE ubReadSize = MIN((UBYTE)(pUnpacker->ubUnpackedChunkSize - pUnpacker->ubUnpackedChunkPos), ulReadSize);
 	UBYTE ubReadPos = pUnpacker->ubUnpackedChunkPos;
@@ -138,59 +344,25 @@ static WORD compressUnpackerReadNext(tCompressUnpacker *pUnpacker, UBYTE *pOut,
 		return ubReadSize;
 	}
 
-	if(pUnpacker->ulUnpackedCount >= pUnpacker->ulUncompressedSize) {
-		return -1;
-	}
+	return compressUnpackerDecodeChunk(pUnpacker);
+}
 
-	// Move unparsed bytes to beginning, fill up the packed buffer
-	UBYTE *pPackedCurrent = pUnpacker->pPackedCurrent;
-	UBYTE *pDst = &pUnpacker->pPacked[0];
-	UBYTE *pEnd = &pUnpacker->pPacked[UNPACKER_PACKED_BUFFER_SIZE];
-	while(pPackedCurrent < pEnd) {
-		*(pDst++) = *(pPackedCurrent++);
-	}
-
-	// Read might return 0 if only unparsed bytes are remaining to process
-	pEnd = pDst + pakSubfileRead(pUnpacker->pSubfileData, pDst, pEnd - pDst);
-
-	// Decode next portion of data
-	pPackedCurrent = &pUnpacker->pPacked[0];
-	UBYTE ubCtl = *(pPackedCurrent++);
-	UBYTE ubBits = UNPACKER_CTL_BITS;
-	UBYTE *pUnpacked = pUnpacker->pUnpacked;
-
-	while(ubBits--) {
-		if(ubCtl & 1) {
-			UBYTE ubRawByte = *(pPackedCurrent++);
-			rleTableWrite(pUnpacker->pLookup, &pUnpacker->uwLookupPos, ubRawByte);
-			*(pUnpacked++) = ubRawByte;
-		}
-		else {
-			UBYTE ubHi = *(pPackedCurrent++);
-			UBYTE ubLo = *(pPackedCurrent++);
-			ULONG ulRleCtl = (ubHi << 8) | ubLo;
-
-			UWORD uwRleLength = (ulRleCtl & 0xF) + 3;
-			UWORD uwRlePos = ulRleCtl >> 4;
-			while(uwRleLength--) {
-				UBYTE ubRawByte = rleTableRead(pUnpacker->pLookup, &uwRlePos);
-				rleTableWrite(pUnpacker->pLookup, &pUnpacker->uwLookupPos, ubRawByte);
-				*(pUnpacked++) = ubRawByte;
+static void compressUnpackerSkip(tCompressUnpacker *pUnpacker, ULONG ulSkipSize) {
+	while(ulSkipSize) {
+		UBYTE ubChunkRemaining = pUnpacker->ubUnpackedChunkSize - pUnpacker->ubUnpackedChunkPos;
+		if(!ubChunkRemaining) {
+			if(compressUnpackerDecodeChunk(pUnpacker) < 0) {
+				break;
 			}
+			continue;
 		}
-		if(pPackedCurrent == pEnd) {
-			// TODO: optimize packing so that there are always 8 bits to process
-			// at the end - would allow removing this cmp.
-			// Might be impossible for some files? E.g. one with no RLE sequences -
-			// perhaps don't ever use compression for them.
-			break;
-		}
-		ubCtl >>= 1;
+
+		// Consume decoded chunk without copying it anywhere
+		UBYTE ubSkip = MIN(ubChunkRemaining, ulSkipSize);
+		pUnpacker->ubUnpackedChunkPos += ubSkip;
+		pUnpacker->ulUnpackedCount += ubSkip;
+		ulSkipSize -= ubSkip;
 	}
-	pUnpacker->ubUnpackedChunkSize = pUnpacked - pUnpacker->pUnpacked;
-	pUnpacker->pPackedCurrent = pPackedCurrent;
-	pUnpacker->ubUnpackedChunkPos = 0;
-	return 0;
 }
 
 static ULONG adler32Buffer(const UBYTE *pData, ULONG ulDataSize) {
@@ -296,9 +468,39 @@ static void pakSubfileFlush(UNUSED_ARG void *pData) {
 	// no-op
 }
 
+static const UBYTE *pakSubfileGetData(void *pData) {
+	tPakFileSubfileData *pSubfileData = (tPakFileSubfileData*)pData;
+	const tPakFile *pPak = pSubfileData->pPak;
+
+	if(!pPak->pPreloaded || pSubfileData->pEntry->ubCodec != PAK_FILE_CODEC_NONE) {
+		// Compressed data is useless without decompression
+		return 0;
+	}
+	return &pPak->pPreloaded[pSubfileData->pEntry->ulOffs];
+}
+
+static void pakCompressedRestart(tPakFileCompressedData *pCompressedData, UWORD uwRestartIndex) {
+	// Restart point 0 is the beginning of the packed stream
+	ULONG ulStreamPos = uwRestartIndex ? pCompressedData->pRestartOffsets[uwRestartIndex - 1] : 0;
+	pakSubfileSeek(
+		pCompressedData->pSubfile->pData, pCompressedData->ulStreamOffs + ulStreamPos,
+		FILE_SEEK_SET
+	);
+	compressUnpackerRestart(
+		&pCompressedData->sUnpacker,
+		uwRestartIndex * pCompressedData->sUnpacker.ulRestartInterval
+	);
+}
+
 static void pakCompressedClose(void *pData) {
 	tPakFileCompressedData *pCompressedData = (tPakFileCompressedData*)pData;
 	fileClose(pCompressedData->pSubfile);
+	if(pCompressedData->uwRestartCount) {
+		memFree(
+			pCompressedData->pRestartOffsets,
+			sizeof(pCompressedData->pRestartOffsets[0]) * pCompressedData->uwRestartCount
+		);
+	}
 	memFree(pCompressedData, sizeof(*pCompressedData));
 }
 
@@ -309,6 +511,20 @@ static ULONG pakCompressedRead(void *pData, void *pDest, ULONG ulSize) {
 	UBYTE *pDestByte = pDest;
 
 	while(ulRemaining) {
+		if(
+			ulRemaining >= UNPACKER_GROUP_UNPACKED_SIZE &&
+			pUnpacker->ubUnpackedChunkPos == pUnpacker->ubUnpackedChunkSize
+		) {
+			// Fast path for big reads - decode straight into destination buffer
+			ULONG ulDecoded = compressUnpackerDecode(pUnpacker, pDestByte, ulRemaining);
+			if(ulDecoded) {
+				pUnpacker->ulUnpackedCount += ulDecoded;
+				pDestByte += ulDecoded;
+				ulRemaining -= ulDecoded;
+				continue;
+			}
+		}
+
 		WORD wRead = compressUnpackerReadNext(pUnpacker, pDestByte, ulRemaining);
 		if(wRead < 0) {
 			break;
@@ -328,12 +544,15 @@ static ULONG pakCompressedWrite(
 
 static ULONG pakCompressedSeek(void *pData, LONG lPos, WORD wMode) {
 	tPakFileCompressedData *pCompressedData = (tPakFileCompressedData*)pData;
-	// seek forward: unpack some bytes to void
-	// seek backward: restart unpacker and unpack some bytes to void
+	tCompressUnpacker *pUnpacker = &pCompressedData->sUnpacker;
+	// seek forward: unpack some bytes to void, or jump to restart point if
+	// there is one between current and target position
+	// seek backward: restart unpacker at nearest restart point or the beginning
+	// and unpack some bytes to void
 
-	ULONG ulPosCurrent = pCompressedData->sUnpacker.ulUnpackedCount;
+	ULONG ulPosCurrent = pUnpacker->ulUnpackedCount;
 	ULONG ulPosTarget;
-	ULONG ulFileSize = pCompressedData->sUnpacker.ulUncompressedSize;
+	ULONG ulFileSize = pUnpacker->ulUncompressedSize;
 	if(wMode == SEEK_CUR) {
 		ulPosTarget = ulPosCurrent + lPos;
 	}
@@ -353,25 +572,25 @@ static ULONG pakCompressedSeek(void *pData, LONG lPos, WORD wMode) {
 	}
 
 	if(ulPosTarget == ulFileSize) {
-		pCompressedData->sUnpacker.ulUnpackedCount = ulFileSize;
+		// Also discard remaining decoded bytes so that they won't be read
+		pUnpacker->ulUnpackedCount = ulFileSize;
+		pUnpacker->ubUnpackedChunkPos = pUnpacker->ubUnpackedChunkSize;
 		return 1;
 	}
 
-	if(ulPosTarget < ulPosCurrent) {
-		logWrite("WARN: Huge performance penalty due to going back in compressed file. Do you *really* need to do it?\n");
-		compressUnpackerInit(
-			&pCompressedData->sUnpacker,
-			pCompressedData->sUnpacker.ulCompressedSize,
-			pCompressedData->sUnpacker.ulUncompressedSize,
-			pCompressedData->pSubfile->pData
-		);
+	if(pCompressedData->uwRestartCount) {
+		UWORD uwRestartIndex = ulPosTarget / pUnpacker->ulRestartInterval;
+		ULONG ulRestartPos = uwRestartIndex * pUnpacker->ulRestartInterval;
+		if(ulPosTarget < ulPosCurrent || ulRestartPos > ulPosCurrent) {
+			pakCompressedRestart(pCompressedData, uwRestartIndex);
+		}
 	}
-
-	while(pCompressedData->sUnpacker.ulUnpackedCount < ulPosTarget) {
-		UBYTE ubDummy;
-		pakCompressedRead(pData, &ubDummy, 1);
+	else if(ulPosTarget < ulPosCurrent) {
+		logWrite("WARN: Huge performance penalty due to going back in compressed file. Do you *really* need to do it?\n");
+		pakCompressedRestart(pCompressedData, 0);
 	}
 
+	compressUnpackerSkip(pUnpacker, ulPosTarget - pUnpacker->ulUnpackedCount);
 	return 1;
 }
 
@@ -394,16 +613,260 @@ static void pakCompressedFlush(UNUSED_ARG void *pData) {
 	// no-op
 }
 
-static UWORD pakFileGetFileIndex(const tPakFile *pPakFile, const char *szPath) {
-	ULONG ulPathHash = adler32Buffer((UBYTE*)szPath, strlen(szPath)); // TODO: Calculate path hash
+/**
+ * @brief Decodes single LZ4 block. Matches are copied from already decoded
+ * output, so no lookup table is needed.
+ *
+ * @return Number of decoded bytes.
+ */
+static UWORD lz4DecodeBlock(const UBYTE *pSrc, UWORD uwSrcSize, UBYTE *pDest) {
+	const UBYTE *pSrcEnd = &pSrc[uwSrcSize];
+	UBYTE *pDestStart = pDest;
+	for(;;) {
+		UBYTE ubToken = *(pSrc++);
+		UWORD uwLiteralCount = ubToken >> 4;
+		if(uwLiteralCount == 15) {
+			UBYTE ubNext;
+			do {
+				ubNext = *(pSrc++);
+				uwLiteralCount += ubNext;
+			} while(ubNext == 255);
+		}
+		while(uwLiteralCount--) {
+			*(pDest++) = *(pSrc++);
+		}
+		if(pSrc >= pSrcEnd) {
+			// Last sequence has only literals
+			break;
+		}
+
+		UWORD uwMatchOffset = pSrc[0] | (pSrc[1] << 8);
+		pSrc += 2;
+		UWORD uwMatchLength = ubToken & 0xF;
+		if(uwMatchLength == 15) {
+			UBYTE ubNext;
+			do {
+				ubNext = *(pSrc++);
+				uwMatchLength += ubNext;
+			} while(ubNext == 255);
+		}
+		uwMatchLength += 4;
+
+		// Byte by byte, since match may overlap with data being written
+		const UBYTE *pMatch = pDest - uwMatchOffset;
+		while(uwMatchLength--) {
+			*(pDest++) = *(pMatch++);
+		}
+	}
+	return pDest - pDestStart;
+}
+
+/**
+ * @brief Reads next block from subfile and decodes it into given buffer, which
+ * must hold at least PAK_FILE_LZ4_BLOCK_SIZE bytes or remaining file size.
+ */
+static UBYTE pakLz4ReadBlock(tPakFileLz4Data *pLz4Data, UBYTE *pDest) {
+	UWORD uwBlockSize = MIN(
+		PAK_FILE_LZ4_BLOCK_SIZE,
+		pLz4Data->ulSizeUncompressed - pLz4Data->ulNextBlockPos
+	);
+	UWORD uwPackedSize;
+	void *pSubfileData = pLz4Data->pSubfile->pData;
+	if(pakSubfileRead(pSubfileData, &uwPackedSize, sizeof(uwPackedSize)) != sizeof(uwPackedSize)) {
+		logWrite("ERR: Unexpected end of LZ4 data\n");
+		return 0;
+	}
+
+	if(uwPackedSize == uwBlockSize) {
+		// Raw block - read straight into destination
+		pakSubfileRead(pSubfileData, pDest, uwBlockSize);
+	}
+	else {
+		pakSubfileRead(pSubfileData, pLz4Data->pPacked, uwPackedSize);
+		if(lz4DecodeBlock(pLz4Data->pPacked, uwPackedSize, pDest) != uwBlockSize) {
+			logWrite("ERR: LZ4 block at %lu decoded to wrong size\n", pLz4Data->ulNextBlockPos);
+			return 0;
+		}
+	}
+	pLz4Data->ulNextBlockPos += uwBlockSize;
+	return 1;
+}
+
+static void pakLz4Close(void *pData) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	fileClose(pLz4Data->pSubfile);
+	memFree(pLz4Data, sizeof(*pLz4Data));
+}
+
+static ULONG pakLz4Read(void *pData, void *pDest, ULONG ulSize) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	UBYTE *pDestByte = pDest;
+
+	ULONG ulFileRemaining = pLz4Data->ulSizeUncompressed - pLz4Data->ulPos;
+	if(ulSize > ulFileRemaining) {
+		ulSize = ulFileRemaining;
+	}
+
+	ULONG ulRemaining = ulSize;
+	while(ulRemaining) {
+		ULONG ulBlockOffs = pLz4Data->ulPos - pLz4Data->ulBlockPos;
+		if(pLz4Data->ulPos >= pLz4Data->ulBlockPos && ulBlockOffs < pLz4Data->uwBlockFill) {
+			// Serve from already decoded block
+			UWORD uwCopySize = MIN(pLz4Data->uwBlockFill - ulBlockOffs, ulRemaining);
+			memcpy(pDestByte, &pLz4Data->pBlock[ulBlockOffs], uwCopySize);
+			pDestByte += uwCopySize;
+			ulRemaining -= uwCopySize;
+			pLz4Data->ulPos += uwCopySize;
+			continue;
+		}
+
+		ULONG ulBlockPos = pLz4Data->ulNextBlockPos;
+		UWORD uwBlockSize = MIN(
+			PAK_FILE_LZ4_BLOCK_SIZE, pLz4Data->ulSizeUncompressed - ulBlockPos
+		);
+		if(pLz4Data->ulPos == ulBlockPos && ulRemaining >= uwBlockSize) {
+			// Whole block is needed - decode it straight into destination
+			if(!pakLz4ReadBlock(pLz4Data, pDestByte)) {
+				break;
+			}
+			pDestByte += uwBlockSize;
+			ulRemaining -= uwBlockSize;
+			pLz4Data->ulPos += uwBlockSize;
+		}
+		else {
+			pLz4Data->uwBlockFill = 0;
+			if(!pakLz4ReadBlock(pLz4Data, pLz4Data->pBlock)) {
+				break;
+			}
+			pLz4Data->ulBlockPos = ulBlockPos;
+			pLz4Data->uwBlockFill = uwBlockSize;
+		}
+	}
+	return ulSize - ulRemaining;
+}
+
+static ULONG pakLz4Write(
+	UNUSED_ARG void *pData, UNUSED_ARG const void *pSrc, UNUSED_ARG ULONG ulSize
+) {
+	logWrite("ERR: Unsupported: pakLz4Write()\n");
+	return 0;
+}
+
+static ULONG pakLz4Seek(void *pData, LONG lPos, WORD wMode) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	ULONG ulPosTarget;
+	if(wMode == SEEK_CUR) {
+		ulPosTarget = pLz4Data->ulPos + lPos;
+	}
+	else if(wMode == SEEK_END) {
+		ulPosTarget = pLz4Data->ulSizeUncompressed + lPos;
+	}
+	else { // (wMode == SEEK_SET)
+		ulPosTarget = lPos;
+	}
+
+	if(ulPosTarget > pLz4Data->ulSizeUncompressed) {
+		logWrite(
+			"ERR: Seek position %lu out of range %lu for LZ4 pakFile\n",
+			ulPosTarget, pLz4Data->ulSizeUncompressed
+		);
+		return 0;
+	}
+
+	// Blocks may be skipped without decoding using their size prefixes.
+	// Target block will be decoded on next read.
+	ULONG ulTargetBlockPos = ulPosTarget & ~(ULONG)(PAK_FILE_LZ4_BLOCK_SIZE - 1);
+	UBYTE isInDecodedBlock = (
+		ulPosTarget >= pLz4Data->ulBlockPos &&
+		ulPosTarget - pLz4Data->ulBlockPos < pLz4Data->uwBlockFill
+	);
+	if(!isInDecodedBlock && ulPosTarget < pLz4Data->ulSizeUncompressed) {
+		void *pSubfileData = pLz4Data->pSubfile->pData;
+		if(ulTargetBlockPos < pLz4Data->ulNextBlockPos) {
+			pakSubfileSeek(pSubfileData, 0, FILE_SEEK_SET);
+			pLz4Data->ulNextBlockPos = 0;
+		}
+		while(pLz4Data->ulNextBlockPos < ulTargetBlockPos) {
+			UWORD uwPackedSize;
+			pakSubfileRead(pSubfileData, &uwPackedSize, sizeof(uwPackedSize));
+			pakSubfileSeek(pSubfileData, uwPackedSize, FILE_SEEK_CURRENT);
+			pLz4Data->ulNextBlockPos += PAK_FILE_LZ4_BLOCK_SIZE;
+		}
+		pLz4Data->uwBlockFill = 0;
+	}
+	pLz4Data->ulPos = ulPosTarget;
+	return 1;
+}
+
+static ULONG pakLz4GetPos(void *pData) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	return pLz4Data->ulPos;
+}
+
+static ULONG pakLz4GetSize(void *pData) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	return pLz4Data->ulSizeUncompressed;
+}
+
+static UBYTE pakLz4IsEof(void *pData) {
+	tPakFileLz4Data *pLz4Data = (tPakFileLz4Data*)pData;
+	return pLz4Data->ulPos >= pLz4Data->ulSizeUncompressed;
+}
+
+static void pakLz4Flush(UNUSED_ARG void *pData) {
+	// no-op
+}
+
+static UWORD pakFileGetFileIndex(const tPakFile *pPakFile, ULONG ulPathHash) {
+	const tPakFileEntry *pEntries = pPakFile->pEntries;
+	if(pPakFile->uwFlags & PAK_FILE_FLAG_SORTED) {
+		UWORD uwLo = 0;
+		UWORD uwHi = pPakFile->uwFileCount;
+		while(uwLo < uwHi) {
+			UWORD uwMid = (uwLo + uwHi) >> 1;
+			ULONG ulMidChecksum = pEntries[uwMid].ulPathChecksum;
+			if(ulMidChecksum == ulPathHash) {
+				return uwMid;
+			}
+			if(ulMidChecksum < ulPathHash) {
+				uwLo = uwMid + 1;
+			}
+			else {
+				uwHi = uwMid;
+			}
+		}
+		return UWORD_MAX;
+	}
+
 	for(UWORD i = 0; i < pPakFile->uwFileCount; ++i) {
-		if(pPakFile->pEntries[i].ulPathChecksum == ulPathHash) {
+		if(pEntries[i].ulPathChecksum == ulPathHash) {
 			return i;
 		}
 	}
 	return UWORD_MAX;
 }
 
+static void pakFileEntriesFromV1(
+	tPakFileEntry *pEntries, const ULONG *pEntriesV1, UWORD uwFileCount
+) {
+	// Going from first entry, each one is written at or before its source,
+	// so read all fields before writing them
+	for(UWORD i = 0; i < uwFileCount; ++i) {
+		ULONG ulPathChecksum = *(pEntriesV1++);
+		ULONG ulOffs = *(pEntriesV1++);
+		ULONG ulSizeUncompressed = *(pEntriesV1++);
+		ULONG ulSizeData = *(pEntriesV1++);
+		tPakFileEntry *pEntry = &pEntries[i];
+		pEntry->ulPathChecksum = ulPathChecksum;
+		pEntry->ulOffs = ulOffs;
+		pEntry->ulSizeUncompressed = ulSizeUncompressed;
+		pEntry->ulSizeData = ulSizeData;
+		pEntry->ubCodec = (
+			ulSizeUncompressed != ulSizeData ? PAK_FILE_CODEC_LZSS : PAK_FILE_CODEC_NONE
+		);
+	}
+}
+
 //------------------------------------------------------------------- PUBLIC FNS
 
 tPakFile *pakFileOpen(const char *szPath, UBYTE isUninterrupted) {
@@ -417,15 +880,44 @@ tPakFile *pakFileOpen(const char *szPath, UBYTE isUninterrupted) {
 	tPakFile *pPakFile = memAllocFast(sizeof(*pPakFile));
 	pPakFile->pFile = pMainFile;
 	pPakFile->pPrevReadSubfile = 0;
+	pPakFile->uwFlags = 0;
+	pPakFile->pPreloaded = 0;
+	pPakFile->ulPreloadedSize = 0;
 	fileRead(pMainFile, &pPakFile->uwFileCount, sizeof(pPakFile->uwFileCount));
+	UWORD uwVersion = 0;
+	if(pPakFile->uwFileCount == 0) {
+		fileRead(pMainFile, &uwVersion, sizeof(uwVersion));
+		if(uwVersion == 0 || uwVersion > PAK_FILE_VERSION) {
+			logWrite("ERR: Unsupported pak version: %hu\n", uwVersion);
+			fileClose(pMainFile);
+			memFree(pPakFile, sizeof(*pPakFile));
+			logBlockEnd("pakFileOpen()");
+			return 0;
+		}
+		fileRead(pMainFile, &pPakFile->uwFlags, sizeof(pPakFile->uwFlags));
+		fileRead(pMainFile, &pPakFile->uwFileCount, sizeof(pPakFile->uwFileCount));
+	}
 	pPakFile->pEntries = memAllocFast(sizeof(pPakFile->pEntries[0]) * pPakFile->uwFileCount);
-	for(UWORD i = 0; i < pPakFile->uwFileCount; ++i) {
-		fileRead(pMainFile, &pPakFile->pEntries[i].ulPathChecksum, sizeof(pPakFile->pEntries[i].ulPathChecksum));
-		fileRead(pMainFile, &pPakFile->pEntries[i].ulOffs, sizeof(pPakFile->pEntries[i].ulOffs));
-		fileRead(pMainFile, &pPakFile->pEntries[i].ulSizeUncompressed, sizeof(pPakFile->pEntries[i].ulSizeUncompressed));
-		fileRead(pMainFile, &pPakFile->pEntries[i].ulSizeData, sizeof(pPakFile->pEntries[i].ulSizeData));
+	if(uwVersion >= 2) {
+		fileRead(
+			pMainFile, pPakFile->pEntries,
+			sizeof(pPakFile->pEntries[0]) * pPakFile->uwFileCount
+		);
 	}
-	logWrite("Pak file: %p, file count: %hu\n", pPakFile, pPakFile->uwFileCount);
+	else {
+		// Older entries are smaller - read them at the end of the table
+		// and spread them to their places
+		ULONG *pEntriesV1 = (ULONG*)(
+			(UBYTE*)&pPakFile->pEntries[pPakFile->uwFileCount] -
+			PAK_FILE_ENTRY_SIZE_V1 * pPakFile->uwFileCount
+		);
+		fileRead(pMainFile, pEntriesV1, PAK_FILE_ENTRY_SIZE_V1 * pPakFile->uwFileCount);
+		pakFileEntriesFromV1(pPakFile->pEntries, pEntriesV1, pPakFile->uwFileCount);
+	}
+	logWrite(
+		"Pak file: %p, version: %hu, file count: %hu, flags: %04hX\n",
+		pPakFile, uwVersion, pPakFile->uwFileCount, pPakFile->uwFlags
+	);
 
 	logBlockEnd("pakFileOpen()");
 	return pPakFile;
@@ -434,27 +926,78 @@ tPakFile *pakFileOpen(const char *szPath, UBYTE isUninterrupted) {
 void pakFileClose(tPakFile *pPakFile) {
 	logBlockBegin("pakFileClose(pPakFile: %p)", pPakFile);
 	fileClose(pPakFile->pFile);
+	if(pPakFile->pPreloaded) {
+		memFree(pPakFile->pPreloaded, pPakFile->ulPreloadedSize);
+	}
 	memFree(pPakFile->pEntries, sizeof(pPakFile->pEntries[0]) * pPakFile->uwFileCount);
 	memFree(pPakFile, sizeof(*pPakFile));
 	logBlockEnd("pakFileClose()");
 }
 
+UBYTE pakFilePreload(tPakFile *pPakFile) {
+	logBlockBegin("pakFilePreload(pPakFile: %p)", pPakFile);
+	if(pPakFile->pPreloaded) {
+		logBlockEnd("pakFilePreload()");
+		return 1;
+	}
+
+	ULONG ulSize = fileGetSize(pPakFile->pFile);
+	UBYTE *pPreloaded = memAllocFast(ulSize);
+	if(!pPreloaded) {
+		logWrite("ERR: Couldn't allocate %lu bytes for pak contents\n", ulSize);
+		logBlockEnd("pakFilePreload()");
+		return 0;
+	}
+	fileSeek(pPakFile->pFile, 0, FILE_SEEK_SET);
+	ULONG ulRead = fileRead(pPakFile->pFile, pPreloaded, ulSize);
+	if(ulRead != ulSize) {
+		logWrite("ERR: Read %lu bytes instead of %lu\n", ulRead, ulSize);
+		memFree(pPreloaded, ulSize);
+		logBlockEnd("pakFilePreload()");
+		return 0;
+	}
+
+	// Subfiles access the main file only by seek & read, so memory file
+	// transparently replaces the disk one
+	fileClose(pPakFile->pFile);
+	pPakFile->pFile = memFileOpen(pPreloaded, ulSize);
+	pPakFile->pPreloaded = pPreloaded;
+	pPakFile->ulPreloadedSize = ulSize;
+	pPakFile->pPrevReadSubfile = 0;
+	logWrite("Preloaded %lu bytes\n", ulSize);
+	logBlockEnd("pakFilePreload()");
+	return 1;
+}
+
+ULONG pakFileGetPathHash(const char *szInternalPath) {
+	return adler32Buffer((const UBYTE*)szInternalPath, strlen(szInternalPath));
+}
+
 tFile *pakFileGetFile(tPakFile *pPakFile, const char *szInternalPath) {
 	logBlockBegin("pakFileGetFile(pPakFile: %p, szInternalPath: '%s')", pPakFile, szInternalPath);
-	UWORD uwFileIndex = pakFileGetFileIndex(pPakFile, szInternalPath);
+	tFile *pFile = pakFileGetFileByHash(pPakFile, pakFileGetPathHash(szInternalPath));
+	logBlockEnd("pakFileGetFile()");
+	return pFile;
+}
+
+tFile *pakFileGetFileByHash(tPakFile *pPakFile, ULONG ulPathHash) {
+	logBlockBegin("pakFileGetFileByHash(pPakFile: %p, ulPathHash: %08lX)", pPakFile, ulPathHash);
+	UWORD uwFileIndex = pakFileGetFileIndex(pPakFile, ulPathHash);
 	if(uwFileIndex == UWORD_MAX) {
 		logWrite("ERR: Can't find subfile in pakfile\n");
-		logBlockEnd("pakFileGetFile()");
+		logBlockEnd("pakFileGetFileByHash()");
 		return 0;
 	}
-	UBYTE isCompressed = pPakFile->pEntries[uwFileIndex].ulSizeUncompressed != pPakFile->pEntries[uwFileIndex].ulSizeData;
+	const tPakFileEntry *pEntry = &pPakFile->pEntries[uwFileIndex];
 	logWrite(
-		"Subfile index: %hu, offset: %lu, size: %lu, compressed: %hhu\n",
-		uwFileIndex,
-		pPakFile->pEntries[uwFileIndex].ulOffs,
-		pPakFile->pEntries[uwFileIndex].ulSizeUncompressed,
-		isCompressed
+		"Subfile index: %hu, offset: %lu, size: %lu, codec: %hhu\n",
+		uwFileIndex, pEntry->ulOffs, pEntry->ulSizeUncompressed, pEntry->ubCodec
 	);
+	if(pEntry->ubCodec > PAK_FILE_CODEC_LZ4) {
+		logWrite("ERR: Unsupported codec\n");
+		logBlockEnd("pakFileGetFileByHash()");
+		return 0;
+	}
 
 	// Create tFile, fill subfileData
 	tPakFileSubfileData *pSubfileData = memAllocFast(sizeof(*pSubfileData));
@@ -468,13 +1011,37 @@ tFile *pakFileGetFile(tPakFile *pPakFile, const char *szInternalPath) {
 	pFile->pCallbacks = &s_sPakSubfileCallbacks;
 	pFile->pData = pSubfileData;
 
-	if(isCompressed) {
+	if(pEntry->ubCodec == PAK_FILE_CODEC_LZSS) {
 		tPakFileCompressedData *pCompressedData = memAllocFast(sizeof(*pCompressedData));
 		pCompressedData->pSubfile = pFile;
+		pCompressedData->ulStreamOffs = 0;
+		pCompressedData->uwRestartCount = 0;
+		pCompressedData->pRestartOffsets = 0;
+		ULONG ulRestartInterval = 0;
+		if(pPakFile->uwFlags & PAK_FILE_FLAG_RESTART_POINTS) {
+			fileRead(pFile, &ulRestartInterval, sizeof(ulRestartInterval));
+			pCompressedData->ulStreamOffs += sizeof(ulRestartInterval);
+			if(ulRestartInterval) {
+				// There's no restart point at the beginning of the stream
+				pCompressedData->uwRestartCount = (
+					pEntry->ulSizeUncompressed - 1
+				) / ulRestartInterval;
+			}
+			if(pCompressedData->uwRestartCount) {
+				ULONG ulIndexSize = sizeof(pCompressedData->pRestartOffsets[0]) * pCompressedData->uwRestartCount;
+				pCompressedData->pRestartOffsets = memAllocFast(ulIndexSize);
+				fileRead(pFile, pCompressedData->pRestartOffsets, ulIndexSize);
+				pCompressedData->ulStreamOffs += ulIndexSize;
+			}
+			logWrite(
+				"Restart interval: %lu, restart points: %hu\n",
+				ulRestartInterval, pCompressedData->uwRestartCount
+			);
+		}
 		compressUnpackerInit(
 			&pCompressedData->sUnpacker,
-			pPakFile->pEntries[uwFileIndex].ulSizeData,
-			pPakFile->pEntries[uwFileIndex].ulSizeUncompressed,
+			pEntry->ulSizeData - pCompressedData->ulStreamOffs,
+			pEntry->ulSizeUncompressed, ulRestartInterval,
 			pCompressedData->pSubfile->pData
 		);
 
@@ -483,9 +1050,41 @@ tFile *pakFileGetFile(tPakFile *pPakFile, const char *szInternalPath) {
 		pCompressedFile->pData = pCompressedData;
 		pFile = pCompressedFile;
 	}
+	else if(pEntry->ubCodec == PAK_FILE_CODEC_LZ4) {
+		tPakFileLz4Data *pLz4Data = memAllocFast(sizeof(*pLz4Data));
+		pLz4Data->pSubfile = pFile;
+		pLz4Data->ulSizeUncompressed = pEntry->ulSizeUncompressed;
+		pLz4Data->ulPos = 0;
+		pLz4Data->ulBlockPos = 0;
+		pLz4Data->ulNextBlockPos = 0;
+		pLz4Data->uwBlockFill = 0;
+
+		tFile *pLz4File = memAllocFast(sizeof(*pLz4File));
+		pLz4File->pCallbacks = &s_sPakLz4Callbacks;
+		pLz4File->pData = pLz4Data;
+		pFile = pLz4File;
+	}
 
-	logBlockEnd("pakFileGetFile()");
+	logBlockEnd("pakFileGetFileByHash()");
 	return pFile;
 }
 
+const UBYTE *pakFileGetData(tPakFile *pPakFile, ULONG ulPathHash, ULONG *pSize) {
+	*pSize = 0;
+	if(!pPakFile->pPreloaded) {
+		return 0;
+	}
+	UWORD uwFileIndex = pakFileGetFileIndex(pPakFile, ulPathHash);
+	if(uwFileIndex == UWORD_MAX) {
+		logWrite("ERR: Can't find subfile %08lX in pakfile\n", ulPathHash);
+		return 0;
+	}
+	const tPakFileEntry *pEntry = &pPakFile->pEntries[uwFileIndex];
+	if(pEntry->ubCodec != PAK_FILE_CODEC_NONE) {
+		return 0;
+	}
+	*pSize = pEntry->ulSizeData;
+	return &pPakFile->pPreloaded[pEntry->ulOffs];
+}
+
 #endif
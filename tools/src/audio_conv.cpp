@@ -2,12 +2,15 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <cmath>
 #include <optional>
+#include <thread>
 #include "common/logging.h"
 #include "common/fs.h"
 #include "common/sfx.h"
 #include "common/wav.h"
 #include "common/math.h"
+#include "common/resample.h"
 
 void printUsage(const std::string &szAppName) {
 	using fmt::print;
@@ -24,6 +27,11 @@ void printUsage(const std::string &szAppName) {
 	print("\t-fpt        Enforce ptplayer-friendly mode: adds empty sample at the beginning, if missing\n");
 	print("\t-fpad N     Force given byte-padding\n");
 	print("\t-sa N       Split sample after every given number of bytes, or kbytes if value ends with k\n");
+	print("\t-r N        Resample to rate closest to N Hz which gives exact Paula period\n");
+	print("\t-ntsc       Use NTSC clock when choosing Paula period for -r. Default: PAL\n");
+	print("\t-rq Q       Resampling quality: fast, medium or best. Default: medium\n");
+	print("\t-dither D   Dithering when converting to 8 bits: none, tpdf or shaped. Default: shaped\n");
+	print("\t-j N        Number of resampling threads. Default: number of CPU cores\n");
 	print("Default conversions:\n");
 	print("\t.wav -> .sfx\n");
 	print("\t.sfx -> .wav\n");
@@ -50,6 +58,11 @@ int main(int lArgCount, const char *pArgs[]) {
 	bool isForcePt = false;
 	std::optional<uint8_t> oForcePad;
 	std::optional<uint32_t> oSplitAfter;
+	std::optional<uint32_t> oSampleRate;
+	bool isNtsc = false;
+	tResampleQuality eQuality = tResampleQuality::MEDIUM;
+	tSfxDither eDither = tSfxDither::SHAPED;
+	std::uint32_t ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
 	for(auto ArgIndex = 2; ArgIndex < lArgCount; ++ArgIndex) {
 		std::string_view Arg = pArgs[ArgIndex];
 		if(Arg == "-o"sv && ArgIndex < lArgCount -1) {
@@ -80,7 +93,7 @@ int main(int lArgCount, const char *pArgs[]) {
 		}
 		else if(Arg == "-fpt"sv) {
 			isForcePt = true;
-			oForcePad = std::min<uint8_t>(oForcePad.value_or(0), 2);
+			oForcePad = std::max<uint8_t>(oForcePad.value_or(0), 2);
 		}
 		else if(Arg == "-fpad"sv && ArgIndex < lArgCount -1) {
 			oForcePad = uint8_t(std::stoul(pArgs[++ArgIndex]));
@@ -98,6 +111,27 @@ int main(int lArgCount, const char *pArgs[]) {
 				oSplitAfter = oSplitAfter.value() * 1024;
 			}
 		}
+		else if(Arg == "-r"sv && ArgIndex < lArgCount -1) {
+			oSampleRate = uint32_t(std::stoul(pArgs[++ArgIndex]));
+		}
+		else if(Arg == "-ntsc"sv) {
+			isNtsc = true;
+		}
+		else if(Arg == "-rq"sv && ArgIndex < lArgCount -1) {
+			if(!resampleParseQuality(pArgs[++ArgIndex], eQuality)) {
+				nLog::error("Illegal -rq value: '{}'", pArgs[ArgIndex]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(Arg == "-dither"sv && ArgIndex < lArgCount -1) {
+			if(!sfxParseDither(pArgs[++ArgIndex], eDither)) {
+				nLog::error("Illegal -dither value: '{}'", pArgs[ArgIndex]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(Arg == "-j"sv && ArgIndex < lArgCount -1) {
+			ulThreadCount = std::max(1ul, std::stoul(pArgs[++ArgIndex]));
+		}
 		else {
 			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
 			printUsage(pArgs[0]);
@@ -129,7 +163,32 @@ int main(int lArgCount, const char *pArgs[]) {
 			nLog::error("No data read from WAV file");
 			return EXIT_FAILURE;
 		}
-		In = tSfx(Wav, isStrict);
+		if(oSampleRate.has_value()) {
+			std::uint16_t uwPeriod;
+			double dRate = resampleGetPaulaRate(oSampleRate.value(), isNtsc, uwPeriod);
+			if(dRate == 0) {
+				nLog::error("Sample rate {} Hz is out of Paula range", oSampleRate.value());
+				return EXIT_FAILURE;
+			}
+
+			// Stored rate must give back the same period in ptplayer
+			auto ulRate = std::uint32_t(std::round(dRate));
+			double dClock = dRate * uwPeriod;
+			if(std::uint32_t((dClock + ulRate / 2) / ulRate) != uwPeriod) {
+				nLog::warn("Sample rate {} Hz can't be stored exactly, period will differ", ulRate);
+			}
+			fmt::print(
+				"Resampling from {} Hz to {:.2f} Hz, {} period: {}\n",
+				Wav.getSampleRate(), dRate, isNtsc ? "NTSC" : "PAL", uwPeriod
+			);
+			auto vSamples = resampleSinc(
+				Wav.getMonoSamples(), Wav.getSampleRate(), dRate, eQuality, ulThreadCount
+			);
+			In = tSfx(vSamples, ulRate, eDither);
+		}
+		else {
+			In = tSfx(Wav, isStrict, eDither);
+		}
 		if(In.isEmpty()) {
 			nLog::error("No valid data to convert");
 			return EXIT_FAILURE;
@@ -2,15 +2,37 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "common/logging.h"
 #include "common/fs.h"
 #include "common/rgb.h"
 #include "common/bitmap.h"
+#include "common/parse.h"
+#include "common/json.h"
+#include "common/quantize.h"
+
+struct tBitmapJob {
+	std::string szInput;
+	std::string szOutput;
+	std::string szMask;
+	bool isWriteInterleaved = false;
+	bool isEnabledOutputMask = true;
+	bool isEnabledOutput = true;
+	bool isMaskColor = false;
+	tRgb MaskColor;
+	bool isQuantize = false;
+	tQuantizeDither eDither = QUANTIZE_DITHER_NONE;
+	std::uint32_t ulThreadCount = 1;
+};
 
 void printUsage(const std::string &szAppName)
 {
 	using fmt::print;
-	print("Usage:\n\t{} palPath inPath [extraOpts]\n\n", szAppName);
+	print("Usage:\n\t{} palPath inPath [extraOpts]\n", szAppName);
+	print("\t{} -m manifestPath [-j threadCount]\n\n", szAppName);
 	print("palPath\t - path to supported palette file\n");
 	print("inPath\t - path to supported input bitmap file\n");
 	print("extraOpts:\n");
@@ -22,138 +44,98 @@ void printUsage(const std::string &szAppName)
 	print("\t\t\tto use same path as .bm with \"_mask.bm\" suffix\n");
 	print("\t-nmo\t\tDon't generate mask output file\n");
 	print("\t-no\t\tDon't generate bitplane output file\n");
+	print("\t-q\t\tRemap colors outside palette to nearest ones instead of failing\n");
+	print("\t-qd dither\tDithering used by -q: none (default), ordered, fs (Floyd-Steinberg)\n");
+	print("\t-qg bpp\t\tGenerate palette with 2^bpp colors from inPath, save it to palPath\n");
+	print("\t\t\tand use it with -q. With -ehb, bpp must be 6.\n");
+	print("\t-qocs\t\tLimit generated palette to 12-bit colors\n");
+	print("\t-j threadCount\tNumber of threads used by -q. Default: number of CPU cores\n");
 	print("Default conversions:\n");
 	print("\t.bm -> .png (will try to read mask from inPath_mask.bm)\n");
 	print("\t.png -> .bm (will write mask to outPath_mask.bm if -mc was specified)\n");
+	print("Batch mode:\n");
+	print("\t-m manifestPath\tConvert all bitmaps listed in JSON manifest, sharing the palette:\n");
+	print("\t\t\t{{\"palette\": \"pal.gpl\", \"ehb\": false, \"bitmaps\": [\n");
+	print("\t\t\t\t{{\"in\": \"a.png\", \"out\": \"a.bm\", \"mask\": \"a_mask.bm\",\n");
+	print("\t\t\t\t\"maskColor\": \"#FF00FF\", \"interleaved\": true,\n");
+	print("\t\t\t\t\"quantize\": false, \"dither\": \"none\"}}\n");
+	print("\t\t\t]}}\n");
+	print("\t\t\tEmpty \"out\" or \"mask\" skips given output, same as -no and -nmo.\n");
+	print("\t-j threadCount\tNumber of conversion threads. Default: number of CPU cores\n");
 }
 
-int main(int lArgCount, const char *pArgs[])
+static bool convertBitmap(const tPalette &Palette, tBitmapJob Job)
 {
-	const std::uint8_t ubMandatoryArgCnt = 2;
-	if(lArgCount - 1 < ubMandatoryArgCnt) {
-		nLog::error("Too few arguments, expected {}", ubMandatoryArgCnt);
-		printUsage(pArgs[0]);
-		return EXIT_FAILURE;
-	}
-
-	std::string szPalette = pArgs[1], szInput = pArgs[2];
-	std::string szOutput = "", szMask = "";
-	bool isWriteInterleaved = false;
-	bool isEhb = false;
-	bool isEnabledOutputMask = true;
-	bool isEnabledOutput = true;
-	bool isMaskColor = false;
-	tRgb MaskColor;
-
-	for(auto ArgIndex = ubMandatoryArgCnt + 1; ArgIndex < lArgCount; ++ArgIndex) {
-		if(pArgs[ArgIndex] == std::string("-o")) {
-			auto &Value = pArgs[++ArgIndex];
-			szOutput = Value;
-		}
-		else if(pArgs[ArgIndex] == std::string("-i")) {
-			isWriteInterleaved = true;
-		}
-		else if(pArgs[ArgIndex] == std::string("-ehb")) {
-			isEhb = true;
-		}
-		else if(pArgs[ArgIndex] == std::string("-mc") && ArgIndex < lArgCount - 1) {
-			isMaskColor = true;
-			auto &Value = pArgs[++ArgIndex];
-			MaskColor = tRgb(Value);
-		}
-		else if(pArgs[ArgIndex] == std::string("-mf") && ArgIndex < lArgCount - 1) {
-			auto &Value = pArgs[++ArgIndex];
-			szMask = Value;
-		}
-		else if(pArgs[ArgIndex] == std::string("-nmo")) {
-			isEnabledOutputMask = false;
-		}
-		else if(pArgs[ArgIndex] == std::string("-no")) {
-			isEnabledOutput = false;
-		}
-		else {
-			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
-			printUsage(pArgs[0]);
-			return EXIT_FAILURE;
-		}
-	}
-
-	std::string szInExt = nFs::getExt(szInput);
+	std::string szInExt = nFs::getExt(Job.szInput);
 	if(szInExt != "png" && szInExt != "bm") {
 		nLog::error("Input file type not supported: {}", szInExt);
-		printUsage(pArgs[0]);
-		return EXIT_FAILURE;
+		return false;
 	}
-	if(szOutput.empty()) {
-		szOutput = nFs::removeExt(szInput);
+	if(Job.szOutput.empty()) {
+		Job.szOutput = nFs::removeExt(Job.szInput);
 		if(szInExt == "png") {
-			szOutput += ".bm";
+			Job.szOutput += ".bm";
 		}
 		else if(szInExt == "bm") {
-			szOutput += ".png";
+			Job.szOutput += ".png";
 		}
 	}
-	std::string szOutExt = nFs::getExt(szOutput);
+	std::string szOutExt = nFs::getExt(Job.szOutput);
 
-	if(szMask == "" && isMaskColor) {
+	if(Job.szMask == "" && Job.isMaskColor) {
 		if(szOutExt == "bm") {
-			szMask = nFs::removeExt(szOutput) + "_mask." + szOutExt;
+			Job.szMask = nFs::removeExt(Job.szOutput) + "_mask." + szOutExt;
 		}
 		else if(szInExt == "bm") {
-			szMask = nFs::removeExt(szInput) + "_mask." + szInExt;
-		}
-	}
-
-	// Load palette
-	auto Palette = tPalette::fromFile(szPalette);
-	if(!Palette.isValid()) {
-		nLog::error("Couldn't read palette '{}'", szPalette);
-		return EXIT_FAILURE;
-	}
-	if(isEhb) {
-		if(!Palette.convertToEhb()) {
-			nLog::error("Couldn't convert palette to EHB! Does it have at most 32 colors?");
+			Job.szMask = nFs::removeExt(Job.szInput) + "_mask." + szInExt;
 		}
 	}
 
-
 	// Load input
 	tChunkyBitmap In;
 	if(szInExt == "bm") {
-		auto InPlanar = tPlanarBitmap::fromBm(szInput);
+		auto InPlanar = tPlanarBitmap::fromBm(Job.szInput);
 		if(!InPlanar.m_uwWidth) {
-			nLog::error("Couldn't load input: '{}'", szInput);
+			nLog::error("Couldn't load input: '{}'", Job.szInput);
 		}
 		In = tChunkyBitmap(InPlanar, Palette);
-		if(isMaskColor) {
+		if(Job.isMaskColor) {
 			tPalette PaletteMask;
 			PaletteMask.m_vColors.push_back(tRgb(0,0,0));
 			for(std::uint16_t i = 1; i < 256; ++i) {
-				PaletteMask.m_vColors.push_back(MaskColor);
+				PaletteMask.m_vColors.push_back(Job.MaskColor);
 			}
-			auto szInMask = nFs::removeExt(szInput) + "_mask." + szInExt;
+			auto szInMask = nFs::removeExt(Job.szInput) + "_mask." + szInExt;
 			auto InMask = tChunkyBitmap(tPlanarBitmap::fromBm(szInMask), PaletteMask);
 			if(!In.mergeWithMask(InMask)) {
 				nLog::error("Mask incompatible with bitmap");
-				return EXIT_FAILURE;
+				return false;
 			}
 		}
 	}
 	else if(szInExt == "png") {
-		In = tChunkyBitmap::fromPng(szInput);
+		In = tChunkyBitmap::fromPng(Job.szInput);
+		if(Job.isQuantize && In.m_uwWidth) {
+			std::optional<tRgb> Ignore;
+			if(Job.isMaskColor) {
+				Ignore = Job.MaskColor;
+			}
+			In = quantizeRemap(In, Palette, Job.eDither, Ignore, Job.ulThreadCount);
+		}
 	}
 	else {
 		nLog::error("Input file type not supported: {}", szInExt);
-		return EXIT_FAILURE;
+		return false;
 	}
 
 	// Save to output
 	if(szOutExt == "bm") {
 		tPalette PaletteMask;
-		if(isMaskColor) {
+		if(Job.isMaskColor) {
+			const auto &MaskColor = Job.MaskColor;
 			tRgb MaskAntiColor(~MaskColor.ubR, ~MaskColor.ubG, ~MaskColor.ubB);
 			// Generate mask palette - 0 is transparent, everything else is not
-			if(isWriteInterleaved) {
+			if(Job.isWriteInterleaved) {
 				auto PaletteSize = 1u << Palette.getBpp();
 				PaletteMask.m_vColors.resize(PaletteSize, tRgb(1, 1, 1));
 				PaletteMask.m_vColors.front() = MaskColor;
@@ -163,22 +145,301 @@ int main(int lArgCount, const char *pArgs[])
 				PaletteMask.m_vColors.push_back(MaskColor);
 				PaletteMask.m_vColors.push_back(MaskAntiColor);
 			}
-			if(isEnabledOutputMask) {
+			if(Job.isEnabledOutputMask) {
 				const auto Mask = In.filterColors(PaletteMask, MaskAntiColor);
-				tPlanarBitmap(Mask, PaletteMask).toBm(szMask, isWriteInterleaved);
+				tPlanarBitmap(Mask, PaletteMask).toBm(Job.szMask, Job.isWriteInterleaved);
 			}
 		}
 		auto Planar = tPlanarBitmap(In, Palette, PaletteMask);
 		if(!Planar.m_uwWidth) {
-			return EXIT_FAILURE;
+			return false;
 		}
-		if(isEnabledOutput) {
-			Planar.toBm(szOutput, isWriteInterleaved);
+		if(Job.isEnabledOutput) {
+			Planar.toBm(Job.szOutput, Job.isWriteInterleaved);
 		}
 	}
 	else if(szOutExt == "png") {
-		In.toPng(szOutput);
+		In.toPng(Job.szOutput);
+	}
+
+	return true;
+}
+
+static bool loadPalette(const std::string &szPalette, bool isEhb, tPalette &Palette)
+{
+	Palette = tPalette::fromFile(szPalette);
+	if(!Palette.isValid()) {
+		nLog::error("Couldn't read palette '{}'", szPalette);
+		return false;
+	}
+	if(isEhb) {
+		if(!Palette.convertToEhb()) {
+			nLog::error("Couldn't convert palette to EHB! Does it have at most 32 colors?");
+		}
+	}
+	return true;
+}
+
+static std::string jsonTokToString(const tJson *pJson, std::uint16_t uwTok)
+{
+	const auto &Token = pJson->pTokens[uwTok];
+	return std::string(&pJson->szData[Token.start], Token.end - Token.start);
+}
+
+static bool jsonTokToBool(const tJson *pJson, std::uint16_t uwTok)
+{
+	return pJson->szData[pJson->pTokens[uwTok].start] == 't';
+}
+
+static bool readManifest(
+	const std::string &szManifest, std::string &szPalette, bool &isEhb,
+	std::vector<tBitmapJob> &vJobs
+)
+{
+	auto *pJson = jsonCreate(szManifest.c_str());
+	if(pJson == nullptr) {
+		nLog::error("Couldn't open manifest: '{}'", szManifest);
+		return false;
+	}
+
+	bool isOk = true;
+	auto TokPalette = jsonGetDom(pJson, "palette");
+	auto TokEhb = jsonGetDom(pJson, "ehb");
+	auto TokBitmaps = jsonGetDom(pJson, "bitmaps");
+	if(!TokPalette || !TokBitmaps || pJson->pTokens[TokBitmaps].type != JSMN_ARRAY) {
+		nLog::error("Manifest '{}' needs 'palette' and 'bitmaps' array", szManifest);
+		isOk = false;
+	}
+	else {
+		szPalette = jsonTokToString(pJson, TokPalette);
+		isEhb = TokEhb && jsonTokToBool(pJson, TokEhb);
+		auto ElementCount = pJson->pTokens[TokBitmaps].size;
+		for(decltype(ElementCount) i = 0; i < ElementCount; ++i) {
+			auto TokEntry = jsonGetElementInArray(pJson, TokBitmaps, i);
+			auto TokIn = jsonGetElementInStruct(pJson, TokEntry, "in");
+			if(!TokIn) {
+				nLog::error("Manifest entry {} has no 'in' path", i);
+				isOk = false;
+				break;
+			}
+			tBitmapJob Job;
+			Job.szInput = jsonTokToString(pJson, TokIn);
+			auto TokOut = jsonGetElementInStruct(pJson, TokEntry, "out");
+			if(TokOut) {
+				Job.szOutput = jsonTokToString(pJson, TokOut);
+				Job.isEnabledOutput = !Job.szOutput.empty();
+			}
+			auto TokMaskColor = jsonGetElementInStruct(pJson, TokEntry, "maskColor");
+			if(TokMaskColor) {
+				Job.isMaskColor = true;
+				Job.MaskColor = tRgb(jsonTokToString(pJson, TokMaskColor));
+			}
+			auto TokMask = jsonGetElementInStruct(pJson, TokEntry, "mask");
+			if(TokMask) {
+				Job.szMask = jsonTokToString(pJson, TokMask);
+				Job.isEnabledOutputMask = !Job.szMask.empty();
+			}
+			auto TokInterleaved = jsonGetElementInStruct(pJson, TokEntry, "interleaved");
+			Job.isWriteInterleaved = TokInterleaved && jsonTokToBool(pJson, TokInterleaved);
+			auto TokQuantize = jsonGetElementInStruct(pJson, TokEntry, "quantize");
+			Job.isQuantize = TokQuantize && jsonTokToBool(pJson, TokQuantize);
+			auto TokDither = jsonGetElementInStruct(pJson, TokEntry, "dither");
+			if(TokDither) {
+				Job.isQuantize = true;
+				auto szDither = jsonTokToString(pJson, TokDither);
+				if(!quantizeParseDither(szDither, Job.eDither)) {
+					nLog::error("Unknown dithering method: '{}'", szDither);
+					isOk = false;
+					break;
+				}
+			}
+			vJobs.push_back(std::move(Job));
+		}
+	}
+
+	jsonDestroy(pJson);
+	return isOk;
+}
+
+static int convertManifest(const std::string &szManifest, std::uint32_t ulThreadCount)
+{
+	std::string szPalette;
+	bool isEhb = false;
+	std::vector<tBitmapJob> vJobs;
+	if(!readManifest(szManifest, szPalette, isEhb, vJobs)) {
+		return EXIT_FAILURE;
+	}
+
+	tPalette Palette;
+	if(!loadPalette(szPalette, isEhb, Palette)) {
+		return EXIT_FAILURE;
+	}
+
+	// Workers pick next unprocessed job until all are done
+	std::atomic<std::size_t> NextJob = 0;
+	std::atomic<std::size_t> FailCount = 0;
+	auto Worker = [&]() {
+		for(auto i = NextJob++; i < vJobs.size(); i = NextJob++) {
+			if(!convertBitmap(Palette, vJobs[i])) {
+				nLog::error("Couldn't convert '{}'", vJobs[i].szInput);
+				++FailCount;
+			}
+		}
+	};
+	ulThreadCount = std::max(1u, std::min<std::uint32_t>(ulThreadCount, vJobs.size()));
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
+	}
+	Worker();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+
+	fmt::print(
+		"Converted {} of {} bitmaps using {} threads\n",
+		vJobs.size() - FailCount, vJobs.size(), ulThreadCount
+	);
+	return FailCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount > 2 && pArgs[1] == std::string("-m")) {
+		std::string szManifest = pArgs[2];
+		std::int32_t lThreadCount = std::thread::hardware_concurrency();
+		for(auto ArgIndex = 3; ArgIndex < lArgCount; ++ArgIndex) {
+			if(pArgs[ArgIndex] == std::string("-j") && ArgIndex < lArgCount - 1) {
+				if(!nParse::toInt32(pArgs[++ArgIndex], "thread count", lThreadCount)) {
+					return EXIT_FAILURE;
+				}
+			}
+			else {
+				nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
+				printUsage(pArgs[0]);
+				return EXIT_FAILURE;
+			}
+		}
+		return convertManifest(szManifest, std::uint32_t(std::max(lThreadCount, 1)));
+	}
+
+	const std::uint8_t ubMandatoryArgCnt = 2;
+	if(lArgCount - 1 < ubMandatoryArgCnt) {
+		nLog::error("Too few arguments, expected {}", ubMandatoryArgCnt);
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szPalette = pArgs[1];
+	tBitmapJob Job;
+	Job.szInput = pArgs[2];
+	Job.ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	bool isEhb = false;
+	bool isOcs = false;
+	std::int32_t lGeneratedBpp = 0;
+
+	for(auto ArgIndex = ubMandatoryArgCnt + 1; ArgIndex < lArgCount; ++ArgIndex) {
+		if(pArgs[ArgIndex] == std::string("-o")) {
+			auto &Value = pArgs[++ArgIndex];
+			Job.szOutput = Value;
+		}
+		else if(pArgs[ArgIndex] == std::string("-i")) {
+			Job.isWriteInterleaved = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-ehb")) {
+			isEhb = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-mc") && ArgIndex < lArgCount - 1) {
+			Job.isMaskColor = true;
+			auto &Value = pArgs[++ArgIndex];
+			Job.MaskColor = tRgb(Value);
+		}
+		else if(pArgs[ArgIndex] == std::string("-mf") && ArgIndex < lArgCount - 1) {
+			auto &Value = pArgs[++ArgIndex];
+			Job.szMask = Value;
+		}
+		else if(pArgs[ArgIndex] == std::string("-nmo")) {
+			Job.isEnabledOutputMask = false;
+		}
+		else if(pArgs[ArgIndex] == std::string("-no")) {
+			Job.isEnabledOutput = false;
+		}
+		else if(pArgs[ArgIndex] == std::string("-q")) {
+			Job.isQuantize = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-qd") && ArgIndex < lArgCount - 1) {
+			Job.isQuantize = true;
+			if(!quantizeParseDither(pArgs[++ArgIndex], Job.eDither)) {
+				nLog::error("Unknown dithering method: '{}'", pArgs[ArgIndex]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(pArgs[ArgIndex] == std::string("-qg") && ArgIndex < lArgCount - 1) {
+			Job.isQuantize = true;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "-qg", lGeneratedBpp)) {
+				return EXIT_FAILURE;
+			}
+			if(lGeneratedBpp < 1 || lGeneratedBpp > 8) {
+				nLog::error("Generated palette bpp must be in range 1..8");
+				return EXIT_FAILURE;
+			}
+		}
+		else if(pArgs[ArgIndex] == std::string("-qocs")) {
+			isOcs = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-j") && ArgIndex < lArgCount - 1) {
+			std::int32_t lThreadCount;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "thread count", lThreadCount)) {
+				return EXIT_FAILURE;
+			}
+			Job.ulThreadCount = std::uint32_t(std::max(lThreadCount, 1));
+		}
+		else {
+			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::string szInExt = nFs::getExt(Job.szInput);
+	if(szInExt != "png" && szInExt != "bm") {
+		nLog::error("Input file type not supported: {}", szInExt);
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	if(lGeneratedBpp) {
+		if(szInExt != "png") {
+			nLog::error("Palette can only be generated from .png file");
+			return EXIT_FAILURE;
+		}
+		if(isEhb && lGeneratedBpp != 6) {
+			nLog::error("EHB palette needs 6 bpp");
+			return EXIT_FAILURE;
+		}
+		std::optional<tRgb> Ignore;
+		if(Job.isMaskColor) {
+			Ignore = Job.MaskColor;
+		}
+		auto Generated = quantizeGeneratePalette(
+			tChunkyBitmap::fromPng(Job.szInput),
+			isEhb ? 32 : (1 << lGeneratedBpp), isEhb, isOcs, Ignore
+		);
+		if(!Generated.toFile(szPalette)) {
+			nLog::error("Couldn't write palette '{}'", szPalette);
+			return EXIT_FAILURE;
+		}
+		fmt::print(
+			"Generated palette with {} colors: '{}'\n",
+			Generated.m_vColors.size(), szPalette
+		);
+	}
+
+	// Load palette
+	tPalette Palette;
+	if(!loadPalette(szPalette, isEhb, Palette)) {
+		return EXIT_FAILURE;
 	}
 
-	return EXIT_SUCCESS;
+	return convertBitmap(Palette, Job) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
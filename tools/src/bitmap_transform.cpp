@@ -17,6 +17,7 @@ public:
 	tOpExtract(std::uint16_t uwX, std::uint16_t uwY, std::uint16_t uwW, std::uint16_t uwH);
 	virtual tChunkyBitmap execute(const tChunkyBitmap &Src);
 	virtual std::string toString(void);
+	tChunkyBitmap executeOnFile(const std::string &szPath);
 private:
 	std::uint16_t m_uwX, m_uwY, m_uwW, m_uwH;
 };
@@ -71,12 +72,6 @@ int main(int lArgCount, char *pArgs[])
 	}
 
 	std::string szSrcPath = pArgs[1];
-	auto Img = tChunkyBitmap::fromPng(szSrcPath);
-	if(!Img.m_uwHeight) {
-		nLog::error("Couldn't open image '{}'", szSrcPath);
-		return EXIT_FAILURE;
-	}
-
 	std::vector<std::unique_ptr<tOp>> vOps;
 
 	for(auto ArgIndex = 3; ArgIndex < lArgCount; ++ArgIndex) {
@@ -146,7 +141,28 @@ int main(int lArgCount, char *pArgs[])
 		}
 	}
 
-	for(const auto &Op: vOps) {
+	// Leading extract needs only part of the image, so don't decode the rest
+	tChunkyBitmap Img;
+	std::size_t ulFirstOp = 0;
+	auto *pExtract = vOps.empty() ? nullptr : dynamic_cast<tOpExtract*>(vOps.front().get());
+	if(pExtract) {
+		Img = pExtract->executeOnFile(szSrcPath);
+		if(!Img.m_uwWidth) {
+			nLog::error("Operation {} failed!", pExtract->toString());
+			return EXIT_FAILURE;
+		}
+		ulFirstOp = 1;
+	}
+	else {
+		Img = tChunkyBitmap::fromPng(szSrcPath);
+		if(!Img.m_uwHeight) {
+			nLog::error("Couldn't open image '{}'", szSrcPath);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for(auto OpIndex = ulFirstOp; OpIndex < vOps.size(); ++OpIndex) {
+		const auto &Op = vOps[OpIndex];
 		Img = Op->execute(Img);
 		if(!Img.m_uwWidth) {
 			nLog::error("Operation {} failed!", Op->toString());
@@ -187,6 +203,18 @@ tChunkyBitmap tOpExtract::execute(const tChunkyBitmap &Source)
 	return Dst;
 }
 
+tChunkyBitmap tOpExtract::executeOnFile(const std::string &szPath)
+{
+	fmt::print(
+		"Extracting rectangle {}x{} at {},{}\n", m_uwW, m_uwH, m_uwX, m_uwY
+	);
+	auto Dst = tChunkyBitmap::fromPng(szPath, m_uwX, m_uwY, m_uwW, m_uwH);
+	if(!Dst.m_uwWidth) {
+		nLog::error("Couldn't extract given rectangle from '{}'", szPath);
+	}
+	return Dst;
+}
+
 std::string tOpExtract::toString(void)
 {
 	return fmt::format(
@@ -9,6 +9,9 @@
 #include "../common/lodepng.h"
 #include "../common/endian.h"
 #include "../common/flags/flags.hpp"
+#include "../common/fs.h"
+#include "../common/png.h"
+#include "planar.h"
 
 enum class tBmFlags: std::uint8_t {
 	NONE = 0,
@@ -16,6 +19,8 @@ enum class tBmFlags: std::uint8_t {
 };
 ALLOW_FLAGS_FOR_ENUM(tBmFlags);
 
+static constexpr std::uint8_t s_ubBmHeaderSize = 9;
+
 tChunkyBitmap::tChunkyBitmap(
 	const tPlanarBitmap &Planar, const tPalette &Palette
 ):
@@ -26,29 +31,36 @@ tChunkyBitmap::tChunkyBitmap(
 		m_uwHeight = 0;
 		return;
 	}
-	m_vData.resize(m_uwWidth * m_uwHeight, Palette.m_vColors[0]);
-	auto PxPerCell = sizeof(Planar.m_pPlanes[0][0]) * 8;
-	for(std::uint32_t ulY = 0; ulY < m_uwHeight; ++ulY) {
-		for(std::uint32_t ulX = 0; ulX < m_uwWidth; ++ulX) {
-			std::uint8_t ubColorIdx = 0;
-			std::uint32_t ulOffs = (ulY * m_uwWidth + ulX) / PxPerCell;
-			for(std::uint8_t ubPlane = Planar.m_ubDepth; ubPlane--;) {
-				auto &Plane = Planar.m_pPlanes[ubPlane];
-				ubColorIdx <<= 1;
-				ubColorIdx |= (Plane.at(ulOffs) >> (15 - (ulX & 15))) & 1;
-			}
-			if(ubColorIdx >= Palette.m_vColors.size()) {
-				nLog::error(
-					"Attempted to read color {} from palette of size {}",
-					ubColorIdx, Palette.m_vColors.size()
-				);
-				m_uwWidth = 0;
-				m_uwHeight = 0;
-				return;
-			}
-			auto Color = Palette.m_vColors.at(ubColorIdx);
-			this->pixelAt(ulX, ulY) = Color;
+	std::uint32_t ulPixelCount = m_uwWidth * m_uwHeight;
+	const std::uint16_t *pPlanes[8];
+	for(std::uint8_t ubPlane = 0; ubPlane < Planar.m_ubDepth; ++ubPlane) {
+		if(Planar.m_pPlanes[ubPlane].size() < ulPixelCount / 16) {
+			nLog::error(
+				"Bitplane {} too small: {} < {} words",
+				ubPlane, Planar.m_pPlanes[ubPlane].size(), ulPixelCount / 16
+			);
+			m_uwWidth = 0;
+			m_uwHeight = 0;
+			return;
+		}
+		pPlanes[ubPlane] = Planar.m_pPlanes[ubPlane].data();
+	}
+	std::vector<std::uint8_t> vIndices(ulPixelCount);
+	planarToChunky(pPlanes, Planar.m_ubDepth, ulPixelCount, vIndices.data());
+
+	m_vData.resize(ulPixelCount, Palette.m_vColors[0]);
+	for(std::uint32_t ulPos = 0; ulPos < ulPixelCount; ++ulPos) {
+		std::uint8_t ubColorIdx = vIndices[ulPos];
+		if(ubColorIdx >= Palette.m_vColors.size()) {
+			nLog::error(
+				"Attempted to read color {} from palette of size {}",
+				ubColorIdx, Palette.m_vColors.size()
+			);
+			m_uwWidth = 0;
+			m_uwHeight = 0;
+			return;
 		}
+		m_vData[ulPos] = Palette.m_vColors[ubColorIdx];
 	}
 }
 
@@ -68,28 +80,92 @@ tChunkyBitmap::tChunkyBitmap(
 	m_vData = std::vector<tRgb>(pRgbData, pRgbDataEnd);
 }
 
+tChunkyBitmap::tChunkyBitmap(
+	std::uint16_t uwWidth, std::uint16_t uwHeight, std::vector<tRgb> &&vData
+):
+	m_uwWidth(uwWidth), m_uwHeight(uwHeight), m_vData(std::move(vData))
+{
+
+}
+
 tChunkyBitmap tChunkyBitmap::fromPng(const std::string &szPath)
 {
-	unsigned uWidth, uHeight;
-	std::uint8_t *pData;
-	auto LodeError = lodepng_decode24_file(&pData, &uWidth, &uHeight, szPath.c_str());
-	if(LodeError) {
+	tPngReader Reader(szPath);
+	if(!Reader.isOpen()) {
+		if(!Reader.isInterlaced()) {
+			return tChunkyBitmap();
+		}
+
+		// Interlaced images can't be streamed, so decode them as a whole
+		unsigned uWidth, uHeight;
+		std::uint8_t *pData;
+		auto LodeError = lodepng_decode24_file(&pData, &uWidth, &uHeight, szPath.c_str());
+		if(LodeError) {
+			return tChunkyBitmap();
+		}
+
+		tChunkyBitmap Chunky(uWidth, uHeight, pData);
+		free(pData);
+		return Chunky;
+	}
+
+	// Decode rows straight into bitmap's storage
+	std::uint32_t ulWidth = Reader.getWidth();
+	std::vector<tRgb> vData(ulWidth * Reader.getHeight());
+	for(std::uint32_t ulY = 0; ulY < Reader.getHeight(); ++ulY) {
+		if(!Reader.readRow(&vData[ulY * ulWidth])) {
+			return tChunkyBitmap();
+		}
+	}
+	return tChunkyBitmap(ulWidth, Reader.getHeight(), std::move(vData));
+}
+
+tChunkyBitmap tChunkyBitmap::fromPng(
+	const std::string &szPath, std::uint16_t uwX, std::uint16_t uwY,
+	std::uint16_t uwWidth, std::uint16_t uwHeight
+)
+{
+	tPngReader Reader(szPath);
+	if(!Reader.isOpen()) {
+		if(!Reader.isInterlaced()) {
+			return tChunkyBitmap();
+		}
+		auto Whole = fromPng(szPath);
+		tChunkyBitmap Rect(uwWidth, uwHeight);
+		if(!Whole.copyRect(uwX, uwY, Rect, 0, 0, uwWidth, uwHeight)) {
+			return tChunkyBitmap();
+		}
+		return Rect;
+	}
+
+	if(
+		std::uint32_t(uwX) + uwWidth > Reader.getWidth() ||
+		std::uint32_t(uwY) + uwHeight > Reader.getHeight() ||
+		!Reader.skipRows(uwY)
+	) {
 		return tChunkyBitmap();
 	}
 
-	tChunkyBitmap Chunky(uWidth, uHeight, pData);
-	free(pData);
-	return Chunky;
+	std::vector<tRgb> vRow(Reader.getWidth());
+	std::vector<tRgb> vData;
+	vData.reserve(uwWidth * uwHeight);
+	for(std::uint16_t uwRow = 0; uwRow < uwHeight; ++uwRow) {
+		if(!Reader.readRow(vRow.data())) {
+			return tChunkyBitmap();
+		}
+		vData.insert(vData.end(), &vRow[uwX], &vRow[uwX] + uwWidth);
+	}
+	return tChunkyBitmap(uwWidth, uwHeight, std::move(vData));
 }
 
-bool tChunkyBitmap::toPng(const std::string &szPngPath) const
+bool tChunkyBitmap::toPng(
+	const std::string &szPngPath, const tPngEncodeSettings &Settings
+) const
 {
-	auto LodeErr = lodepng_encode_file(
-		szPngPath.c_str(), reinterpret_cast<const uint8_t*>(m_vData.data()),
-		m_uwWidth, m_uwHeight, LCT_RGB, 8
+	return pngEncode(
+		szPngPath, reinterpret_cast<const uint8_t*>(m_vData.data()),
+		m_uwWidth, m_uwHeight, Settings
 	);
-
-	return LodeErr == 0;
 }
 
 tPlanarBitmap::tPlanarBitmap(
@@ -110,7 +186,7 @@ tPlanarBitmap::tPlanarBitmap(
 	m_ubDepth = ubDepth;
 
 	for(std::uint8_t i = 0; i < ubDepth; ++i) {
-		m_pPlanes[i].resize(uwWidth * uwHeight / sizeof(m_pPlanes[0][0]));
+		m_pPlanes[i].resize((uwWidth / 16) * uwHeight);
 	}
 }
 
@@ -134,39 +210,43 @@ tPlanarBitmap::tPlanarBitmap(
 		return;
 	}
 
-	// Write bitplanes - from LSB to MSB
-	std::uint16_t uwPixelBuffer;
-	std::uint32_t ulPos;
-	for(std::uint8_t ubPlane = 0; ubPlane != ubDepth; ++ubPlane) {
-		for(std::uint16_t y = 0; y != Chunky.m_uwHeight; ++y) {
-			uwPixelBuffer = 0;
-			for(std::uint16_t x = 0; x != Chunky.m_uwWidth; ++x) {
-				// Determine bit value for given color at specified bitplane's pos
-				auto Color = Chunky.pixelAt(x, y);
-				std::int16_t wIdx = Palette.getColorIdx(Color);
-				std::uint8_t ubBit = 0;
-				if(wIdx == -1) {
-					if(PaletteIgnore.getColorIdx(Color) == -1) {
-						nLog::error(
-							"Unexpected color: {0}, {1}, {2} (#{0:02X}{1:02X}{2:02X}) @{3},{4}",
-							Color.ubR, Color.ubG,	Color.ubB, x, y
-						);
-						return;
-					}
-				}
-				else if(wIdx & (1 << ubPlane)) {
-					ubBit = 1;
-				}
-
-				uwPixelBuffer <<= 1;
-				uwPixelBuffer |= ubBit;
-				if((x & 0xF) == 0xF) {
-					m_pPlanes[ubPlane].push_back(uwPixelBuffer);
-				}
+	// Look up each pixel's color only once, then scatter index bits to all planes
+	tPaletteLookup Lookup(Palette);
+	tPaletteLookup LookupIgnore(PaletteIgnore);
+	std::uint32_t ulPixelCount = Chunky.m_uwWidth * Chunky.m_uwHeight;
+	std::vector<std::uint8_t> vIndices(ulPixelCount);
+	tRgb PrevColor;
+	std::int16_t wPrevIdx = Lookup.getColorIdx(PrevColor);
+	for(std::uint32_t ulPos = 0; ulPos < ulPixelCount; ++ulPos) {
+		// Neighboring pixels are often the same, so skip repeated lookups
+		const auto &Color = Chunky.m_vData[ulPos];
+		if(Color != PrevColor) {
+			PrevColor = Color;
+			wPrevIdx = Lookup.getColorIdx(Color);
+		}
+		if(wPrevIdx == -1) {
+			if(LookupIgnore.getColorIdx(Color) == -1) {
+				nLog::error(
+					"Unexpected color: {0}, {1}, {2} (#{0:02X}{1:02X}{2:02X}) @{3},{4}",
+					Color.ubR, Color.ubG,	Color.ubB,
+					ulPos % Chunky.m_uwWidth, ulPos / Chunky.m_uwWidth
+				);
+				return;
 			}
+			vIndices[ulPos] = 0;
+		}
+		else {
+			vIndices[ulPos] = std::uint8_t(wPrevIdx);
 		}
 	}
 
+	std::uint16_t *pPlanes[8];
+	for(std::uint8_t ubPlane = 0; ubPlane != ubDepth; ++ubPlane) {
+		m_pPlanes[ubPlane].resize(ulPixelCount / 16);
+		pPlanes[ubPlane] = m_pPlanes[ubPlane].data();
+	}
+	planarFromChunky(vIndices.data(), ulPixelCount, ubDepth, pPlanes);
+
 	// Everything's okay - write dimensions to apropriate fields
 	m_uwWidth = Chunky.m_uwWidth;
 	m_uwHeight = Chunky.m_uwHeight;
@@ -180,103 +260,102 @@ bool tPlanarBitmap::toBm(const std::string &szPath, bool isInterleaved)
 		eFlags |= tBmFlags::INTERLEAVED;
 	}
 
-	std::ofstream OutFile(szPath.c_str(), std::ios::out | std::ios::binary);
-	if(!OutFile.is_open()) {
-		return false;
-	}
-
-	// Write .bm header
-	std::uint16_t uwOut = nEndian::toBig16(m_uwWidth);
-	OutFile.write(reinterpret_cast<char*>(&uwOut), 2);
-	uwOut = nEndian::toBig16(m_uwHeight);
-	OutFile.write(reinterpret_cast<char*>(&uwOut), 2);
-	OutFile.write(reinterpret_cast<char*>(&m_ubDepth), 1);
-
-	std::uint8_t ubOut = 0;
-	OutFile.write(reinterpret_cast<char*>(&ubOut), 1); // Version
-	OutFile.write(reinterpret_cast<char*>(&eFlags), 1); // Flags
-	OutFile.write(reinterpret_cast<char*>(&ubOut), 1); // Reserved 1
-	OutFile.write(reinterpret_cast<char*>(&ubOut), 1); // Reserved 2
-
-	// Write bitplanes
+	// Build whole file in memory so that it's written in one go
 	std::uint16_t uwRowWordCount = m_uwWidth / 16;
+	std::uint32_t ulRowSize = uwRowWordCount * sizeof(std::uint16_t);
+	std::vector<std::uint8_t> vOut(
+		s_ubBmHeaderSize + ulRowSize * m_uwHeight * m_ubDepth
+	);
+
+	// .bm header
+	vOut[0] = std::uint8_t(m_uwWidth >> 8);
+	vOut[1] = std::uint8_t(m_uwWidth);
+	vOut[2] = std::uint8_t(m_uwHeight >> 8);
+	vOut[3] = std::uint8_t(m_uwHeight);
+	vOut[4] = m_ubDepth;
+	vOut[5] = 0; // Version
+	vOut[6] = std::uint8_t(eFlags.underlying_value()); // Flags
+	vOut[7] = 0; // Reserved 1
+	vOut[8] = 0; // Reserved 2
+
+	// Bitplanes
+	std::uint8_t *pOut = &vOut[s_ubBmHeaderSize];
 	if(isInterleaved) {
 		for(std::uint16_t y = 0; y < m_uwHeight; ++y) {
 			for(std::uint8_t ubPlane = 0; ubPlane < m_ubDepth; ++ubPlane) {
-				for(std::uint16_t x = 0; x < uwRowWordCount; ++x) {
-					std::uint16_t uwData = nEndian::toBig16(
-						m_pPlanes[ubPlane].at(y * uwRowWordCount + x)
-					);
-					OutFile.write(reinterpret_cast<char*>(&uwData), sizeof(uint16_t));
-				}
+				nEndian::copyToBig16(
+					pOut, &m_pPlanes[ubPlane][y * uwRowWordCount], uwRowWordCount
+				);
+				pOut += ulRowSize;
 			}
 		}
 	}
 	else {
 		for(std::uint8_t ubPlane = 0; ubPlane < m_ubDepth; ++ubPlane) {
-			for(std::uint16_t y = 0; y < m_uwHeight; ++y) {
-				for(std::uint16_t x = 0; x < uwRowWordCount; ++x) {
-					std::uint16_t uwData = nEndian::toBig16(
-						m_pPlanes[ubPlane].at(y * uwRowWordCount + x)
-					);
-					OutFile.write(reinterpret_cast<char*>(&uwData), sizeof(uint16_t));
-				}
-			}
+			nEndian::copyToBig16(
+				pOut, m_pPlanes[ubPlane].data(), uwRowWordCount * m_uwHeight
+			);
+			pOut += ulRowSize * m_uwHeight;
 		}
 	}
+
+	std::ofstream OutFile(szPath.c_str(), std::ios::out | std::ios::binary);
+	if(!OutFile.is_open()) {
+		return false;
+	}
+	OutFile.write(reinterpret_cast<char*>(vOut.data()), vOut.size());
 	OutFile.close();
 	return true;
 }
 
 tPlanarBitmap tPlanarBitmap::fromBm(const std::string &szPath)
 {
-	std::ifstream File(szPath, std::ios::in | std::ios::binary);
-	if(!File.is_open()) {
+	nFs::tMappedFile File(szPath);
+	if(!File.isOpen()) {
+		return tPlanarBitmap(0, 0, 0);
+	}
+	if(File.getSize() < s_ubBmHeaderSize) {
+		nLog::error("Bitmap file '{}' is too short", szPath);
 		return tPlanarBitmap(0, 0, 0);
 	}
 
-	std::uint16_t uwWidth, uwHeight;
-	std::uint8_t ubBpp, ubVersion, ubReserved1, ubReserved2;
-	tBmFlags eFlags;
-	File.read(reinterpret_cast<char*>(&uwWidth), sizeof(uwWidth));
-	File.read(reinterpret_cast<char*>(&uwHeight), sizeof(uwHeight));
-	File.read(reinterpret_cast<char*>(&ubBpp), sizeof(ubBpp));
-	File.read(reinterpret_cast<char*>(&ubVersion), sizeof(ubVersion));
-	File.read(reinterpret_cast<char*>(&eFlags), sizeof(eFlags));
-	File.read(reinterpret_cast<char*>(&ubReserved1), sizeof(ubReserved1));
-	File.read(reinterpret_cast<char*>(&ubReserved2), sizeof(ubReserved2));
-
-	uwWidth = nEndian::fromBig16(uwWidth);
-	uwHeight = nEndian::fromBig16(uwHeight);
+	const std::uint8_t *pData = File.getData();
+	std::uint16_t uwWidth = (pData[0] << 8) | pData[1];
+	std::uint16_t uwHeight = (pData[2] << 8) | pData[3];
+	std::uint8_t ubBpp = pData[4];
+	std::uint8_t ubVersion = pData[5];
+	tBmFlags eFlags = tBmFlags(pData[6]);
 
 	if(ubVersion == 0) {
-		tPlanarBitmap Bm(uwWidth, uwHeight, ubBpp);
-		for(std::uint8_t i = 0; i < ubBpp; ++i) {
-			Bm.m_pPlanes[i].resize(uwWidth * uwHeight / sizeof(Bm.m_pPlanes[0][0]));
+		if((uwWidth & 0xF) || ubBpp > 8) {
+			nLog::error("Unsupported bitmap size: {}x{}, {}bpp", uwWidth, uwHeight, ubBpp);
+			return tPlanarBitmap(0, 0, 0);
 		}
+		std::uint16_t uwRowWordCount = uwWidth / 16;
+		std::uint32_t ulRowSize = uwRowWordCount * sizeof(std::uint16_t);
+		if(File.getSize() < s_ubBmHeaderSize + ulRowSize * uwHeight * ubBpp) {
+			nLog::error("Bitmap file '{}' is too short", szPath);
+			return tPlanarBitmap(0, 0, 0);
+		}
+
+		tPlanarBitmap Bm(uwWidth, uwHeight, ubBpp);
+		const std::uint8_t *pIn = &pData[s_ubBmHeaderSize];
 		if(eFlags & tBmFlags::INTERLEAVED) {
 			for(std::uint32_t y = 0; y < uwHeight; ++y) {
 				for(std::uint8_t i = 0; i < ubBpp; ++i) {
-					File.read(
-						&(reinterpret_cast<char*>(Bm.m_pPlanes[i].data())[y * uwWidth / 8]),
-						uwWidth / 8
+					nEndian::copyFromBig16(
+						&Bm.m_pPlanes[i][y * uwRowWordCount], pIn, uwRowWordCount
 					);
+					pIn += ulRowSize;
 				}
 			}
 		}
 		else {
 			for(std::uint8_t i = 0; i < ubBpp; ++i) {
-				File.read(
-					reinterpret_cast<char*>(Bm.m_pPlanes[i].data()),
-					(uwWidth / 8) * uwHeight
+				nEndian::copyFromBig16(
+					Bm.m_pPlanes[i].data(), pIn, uwRowWordCount * uwHeight
 				);
-			}
-		}
-
-		// Convert endianness on data
-		for(std::uint8_t i = ubBpp; i--;) {
-			for(auto &Cell: Bm.m_pPlanes[i]) {
-				Cell = nEndian::fromBig16(Cell);
+				pIn += ulRowSize * uwHeight;
 			}
 		}
 
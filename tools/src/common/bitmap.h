@@ -10,6 +10,7 @@
 #include <string>
 #include "../common/rgb.h"
 #include "palette.h"
+#include "png.h"
 
 class tPlanarBitmap;
 
@@ -25,12 +26,28 @@ public:
 
 	tChunkyBitmap(std::uint16_t uwWidth, std::uint16_t uwHeight, const std::uint8_t *pData);
 
+	tChunkyBitmap(std::uint16_t uwWidth, std::uint16_t uwHeight, std::vector<tRgb> &&vData);
+
 	tChunkyBitmap(void) { };
 
-	bool toPng(const std::string &szPngPath) const;
+	bool toPng(
+		const std::string &szPngPath,
+		const tPngEncodeSettings &Settings = tPngEncodeSettings()
+	) const;
 
 	static tChunkyBitmap fromPng(const std::string &szPath);
 
+	/**
+	 * @brief Loads only given rectangle of PNG image. Rows below it aren't
+	 * decoded at all, so it's cheaper than extracting it from whole image.
+	 *
+	 * @return Loaded rectangle on success, otherwise empty bitmap.
+	 */
+	static tChunkyBitmap fromPng(
+		const std::string &szPath, std::uint16_t uwX, std::uint16_t uwY,
+		std::uint16_t uwWidth, std::uint16_t uwHeight
+	);
+
 	tRgb &pixelAt(std::uint16_t uwX, std::uint16_t uwY);
 	const tRgb &pixelAt(std::uint16_t uwX, std::uint16_t uwY) const;
 
@@ -1,9 +1,20 @@
 #include "../common/compress.hpp"
 #include <cmath>
+#include <algorithm>
+#include <vector>
 #include <fmt/format.h>
 
 static constexpr auto s_RleMinLength = 3u;
 static constexpr auto s_RleMaxLength = 18u;
+static constexpr auto s_LookupSize = 0x1000u;
+static constexpr auto s_HashBits = 14u;
+
+struct tHashChain {
+	// Most recent source position for each hash of 3 consecutive bytes
+	std::vector<std::int32_t> vHead;
+	// Previous source position with same hash, indexed by position in window
+	std::vector<std::int32_t> vPrev;
+};
 
 static uint8_t rleTableRead(const uint8_t *table, std::uint16_t *index)
 {
@@ -59,6 +70,86 @@ static bool rleTableFind(
 	return isFound;
 }
 
+static std::uint32_t hashChainHash(const uint8_t *pData)
+{
+	std::uint32_t ulKey = (pData[0] << 16) | (pData[1] << 8) | pData[2];
+	return (ulKey * 2654435761u) >> (32 - s_HashBits);
+}
+
+static void hashChainInit(tHashChain *pChain)
+{
+	pChain->vHead.assign(1 << s_HashBits, -1);
+	pChain->vPrev.assign(s_LookupSize, -1);
+}
+
+static void hashChainInsert(
+	tHashChain *pChain, const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	std::uint32_t ulPos
+)
+{
+	if(ulPos + s_RleMinLength > ulSrcSize) {
+		return;
+	}
+	auto &Head = pChain->vHead[hashChainHash(&pSrc[ulPos])];
+	pChain->vPrev[ulPos & (s_LookupSize - 1)] = Head;
+	Head = std::int32_t(ulPos);
+}
+
+/**
+ * @brief Finds the longest match for data at ulPos among last 4096 bytes.
+ *
+ * Lookup table written by unpacker always holds last 4096 source bytes, with
+ * source byte at position N being stored at table index N & 0xfff. Unpacker
+ * reads a table byte before writing next one, so matches may overlap
+ * the bytes being written - those will be the very bytes just unpacked.
+ * This allows encoding runs as sequences referring to previous byte.
+ *
+ * Nearest of equally long matches is returned.
+ */
+static bool hashChainFind(
+	const tHashChain *pChain, const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	std::uint32_t ulPos, std::uint16_t *pMatchPosition, std::uint8_t *pMatchLength
+)
+{
+	*pMatchPosition = 0;
+	*pMatchLength = 0;
+	if(ulPos + s_RleMinLength > ulSrcSize) {
+		return false;
+	}
+
+	std::uint32_t ulMatchLimit = std::min(ulSrcSize - ulPos, s_RleMaxLength);
+	const uint8_t *pData = &pSrc[ulPos];
+	std::int32_t lCandidate = pChain->vHead[hashChainHash(pData)];
+	while(lCandidate >= 0 && ulPos - std::uint32_t(lCandidate) <= s_LookupSize) {
+		const uint8_t *pCandidate = &pSrc[lCandidate];
+		if(pCandidate[*pMatchLength] == pData[*pMatchLength]) {
+			std::uint32_t ulMatchedLength = 0;
+			while(
+				ulMatchedLength < ulMatchLimit &&
+				pCandidate[ulMatchedLength] == pData[ulMatchedLength]
+			) {
+				++ulMatchedLength;
+			}
+			if(ulMatchedLength > *pMatchLength) {
+				*pMatchPosition = std::uint16_t(lCandidate & (s_LookupSize - 1));
+				*pMatchLength = std::uint8_t(ulMatchedLength);
+				if(ulMatchedLength == ulMatchLimit) {
+					break;
+				}
+			}
+		}
+
+		std::int32_t lNext = pChain->vPrev[lCandidate & (s_LookupSize - 1)];
+		if(lNext >= lCandidate) {
+			// Slot already reused by a position outside of the window
+			break;
+		}
+		lCandidate = lNext;
+	}
+
+	return *pMatchLength >= s_RleMinLength;
+}
+
 static void rleTableWrite(uint8_t *table, std::uint16_t *index, uint8_t byte)
 {
 	table[*index] = byte;
@@ -167,10 +258,14 @@ tCompressUnpackResult compressUnpackerProcess(
 
 std::uint32_t compressPack(
 	const uint8_t *pSrc, std::uint32_t ulSrcSize,
-	uint8_t *pDest, bool isVerbose
+	uint8_t *pDest, bool isVerbose, tCompressMatchFinder eMatchFinder
 ) {
 	if(isVerbose) fmt::println("Compress start, size {}", ulSrcSize);
 	std::uint8_t pLookup[0x1000] = {0};
+	tHashChain HashChain;
+	if(eMatchFinder == COMPRESS_MATCH_FINDER_HASH_CHAIN) {
+		hashChainInit(&HashChain);
+	}
 	std::uint32_t ulSrcOffset = 0, ulDestOffset = 0, ulCtrlByteOffset;
 	std::uint16_t uwLookupWritePos = 0;
 	std::uint16_t uwRleMatchPosition;
@@ -189,11 +284,20 @@ std::uint32_t compressPack(
 			}
 
 			// Try to find an repeated sequence
-			bool isFound = rleTableFind(
-				pLookup, uwLookupLength, uwLookupWritePos, &pSrc[ulSrcOffset],
-				std::min(ulSrcSize - ulSrcOffset, s_RleMaxLength),
-				&uwRleMatchPosition, &ubRleMatchLength
-			);
+			bool isFound;
+			if(eMatchFinder == COMPRESS_MATCH_FINDER_BRUTE_FORCE) {
+				isFound = rleTableFind(
+					pLookup, uwLookupLength, uwLookupWritePos, &pSrc[ulSrcOffset],
+					std::min(ulSrcSize - ulSrcOffset, s_RleMaxLength),
+					&uwRleMatchPosition, &ubRleMatchLength
+				);
+			}
+			else {
+				isFound = hashChainFind(
+					&HashChain, pSrc, ulSrcSize, ulSrcOffset,
+					&uwRleMatchPosition, &ubRleMatchLength
+				);
+			}
 			if (isFound) {
 				// RLE sequence found. Encode a 16-bit word for length
 				// and index. Control byte flag is not set.
@@ -209,6 +313,9 @@ std::uint32_t compressPack(
 				pDest[ulDestOffset++] = std::uint8_t(uwRleCtl);
 
 				for (std::uint8_t i = 0; i < ubRleMatchLength; i++) {
+					if(eMatchFinder == COMPRESS_MATCH_FINDER_HASH_CHAIN) {
+						hashChainInsert(&HashChain, pSrc, ulSrcSize, ulSrcOffset);
+					}
 					rleTableWrite(pLookup, &uwLookupWritePos, pSrc[ulSrcOffset++]);
 					uwLookupLength = std::min(0x1000, uwLookupLength + 1);
 				}
@@ -217,6 +324,9 @@ std::uint32_t compressPack(
 				// No sequence found. Encode the byte directly.
 				// Control byte flag is set.
 				pDest[ulCtrlByteOffset] |= (1 << ubBit);
+				if(eMatchFinder == COMPRESS_MATCH_FINDER_HASH_CHAIN) {
+					hashChainInsert(&HashChain, pSrc, ulSrcSize, ulSrcOffset);
+				}
 				auto RawByte = pSrc[ulSrcOffset++];
 				if(isVerbose) fmt::println("byte at {}: {:02X}", ulDestOffset, RawByte);
 				pDest[ulDestOffset++] = RawByte;
@@ -230,3 +340,257 @@ std::uint32_t compressPack(
 	if(isVerbose) fmt::println("compress done, length: {}", ulDestOffset);
 	return ulDestOffset;
 }
+
+std::uint32_t compressPackOptimal(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	uint8_t *pDest, bool isVerbose
+) {
+	if(isVerbose) fmt::println("Optimal compress start, size {}", ulSrcSize);
+
+	// Find longest match at each position - all shorter ones are its prefixes
+	std::vector<std::uint16_t> vMatchPositions(ulSrcSize);
+	std::vector<std::uint8_t> vMatchLengths(ulSrcSize);
+	tHashChain HashChain;
+	hashChainInit(&HashChain);
+	for(std::uint32_t ulPos = 0; ulPos < ulSrcSize; ++ulPos) {
+		hashChainFind(
+			&HashChain, pSrc, ulSrcSize, ulPos,
+			&vMatchPositions[ulPos], &vMatchLengths[ulPos]
+		);
+		hashChainInsert(&HashChain, pSrc, ulSrcSize, ulPos);
+	}
+
+	// Cost in bits of encoding data from given position to the end.
+	// Each literal takes 8 bits, each sequence 16, plus a control bit for both.
+	static constexpr std::uint32_t s_CostLiteral = 1 + 8;
+	static constexpr std::uint32_t s_CostSequence = 1 + 16;
+	std::vector<std::uint32_t> vCosts(ulSrcSize + 1);
+	std::vector<std::uint8_t> vStepLengths(ulSrcSize);
+	vCosts[ulSrcSize] = 0;
+	for(std::uint32_t ulPos = ulSrcSize; ulPos--;) {
+		vCosts[ulPos] = s_CostLiteral + vCosts[ulPos + 1];
+		vStepLengths[ulPos] = 1;
+		for(std::uint8_t ubLength = s_RleMinLength; ubLength <= vMatchLengths[ulPos]; ++ubLength) {
+			std::uint32_t ulCost = s_CostSequence + vCosts[ulPos + ubLength];
+			if(ulCost < vCosts[ulPos]) {
+				vCosts[ulPos] = ulCost;
+				vStepLengths[ulPos] = ubLength;
+			}
+		}
+	}
+
+	// Emit the cheapest path
+	std::uint32_t ulSrcOffset = 0, ulDestOffset = 0, ulCtrlByteOffset = 0;
+	std::uint8_t ubBit = 8;
+	while(ulSrcOffset < ulSrcSize) {
+		if(ubBit == 8) {
+			if(ulSrcOffset && isVerbose) fmt::println("used ctl at {}: {:02X}", ulCtrlByteOffset, pDest[ulCtrlByteOffset]);
+			ulCtrlByteOffset = ulDestOffset++;
+			pDest[ulCtrlByteOffset] = 0;
+			ubBit = 0;
+		}
+
+		std::uint8_t ubLength = vStepLengths[ulSrcOffset];
+		if(ubLength >= s_RleMinLength) {
+			std::uint16_t uwRleCtl = (ubLength - 3) & 0xf;
+			uwRleCtl |= (vMatchPositions[ulSrcOffset] & 0xfff) << 4;
+			if(isVerbose) fmt::println(
+				"sequence at {}, word: {:04X}, len: {}, index: {}",
+				ulDestOffset, uwRleCtl, ubLength, vMatchPositions[ulSrcOffset]
+			);
+			pDest[ulDestOffset++] = uwRleCtl >> 8;
+			pDest[ulDestOffset++] = std::uint8_t(uwRleCtl);
+		}
+		else {
+			pDest[ulCtrlByteOffset] |= (1 << ubBit);
+			if(isVerbose) fmt::println("byte at {}: {:02X}", ulDestOffset, pSrc[ulSrcOffset]);
+			pDest[ulDestOffset++] = pSrc[ulSrcOffset];
+		}
+		ulSrcOffset += ubLength;
+		++ubBit;
+	}
+
+	if(isVerbose) fmt::println("compress done, length: {}", ulDestOffset);
+	return ulDestOffset;
+}
+
+bool compressVerify(
+	const uint8_t *pCompressed, std::size_t ulCompressedSize,
+	const uint8_t *pOriginal, std::size_t ulOriginalSize,
+	std::size_t *pMismatchOffset
+) {
+	tCompressUnpacker UnpackState;
+	compressUnpackerInit(&UnpackState, pCompressed, ulCompressedSize, ulOriginalSize);
+	while(true) {
+		std::uint8_t ubRead;
+		tCompressUnpackResult eResult = compressUnpackerProcess(&UnpackState, &ubRead);
+		if(eResult == COMPRESS_UNPACK_RESULT_DONE) {
+			return true;
+		}
+		if(
+			eResult == COMPRESS_UNPACK_RESULT_BUSY_WROTE_BYTE &&
+			pOriginal[UnpackState.ulWriteOffset - 1] != ubRead
+		) {
+			*pMismatchOffset = UnpackState.ulWriteOffset - 1;
+			return false;
+		}
+	}
+}
+
+// LZ4 block format: token with literal count in upper nibble and match length
+// minus 4 in lower one, extended with 255-valued bytes if nibble is 15.
+// Literals follow, then 16-bit little endian match offset. Last sequence
+// consists only of literals.
+static constexpr std::uint32_t s_Lz4MinMatch = 4;
+static constexpr std::uint32_t s_Lz4LastLiterals = 5;
+static constexpr std::uint32_t s_Lz4MatchFindLimit = 12;
+static constexpr std::uint32_t s_Lz4MaxOffset = 0xFFFF;
+static constexpr std::uint32_t s_Lz4HashBits = 14;
+
+static std::uint32_t lz4Hash(const uint8_t *pData) {
+	std::uint32_t ulValue = (
+		pData[0] | (pData[1] << 8) | (pData[2] << 16) | (std::uint32_t(pData[3]) << 24)
+	);
+	return (ulValue * 2654435761u) >> (32 - s_Lz4HashBits);
+}
+
+static void lz4WriteLength(uint8_t *pDest, std::uint32_t *pDestOffset, std::uint32_t ulLength) {
+	while(ulLength >= 255) {
+		pDest[(*pDestOffset)++] = 255;
+		ulLength -= 255;
+	}
+	pDest[(*pDestOffset)++] = std::uint8_t(ulLength);
+}
+
+static void lz4WriteSequence(
+	const uint8_t *pLiterals, std::uint32_t ulLiteralCount,
+	std::uint32_t ulMatchOffset, std::uint32_t ulMatchLength,
+	uint8_t *pDest, std::uint32_t *pDestOffset
+) {
+	std::uint32_t ulTokenOffset = (*pDestOffset)++;
+	std::uint8_t ubToken = std::uint8_t(std::min(ulLiteralCount, 15u) << 4);
+	if(ulLiteralCount >= 15) {
+		lz4WriteLength(pDest, pDestOffset, ulLiteralCount - 15);
+	}
+	std::copy_n(pLiterals, ulLiteralCount, &pDest[*pDestOffset]);
+	*pDestOffset += ulLiteralCount;
+
+	if(ulMatchLength) {
+		pDest[(*pDestOffset)++] = std::uint8_t(ulMatchOffset);
+		pDest[(*pDestOffset)++] = std::uint8_t(ulMatchOffset >> 8);
+		std::uint32_t ulLengthCode = ulMatchLength - s_Lz4MinMatch;
+		ubToken |= std::uint8_t(std::min(ulLengthCode, 15u));
+		if(ulLengthCode >= 15) {
+			lz4WriteLength(pDest, pDestOffset, ulLengthCode - 15);
+		}
+	}
+	pDest[ulTokenOffset] = ubToken;
+}
+
+std::uint32_t compressLz4Pack(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize, uint8_t *pDest
+) {
+	std::vector<std::int32_t> vHashTable(1 << s_Lz4HashBits, -1);
+	std::uint32_t ulSrcOffset = 0, ulAnchor = 0, ulDestOffset = 0;
+
+	// Format requires last match to start at least 12 bytes before the end
+	// and last 5 bytes to be literals
+	if(ulSrcSize > s_Lz4MatchFindLimit) {
+		std::uint32_t ulMatchEndLimit = ulSrcSize - s_Lz4LastLiterals;
+		while(ulSrcOffset < ulSrcSize - s_Lz4MatchFindLimit) {
+			std::uint32_t ulHash = lz4Hash(&pSrc[ulSrcOffset]);
+			std::int32_t lCandidate = vHashTable[ulHash];
+			vHashTable[ulHash] = std::int32_t(ulSrcOffset);
+			if(
+				lCandidate < 0 || ulSrcOffset - lCandidate > s_Lz4MaxOffset ||
+				!std::equal(&pSrc[lCandidate], &pSrc[lCandidate + s_Lz4MinMatch], &pSrc[ulSrcOffset])
+			) {
+				++ulSrcOffset;
+				continue;
+			}
+
+			std::uint32_t ulMatchLength = s_Lz4MinMatch;
+			while(
+				ulSrcOffset + ulMatchLength < ulMatchEndLimit &&
+				pSrc[lCandidate + ulMatchLength] == pSrc[ulSrcOffset + ulMatchLength]
+			) {
+				++ulMatchLength;
+			}
+			lz4WriteSequence(
+				&pSrc[ulAnchor], ulSrcOffset - ulAnchor,
+				ulSrcOffset - lCandidate, ulMatchLength, pDest, &ulDestOffset
+			);
+
+			// Index positions inside the match too - improves ratio of later data
+			std::uint32_t ulMatchEnd = ulSrcOffset + ulMatchLength;
+			for(++ulSrcOffset; ulSrcOffset < ulMatchEnd && ulSrcOffset < ulSrcSize - s_Lz4MatchFindLimit; ++ulSrcOffset) {
+				vHashTable[lz4Hash(&pSrc[ulSrcOffset])] = std::int32_t(ulSrcOffset);
+			}
+			ulSrcOffset = ulMatchEnd;
+			ulAnchor = ulSrcOffset;
+		}
+	}
+
+	lz4WriteSequence(&pSrc[ulAnchor], ulSrcSize - ulAnchor, 0, 0, pDest, &ulDestOffset);
+	return ulDestOffset;
+}
+
+std::int32_t compressLz4Unpack(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	uint8_t *pDest, std::uint32_t ulDestSize
+) {
+	std::uint32_t ulSrcOffset = 0, ulDestOffset = 0;
+	auto readLength = [&](std::uint32_t *pLength) {
+		std::uint8_t ubNext;
+		do {
+			if(ulSrcOffset >= ulSrcSize) {
+				return false;
+			}
+			ubNext = pSrc[ulSrcOffset++];
+			*pLength += ubNext;
+		} while(ubNext == 255);
+		return true;
+	};
+
+	while(ulSrcOffset < ulSrcSize) {
+		std::uint8_t ubToken = pSrc[ulSrcOffset++];
+		std::uint32_t ulLiteralCount = ubToken >> 4;
+		if(ulLiteralCount == 15 && !readLength(&ulLiteralCount)) {
+			return -1;
+		}
+		if(
+			ulSrcOffset + ulLiteralCount > ulSrcSize ||
+			ulDestOffset + ulLiteralCount > ulDestSize
+		) {
+			return -1;
+		}
+		std::copy_n(&pSrc[ulSrcOffset], ulLiteralCount, &pDest[ulDestOffset]);
+		ulSrcOffset += ulLiteralCount;
+		ulDestOffset += ulLiteralCount;
+		if(ulSrcOffset == ulSrcSize) {
+			break;
+		}
+
+		if(ulSrcOffset + 2 > ulSrcSize) {
+			return -1;
+		}
+		std::uint32_t ulMatchOffset = pSrc[ulSrcOffset] | (pSrc[ulSrcOffset + 1] << 8);
+		ulSrcOffset += 2;
+		std::uint32_t ulMatchLength = ubToken & 0xF;
+		if(ulMatchLength == 15 && !readLength(&ulMatchLength)) {
+			return -1;
+		}
+		ulMatchLength += s_Lz4MinMatch;
+		if(
+			!ulMatchOffset || ulMatchOffset > ulDestOffset ||
+			ulDestOffset + ulMatchLength > ulDestSize
+		) {
+			return -1;
+		}
+		// Byte by byte, since match may overlap with data being written
+		for(std::uint32_t i = 0; i < ulMatchLength; ++i, ++ulDestOffset) {
+			pDest[ulDestOffset] = pDest[ulDestOffset - ulMatchOffset];
+		}
+	}
+	return std::int32_t(ulDestOffset);
+}
@@ -18,6 +18,11 @@ enum tCompressUnpackResult {
 	COMPRESS_UNPACK_RESULT_DONE,
 };
 
+enum tCompressMatchFinder {
+	COMPRESS_MATCH_FINDER_HASH_CHAIN,
+	COMPRESS_MATCH_FINDER_BRUTE_FORCE,
+};
+
 struct tCompressUnpacker {
 	tCompressUnpackStateKind eCurrentState;
 	std::uint8_t pLookup[0x1000];
@@ -37,10 +42,60 @@ struct tCompressUnpacker {
 };
 
 std::uint32_t compressPack(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	uint8_t *pDest, bool isVerbose = false,
+	tCompressMatchFinder eMatchFinder = COMPRESS_MATCH_FINDER_HASH_CHAIN
+);
+
+/**
+ * @brief Compresses data using optimal parse for the lowest output size.
+ * Slower than compressPack() but output is readable by the same unpacker.
+ */
+std::uint32_t compressPackOptimal(
 	const uint8_t *pSrc, std::uint32_t ulSrcSize,
 	uint8_t *pDest, bool isVerbose = false
 );
 
+/**
+ * @brief Unpacks compressed data and compares it with original.
+ *
+ * @param pMismatchOffset Set to offset of first mismatching byte on failure.
+ * @return True if unpacked data matches original, otherwise false.
+ */
+bool compressVerify(
+	const uint8_t *pCompressed, std::size_t ulCompressedSize,
+	const uint8_t *pOriginal, std::size_t ulOriginalSize,
+	std::size_t *pMismatchOffset
+);
+
+/**
+ * @brief Compresses data into single LZ4 block. Decoding of such blocks needs
+ * no lookup table since matches are copied from already decoded output,
+ * which makes it much faster than compressPack() output on 68k.
+ *
+ * @param pDest Destination buffer. Must hold at least
+ * compressLz4GetMaxPackedSize(ulSrcSize) bytes.
+ * @return Size of compressed data.
+ */
+std::uint32_t compressLz4Pack(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize, uint8_t *pDest
+);
+
+/**
+ * @brief Unpacks single LZ4 block.
+ *
+ * @return Size of unpacked data or -1 if input is malformed or doesn't fit
+ * in destination buffer.
+ */
+std::int32_t compressLz4Unpack(
+	const uint8_t *pSrc, std::uint32_t ulSrcSize,
+	uint8_t *pDest, std::uint32_t ulDestSize
+);
+
+constexpr std::uint32_t compressLz4GetMaxPackedSize(std::uint32_t ulSrcSize) {
+	return ulSrcSize + ulSrcSize / 255 + 16;
+}
+
 void compressUnpackerInit(
 	tCompressUnpacker *pUnpacker, const uint8_t *pCompressed, size_t ulCompressedSize,
 	size_t ulUncompressedSize, bool isVerbose = false
@@ -7,6 +7,8 @@
 
 #include <cstdint>
 #include <bit>
+#include <cstddef>
+#include <cstring>
 
 namespace nEndian {
 	constexpr bool isBig(void)
@@ -47,6 +49,31 @@ namespace nEndian {
 	{
 		return toBig32(uwIn);
 	}
+
+	/**
+	 * @brief Copies words to byte buffer as big endian. Simple enough for
+	 * the compiler to vectorize, unlike per-word stream writes.
+	 */
+	inline void copyToBig16(
+		std::uint8_t *pDst, const std::uint16_t *pSrc, std::size_t ulWordCount
+	)
+	{
+		for(std::size_t i = 0; i < ulWordCount; ++i) {
+			std::uint16_t uwWord = toBig16(pSrc[i]);
+			std::memcpy(&pDst[i * sizeof(uwWord)], &uwWord, sizeof(uwWord));
+		}
+	}
+
+	inline void copyFromBig16(
+		std::uint16_t *pDst, const std::uint8_t *pSrc, std::size_t ulWordCount
+	)
+	{
+		for(std::size_t i = 0; i < ulWordCount; ++i) {
+			std::uint16_t uwWord;
+			std::memcpy(&uwWord, &pSrc[i * sizeof(uwWord)], sizeof(uwWord));
+			pDst[i] = fromBig16(uwWord);
+		}
+	}
 }
 
 #endif // _ACE_TOOLS_COMMON_ENDIAN_H_
@@ -8,6 +8,13 @@
 
 #if defined(_WIN32)
 #    include <direct.h>
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
 #endif
 
 namespace nFs {
@@ -67,4 +74,95 @@ std::string getBaseName(const std::string &szPath)
 	return szPath.substr(std::max(LastSlash, LastBackslash));
 }
 
+tMappedFile::tMappedFile(const std::string &szPath)
+{
+	#if defined(_WIN32)
+		m_pHandleFile = CreateFileA(
+			szPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, nullptr
+		);
+		if(m_pHandleFile == INVALID_HANDLE_VALUE) {
+			m_pHandleFile = nullptr;
+			return;
+		}
+		LARGE_INTEGER Size;
+		if(!GetFileSizeEx(m_pHandleFile, &Size)) {
+			return;
+		}
+		m_ulSize = std::size_t(Size.QuadPart);
+		if(m_ulSize) {
+			// Empty files can't be mapped
+			m_pHandleMapping = CreateFileMappingA(
+				m_pHandleFile, nullptr, PAGE_READONLY, 0, 0, nullptr
+			);
+			if(!m_pHandleMapping) {
+				return;
+			}
+			m_pData = static_cast<const std::uint8_t*>(
+				MapViewOfFile(m_pHandleMapping, FILE_MAP_READ, 0, 0, 0)
+			);
+			if(!m_pData) {
+				return;
+			}
+		}
+	#else
+		int lFd = open(szPath.c_str(), O_RDONLY);
+		if(lFd < 0) {
+			return;
+		}
+		struct stat Info;
+		if(fstat(lFd, &Info) != 0) {
+			close(lFd);
+			return;
+		}
+		m_ulSize = std::size_t(Info.st_size);
+		if(m_ulSize) {
+			// Empty files can't be mapped
+			void *pMapped = mmap(nullptr, m_ulSize, PROT_READ, MAP_PRIVATE, lFd, 0);
+			if(pMapped == MAP_FAILED) {
+				close(lFd);
+				return;
+			}
+			m_pData = static_cast<const std::uint8_t*>(pMapped);
+		}
+		// Mapping stays valid after closing the descriptor
+		close(lFd);
+	#endif
+	m_isOpen = true;
+}
+
+tMappedFile::~tMappedFile(void)
+{
+	#if defined(_WIN32)
+		if(m_pData) {
+			UnmapViewOfFile(m_pData);
+		}
+		if(m_pHandleMapping) {
+			CloseHandle(m_pHandleMapping);
+		}
+		if(m_pHandleFile) {
+			CloseHandle(m_pHandleFile);
+		}
+	#else
+		if(m_pData) {
+			munmap(const_cast<std::uint8_t*>(m_pData), m_ulSize);
+		}
+	#endif
+}
+
+bool tMappedFile::isOpen(void) const
+{
+	return m_isOpen;
+}
+
+const std::uint8_t *tMappedFile::getData(void) const
+{
+	return m_pData;
+}
+
+std::size_t tMappedFile::getSize(void) const
+{
+	return m_ulSize;
+}
+
 } // namespace nFs
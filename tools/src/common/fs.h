@@ -8,6 +8,7 @@
 #define _ACE_TOOLS_COMMON_FS_H_
 
 #include <string>
+#include <cstdint>
 
 namespace nFs {
 
@@ -21,6 +22,36 @@ std::string removeExt(const std::string &szPath);
 
 std::string getBaseName(const std::string &szPath);
 
+/**
+ * @brief Read-only view of whole file contents, mapped into memory
+ * by the OS instead of being copied through stream buffers.
+ */
+class tMappedFile {
+public:
+	tMappedFile(const std::string &szPath);
+
+	~tMappedFile(void);
+
+	tMappedFile(const tMappedFile &Other) = delete;
+
+	tMappedFile &operator=(const tMappedFile &Other) = delete;
+
+	bool isOpen(void) const;
+
+	const std::uint8_t *getData(void) const;
+
+	std::size_t getSize(void) const;
+
+private:
+	const std::uint8_t *m_pData = nullptr;
+	std::size_t m_ulSize = 0;
+	bool m_isOpen = false;
+#if defined(_WIN32)
+	void *m_pHandleFile = nullptr;
+	void *m_pHandleMapping = nullptr;
+#endif
+};
+
 } // namespace nFs
 
 #endif // _ACE_TOOLS_COMMON_FS_H_
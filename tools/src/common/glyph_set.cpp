@@ -3,7 +3,9 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include "glyph_set.h"
+#include <atomic>
 #include <fstream>
+#include <thread>
 #include <fmt/format.h>
 #include <freetype/freetype.h>
 #include "../common/lodepng.h"
@@ -226,32 +228,52 @@ tGlyphSet tGlyphSet::fromDir(const std::string &szDirPath)
 	return GlyphSet;
 }
 
-bool tGlyphSet::toDir(const std::string &szDirPath)
+bool tGlyphSet::toDir(
+	const std::string &szDirPath, const tPngEncodeSettings &Settings
+)
 {
 	nFs::dirCreate(szDirPath);
+	std::vector<const std::pair<const uint16_t, tBitmapGlyph>*> vGlyphPairs;
 	for(const auto &GlyphPair: m_mGlyphs) {
-		auto Glyph = GlyphPair.second;
-		std::vector<tRgb> vImage(Glyph.m_ubWidth * Glyph.m_ubHeight, tRgb(0));
+		vGlyphPairs.push_back(&GlyphPair);
+	}
 
-		for(auto y = 0; y < Glyph.m_ubHeight; ++y) {
-			for(auto x = 0; x < Glyph.m_ubWidth; ++x) {
-				auto Val = Glyph.m_vData[y * Glyph.m_ubWidth + x];
-				vImage[y * Glyph.m_ubWidth + x] = tRgb(Val);
+	std::atomic<std::size_t> NextGlyph = 0;
+	std::atomic<bool> isOk = true;
+	auto Worker = [&]() {
+		for(auto i = NextGlyph++; i < vGlyphPairs.size() && isOk; i = NextGlyph++) {
+			const auto &GlyphPair = *vGlyphPairs[i];
+			const auto &Glyph = GlyphPair.second;
+			tChunkyBitmap Image(Glyph.m_ubWidth, Glyph.m_ubHeight);
+			for(auto y = 0; y < Glyph.m_ubHeight; ++y) {
+				for(auto x = 0; x < Glyph.m_ubWidth; ++x) {
+					auto Val = Glyph.m_vData[y * Glyph.m_ubWidth + x];
+					Image.m_vData[y * Glyph.m_ubWidth + x] = tRgb(Val);
+				}
 			}
-		}
 
-		auto LodeErr = lodepng_encode_file(
-			fmt::format("{}/{}.png", szDirPath, static_cast<unsigned char>(GlyphPair.first)).c_str(),
-			reinterpret_cast<uint8_t*>(vImage.data()),
-			Glyph.m_ubWidth, Glyph.m_ubHeight, LCT_RGB, 8
-		);
-
-		if(LodeErr) {
-			fmt::print("Lode Err: {}", LodeErr);
-			return false;
+			auto szPath = fmt::format(
+				"{}/{}.png", szDirPath, static_cast<unsigned char>(GlyphPair.first)
+			);
+			if(!Image.toPng(szPath, Settings)) {
+				nLog::error("Couldn't write glyph to '{}'", szPath);
+				isOk = false;
+			}
 		}
+	};
+
+	std::vector<std::thread> vThreads;
+	auto ThreadCount = std::min<std::size_t>(
+		std::max(1u, std::thread::hardware_concurrency()), vGlyphPairs.size()
+	);
+	for(std::size_t i = 1; i < ThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
 	}
-	return true;
+	Worker();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	return isOk;
 }
 
 tChunkyBitmap tGlyphSet::toPackedBitmap(bool isPmng)
@@ -36,7 +36,17 @@ public:
 
 	static tGlyphSet fromDir(const std::string &szDirPath);
 
-	bool toDir(const std::string &szDirPath);
+	/**
+	 * @brief Saves each glyph as separate PNG file, encoding them in parallel.
+	 *
+	 * @param szDirPath Path to output directory, created if needed.
+	 * @param Settings PNG encoder settings.
+	 * @return True on success, otherwise false.
+	 */
+	bool toDir(
+		const std::string &szDirPath,
+		const tPngEncodeSettings &Settings = tPngEncodeSettings()
+	);
 
 	void toAceFont(const std::string &szFontPath);
 
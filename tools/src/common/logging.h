@@ -17,7 +17,7 @@ void error(fmt::format_string<t_tArgs...> szFmt, t_tArgs&&... Args) {
 }
 
 template<typename... t_tArgs>
-void warn(fmt::format_string<t_tArgs...> szFmt, const t_tArgs&&... Args) {
+void warn(fmt::format_string<t_tArgs...> szFmt, t_tArgs&&... Args) {
 	fmt::print("WARN: ");
 	fmt::print(szFmt, std::forward<t_tArgs>(Args)...);
 	fmt::print("\n");
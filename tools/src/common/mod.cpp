@@ -10,6 +10,29 @@
 
 #define SAMPLE_NAME_SIZE 22
 
+// Replaces regular format tag in files with packed patterns
+static constexpr char s_szPackedPatternsTag[] = "ACEP";
+
+// Packed row starts with byte holding 2-bit mode for each channel, channel 0
+// in lowest bits. Data of non-empty channels follows in channel order.
+enum class tPackedNote: std::uint8_t {
+	EMPTY = 0, ///< All zeros, no data.
+	FULL = 1, ///< 4 bytes of raw note.
+	CMD = 2, ///< No period, instrument < 16 - 2 lower bytes of raw note.
+	REPEAT = 3, ///< Same as in previous row of the pattern, no data.
+};
+
+static std::uint32_t noteToRaw(const tNote &Note)
+{
+	// [instrumentHi:4] [period:12] [instrumentLo:4] [cmdNo:4] [cmdArg:8]
+	return (
+		((Note.ubInstrument & 0xF0  ) << 24) |
+		((Note.uwPeriod     & 0x0FFF) << 16) |
+		((Note.ubInstrument & 0x0F  ) << 12) |
+		((Note.ubCmd & 0xF) << 8) | (Note.ubCmdArg & 0xFF)
+	);
+}
+
 tMod::tMod(const std::string &szFileName)
 {
 	std::ifstream FileIn;
@@ -132,7 +155,9 @@ tMod::tMod(const std::string &szFileName)
 	}
 }
 
-void tMod::toMod(const std::string &szFileName, bool isSkipSampleData)
+void tMod::toMod(
+	const std::string &szFileName, bool isSkipSampleData, bool isPackPatterns
+)
 {
 	std::ofstream FileOut;
 	FileOut.open(szFileName, std::ios::binary);
@@ -177,23 +202,25 @@ void tMod::toMod(const std::string &szFileName, bool isSkipSampleData)
 	// Pattern table
 	FileOut.write(reinterpret_cast<char*>(m_vArrangement.data()), m_vArrangement.size());
 
-	// File format tag
-	FileOut.write(m_szFileFormatTag.data(), 4);
-
-	// Pattern data
-	for(const auto &Pattern: m_vPatterns) {
-		for(std::uint8_t ubRow = 0; ubRow < 64; ++ubRow) {
-			for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
-				const auto Note = &Pattern[ubRow][ubChan];
-				// [instrumentHi:4] [period:12] [instrumentLo:4] [cmdNo:4] [cmdArg:8]
-				std::uint32_t ulNoteRaw = nEndian::toBig32(
-					((Note->ubInstrument & 0xF0  ) << 24) |
-					((Note->uwPeriod     & 0x0FFF) << 16) |
-					((Note->ubInstrument & 0x0F  ) << 12) |
-					((Note->ubCmd & 0xF) << 8) | (Note->ubCmdArg & 0xFF)
-				);
-				FileOut.write(reinterpret_cast<char*>(&ulNoteRaw), sizeof(ulNoteRaw));
-				FileOut.flush();
+	if(isPackPatterns) {
+		// File format tag, packed pattern data size, packed pattern data
+		FileOut.write(s_szPackedPatternsTag, 4);
+		auto vPacked = packPatterns();
+		std::uint32_t ulPackedSize = nEndian::toBig32(std::uint32_t(vPacked.size()));
+		FileOut.write(reinterpret_cast<char*>(&ulPackedSize), sizeof(ulPackedSize));
+		FileOut.write(reinterpret_cast<char*>(vPacked.data()), vPacked.size());
+	}
+	else {
+		// File format tag
+		FileOut.write(m_szFileFormatTag.data(), 4);
+
+		// Pattern data
+		for(const auto &Pattern: m_vPatterns) {
+			for(std::uint8_t ubRow = 0; ubRow < 64; ++ubRow) {
+				for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
+					std::uint32_t ulNoteRaw = nEndian::toBig32(noteToRaw(Pattern[ubRow][ubChan]));
+					FileOut.write(reinterpret_cast<char*>(&ulNoteRaw), sizeof(ulNoteRaw));
+				}
 			}
 		}
 	}
@@ -224,10 +251,8 @@ void tMod::reorderSamples(const std::vector<uint8_t> vNewOrder)
 	// Generate reordered sample defs - do it on copy because of X->Y & Y->X
 	std::vector<tSample> vSamplesNew(m_vSamples.size());
 	for(std::uint8_t ubOldIdx = 0; ubOldIdx < vNewOrder.size(); ++ubOldIdx) {
-		if(!m_vSamples[ubOldIdx].m_szName.empty()) {
-			std::uint8_t ubNewIdx = vNewOrder[ubOldIdx];
-			vSamplesNew[ubNewIdx] = m_vSamples[ubOldIdx];
-		}
+		std::uint8_t ubNewIdx = vNewOrder[ubOldIdx];
+		vSamplesNew[ubNewIdx] = m_vSamples[ubOldIdx];
 	}
 
 	// Replace all at once
@@ -246,7 +271,6 @@ void tMod::reorderSamples(const std::vector<uint8_t> vNewOrder)
 	}
 }
 
-
 void tMod::clearSampleData(void)
 {
 	for(auto &Sample: m_vSamples) {
@@ -254,6 +278,93 @@ void tMod::clearSampleData(void)
 	}
 }
 
+std::uint8_t tMod::removeUnusedPatterns(void)
+{
+	// Only positions within arrangement length can be played or jumped to
+	std::vector<bool> vIsUsed(m_vPatterns.size(), false);
+	for(std::uint8_t ubPos = 0; ubPos < m_ubArrangementLength; ++ubPos) {
+		if(m_vArrangement[ubPos] < vIsUsed.size()) {
+			vIsUsed[m_vArrangement[ubPos]] = true;
+		}
+	}
+
+	std::vector<std::uint8_t> vNewIndices(m_vPatterns.size());
+	std::uint8_t ubNewCount = 0;
+	for(std::uint8_t ubOldIdx = 0; ubOldIdx < m_vPatterns.size(); ++ubOldIdx) {
+		if(vIsUsed[ubOldIdx]) {
+			vNewIndices[ubOldIdx] = ubNewCount;
+			if(ubNewCount != ubOldIdx) {
+				m_vPatterns[ubNewCount] = std::move(m_vPatterns[ubOldIdx]);
+			}
+			++ubNewCount;
+		}
+	}
+
+	std::uint8_t ubRemovedCount = std::uint8_t(m_vPatterns.size() - ubNewCount);
+	m_vPatterns.resize(ubNewCount);
+	for(std::uint8_t ubPos = 0; ubPos < m_vArrangement.size(); ++ubPos) {
+		if(ubPos < m_ubArrangementLength && m_vArrangement[ubPos] < vNewIndices.size()) {
+			m_vArrangement[ubPos] = vNewIndices[m_vArrangement[ubPos]];
+		}
+		else {
+			// Players derive pattern count from highest arrangement entry
+			m_vArrangement[ubPos] = 0;
+		}
+	}
+	return ubRemovedCount;
+}
+
+std::uint8_t tMod::getPatternCount(void) const
+{
+	return std::uint8_t(m_vPatterns.size());
+}
+
+std::vector<std::uint8_t> tMod::packPatterns(void) const
+{
+	// Big endian offset of each pattern from start of packed data, then rows.
+	// Rows may repeat notes of previous ones, so each pattern must be decoded
+	// from its first row - pattern breaks and jumps must seek from there.
+	std::vector<std::uint8_t> vPacked(m_vPatterns.size() * sizeof(std::uint32_t));
+	for(std::uint8_t ubPattern = 0; ubPattern < m_vPatterns.size(); ++ubPattern) {
+		std::uint32_t ulOffset = std::uint32_t(vPacked.size());
+		for(std::uint8_t i = 0; i < sizeof(ulOffset); ++i) {
+			vPacked[ubPattern * sizeof(ulOffset) + i] = std::uint8_t(ulOffset >> (24 - 8 * i));
+		}
+
+		std::array<std::uint32_t, 4> PrevRow = {0};
+		for(const auto &Row: m_vPatterns[ubPattern]) {
+			std::size_t ulModesPos = vPacked.size();
+			vPacked.push_back(0);
+			std::uint8_t ubModes = 0;
+			for(std::uint8_t ubChan = 0; ubChan < 4; ++ubChan) {
+				std::uint32_t ulRaw = noteToRaw(Row[ubChan]);
+				tPackedNote eMode;
+				if(ulRaw == 0) {
+					eMode = tPackedNote::EMPTY;
+				}
+				else if(ulRaw == PrevRow[ubChan]) {
+					eMode = tPackedNote::REPEAT;
+				}
+				else if((ulRaw >> 16) == 0) {
+					eMode = tPackedNote::CMD;
+					vPacked.push_back(std::uint8_t(ulRaw >> 8));
+					vPacked.push_back(std::uint8_t(ulRaw));
+				}
+				else {
+					eMode = tPackedNote::FULL;
+					for(std::uint8_t i = 0; i < sizeof(ulRaw); ++i) {
+						vPacked.push_back(std::uint8_t(ulRaw >> (24 - 8 * i)));
+					}
+				}
+				ubModes |= std::uint8_t(eMode) << (2 * ubChan);
+				PrevRow[ubChan] = ulRaw;
+			}
+			vPacked[ulModesPos] = ubModes;
+		}
+	}
+	return vPacked;
+}
+
 bool tSample::operator ==(const tSample &Other) const
 {
 	bool isSame = (
@@ -12,10 +12,10 @@
 
 struct tSample {
 	std::string m_szName;
-	std::uint8_t m_ubFineTune; ///< Finetune. Only lower nibble is used. Values translate to finetune: {0..7, -8..-1}
-	std::uint8_t m_ubVolume; ///< Sample volume. 0..64
-	std::uint16_t m_uwRepeatOffs; ///< In words.
-	std::uint16_t m_uwRepeatLength; ///< In words.
+	std::uint8_t m_ubFineTune = 0; ///< Finetune. Only lower nibble is used. Values translate to finetune: {0..7, -8..-1}
+	std::uint8_t m_ubVolume = 0; ///< Sample volume. 0..64
+	std::uint16_t m_uwRepeatOffs = 0; ///< In words.
+	std::uint16_t m_uwRepeatLength = 1; ///< In words.
 
 	std::vector<uint16_t> m_vData;
 
@@ -37,7 +37,18 @@ class tMod {
 public:
 	tMod(const std::string &szFileName);
 
-	void toMod(const std::string &szFileName, bool isSkipSampleData);
+	/**
+	 * @brief Writes module file.
+	 *
+	 * @param szFileName Destination path.
+	 * @param isSkipSampleData If set, sample data is omitted, leaving only headers.
+	 * @param isPackPatterns If set, patterns are written in ACE's packed format
+	 * instead of the regular one. Such file can only be loaded by ptplayer.
+	 */
+	void toMod(
+		const std::string &szFileName, bool isSkipSampleData,
+		bool isPackPatterns = false
+	);
 
 	const std::vector<tSample> &getSamples(void) const;
 
@@ -47,7 +58,7 @@ public:
 
 	/**
 	 * @brief Reorder samples in module using the index array.
-	 * Reorder values for empty samples are ignored.
+	 * Samples mapped to the same index should have the same header.
 	 *
 	 * @param vNewOrder Vector index is old sample idx, value is new sample idx.
 	 */
@@ -55,7 +66,20 @@ public:
 
 	void clearSampleData(void);
 
+	/**
+	 * @brief Removes patterns not referenced by the arrangement and renumbers
+	 * the remaining ones, keeping their order. Arrangement entries past its
+	 * length are zeroed so that they don't count as pattern references.
+	 *
+	 * @return Number of removed patterns.
+	 */
+	std::uint8_t removeUnusedPatterns(void);
+
+	std::uint8_t getPatternCount(void) const;
+
 private:
+	std::vector<std::uint8_t> packPatterns(void) const;
+
 	std::string m_szSongName;
 	std::uint8_t m_ubArrangementLength; ///< End pattern idx? Jumps are possible.
 	std::uint8_t m_ubSongEndPos;
@@ -155,6 +155,24 @@ tPalette tPalette::fromFile(const std::string &szPath)
 	return Palette;
 }
 
+bool tPalette::toFile(const std::string &szPath)
+{
+	std::string szExtOut = nFs::getExt(szPath);
+	if(szExtOut == "gpl") {
+		return toGpl(szPath);
+	}
+	else if(szExtOut == "act") {
+		return toAct(szPath);
+	}
+	else if(szExtOut == "pal") {
+		return toPromotionPal(szPath);
+	}
+	else if(szExtOut == "plt") {
+		return toPlt(szPath, true);
+	}
+	return false;
+}
+
 bool tPalette::toPlt(const std::string &szPath, bool isForceOcs)
 {
 	std::ofstream Dest(szPath, std::ios::out | std::ios::binary);
@@ -274,6 +292,17 @@ std::int16_t tPalette::getColorIdx(const tRgb &Ref) const
 	return -1;
 }
 
+tPaletteLookup::tPaletteLookup(const tPalette &Palette)
+{
+	m_mIndices.reserve(Palette.m_vColors.size());
+	std::int16_t wIdx = 0;
+	for(const auto &Color: Palette.m_vColors) {
+		// Don't overwrite earlier duplicates, same as getColorIdx()
+		m_mIndices.emplace(toKey(Color), wIdx);
+		++wIdx;
+	}
+}
+
 bool tPalette::isValid(void) const {
 	return m_vColors.size() != 0;
 }
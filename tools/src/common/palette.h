@@ -7,6 +7,7 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include "../common/rgb.h"
 
 class tPalette {
@@ -30,6 +31,12 @@ public:
 
 	bool toAct(const std::string &szPath);
 
+	/**
+	 * @brief Saves palette in format matching file extension,
+	 * as opposed to fromFile().
+	 */
+	bool toFile(const std::string &szPath);
+
 	bool isValid(void) const;
 
 	std::uint8_t getBpp(void) const;
@@ -47,4 +54,29 @@ public:
 	std::int16_t getColorIdx(const tRgb &Ref) const;
 };
 
+/**
+ * @brief Constant-time color index lookup, built once for given palette.
+ * Use instead of tPalette::getColorIdx() when converting many pixels.
+ */
+class tPaletteLookup {
+public:
+	tPaletteLookup(const tPalette &Palette);
+
+	/**
+	 * @brief Same as tPalette::getColorIdx() - returns first matching index,
+	 * or -1 if color isn't in the palette.
+	 */
+	std::int16_t getColorIdx(const tRgb &Ref) const {
+		auto It = m_mIndices.find(toKey(Ref));
+		return It != m_mIndices.end() ? It->second : -1;
+	}
+
+private:
+	static std::uint32_t toKey(const tRgb &Color) {
+		return (std::uint32_t(Color.ubR) << 16) | (Color.ubG << 8) | Color.ubB;
+	}
+
+	std::unordered_map<std::uint32_t, std::int16_t> m_mIndices;
+};
+
 #endif // _ACE_TOOLS_COMMON_PALETTE_H_
@@ -0,0 +1,318 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "planar.h"
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define PLANAR_HAS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+// MSVC lacks per-function target attributes, so it sticks with SSE2
+#define PLANAR_HAS_AVX2
+#include <immintrin.h>
+#define PLANAR_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+//---------------------------------------------------------------------- HELPERS
+
+#if defined(PLANAR_HAS_SSE2)
+// Bit order of byte reversed - movemask returns leftmost pixel in LSB
+static constexpr auto s_pReversedBits = []() {
+	std::array<std::uint8_t, 256> pReversed = {};
+	for(std::uint16_t i = 0; i < 256; ++i) {
+		for(std::uint8_t ubBit = 0; ubBit < 8; ++ubBit) {
+			if(i & (1 << ubBit)) {
+				pReversed[i] |= 0x80 >> ubBit;
+			}
+		}
+	}
+	return pReversed;
+}();
+#endif
+
+// Byte i of entry holds bit (7 - i) of the index, so that plane byte
+// is spread over 8 pixels, leftmost in lowest byte
+static constexpr auto s_pSpreadBits = []() {
+	std::array<std::uint64_t, 256> pSpread = {};
+	for(std::uint16_t i = 0; i < 256; ++i) {
+		for(std::uint8_t ubPixel = 0; ubPixel < 8; ++ubPixel) {
+			if(i & (0x80 >> ubPixel)) {
+				pSpread[i] |= std::uint64_t(1) << (ubPixel * 8);
+			}
+		}
+	}
+	return pSpread;
+}();
+
+#if defined(PLANAR_HAS_SSE2)
+static std::uint16_t reverseMask16(std::uint32_t ulMask) {
+	return std::uint16_t(
+		(s_pReversedBits[ulMask & 0xFF] << 8) | s_pReversedBits[(ulMask >> 8) & 0xFF]
+	);
+}
+#endif
+
+static std::uint64_t loadPixels8(const std::uint8_t *pIndices) {
+	// Leftmost pixel in lowest byte regardless of host endianness
+	std::uint64_t ullPixels = 0;
+	for(std::uint8_t i = 8; i--;) {
+		ullPixels = (ullPixels << 8) | pIndices[i];
+	}
+	return ullPixels;
+}
+
+static void storePixels8(std::uint64_t ullPixels, std::uint8_t *pIndices) {
+	for(std::uint8_t i = 0; i < 8; ++i) {
+		pIndices[i] = std::uint8_t(ullPixels);
+		ullPixels >>= 8;
+	}
+}
+
+//----------------------------------------------------------------------- SCALAR
+
+static void planarFromChunkyScalar(
+	const std::uint8_t *pIndices, std::uint32_t ulPixelCount,
+	std::uint8_t ubDepth, std::uint16_t *const *pPlanes
+) {
+	for(std::uint32_t ulWord = 0; ulWord < ulPixelCount / 16; ++ulWord) {
+		std::uint64_t ullLeft = loadPixels8(&pIndices[ulWord * 16]);
+		std::uint64_t ullRight = loadPixels8(&pIndices[ulWord * 16 + 8]);
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			// Gather bit of each byte into top byte, leftmost pixel in MSB.
+			// Partial products don't overlap, so there are no carries.
+			std::uint64_t ullBitsLeft = (ullLeft >> ubPlane) & 0x0101010101010101ull;
+			std::uint64_t ullBitsRight = (ullRight >> ubPlane) & 0x0101010101010101ull;
+			pPlanes[ubPlane][ulWord] = std::uint16_t(
+				(((ullBitsLeft * 0x8040201008040201ull) >> 56) << 8) |
+				((ullBitsRight * 0x8040201008040201ull) >> 56)
+			);
+		}
+	}
+}
+
+static void planarToChunkyScalar(
+	const std::uint16_t *const *pPlanes, std::uint8_t ubDepth,
+	std::uint32_t ulPixelCount, std::uint8_t *pIndices
+) {
+	for(std::uint32_t ulWord = 0; ulWord < ulPixelCount / 16; ++ulWord) {
+		std::uint64_t ullLeft = 0, ullRight = 0;
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			std::uint16_t uwData = pPlanes[ubPlane][ulWord];
+			ullLeft |= s_pSpreadBits[uwData >> 8] << ubPlane;
+			ullRight |= s_pSpreadBits[uwData & 0xFF] << ubPlane;
+		}
+		storePixels8(ullLeft, &pIndices[ulWord * 16]);
+		storePixels8(ullRight, &pIndices[ulWord * 16 + 8]);
+	}
+}
+
+//------------------------------------------------------------------------- SSE2
+
+#if defined(PLANAR_HAS_SSE2)
+
+static void planarFromChunkySse2(
+	const std::uint8_t *pIndices, std::uint32_t ulPixelCount,
+	std::uint8_t ubDepth, std::uint16_t *const *pPlanes
+) {
+	for(std::uint32_t ulWord = 0; ulWord < ulPixelCount / 16; ++ulWord) {
+		__m128i Pixels = _mm_loadu_si128(
+			reinterpret_cast<const __m128i*>(&pIndices[ulWord * 16])
+		);
+		// Move each plane's bit to byte's MSB and collect them with movemask.
+		// 16-bit shifts don't leak other byte's bits into MSB for shifts < 8.
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			std::uint32_t ulMask = _mm_movemask_epi8(
+				_mm_sll_epi16(Pixels, _mm_cvtsi32_si128(7 - ubPlane))
+			);
+			pPlanes[ubPlane][ulWord] = reverseMask16(ulMask);
+		}
+	}
+}
+
+static void planarToChunkySse2(
+	const std::uint16_t *const *pPlanes, std::uint8_t ubDepth,
+	std::uint32_t ulPixelCount, std::uint8_t *pIndices
+) {
+	const __m128i PixelBits = _mm_set_epi8(
+		1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128)
+	);
+	for(std::uint32_t ulWord = 0; ulWord < ulPixelCount / 16; ++ulWord) {
+		__m128i Indices = _mm_setzero_si128();
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			// Broadcast left byte to lower half, right byte to upper half,
+			// then test each pixel's bit
+			std::uint16_t uwData = pPlanes[ubPlane][ulWord];
+			__m128i Bytes = _mm_set_epi64x(
+				std::int64_t((uwData & 0xFF) * 0x0101010101010101ull),
+				std::int64_t((uwData >> 8) * 0x0101010101010101ull)
+			);
+			__m128i IsSet = _mm_cmpeq_epi8(_mm_and_si128(Bytes, PixelBits), PixelBits);
+			Indices = _mm_or_si128(
+				Indices, _mm_and_si128(IsSet, _mm_set1_epi8(char(1 << ubPlane)))
+			);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&pIndices[ulWord * 16]), Indices);
+	}
+}
+
+#endif // PLANAR_HAS_SSE2
+
+//------------------------------------------------------------------------- AVX2
+
+#if defined(PLANAR_HAS_AVX2)
+
+PLANAR_TARGET_AVX2 static void planarFromChunkyAvx2(
+	const std::uint8_t *pIndices, std::uint32_t ulPixelCount,
+	std::uint8_t ubDepth, std::uint16_t *const *pPlanes
+) {
+	std::uint32_t ulWordCount = ulPixelCount / 16;
+	std::uint32_t ulWord = 0;
+	for(; ulWord + 2 <= ulWordCount; ulWord += 2) {
+		__m256i Pixels = _mm256_loadu_si256(
+			reinterpret_cast<const __m256i*>(&pIndices[ulWord * 16])
+		);
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			std::uint32_t ulMask = _mm256_movemask_epi8(
+				_mm256_sll_epi16(Pixels, _mm_cvtsi32_si128(7 - ubPlane))
+			);
+			pPlanes[ubPlane][ulWord] = reverseMask16(ulMask);
+			pPlanes[ubPlane][ulWord + 1] = reverseMask16(ulMask >> 16);
+		}
+	}
+	if(ulWord < ulWordCount) {
+		// Odd word count - convert last word with SSE2
+		std::uint16_t *pLastWords[8];
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			pLastWords[ubPlane] = &pPlanes[ubPlane][ulWord];
+		}
+		planarFromChunkySse2(&pIndices[ulWord * 16], 16, ubDepth, pLastWords);
+	}
+}
+
+PLANAR_TARGET_AVX2 static void planarToChunkyAvx2(
+	const std::uint16_t *const *pPlanes, std::uint8_t ubDepth,
+	std::uint32_t ulPixelCount, std::uint8_t *pIndices
+) {
+	const __m256i PixelBits = _mm256_set1_epi64x(0x0102040810204080ll);
+	std::uint32_t ulWordCount = ulPixelCount / 16;
+	std::uint32_t ulWord = 0;
+	for(; ulWord + 2 <= ulWordCount; ulWord += 2) {
+		__m256i Indices = _mm256_setzero_si256();
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			std::uint16_t uwFirst = pPlanes[ubPlane][ulWord];
+			std::uint16_t uwSecond = pPlanes[ubPlane][ulWord + 1];
+			__m256i Bytes = _mm256_set_epi64x(
+				std::int64_t((uwSecond & 0xFF) * 0x0101010101010101ull),
+				std::int64_t((uwSecond >> 8) * 0x0101010101010101ull),
+				std::int64_t((uwFirst & 0xFF) * 0x0101010101010101ull),
+				std::int64_t((uwFirst >> 8) * 0x0101010101010101ull)
+			);
+			__m256i IsSet = _mm256_cmpeq_epi8(_mm256_and_si256(Bytes, PixelBits), PixelBits);
+			Indices = _mm256_or_si256(
+				Indices, _mm256_and_si256(IsSet, _mm256_set1_epi8(char(1 << ubPlane)))
+			);
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(&pIndices[ulWord * 16]), Indices);
+	}
+	if(ulWord < ulWordCount) {
+		const std::uint16_t *pLastWords[8];
+		for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+			pLastWords[ubPlane] = &pPlanes[ubPlane][ulWord];
+		}
+		planarToChunkySse2(pLastWords, ubDepth, 16, &pIndices[ulWord * 16]);
+	}
+}
+
+#endif // PLANAR_HAS_AVX2
+
+//------------------------------------------------------------------- PUBLIC FNS
+
+static tPlanarKernel planarResolveKernel(tPlanarKernel eKernel) {
+	if(eKernel != PLANAR_KERNEL_AUTO) {
+		return eKernel;
+	}
+	static const tPlanarKernel eBest = []() {
+		for(auto eCandidate: {PLANAR_KERNEL_AVX2, PLANAR_KERNEL_SSE2}) {
+			if(planarIsKernelSupported(eCandidate)) {
+				return eCandidate;
+			}
+		}
+		return PLANAR_KERNEL_SCALAR;
+	}();
+	return eBest;
+}
+
+bool planarIsKernelSupported(tPlanarKernel eKernel) {
+	switch(eKernel) {
+		case PLANAR_KERNEL_AUTO:
+		case PLANAR_KERNEL_SCALAR:
+			return true;
+		case PLANAR_KERNEL_SSE2:
+#if defined(PLANAR_HAS_SSE2)
+			return true;
+#else
+			return false;
+#endif
+		case PLANAR_KERNEL_AVX2:
+#if defined(PLANAR_HAS_AVX2)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+	}
+	return false;
+}
+
+const char *planarGetKernelName(tPlanarKernel eKernel) {
+	switch(planarResolveKernel(eKernel)) {
+		case PLANAR_KERNEL_SCALAR: return "scalar";
+		case PLANAR_KERNEL_SSE2: return "sse2";
+		case PLANAR_KERNEL_AVX2: return "avx2";
+		default: return "unknown";
+	}
+}
+
+void planarFromChunky(
+	const std::uint8_t *pIndices, std::uint32_t ulPixelCount,
+	std::uint8_t ubDepth, std::uint16_t *const *pPlanes, tPlanarKernel eKernel
+) {
+	switch(planarResolveKernel(eKernel)) {
+#if defined(PLANAR_HAS_AVX2)
+		case PLANAR_KERNEL_AVX2:
+			planarFromChunkyAvx2(pIndices, ulPixelCount, ubDepth, pPlanes);
+			return;
+#endif
+#if defined(PLANAR_HAS_SSE2)
+		case PLANAR_KERNEL_SSE2:
+			planarFromChunkySse2(pIndices, ulPixelCount, ubDepth, pPlanes);
+			return;
+#endif
+		default:
+			planarFromChunkyScalar(pIndices, ulPixelCount, ubDepth, pPlanes);
+			return;
+	}
+}
+
+void planarToChunky(
+	const std::uint16_t *const *pPlanes, std::uint8_t ubDepth,
+	std::uint32_t ulPixelCount, std::uint8_t *pIndices, tPlanarKernel eKernel
+) {
+	switch(planarResolveKernel(eKernel)) {
+#if defined(PLANAR_HAS_AVX2)
+		case PLANAR_KERNEL_AVX2:
+			planarToChunkyAvx2(pPlanes, ubDepth, ulPixelCount, pIndices);
+			return;
+#endif
+#if defined(PLANAR_HAS_SSE2)
+		case PLANAR_KERNEL_SSE2:
+			planarToChunkySse2(pPlanes, ubDepth, ulPixelCount, pIndices);
+			return;
+#endif
+		default:
+			planarToChunkyScalar(pPlanes, ubDepth, ulPixelCount, pIndices);
+			return;
+	}
+}
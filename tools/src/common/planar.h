@@ -0,0 +1,56 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_PLANAR_H_
+#define _ACE_TOOLS_COMMON_PLANAR_H_
+
+#include <cstdint>
+
+enum tPlanarKernel {
+	PLANAR_KERNEL_AUTO, ///< Fastest one supported by the CPU.
+	PLANAR_KERNEL_SCALAR,
+	PLANAR_KERNEL_SSE2,
+	PLANAR_KERNEL_AVX2,
+};
+
+/**
+ * @brief Checks whether given kernel may be used on this build & CPU.
+ */
+bool planarIsKernelSupported(tPlanarKernel eKernel);
+
+const char *planarGetKernelName(tPlanarKernel eKernel);
+
+/**
+ * @brief Scatters bits of chunky color indices into bitplanes.
+ * Bitplane words hold 16 pixels each, leftmost pixel in MSB.
+ *
+ * @param pIndices Color indices of consecutive pixels.
+ * @param ulPixelCount Number of pixels to convert, must be multiple of 16.
+ * @param ubDepth Number of bitplanes to fill, 1..8. Higher index bits are ignored.
+ * @param pPlanes Destination bitplanes, each holding ulPixelCount / 16 words.
+ * @param eKernel Implementation to be used.
+ */
+void planarFromChunky(
+	const std::uint8_t *pIndices, std::uint32_t ulPixelCount,
+	std::uint8_t ubDepth, std::uint16_t *const *pPlanes,
+	tPlanarKernel eKernel = PLANAR_KERNEL_AUTO
+);
+
+/**
+ * @brief Gathers bits from bitplanes into chunky color indices.
+ * Reverse of planarFromChunky().
+ *
+ * @param pPlanes Source bitplanes, each holding ulPixelCount / 16 words.
+ * @param ubDepth Number of bitplanes to read, 1..8. Higher index bits are zeroed.
+ * @param ulPixelCount Number of pixels to convert, must be multiple of 16.
+ * @param pIndices Destination for color indices.
+ * @param eKernel Implementation to be used.
+ */
+void planarToChunky(
+	const std::uint16_t *const *pPlanes, std::uint8_t ubDepth,
+	std::uint32_t ulPixelCount, std::uint8_t *pIndices,
+	tPlanarKernel eKernel = PLANAR_KERNEL_AUTO
+);
+
+#endif // _ACE_TOOLS_COMMON_PLANAR_H_
@@ -0,0 +1,756 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "png.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "logging.h"
+
+//---------------------------------------------------------------------- INFLATE
+
+/**
+ * @brief Resumable zlib stream decoder, producing exactly as many bytes
+ * as requested on each read.
+ */
+class tPngReader::tInflate {
+public:
+	using tSegments = std::vector<std::pair<const std::uint8_t*, std::size_t>>;
+
+	tInflate(const tSegments &vSegments);
+
+	bool readHeader(void);
+
+	bool read(std::uint8_t *pDst, std::size_t ulSize);
+
+	/**
+	 * @brief Decodes the rest of the stream, discarding the output, and checks
+	 * Adler-32 of all decoded data against the zlib trailer.
+	 *
+	 * @return True if the stream is complete and its checksum matches.
+	 */
+	bool finish(void);
+
+private:
+	struct tHuffman {
+		static constexpr std::uint8_t s_ubFastBits = 9;
+
+		std::uint16_t pCounts[16];
+		std::uint16_t pSymbols[288];
+		/// (symbol << 4) | length for codes up to s_ubFastBits long, zero if longer.
+		std::uint16_t pFast[1 << s_ubFastBits];
+	};
+
+	enum class tState: std::uint8_t {
+		BLOCK_HEADER,
+		STORED,
+		HUFFMAN,
+	};
+
+	static bool buildHuffman(
+		tHuffman &Huffman, const std::uint8_t *pLengths, std::uint16_t uwCount
+	);
+
+	void refill(void);
+
+	std::uint32_t getBits(std::uint8_t ubCount);
+
+	std::int32_t decodeSymbol(const tHuffman &Huffman);
+
+	bool readBlockHeader(void);
+
+	bool readDynamicTables(void);
+
+	bool step(std::uint8_t *pDst, std::size_t &ulPos, std::size_t ulSize);
+
+	bool isFinalBlockEnded(void) const;
+
+	bool isPastEnd(void) const;
+
+	void emit(std::uint8_t ubValue, std::uint8_t *pDst, std::size_t &ulPos);
+
+	tSegments m_vSegments;
+	std::size_t m_ulSegment = 0;
+	std::size_t m_ulSegmentPos = 0;
+	std::uint64_t m_ullBits = 0;
+	std::uint8_t m_ubBitCount = 0;
+	std::uint32_t m_ulPadBits = 0; ///< Zero bits fed past the end of data.
+
+	tState m_eState = tState::BLOCK_HEADER;
+	bool m_isFinalBlock = false;
+	std::uint16_t m_uwStoredLeft = 0;
+	std::uint16_t m_uwMatchLeft = 0;
+	std::uint16_t m_uwMatchDist = 0;
+	tHuffman m_Literals;
+	tHuffman m_Distances;
+
+	static constexpr std::uint32_t s_ulWindowSize = 32768;
+	std::vector<std::uint8_t> m_vWindow;
+	std::uint64_t m_ullOutPos = 0;
+
+	// Adler-32 sums are reduced lazily, max byte count keeping them in 32 bits
+	static constexpr std::uint32_t s_ulAdlerModulo = 65521;
+	static constexpr std::uint16_t s_uwAdlerMaxPending = 5552;
+	std::uint32_t m_ulAdlerA = 1;
+	std::uint32_t m_ulAdlerB = 0;
+	std::uint16_t m_uwAdlerPending = 0;
+};
+
+static constexpr std::uint16_t s_pLengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static constexpr std::uint8_t s_pLengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static constexpr std::uint16_t s_pDistBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static constexpr std::uint8_t s_pDistExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+static constexpr std::uint8_t s_pCodeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+tPngReader::tInflate::tInflate(const tSegments &vSegments):
+	m_vSegments(vSegments), m_vWindow(s_ulWindowSize)
+{
+
+}
+
+bool tPngReader::tInflate::buildHuffman(
+	tHuffman &Huffman, const std::uint8_t *pLengths, std::uint16_t uwCount
+)
+{
+	std::fill_n(Huffman.pCounts, 16, 0);
+	std::fill_n(Huffman.pFast, 1 << tHuffman::s_ubFastBits, 0);
+	for(std::uint16_t i = 0; i < uwCount; ++i) {
+		++Huffman.pCounts[pLengths[i]];
+	}
+	Huffman.pCounts[0] = 0;
+
+	// Reject over-subscribed codes, incomplete ones are allowed
+	std::int32_t lLeft = 1;
+	for(std::uint8_t ubLength = 1; ubLength < 16; ++ubLength) {
+		lLeft = (lLeft << 1) - Huffman.pCounts[ubLength];
+		if(lLeft < 0) {
+			return false;
+		}
+	}
+
+	std::uint16_t pOffsets[16];
+	std::uint16_t pNextCodes[16];
+	pOffsets[1] = 0;
+	pNextCodes[1] = 0;
+	for(std::uint8_t ubLength = 1; ubLength < 15; ++ubLength) {
+		pOffsets[ubLength + 1] = pOffsets[ubLength] + Huffman.pCounts[ubLength];
+		pNextCodes[ubLength + 1] = (pNextCodes[ubLength] + Huffman.pCounts[ubLength]) << 1;
+	}
+
+	for(std::uint16_t uwSymbol = 0; uwSymbol < uwCount; ++uwSymbol) {
+		auto ubLength = pLengths[uwSymbol];
+		if(!ubLength) {
+			continue;
+		}
+		Huffman.pSymbols[pOffsets[ubLength]++] = uwSymbol;
+
+		// Codes are stored MSB-first, so they're reversed in LSB-first bit buffer
+		std::uint16_t uwCode = pNextCodes[ubLength]++;
+		if(ubLength <= tHuffman::s_ubFastBits) {
+			std::uint16_t uwReversed = 0;
+			for(std::uint8_t i = 0; i < ubLength; ++i) {
+				uwReversed = (uwReversed << 1) | ((uwCode >> i) & 1);
+			}
+			for(
+				std::uint16_t uwIdx = uwReversed; uwIdx < (1 << tHuffman::s_ubFastBits);
+				uwIdx += (1 << ubLength)
+			) {
+				Huffman.pFast[uwIdx] = (uwSymbol << 4) | ubLength;
+			}
+		}
+	}
+	return true;
+}
+
+void tPngReader::tInflate::refill(void)
+{
+	// Past the end of data, zeros are fed - reading them is reported as error
+	while(m_ubBitCount <= 56) {
+		std::uint8_t ubByte = 0;
+		while(
+			m_ulSegment < m_vSegments.size() &&
+			m_ulSegmentPos >= m_vSegments[m_ulSegment].second
+		) {
+			++m_ulSegment;
+			m_ulSegmentPos = 0;
+		}
+		if(m_ulSegment < m_vSegments.size()) {
+			ubByte = m_vSegments[m_ulSegment].first[m_ulSegmentPos++];
+		}
+		else {
+			m_ulPadBits += 8;
+		}
+		m_ullBits |= std::uint64_t(ubByte) << m_ubBitCount;
+		m_ubBitCount += 8;
+	}
+}
+
+std::uint32_t tPngReader::tInflate::getBits(std::uint8_t ubCount)
+{
+	if(m_ubBitCount < ubCount) {
+		refill();
+	}
+	std::uint32_t ulValue = std::uint32_t(m_ullBits & ((1ull << ubCount) - 1));
+	m_ullBits >>= ubCount;
+	m_ubBitCount -= ubCount;
+	return ulValue;
+}
+
+std::int32_t tPngReader::tInflate::decodeSymbol(const tHuffman &Huffman)
+{
+	if(m_ubBitCount < 15) {
+		refill();
+	}
+	auto uwEntry = Huffman.pFast[m_ullBits & ((1 << tHuffman::s_ubFastBits) - 1)];
+	if(uwEntry) {
+		getBits(uwEntry & 0xF);
+		return uwEntry >> 4;
+	}
+
+	// Longer code - walk canonical code lengths bit by bit
+	std::int32_t lCode = 0, lFirst = 0, lIndex = 0;
+	for(std::uint8_t ubLength = 1; ubLength < 16; ++ubLength) {
+		lCode |= getBits(1);
+		std::int32_t lCount = Huffman.pCounts[ubLength];
+		if(lCode - lCount < lFirst) {
+			return Huffman.pSymbols[lIndex + (lCode - lFirst)];
+		}
+		lIndex += lCount;
+		lFirst = (lFirst + lCount) << 1;
+		lCode <<= 1;
+	}
+	return -1;
+}
+
+bool tPngReader::tInflate::readHeader(void)
+{
+	std::uint8_t ubCmf = std::uint8_t(getBits(8));
+	std::uint8_t ubFlg = std::uint8_t(getBits(8));
+	if((ubCmf & 0xF) != 8 || (ubCmf >> 4) > 7 || ((ubCmf << 8) | ubFlg) % 31) {
+		return false;
+	}
+	if(ubFlg & 0x20) {
+		// Preset dictionary isn't allowed in PNG
+		return false;
+	}
+	return !isPastEnd();
+}
+
+bool tPngReader::tInflate::isPastEnd(void) const
+{
+	return m_ubBitCount < m_ulPadBits;
+}
+
+bool tPngReader::tInflate::isFinalBlockEnded(void) const
+{
+	return m_eState == tState::BLOCK_HEADER && m_isFinalBlock && !m_uwMatchLeft;
+}
+
+bool tPngReader::tInflate::readDynamicTables(void)
+{
+	std::uint16_t uwLiteralCount = getBits(5) + 257;
+	std::uint16_t uwDistCount = getBits(5) + 1;
+	std::uint8_t ubCodeLengthCount = getBits(4) + 4;
+	if(uwLiteralCount > 286 || uwDistCount > 30) {
+		return false;
+	}
+
+	std::uint8_t pLengths[286 + 30] = {0};
+	for(std::uint8_t i = 0; i < ubCodeLengthCount; ++i) {
+		pLengths[s_pCodeLengthOrder[i]] = getBits(3);
+	}
+	tHuffman CodeLengths;
+	if(!buildHuffman(CodeLengths, pLengths, 19)) {
+		return false;
+	}
+
+	std::fill_n(pLengths, 19, 0);
+	std::uint16_t uwIdx = 0;
+	while(uwIdx < uwLiteralCount + uwDistCount) {
+		auto lSymbol = decodeSymbol(CodeLengths);
+		if(lSymbol < 0) {
+			return false;
+		}
+		if(lSymbol < 16) {
+			pLengths[uwIdx++] = std::uint8_t(lSymbol);
+			continue;
+		}
+
+		std::uint8_t ubValue = 0;
+		std::uint8_t ubRepeat;
+		if(lSymbol == 16) {
+			if(uwIdx == 0) {
+				return false;
+			}
+			ubValue = pLengths[uwIdx - 1];
+			ubRepeat = 3 + getBits(2);
+		}
+		else if(lSymbol == 17) {
+			ubRepeat = 3 + getBits(3);
+		}
+		else {
+			ubRepeat = 11 + getBits(7);
+		}
+		if(uwIdx + ubRepeat > uwLiteralCount + uwDistCount) {
+			return false;
+		}
+		std::fill_n(&pLengths[uwIdx], ubRepeat, ubValue);
+		uwIdx += ubRepeat;
+	}
+
+	if(!pLengths[256]) {
+		// No end of block code
+		return false;
+	}
+	return (
+		buildHuffman(m_Literals, pLengths, uwLiteralCount) &&
+		buildHuffman(m_Distances, &pLengths[uwLiteralCount], uwDistCount)
+	);
+}
+
+bool tPngReader::tInflate::readBlockHeader(void)
+{
+	m_isFinalBlock = getBits(1);
+	auto ubType = getBits(2);
+	if(ubType == 0) {
+		getBits(m_ubBitCount & 7);
+		std::uint16_t uwLength = getBits(16);
+		std::uint16_t uwLengthNeg = getBits(16);
+		if(uwLength != std::uint16_t(~uwLengthNeg)) {
+			return false;
+		}
+		m_uwStoredLeft = uwLength;
+		m_eState = tState::STORED;
+	}
+	else if(ubType == 1) {
+		std::uint8_t pLengths[288 + 30];
+		std::fill_n(&pLengths[0], 144, 8);
+		std::fill_n(&pLengths[144], 112, 9);
+		std::fill_n(&pLengths[256], 24, 7);
+		std::fill_n(&pLengths[280], 8, 8);
+		std::fill_n(&pLengths[288], 30, 5);
+		buildHuffman(m_Literals, pLengths, 288);
+		buildHuffman(m_Distances, &pLengths[288], 30);
+		m_eState = tState::HUFFMAN;
+	}
+	else if(ubType == 2) {
+		// Tables are long enough to run past the end of truncated stream
+		if(!readDynamicTables() || isPastEnd()) {
+			return false;
+		}
+		m_eState = tState::HUFFMAN;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+void tPngReader::tInflate::emit(
+	std::uint8_t ubValue, std::uint8_t *pDst, std::size_t &ulPos
+)
+{
+	m_vWindow[m_ullOutPos++ & (s_ulWindowSize - 1)] = ubValue;
+	pDst[ulPos++] = ubValue;
+	m_ulAdlerA += ubValue;
+	m_ulAdlerB += m_ulAdlerA;
+	if(++m_uwAdlerPending == s_uwAdlerMaxPending) {
+		m_ulAdlerA %= s_ulAdlerModulo;
+		m_ulAdlerB %= s_ulAdlerModulo;
+		m_uwAdlerPending = 0;
+	}
+}
+
+bool tPngReader::tInflate::step(
+	std::uint8_t *pDst, std::size_t &ulPos, std::size_t ulSize
+)
+{
+	if(m_uwMatchLeft) {
+		auto ulCount = std::min<std::size_t>(m_uwMatchLeft, ulSize - ulPos);
+		for(std::size_t i = 0; i < ulCount; ++i) {
+			emit(
+				m_vWindow[(m_ullOutPos - m_uwMatchDist) & (s_ulWindowSize - 1)],
+				pDst, ulPos
+			);
+		}
+		m_uwMatchLeft -= std::uint16_t(ulCount);
+		return true;
+	}
+
+	if(m_eState == tState::BLOCK_HEADER) {
+		if(!readBlockHeader()) {
+			return false;
+		}
+	}
+	else if(m_eState == tState::STORED) {
+		if(!m_uwStoredLeft) {
+			m_eState = tState::BLOCK_HEADER;
+			return true;
+		}
+		emit(std::uint8_t(getBits(8)), pDst, ulPos);
+		--m_uwStoredLeft;
+	}
+	else {
+		auto lSymbol = decodeSymbol(m_Literals);
+		if(lSymbol < 0 || lSymbol > 285) {
+			return false;
+		}
+		if(lSymbol < 256) {
+			emit(std::uint8_t(lSymbol), pDst, ulPos);
+		}
+		else if(lSymbol == 256) {
+			m_eState = tState::BLOCK_HEADER;
+		}
+		else {
+			lSymbol -= 257;
+			std::uint16_t uwLength = s_pLengthBase[lSymbol] + getBits(s_pLengthExtra[lSymbol]);
+			auto lDistSymbol = decodeSymbol(m_Distances);
+			if(lDistSymbol < 0 || lDistSymbol > 29) {
+				return false;
+			}
+			std::uint16_t uwDist = s_pDistBase[lDistSymbol] + getBits(s_pDistExtra[lDistSymbol]);
+			if(uwDist > m_ullOutPos) {
+				return false;
+			}
+			m_uwMatchLeft = uwLength;
+			m_uwMatchDist = uwDist;
+		}
+	}
+
+	// Reading past the end of compressed data
+	return !isPastEnd();
+}
+
+bool tPngReader::tInflate::read(std::uint8_t *pDst, std::size_t ulSize)
+{
+	std::size_t ulPos = 0;
+	while(ulPos < ulSize) {
+		if(isFinalBlockEnded()) {
+			// Stream ended before all requested data was produced
+			return false;
+		}
+		if(!step(pDst, ulPos, ulSize)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool tPngReader::tInflate::finish(void)
+{
+	// Image data may end before the final end of block code
+	std::uint8_t pDiscard[258];
+	while(!isFinalBlockEnded()) {
+		std::size_t ulPos = 0;
+		if(!step(pDiscard, ulPos, sizeof(pDiscard))) {
+			return false;
+		}
+	}
+
+	// Trailer is byte-aligned, stored big-endian
+	getBits(m_ubBitCount & 7);
+	std::uint32_t ulExpected = 0;
+	for(std::uint8_t i = 0; i < 4; ++i) {
+		ulExpected = (ulExpected << 8) | getBits(8);
+	}
+	if(isPastEnd()) {
+		return false;
+	}
+	std::uint32_t ulAdler = (
+		((m_ulAdlerB % s_ulAdlerModulo) << 16) | (m_ulAdlerA % s_ulAdlerModulo)
+	);
+	return ulAdler == ulExpected;
+}
+
+//--------------------------------------------------------------------- PNG READ
+
+static std::uint8_t pngPaeth(std::uint8_t ubA, std::uint8_t ubB, std::uint8_t ubC)
+{
+	std::int16_t wP = std::int16_t(ubA) + ubB - ubC;
+	std::int16_t wDistA = std::abs(wP - ubA);
+	std::int16_t wDistB = std::abs(wP - ubB);
+	std::int16_t wDistC = std::abs(wP - ubC);
+	if(wDistA <= wDistB && wDistA <= wDistC) {
+		return ubA;
+	}
+	return (wDistB <= wDistC) ? ubB : ubC;
+}
+
+tPngReader::tPngReader(const std::string &szPath):
+	m_File(szPath)
+{
+	lodepng_color_mode_init(&m_ColorIn);
+	lodepng_color_mode_init(&m_ColorOut);
+	m_ColorOut.colortype = LCT_RGB;
+	m_ColorOut.bitdepth = 8;
+	if(!m_File.isOpen()) {
+		return;
+	}
+
+	// Let lodepng validate the signature and IHDR
+	const std::uint8_t *pData = m_File.getData();
+	std::size_t ulSize = m_File.getSize();
+	LodePNGState State;
+	lodepng_state_init(&State);
+	unsigned uWidth, uHeight;
+	auto LodeError = lodepng_inspect(&uWidth, &uHeight, &State, pData, ulSize);
+	if(LodeError) {
+		lodepng_state_cleanup(&State);
+		return;
+	}
+	lodepng_color_mode_copy(&m_ColorIn, &State.info_png.color);
+	m_isInterlaced = State.info_png.interlace_method != 0;
+	lodepng_state_cleanup(&State);
+	if(m_isInterlaced) {
+		return;
+	}
+
+	// Gather palette and compressed data, checking chunk CRCs on the way
+	tInflate::tSegments vSegments;
+	std::size_t ulPos = 8;
+	bool isEnd = false;
+	while(!isEnd && ulPos + 12 <= ulSize) {
+		const std::uint8_t *pChunk = &pData[ulPos];
+		std::size_t ulChunkLength = lodepng_chunk_length(pChunk);
+		if(ulChunkLength > ulSize - ulPos - 12 || lodepng_chunk_check_crc(pChunk)) {
+			return;
+		}
+		const std::uint8_t *pChunkData = lodepng_chunk_data_const(pChunk);
+		if(lodepng_chunk_type_equals(pChunk, "IDAT")) {
+			vSegments.push_back({pChunkData, ulChunkLength});
+		}
+		else if(lodepng_chunk_type_equals(pChunk, "PLTE")) {
+			lodepng_palette_clear(&m_ColorIn);
+			for(std::size_t i = 0; i + 2 < ulChunkLength; i += 3) {
+				lodepng_palette_add(
+					&m_ColorIn, pChunkData[i], pChunkData[i + 1], pChunkData[i + 2], 255
+				);
+			}
+		}
+		else if(lodepng_chunk_type_equals(pChunk, "IEND")) {
+			isEnd = true;
+		}
+		ulPos += ulChunkLength + 12;
+	}
+	if(vSegments.empty() || (m_ColorIn.colortype == LCT_PALETTE && !m_ColorIn.palettesize)) {
+		return;
+	}
+
+	m_ulWidth = uWidth;
+	m_ulHeight = uHeight;
+	auto ulBitsPerPixel = lodepng_get_bpp(&m_ColorIn);
+	m_ulStride = (m_ulWidth * ulBitsPerPixel + 7) / 8;
+	m_ubBytesPerPixel = std::uint8_t((ulBitsPerPixel + 7) / 8);
+	// First byte of each row is its filter type
+	m_vRow.resize(m_ulStride + 1);
+	m_vPrevRow.resize(m_ulStride + 1, 0);
+
+	m_pInflate = std::make_unique<tInflate>(vSegments);
+	m_isOpen = m_pInflate->readHeader();
+}
+
+tPngReader::~tPngReader(void)
+{
+	lodepng_color_mode_cleanup(&m_ColorIn);
+	lodepng_color_mode_cleanup(&m_ColorOut);
+}
+
+bool tPngReader::isOpen(void) const
+{
+	return m_isOpen;
+}
+
+bool tPngReader::isInterlaced(void) const
+{
+	return m_isInterlaced;
+}
+
+std::uint32_t tPngReader::getWidth(void) const
+{
+	return m_ulWidth;
+}
+
+std::uint32_t tPngReader::getHeight(void) const
+{
+	return m_ulHeight;
+}
+
+bool tPngReader::decodeRow(void)
+{
+	if(!m_isOpen || m_ulRow >= m_ulHeight) {
+		return false;
+	}
+	if(!m_pInflate->read(m_vRow.data(), m_vRow.size())) {
+		m_isOpen = false;
+		return false;
+	}
+
+	std::uint8_t *pCurr = &m_vRow[1];
+	const std::uint8_t *pPrev = &m_vPrevRow[1];
+	std::uint32_t ulBpp = m_ubBytesPerPixel;
+	switch(m_vRow[0]) {
+		case 0:
+			break;
+		case 1:
+			for(std::uint32_t i = ulBpp; i < m_ulStride; ++i) {
+				pCurr[i] += pCurr[i - ulBpp];
+			}
+			break;
+		case 2:
+			for(std::uint32_t i = 0; i < m_ulStride; ++i) {
+				pCurr[i] += pPrev[i];
+			}
+			break;
+		case 3:
+			for(std::uint32_t i = 0; i < std::min(ulBpp, m_ulStride); ++i) {
+				pCurr[i] += pPrev[i] >> 1;
+			}
+			for(std::uint32_t i = ulBpp; i < m_ulStride; ++i) {
+				pCurr[i] += (pCurr[i - ulBpp] + pPrev[i]) >> 1;
+			}
+			break;
+		case 4:
+			for(std::uint32_t i = 0; i < std::min(ulBpp, m_ulStride); ++i) {
+				pCurr[i] += pPrev[i];
+			}
+			for(std::uint32_t i = ulBpp; i < m_ulStride; ++i) {
+				pCurr[i] += pngPaeth(pCurr[i - ulBpp], pPrev[i], pPrev[i - ulBpp]);
+			}
+			break;
+		default:
+			m_isOpen = false;
+			return false;
+	}
+
+	std::swap(m_vRow, m_vPrevRow);
+	++m_ulRow;
+	if(m_ulRow == m_ulHeight && !m_pInflate->finish()) {
+		m_isOpen = false;
+		return false;
+	}
+	return true;
+}
+
+bool tPngReader::readRow(tRgb *pDst)
+{
+	if(!decodeRow()) {
+		return false;
+	}
+	auto LodeError = lodepng_convert(
+		reinterpret_cast<std::uint8_t*>(pDst), &m_vPrevRow[1],
+		&m_ColorOut, &m_ColorIn, m_ulWidth, 1
+	);
+	return LodeError == 0;
+}
+
+bool tPngReader::skipRows(std::uint32_t ulCount)
+{
+	for(std::uint32_t i = 0; i < ulCount; ++i) {
+		if(!decodeRow()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------- PNG WRITE
+
+bool pngParseLevel(const std::string &szLevel, std::uint8_t &ubLevel)
+{
+	if(szLevel.size() != 1 || szLevel[0] < '0' || szLevel[0] > '9') {
+		nLog::error("Invalid png compression level: '{}', expected 0..9", szLevel);
+		return false;
+	}
+	ubLevel = std::uint8_t(szLevel[0] - '0');
+	return true;
+}
+
+bool pngParseFilter(const std::string &szFilter, tPngFilter &eFilter)
+{
+	if(szFilter == "none") {
+		eFilter = tPngFilter::NONE;
+	}
+	else if(szFilter == "minsum") {
+		eFilter = tPngFilter::MINSUM;
+	}
+	else if(szFilter == "entropy") {
+		eFilter = tPngFilter::ENTROPY;
+	}
+	else if(szFilter == "brute") {
+		eFilter = tPngFilter::BRUTE_FORCE;
+	}
+	else {
+		nLog::error("Unknown png filter: '{}'", szFilter);
+		return false;
+	}
+	return true;
+}
+
+bool pngEncode(
+	const std::string &szPath, const std::uint8_t *pRgb,
+	std::uint32_t ulWidth, std::uint32_t ulHeight,
+	const tPngEncodeSettings &Settings
+)
+{
+	// Window size, nice match length, lazy matching - level 5 is lodepng's default
+	static constexpr struct {
+		std::uint16_t uwWindowSize;
+		std::uint16_t uwNiceMatch;
+		bool isLazy;
+	} s_pLevels[10] = {
+		{0, 0, false},
+		{256, 16, false}, {512, 32, false}, {1024, 64, false}, {1024, 96, true},
+		{2048, 128, true}, {4096, 128, true}, {8192, 258, true},
+		{16384, 258, true}, {32768, 258, true},
+	};
+
+	LodePNGState State;
+	lodepng_state_init(&State);
+	State.info_raw.colortype = LCT_RGB;
+	State.info_raw.bitdepth = 8;
+	State.info_png.color.colortype = LCT_RGB;
+	State.info_png.color.bitdepth = 8;
+
+	auto &Zlib = State.encoder.zlibsettings;
+	auto ubLevel = std::min<std::uint8_t>(Settings.ubLevel, 9);
+	if(ubLevel == 0) {
+		Zlib.btype = 0;
+		Zlib.use_lz77 = 0;
+	}
+	else {
+		Zlib.windowsize = s_pLevels[ubLevel].uwWindowSize;
+		Zlib.nicematch = s_pLevels[ubLevel].uwNiceMatch;
+		Zlib.lazymatching = s_pLevels[ubLevel].isLazy;
+	}
+	switch(Settings.eFilter) {
+		case tPngFilter::NONE: State.encoder.filter_strategy = LFS_ZERO; break;
+		case tPngFilter::MINSUM: State.encoder.filter_strategy = LFS_MINSUM; break;
+		case tPngFilter::ENTROPY: State.encoder.filter_strategy = LFS_ENTROPY; break;
+		case tPngFilter::BRUTE_FORCE: State.encoder.filter_strategy = LFS_BRUTE_FORCE; break;
+	}
+
+	std::uint8_t *pOut = nullptr;
+	std::size_t ulOutSize = 0;
+	auto LodeErr = lodepng_encode(&pOut, &ulOutSize, pRgb, ulWidth, ulHeight, &State);
+	if(!LodeErr) {
+		LodeErr = lodepng_save_file(pOut, ulOutSize, szPath.c_str());
+	}
+	free(pOut);
+	lodepng_state_cleanup(&State);
+	return LodeErr == 0;
+}
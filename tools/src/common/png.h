@@ -0,0 +1,117 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_PNG_H_
+#define _ACE_TOOLS_COMMON_PNG_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "fs.h"
+#include "rgb.h"
+#include "lodepng.h"
+
+enum class tPngFilter: std::uint8_t {
+	NONE,
+	MINSUM,
+	ENTROPY,
+	BRUTE_FORCE,
+};
+
+/**
+ * @brief PNG encoder settings. Defaults match ones of lodepng.
+ */
+struct tPngEncodeSettings {
+	/// 0 stores image data without compression, 1 is fastest, 9 compresses best.
+	std::uint8_t ubLevel = 5;
+	/// Row filter choice for truecolor images, palette ones are never filtered.
+	tPngFilter eFilter = tPngFilter::MINSUM;
+};
+
+bool pngParseLevel(const std::string &szLevel, std::uint8_t &ubLevel);
+
+bool pngParseFilter(const std::string &szFilter, tPngFilter &eFilter);
+
+/**
+ * @brief Encodes 24-bit RGB image to PNG file.
+ *
+ * @param szPath Destination path.
+ * @param pRgb Image data, 3 bytes per pixel.
+ * @param ulWidth Image width.
+ * @param ulHeight Image height.
+ * @param Settings Encoder settings.
+ * @return True on success, otherwise false.
+ */
+bool pngEncode(
+	const std::string &szPath, const std::uint8_t *pRgb,
+	std::uint32_t ulWidth, std::uint32_t ulHeight,
+	const tPngEncodeSettings &Settings
+);
+
+/**
+ * @brief Decodes PNG file row by row, without holding whole image in memory.
+ * Compressed data is mapped from file and inflated on the fly, so only current
+ * and previous scanline are kept - converters which need only part of image
+ * may stop reading early.
+ *
+ * Rows are converted to 24-bit RGB the same way lodepng_decode24() does.
+ * Interlaced images can't be streamed - isOpen() returns false for them,
+ * with isInterlaced() allowing to fall back to whole image decoding.
+ */
+class tPngReader {
+public:
+	tPngReader(const std::string &szPath);
+
+	~tPngReader(void);
+
+	tPngReader(const tPngReader &Other) = delete;
+
+	tPngReader &operator=(const tPngReader &Other) = delete;
+
+	bool isOpen(void) const;
+
+	bool isInterlaced(void) const;
+
+	std::uint32_t getWidth(void) const;
+
+	std::uint32_t getHeight(void) const;
+
+	/**
+	 * @brief Decodes next row.
+	 *
+	 * @param pDst Destination for getWidth() pixels.
+	 * @return True on success, false on decode error or if there are no more rows.
+	 */
+	bool readRow(tRgb *pDst);
+
+	/**
+	 * @brief Decodes next rows without color conversion, discarding them.
+	 *
+	 * @param ulCount Number of rows to skip.
+	 * @return True on success, otherwise false.
+	 */
+	bool skipRows(std::uint32_t ulCount);
+
+private:
+	class tInflate;
+
+	bool decodeRow(void);
+
+	nFs::tMappedFile m_File;
+	std::unique_ptr<tInflate> m_pInflate;
+	LodePNGColorMode m_ColorIn;
+	LodePNGColorMode m_ColorOut;
+	std::uint32_t m_ulWidth = 0;
+	std::uint32_t m_ulHeight = 0;
+	std::uint32_t m_ulRow = 0;
+	std::uint32_t m_ulStride = 0;
+	std::uint8_t m_ubBytesPerPixel = 0;
+	std::vector<std::uint8_t> m_vRow;
+	std::vector<std::uint8_t> m_vPrevRow;
+	bool m_isOpen = false;
+	bool m_isInterlaced = false;
+};
+
+#endif // _ACE_TOOLS_COMMON_PNG_H_
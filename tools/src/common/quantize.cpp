@@ -0,0 +1,463 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "quantize.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+struct tQuantizeBin {
+	double fR, fG, fB;
+	std::uint32_t ulCount;
+};
+
+struct tQuantizeBox {
+	std::size_t ulStart;
+	std::size_t ulEnd;
+};
+
+struct tQuantizeSum {
+	double fR, fG, fB, fCount;
+};
+
+/**
+ * @brief Nearest palette color lookup, with direct-mapped cache of recent
+ * results. Not thread-safe - use one per thread.
+ */
+class tQuantizeNearest {
+public:
+	tQuantizeNearest(const std::vector<tRgb> &vColors):
+		m_vColors(vColors),
+		m_vCacheKeys(s_ulCacheSize, 0),
+		m_vCacheIndices(s_ulCacheSize, 0)
+	{
+	}
+
+	std::uint8_t find(std::int32_t lR, std::int32_t lG, std::int32_t lB) {
+		std::uint32_t ulKey = (lR << 16) | (lG << 8) | lB;
+		std::uint32_t ulSlot = ((ulKey * 0x9E3779B1) >> 20) & (s_ulCacheSize - 1);
+		if(m_vCacheKeys[ulSlot] == (ulKey | s_ulCacheValid)) {
+			return m_vCacheIndices[ulSlot];
+		}
+
+		// First match wins, same as tPalette::getColorIdx()
+		std::uint8_t ubBest = 0;
+		std::int32_t lBestDist = INT32_MAX;
+		for(std::size_t i = 0; i < m_vColors.size(); ++i) {
+			std::int32_t lDistR = lR - m_vColors[i].ubR;
+			std::int32_t lDistG = lG - m_vColors[i].ubG;
+			std::int32_t lDistB = lB - m_vColors[i].ubB;
+			std::int32_t lDist = lDistR * lDistR + lDistG * lDistG + lDistB * lDistB;
+			if(lDist < lBestDist) {
+				lBestDist = lDist;
+				ubBest = std::uint8_t(i);
+			}
+		}
+
+		m_vCacheKeys[ulSlot] = ulKey | s_ulCacheValid;
+		m_vCacheIndices[ulSlot] = ubBest;
+		return ubBest;
+	}
+
+private:
+	static constexpr std::uint32_t s_ulCacheSize = 4096;
+	static constexpr std::uint32_t s_ulCacheValid = 1 << 24;
+
+	const std::vector<tRgb> &m_vColors;
+	std::vector<std::uint32_t> m_vCacheKeys;
+	std::vector<std::uint8_t> m_vCacheIndices;
+};
+
+static constexpr std::uint8_t s_pBayer8[8][8] = {
+	{ 0, 32,  8, 40,  2, 34, 10, 42},
+	{48, 16, 56, 24, 50, 18, 58, 26},
+	{12, 44,  4, 36, 14, 46,  6, 38},
+	{60, 28, 52, 20, 62, 30, 54, 22},
+	{ 3, 35, 11, 43,  1, 33,  9, 41},
+	{51, 19, 59, 27, 49, 17, 57, 25},
+	{15, 47,  7, 39, 13, 45,  5, 37},
+	{63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+static std::vector<tQuantizeBin> quantizeGetBins(
+	const std::vector<const tChunkyBitmap*> &vBitmaps,
+	const std::optional<tRgb> &Ignore, std::uint32_t ulThreadCount
+)
+{
+	// Group colors into 15-bit bins, keeping their exact mean. Each thread
+	// fills its own histogram, merged afterwards.
+	ulThreadCount = std::max(1u, std::min(ulThreadCount, std::uint32_t(vBitmaps.size())));
+	std::vector<std::vector<tQuantizeSum>> vThreadSums(
+		ulThreadCount, std::vector<tQuantizeSum>(1 << 15, {0, 0, 0, 0})
+	);
+	std::atomic<std::size_t> NextBitmap = 0;
+	auto Worker = [&](std::vector<tQuantizeSum> &vSums) {
+		for(auto i = NextBitmap++; i < vBitmaps.size(); i = NextBitmap++) {
+			for(const auto &Color: vBitmaps[i]->m_vData) {
+				if(Ignore && Color == Ignore.value()) {
+					continue;
+				}
+				auto &Sum = vSums[((Color.ubR >> 3) << 10) | ((Color.ubG >> 3) << 5) | (Color.ubB >> 3)];
+				Sum.fR += Color.ubR;
+				Sum.fG += Color.ubG;
+				Sum.fB += Color.ubB;
+				Sum.fCount += 1;
+			}
+		}
+	};
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker, std::ref(vThreadSums[i]));
+	}
+	Worker(vThreadSums[0]);
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+
+	auto &vSums = vThreadSums[0];
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		for(std::size_t ulBin = 0; ulBin < vSums.size(); ++ulBin) {
+			vSums[ulBin].fR += vThreadSums[i][ulBin].fR;
+			vSums[ulBin].fG += vThreadSums[i][ulBin].fG;
+			vSums[ulBin].fB += vThreadSums[i][ulBin].fB;
+			vSums[ulBin].fCount += vThreadSums[i][ulBin].fCount;
+		}
+	}
+
+	std::vector<tQuantizeBin> vBins;
+	for(const auto &Sum: vSums) {
+		if(Sum.fCount) {
+			vBins.push_back({
+				Sum.fR / Sum.fCount, Sum.fG / Sum.fCount, Sum.fB / Sum.fCount,
+				std::uint32_t(Sum.fCount)
+			});
+		}
+	}
+	return vBins;
+}
+
+static double quantizeGetChannel(const tQuantizeBin &Bin, std::uint8_t ubChannel)
+{
+	return ubChannel == 0 ? Bin.fR : (ubChannel == 1 ? Bin.fG : Bin.fB);
+}
+
+static std::vector<tQuantizeSum> quantizeMedianCut(
+	std::vector<tQuantizeBin> &vBins, std::uint16_t uwColorCount
+)
+{
+	std::vector<tQuantizeBox> vBoxes = {{0, vBins.size()}};
+	while(vBoxes.size() < uwColorCount) {
+		// Split the box with the widest channel range
+		double fBestRange = 0;
+		std::size_t ulBestBox = 0;
+		std::uint8_t ubBestChannel = 0;
+		for(std::size_t i = 0; i < vBoxes.size(); ++i) {
+			if(vBoxes[i].ulEnd - vBoxes[i].ulStart < 2) {
+				continue;
+			}
+			for(std::uint8_t ubChannel = 0; ubChannel < 3; ++ubChannel) {
+				auto [MinIt, MaxIt] = std::minmax_element(
+					&vBins[vBoxes[i].ulStart], &vBins[vBoxes[i].ulEnd],
+					[ubChannel](const tQuantizeBin &Lhs, const tQuantizeBin &Rhs) {
+						return quantizeGetChannel(Lhs, ubChannel) < quantizeGetChannel(Rhs, ubChannel);
+					}
+				);
+				double fRange = quantizeGetChannel(*MaxIt, ubChannel) - quantizeGetChannel(*MinIt, ubChannel);
+				if(fRange > fBestRange) {
+					fBestRange = fRange;
+					ulBestBox = i;
+					ubBestChannel = ubChannel;
+				}
+			}
+		}
+		if(fBestRange == 0) {
+			break;
+		}
+
+		// Split at pixel-weighted median, leaving at least one bin on each side
+		auto &Box = vBoxes[ulBestBox];
+		std::sort(
+			&vBins[Box.ulStart], &vBins[Box.ulEnd],
+			[ubBestChannel](const tQuantizeBin &Lhs, const tQuantizeBin &Rhs) {
+				return quantizeGetChannel(Lhs, ubBestChannel) < quantizeGetChannel(Rhs, ubBestChannel);
+			}
+		);
+		std::uint64_t ullTotal = 0;
+		for(auto i = Box.ulStart; i < Box.ulEnd; ++i) {
+			ullTotal += vBins[i].ulCount;
+		}
+		std::uint64_t ullAccumulated = 0;
+		std::size_t ulSplit = Box.ulStart + 1;
+		for(auto i = Box.ulStart; i < Box.ulEnd - 1; ++i) {
+			ullAccumulated += vBins[i].ulCount;
+			ulSplit = i + 1;
+			if(ullAccumulated * 2 >= ullTotal) {
+				break;
+			}
+		}
+		tQuantizeBox NewBox = {ulSplit, Box.ulEnd};
+		Box.ulEnd = ulSplit;
+		vBoxes.push_back(NewBox);
+	}
+
+	std::vector<tQuantizeSum> vCentroids;
+	for(const auto &Box: vBoxes) {
+		tQuantizeSum Sum = {0, 0, 0, 0};
+		for(auto i = Box.ulStart; i < Box.ulEnd; ++i) {
+			Sum.fR += vBins[i].fR * vBins[i].ulCount;
+			Sum.fG += vBins[i].fG * vBins[i].ulCount;
+			Sum.fB += vBins[i].fB * vBins[i].ulCount;
+			Sum.fCount += vBins[i].ulCount;
+		}
+		vCentroids.push_back({
+			Sum.fR / Sum.fCount, Sum.fG / Sum.fCount, Sum.fB / Sum.fCount, Sum.fCount
+		});
+	}
+	return vCentroids;
+}
+
+static tRgb quantizeToRgb(const tQuantizeSum &Centroid, bool isOcs)
+{
+	auto ToByte = [](double fValue) {
+		return std::uint8_t(std::clamp(std::lround(fValue), 0l, 255l));
+	};
+	tRgb Color(ToByte(Centroid.fR), ToByte(Centroid.fG), ToByte(Centroid.fB));
+	return isOcs ? Color.to12Bit() : Color;
+}
+
+static tPalette quantizeGeneratePalette(
+	const std::vector<const tChunkyBitmap*> &vBitmaps, std::uint16_t uwColorCount,
+	bool isEhb, bool isOcs, const std::optional<tRgb> &Ignore,
+	std::uint32_t ulThreadCount
+)
+{
+	if(uwColorCount == 0 || uwColorCount > 256 || (isEhb && uwColorCount > 32)) {
+		throw std::runtime_error("Unsupported palette color count");
+	}
+
+	// EHB is OCS/ECS feature, so its colors are always 12-bit
+	isOcs = isOcs || isEhb;
+
+	auto vBins = quantizeGetBins(vBitmaps, Ignore, ulThreadCount);
+	if(vBins.empty()) {
+		return tPalette(std::vector<tRgb>{tRgb(0)});
+	}
+	auto vCentroids = quantizeMedianCut(vBins, uwColorCount);
+
+	// Refine with k-means. For EHB, bins may also match half-bright colors,
+	// in which case they pull the base color to twice their value.
+	static constexpr std::uint8_t s_ubMaxIterations = 16;
+	std::vector<tRgb> vCandidates;
+	for(std::uint8_t ubIteration = 0; ubIteration < s_ubMaxIterations; ++ubIteration) {
+		vCandidates.clear();
+		for(const auto &Centroid: vCentroids) {
+			vCandidates.push_back(quantizeToRgb(Centroid, isOcs));
+		}
+		if(isEhb) {
+			for(std::size_t i = 0; i < vCentroids.size(); ++i) {
+				vCandidates.push_back(vCandidates[i].toEhb());
+			}
+		}
+
+		tQuantizeNearest Nearest(vCandidates);
+		std::vector<tQuantizeSum> vSums(vCentroids.size(), {0, 0, 0, 0});
+		for(const auto &Bin: vBins) {
+			auto ubIdx = Nearest.find(
+				std::lround(Bin.fR), std::lround(Bin.fG), std::lround(Bin.fB)
+			);
+			double fScale = 1;
+			if(ubIdx >= vCentroids.size()) {
+				ubIdx -= std::uint8_t(vCentroids.size());
+				fScale = 2;
+			}
+			auto &Sum = vSums[ubIdx];
+			Sum.fR += std::min(Bin.fR * fScale, 255.0) * Bin.ulCount;
+			Sum.fG += std::min(Bin.fG * fScale, 255.0) * Bin.ulCount;
+			Sum.fB += std::min(Bin.fB * fScale, 255.0) * Bin.ulCount;
+			Sum.fCount += Bin.ulCount;
+		}
+
+		double fMaxShift = 0;
+		for(std::size_t i = 0; i < vCentroids.size(); ++i) {
+			const auto &Sum = vSums[i];
+			if(!Sum.fCount) {
+				// Unused color - leave it where it was
+				continue;
+			}
+			tQuantizeSum New = {
+				Sum.fR / Sum.fCount, Sum.fG / Sum.fCount, Sum.fB / Sum.fCount, Sum.fCount
+			};
+			fMaxShift = std::max({
+				fMaxShift, std::abs(New.fR - vCentroids[i].fR),
+				std::abs(New.fG - vCentroids[i].fG), std::abs(New.fB - vCentroids[i].fB)
+			});
+			vCentroids[i] = New;
+		}
+		if(fMaxShift < 0.5) {
+			break;
+		}
+	}
+
+	tPalette Palette;
+	for(const auto &Centroid: vCentroids) {
+		Palette.m_vColors.push_back(quantizeToRgb(Centroid, isOcs));
+	}
+	return Palette;
+}
+
+tPalette quantizeGeneratePalette(
+	const tChunkyBitmap &Bitmap, std::uint16_t uwColorCount, bool isEhb,
+	bool isOcs, const std::optional<tRgb> &Ignore
+)
+{
+	return quantizeGeneratePalette(
+		std::vector<const tChunkyBitmap*>{&Bitmap}, uwColorCount, isEhb, isOcs,
+		Ignore, 1
+	);
+}
+
+tPalette quantizeGeneratePalette(
+	const std::vector<tChunkyBitmap> &vBitmaps, std::uint16_t uwColorCount,
+	bool isEhb, bool isOcs, const std::optional<tRgb> &Ignore,
+	std::uint32_t ulThreadCount
+)
+{
+	std::vector<const tChunkyBitmap*> vBitmapPtrs;
+	for(const auto &Bitmap: vBitmaps) {
+		vBitmapPtrs.push_back(&Bitmap);
+	}
+	return quantizeGeneratePalette(
+		vBitmapPtrs, uwColorCount, isEhb, isOcs, Ignore, ulThreadCount
+	);
+}
+
+tChunkyBitmap quantizeRemap(
+	const tChunkyBitmap &Bitmap, const tPalette &Palette,
+	tQuantizeDither eDither, const std::optional<tRgb> &Ignore,
+	std::uint32_t ulThreadCount
+)
+{
+	const auto &vColors = Palette.m_vColors;
+	if(vColors.empty() || vColors.size() > 256) {
+		throw std::runtime_error("Unsupported palette color count");
+	}
+
+	std::uint32_t ulWidth = Bitmap.m_uwWidth;
+	std::uint32_t ulHeight = Bitmap.m_uwHeight;
+	tChunkyBitmap Out(Bitmap.m_uwWidth, Bitmap.m_uwHeight);
+
+	// Bayer offsets get scaled to the average distance between palette colors
+	std::int32_t lOrderedSpread = std::int32_t(256 / std::cbrt(double(vColors.size())));
+
+	// Floyd-Steinberg: row y may process pixel x only after row y - 1 is done
+	// with x + 1, since it receives error from it. Two error rows suffice,
+	// since row y zeroes its input after use and row y + 1 writes to it
+	// only after row y is done with given part of it.
+	std::vector<std::atomic<std::uint32_t>> vProgress(ulHeight);
+	std::vector<std::int32_t> vErrors(2 * (ulWidth + 2) * 3, 0);
+
+	std::atomic<std::uint32_t> NextRow = 0;
+	auto Worker = [&]() {
+		tQuantizeNearest Nearest(vColors);
+		for(auto y = NextRow++; y < ulHeight; y = NextRow++) {
+			const tRgb *pSrc = &Bitmap.m_vData[y * ulWidth];
+			tRgb *pDst = &Out.m_vData[y * ulWidth];
+			if(eDither == QUANTIZE_DITHER_FLOYD_STEINBERG) {
+				std::int32_t *pErrIn = &vErrors[(y & 1) * (ulWidth + 2) * 3];
+				std::int32_t *pErrOut = &vErrors[((y + 1) & 1) * (ulWidth + 2) * 3];
+				std::int32_t pCarry[3] = {0, 0, 0};
+				std::uint32_t ulPrevProgress = 0;
+				for(std::uint32_t x = 0; x < ulWidth; ++x) {
+					if(y > 0) {
+						auto ulNeeded = std::min(x + 2, ulWidth);
+						while(ulPrevProgress < ulNeeded) {
+							ulPrevProgress = vProgress[y - 1].load(std::memory_order_acquire);
+							if(ulPrevProgress < ulNeeded) {
+								std::this_thread::yield();
+							}
+						}
+					}
+
+					// Errors are stored in 1/16 units
+					std::int32_t *pIn = &pErrIn[(x + 1) * 3];
+					if(Ignore && pSrc[x] == Ignore.value()) {
+						pDst[x] = pSrc[x];
+						std::fill_n(pIn, 3, 0);
+						std::fill_n(pCarry, 3, 0);
+					}
+					else {
+						const std::uint8_t pSrcChannels[3] = {pSrc[x].ubR, pSrc[x].ubG, pSrc[x].ubB};
+						std::int32_t pValue[3];
+						for(std::uint8_t c = 0; c < 3; ++c) {
+							pValue[c] = std::clamp(
+								pSrcChannels[c] + ((pIn[c] + pCarry[c] + 8) >> 4), 0, 255
+							);
+							pIn[c] = 0;
+						}
+						const auto &Chosen = vColors[Nearest.find(pValue[0], pValue[1], pValue[2])];
+						pDst[x] = Chosen;
+						const std::uint8_t pChosenChannels[3] = {Chosen.ubR, Chosen.ubG, Chosen.ubB};
+						for(std::uint8_t c = 0; c < 3; ++c) {
+							std::int32_t lError = pValue[c] - pChosenChannels[c];
+							pCarry[c] = lError * 7;
+							pErrOut[x * 3 + c] += lError * 3;
+							pErrOut[(x + 1) * 3 + c] += lError * 5;
+							pErrOut[(x + 2) * 3 + c] += lError;
+						}
+					}
+					vProgress[y].store(x + 1, std::memory_order_release);
+				}
+			}
+			else {
+				for(std::uint32_t x = 0; x < ulWidth; ++x) {
+					if(Ignore && pSrc[x] == Ignore.value()) {
+						pDst[x] = pSrc[x];
+						continue;
+					}
+					std::int32_t lOffset = 0;
+					if(eDither == QUANTIZE_DITHER_ORDERED) {
+						lOffset = ((2 * s_pBayer8[y & 7][x & 7] + 1) * lOrderedSpread) / 128 - lOrderedSpread / 2;
+					}
+					pDst[x] = vColors[Nearest.find(
+						std::clamp(pSrc[x].ubR + lOffset, 0, 255),
+						std::clamp(pSrc[x].ubG + lOffset, 0, 255),
+						std::clamp(pSrc[x].ubB + lOffset, 0, 255)
+					)];
+				}
+			}
+		}
+	};
+
+	ulThreadCount = std::max(1u, std::min(ulThreadCount, ulHeight));
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
+	}
+	Worker();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	return Out;
+}
+
+bool quantizeParseDither(const std::string &szName, tQuantizeDither &eDither)
+{
+	if(szName == "none") {
+		eDither = QUANTIZE_DITHER_NONE;
+	}
+	else if(szName == "ordered") {
+		eDither = QUANTIZE_DITHER_ORDERED;
+	}
+	else if(szName == "fs") {
+		eDither = QUANTIZE_DITHER_FLOYD_STEINBERG;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
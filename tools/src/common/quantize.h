@@ -0,0 +1,84 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_QUANTIZE_H_
+#define _ACE_TOOLS_COMMON_QUANTIZE_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "bitmap.h"
+#include "palette.h"
+
+enum tQuantizeDither {
+	QUANTIZE_DITHER_NONE,
+	QUANTIZE_DITHER_ORDERED, ///< 8x8 Bayer matrix.
+	QUANTIZE_DITHER_FLOYD_STEINBERG,
+};
+
+/**
+ * @brief Parses dithering method name: none, ordered or fs.
+ *
+ * @param szName Name to be parsed.
+ * @param eDither Destination of parsed value, unchanged on failure.
+ * @return True on success, false on unknown name.
+ */
+bool quantizeParseDither(const std::string &szName, tQuantizeDither &eDither);
+
+/**
+ * @brief Generates palette for given bitmap using median cut, refined
+ * with k-means.
+ *
+ * @param Bitmap Source bitmap.
+ * @param uwColorCount Max number of palette colors. For EHB, number of base
+ * colors - at most 32, with their half-bright counterparts taken into account.
+ * @param isEhb If set, palette is optimized for EHB mode.
+ * @param isOcs If set, palette colors are limited to 12-bit.
+ * @param Ignore Color to be skipped, e.g. mask color.
+ * @return Generated palette, possibly with less colors than requested.
+ */
+tPalette quantizeGeneratePalette(
+	const tChunkyBitmap &Bitmap, std::uint16_t uwColorCount, bool isEhb,
+	bool isOcs, const std::optional<tRgb> &Ignore
+);
+
+/**
+ * @brief Generates single palette shared by all given bitmaps, minimizing
+ * their total color error - each pixel has the same weight, so bigger
+ * bitmaps have more influence on the result.
+ *
+ * @param vBitmaps Source bitmaps.
+ * @param uwColorCount Max number of palette colors, same as for single bitmap.
+ * @param isEhb If set, palette is optimized for EHB mode.
+ * @param isOcs If set, palette colors are limited to 12-bit.
+ * @param Ignore Color to be skipped, e.g. mask color.
+ * @param ulThreadCount Number of threads used for building color histogram.
+ * @return Generated palette, possibly with less colors than requested.
+ */
+tPalette quantizeGeneratePalette(
+	const std::vector<tChunkyBitmap> &vBitmaps, std::uint16_t uwColorCount,
+	bool isEhb, bool isOcs, const std::optional<tRgb> &Ignore,
+	std::uint32_t ulThreadCount
+);
+
+/**
+ * @brief Replaces bitmap colors with nearest ones from palette.
+ * Rows are processed in parallel, Floyd-Steinberg included - its result
+ * is the same as the sequential one.
+ *
+ * @param Bitmap Source bitmap.
+ * @param Palette Palette to be used. For EHB, pass one with all 64 colors.
+ * @param eDither Dithering method.
+ * @param Ignore Color to be left as-is, e.g. mask color.
+ * @param ulThreadCount Number of threads to be used.
+ * @return Bitmap using only palette colors and the ignored one.
+ */
+tChunkyBitmap quantizeRemap(
+	const tChunkyBitmap &Bitmap, const tPalette &Palette,
+	tQuantizeDither eDither, const std::optional<tRgb> &Ignore,
+	std::uint32_t ulThreadCount
+);
+
+#endif // _ACE_TOOLS_COMMON_QUANTIZE_H_
@@ -0,0 +1,164 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "resample.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <numbers>
+#include <thread>
+
+struct tResampleParams {
+	std::uint8_t ubTaps;
+	double dKaiserBeta;
+	double dRolloff;
+};
+
+static constexpr tResampleParams s_pResampleParams[] = {
+	{16, 6.0, 0.85}, // FAST
+	{32, 8.0, 0.92}, // MEDIUM
+	{64, 10.0, 0.95}, // BEST
+};
+
+static constexpr std::uint32_t s_ulPhaseCount = 256;
+static constexpr std::uint32_t s_ulBlockSize = 4096;
+static constexpr std::uint32_t s_ulLaneCount = 8;
+static constexpr double s_dClockPal = 3546895;
+static constexpr double s_dClockNtsc = 3579545;
+static constexpr std::uint16_t s_uwPaulaMinPeriod = 124;
+
+static double besselI0(double dX)
+{
+	double dSum = 1;
+	double dTerm = 1;
+	for(std::uint32_t k = 1; k < 64 && dTerm > dSum * 1e-12; ++k) {
+		double dHalf = dX / (2 * k);
+		dTerm *= dHalf * dHalf;
+		dSum += dTerm;
+	}
+	return dSum;
+}
+
+static float dotProduct(const float *pA, const float *pB, std::uint32_t ulCount)
+{
+	// Separate lane sums let compiler vectorize it without reordering float adds
+	float pSums[s_ulLaneCount] = {0};
+	for(std::uint32_t i = 0; i < ulCount; i += s_ulLaneCount) {
+		for(std::uint32_t ulLane = 0; ulLane < s_ulLaneCount; ++ulLane) {
+			pSums[ulLane] += pA[i + ulLane] * pB[i + ulLane];
+		}
+	}
+	return (
+		(pSums[0] + pSums[4]) + (pSums[1] + pSums[5]) +
+		(pSums[2] + pSums[6]) + (pSums[3] + pSums[7])
+	);
+}
+
+bool resampleParseQuality(const std::string &szQuality, tResampleQuality &eQuality)
+{
+	if(szQuality == "fast") {
+		eQuality = tResampleQuality::FAST;
+	}
+	else if(szQuality == "medium") {
+		eQuality = tResampleQuality::MEDIUM;
+	}
+	else if(szQuality == "best") {
+		eQuality = tResampleQuality::BEST;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+double resampleGetPaulaRate(std::uint32_t ulRateHz, bool isNtsc, std::uint16_t &uwPeriod)
+{
+	double dClock = isNtsc ? s_dClockNtsc : s_dClockPal;
+	double dPeriod = std::round(dClock / std::max(1u, ulRateHz));
+	if(dPeriod < s_uwPaulaMinPeriod || dPeriod > UINT16_MAX) {
+		return 0;
+	}
+	uwPeriod = std::uint16_t(dPeriod);
+	return dClock / uwPeriod;
+}
+
+std::vector<float> resampleSinc(
+	std::span<const float> Samples, double dRateIn, double dRateOut,
+	tResampleQuality eQuality, std::uint32_t ulThreadCount
+)
+{
+	const auto &Params = s_pResampleParams[std::uint8_t(eQuality)];
+	double dRatio = dRateOut / dRateIn;
+	double dCutoff = std::min(1.0, dRatio) * Params.dRolloff;
+
+	// Keep transition band width relative to output rate when downsampling
+	auto ulTaps = std::uint32_t(std::ceil(Params.ubTaps / std::min(1.0, dRatio)));
+	ulTaps = (ulTaps + s_ulLaneCount - 1) & ~(s_ulLaneCount - 1);
+	std::int32_t lHalf = ulTaps / 2;
+
+	// Filter for each fractional position, with extra one at position 1
+	// for interpolating between adjacent phases.
+	std::vector<float> vFilters((s_ulPhaseCount + 1) * ulTaps);
+	double dWindowScale = 1.0 / besselI0(Params.dKaiserBeta);
+	for(std::uint32_t ulPhase = 0; ulPhase <= s_ulPhaseCount; ++ulPhase) {
+		float *pFilter = &vFilters[ulPhase * ulTaps];
+		double dFrac = double(ulPhase) / s_ulPhaseCount;
+		double dSum = 0;
+		for(std::uint32_t ulTap = 0; ulTap < ulTaps; ++ulTap) {
+			double dX = double(std::int32_t(ulTap) - lHalf + 1) - dFrac;
+			double dR = dX / lHalf;
+			double dWindow = (std::abs(dR) < 1) ?
+				besselI0(Params.dKaiserBeta * std::sqrt(1 - dR * dR)) * dWindowScale : 0;
+			double dArg = std::numbers::pi * dCutoff * dX;
+			double dSinc = (dArg == 0) ? 1 : std::sin(dArg) / dArg;
+			double dCoeff = dCutoff * dSinc * dWindow;
+			pFilter[ulTap] = float(dCoeff);
+			dSum += dCoeff;
+		}
+
+		// Normalize for unity gain at DC on every phase
+		for(std::uint32_t ulTap = 0; ulTap < ulTaps; ++ulTap) {
+			pFilter[ulTap] = float(pFilter[ulTap] / dSum);
+		}
+	}
+
+	// Pad source with silence so that filter never reads outside of it
+	std::vector<float> vPadded(Samples.size() + 2 * ulTaps, 0);
+	std::copy(Samples.begin(), Samples.end(), vPadded.begin() + ulTaps);
+
+	auto ulOutSize = std::uint32_t(std::ceil(Samples.size() * dRatio));
+	std::vector<float> vOut(ulOutSize);
+	double dStep = dRateIn / dRateOut;
+	std::uint32_t ulBlockCount = (ulOutSize + s_ulBlockSize - 1) / s_ulBlockSize;
+	std::atomic<std::uint32_t> NextBlock = 0;
+	auto Worker = [&]() {
+		for(auto ulBlock = NextBlock++; ulBlock < ulBlockCount; ulBlock = NextBlock++) {
+			std::uint32_t ulEnd = std::min(ulOutSize, (ulBlock + 1) * s_ulBlockSize);
+			for(std::uint32_t ulOut = ulBlock * s_ulBlockSize; ulOut < ulEnd; ++ulOut) {
+				// Position is computed from scratch so that blocks are independent
+				double dPos = ulOut * dStep;
+				double dPosInt = std::floor(dPos);
+				double dPhase = (dPos - dPosInt) * s_ulPhaseCount;
+				auto ulPhase = std::min(s_ulPhaseCount - 1, std::uint32_t(dPhase));
+				float fPhaseFrac = float(dPhase - ulPhase);
+				const float *pSrc = &vPadded[std::size_t(dPosInt) + ulTaps - lHalf + 1];
+				const float *pFilter = &vFilters[ulPhase * ulTaps];
+				float fA = dotProduct(pSrc, pFilter, ulTaps);
+				float fB = dotProduct(pSrc, pFilter + ulTaps, ulTaps);
+				vOut[ulOut] = fA + (fB - fA) * fPhaseFrac;
+			}
+		}
+	};
+
+	ulThreadCount = std::max(1u, std::min(ulThreadCount, ulBlockCount));
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulThreadCount; ++i) {
+		vThreads.emplace_back(Worker);
+	}
+	Worker();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	return vOut;
+}
@@ -0,0 +1,50 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_RESAMPLE_H_
+#define _ACE_TOOLS_COMMON_RESAMPLE_H_
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class tResampleQuality: std::uint8_t {
+	FAST,
+	MEDIUM,
+	BEST,
+};
+
+bool resampleParseQuality(const std::string &szQuality, tResampleQuality &eQuality);
+
+/**
+ * @brief Finds sample rate closest to requested one, which is played back
+ * by Paula at exact period - without pitch error caused by period rounding.
+ *
+ * @param ulRateHz Requested sample rate.
+ * @param isNtsc If set, NTSC clock is used, otherwise PAL one.
+ * @param uwPeriod Paula period for returned rate.
+ * @return Exact sample rate, or 0 if requested one is too high for Paula.
+ */
+double resampleGetPaulaRate(std::uint32_t ulRateHz, bool isNtsc, std::uint16_t &uwPeriod);
+
+/**
+ * @brief Changes sample rate using polyphase windowed-sinc filter. Filter is
+ * widened when downsampling so that it also removes frequencies which
+ * wouldn't fit in new rate. Output is computed in independent blocks,
+ * split between threads.
+ *
+ * @param Samples Source samples.
+ * @param dRateIn Source sample rate.
+ * @param dRateOut Destination sample rate.
+ * @param eQuality Filter quality - longer filters give sharper cutoff.
+ * @param ulThreadCount Number of threads to be used.
+ * @return Resampled samples.
+ */
+std::vector<float> resampleSinc(
+	std::span<const float> Samples, double dRateIn, double dRateOut,
+	tResampleQuality eQuality, std::uint32_t ulThreadCount
+);
+
+#endif // _ACE_TOOLS_COMMON_RESAMPLE_H_
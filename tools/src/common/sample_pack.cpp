@@ -0,0 +1,283 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "sample_pack.h"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
+#include <span>
+#include "endian.h"
+#include "logging.h"
+#include "sfx.h"
+
+static bool isSameHeader(const tSample &Lhs, const tSample &Rhs)
+{
+	return (
+		Lhs.m_ubFineTune == Rhs.m_ubFineTune &&
+		Lhs.m_ubVolume == Rhs.m_ubVolume &&
+		Lhs.m_uwRepeatOffs == Rhs.m_uwRepeatOffs &&
+		Lhs.m_uwRepeatLength == Rhs.m_uwRepeatLength
+	);
+}
+
+std::vector<std::uint8_t> tSamplePack::addMod(const tMod &Mod)
+{
+	const auto &vSamples = Mod.getSamples();
+	std::vector<std::uint8_t> vReorder(vSamples.size(), 0);
+
+	// Mod has single sample header per index, so its samples may share index
+	// only if they have the same header.
+	std::vector<const tSample*> vClaims(s_ubMaxSampleCount, nullptr);
+	for(std::size_t i = 0; i < vSamples.size(); ++i) {
+		const auto &Sample = vSamples[i];
+		if(Sample.m_vData.empty()) {
+			continue;
+		}
+		m_ulAddedSize += std::uint32_t(Sample.m_vData.size() * sizeof(Sample.m_vData[0]));
+
+		auto ulContents = addContents(Sample.m_vData);
+		std::optional<std::uint8_t> oIndex;
+		for(auto ubIndex: m_vContentsSamples[ulContents]) {
+			if(!vClaims[ubIndex] || isSameHeader(*vClaims[ubIndex], Sample)) {
+				oIndex = ubIndex;
+				break;
+			}
+		}
+
+		if(oIndex) {
+			fmt::print(
+				FMT_STRING("Sample '{}' of '{}' reuses index {}\n"),
+				Sample.m_szName, Mod.getSongName(), oIndex.value()
+			);
+		}
+		else {
+			if(m_vSampleContents.size() >= s_ubMaxSampleCount) {
+				return {};
+			}
+			oIndex = std::uint8_t(m_vSampleContents.size());
+			m_vSampleContents.push_back(ulContents);
+			m_vContentsSamples[ulContents].push_back(oIndex.value());
+			fmt::print(
+				FMT_STRING("Adding sample '{}' of '{}' at index {}\n"),
+				Sample.m_szName, Mod.getSongName(), oIndex.value()
+			);
+		}
+		vClaims[oIndex.value()] = &Sample;
+		vReorder[i] = oIndex.value();
+	}
+
+	// Samples without data only need an index not used by other ones in the mod
+	std::uint8_t ubFreeIndex = 0;
+	for(std::size_t i = 0; i < vSamples.size(); ++i) {
+		if(!vSamples[i].m_vData.empty()) {
+			continue;
+		}
+		while(ubFreeIndex < s_ubMaxSampleCount && vClaims[ubFreeIndex]) {
+			++ubFreeIndex;
+		}
+		if(ubFreeIndex >= s_ubMaxSampleCount) {
+			return {};
+		}
+		vClaims[ubFreeIndex] = &vSamples[i];
+		vReorder[i] = ubFreeIndex;
+	}
+
+	return vReorder;
+}
+
+bool tSamplePack::toFile(const std::string &szPath, bool isCompressed) const
+{
+	std::ofstream FileSamplePack(szPath, std::ios::binary);
+	if(!FileSamplePack.is_open()) {
+		return false;
+	}
+
+	std::uint8_t ubVersion = 4;
+	std::uint8_t ubSampleCount = getSampleCount();
+	FileSamplePack.write(reinterpret_cast<char*>(&ubVersion), sizeof(ubVersion));
+	FileSamplePack.write(reinterpret_cast<char*>(&ubSampleCount), sizeof(ubSampleCount));
+
+	auto vSources = getSources();
+	std::uint32_t ulChipSize = 0;
+	for(std::uint8_t ubIndex = 0; ubIndex < ubSampleCount; ++ubIndex) {
+		const auto &vData = m_vContents[m_vSampleContents[ubIndex]];
+		const auto &Source = vSources[ubIndex];
+		std::uint16_t uwSampleWordLengthBe = nEndian::toBig16(std::uint16_t(vData.size()));
+		FileSamplePack.write(reinterpret_cast<char*>(&uwSampleWordLengthBe), sizeof(uwSampleWordLengthBe));
+		FileSamplePack.write(reinterpret_cast<const char*>(&Source.ubIndex), sizeof(Source.ubIndex));
+		if(Source.ubIndex != ubIndex) {
+			fmt::print(
+				FMT_STRING("Sample at index {} uses data of index {} at word offset {}\n"),
+				ubIndex, Source.ubIndex, Source.uwWordOffset
+			);
+			std::uint16_t uwWordOffsetBe = nEndian::toBig16(Source.uwWordOffset);
+			FileSamplePack.write(reinterpret_cast<char*>(&uwWordOffsetBe), sizeof(uwWordOffsetBe));
+			continue;
+		}
+
+		std::uint32_t ulUncompressedSize = std::uint32_t(vData.size() * sizeof(vData[0]));
+		ulChipSize += ulUncompressedSize;
+		auto UncompressedBytes = std::span(reinterpret_cast<const int8_t*>(vData.data()), ulUncompressedSize);
+		std::vector<std::uint8_t> vCompressed;
+		if(isCompressed) {
+			vCompressed = tSfx::compressBlockDpcm(UncompressedBytes);
+			fmt::print(
+				FMT_STRING("Compressed: {}/{} ({:.2f}%)\n"),
+				vCompressed.size(), ulUncompressedSize,
+				(float(vCompressed.size()) / ulUncompressedSize * 100)
+			);
+
+			std::vector<std::int8_t> vDecompressed(ulUncompressedSize);
+			if(
+				!tSfx::decompressBlockDpcm(vCompressed, vDecompressed) ||
+				!std::equal(vDecompressed.begin(), vDecompressed.end(), UncompressedBytes.begin())
+			) {
+				nLog::error("Decompressed sample at index {} mismatch", ubIndex);
+				return false;
+			}
+
+			if(vCompressed.size() >= ulUncompressedSize) {
+				// Store as uncompressed, as it won't get any smaller
+				vCompressed.clear();
+			}
+		}
+
+		std::uint32_t ulCompressedSizeBe = nEndian::toBig32(std::uint32_t(vCompressed.size()));
+		FileSamplePack.write(reinterpret_cast<char*>(&ulCompressedSizeBe), sizeof(ulCompressedSizeBe));
+		if(!vCompressed.empty()) {
+			FileSamplePack.write(
+				reinterpret_cast<const char*>(vCompressed.data()),
+				vCompressed.size() * sizeof(vCompressed[0])
+			);
+		}
+		else {
+			FileSamplePack.write(
+				reinterpret_cast<const char*>(vData.data()), ulUncompressedSize
+			);
+		}
+	}
+
+	fmt::print(
+		FMT_STRING("Sample data: {} bytes, {} without deduplication\n"),
+		ulChipSize, m_ulAddedSize
+	);
+	return true;
+}
+
+std::uint8_t tSamplePack::getSampleCount(void) const
+{
+	return std::uint8_t(m_vSampleContents.size());
+}
+
+std::uint64_t tSamplePack::hash(const std::vector<std::uint16_t> &vData)
+{
+	// FNV-1a over all but first word, which is zeroed by ptplayer anyway
+	std::uint64_t ullHash = 0xCBF29CE484222325;
+	for(std::size_t i = 1; i < vData.size(); ++i) {
+		ullHash = (ullHash ^ vData[i]) * 0x100000001B3;
+	}
+	return (ullHash ^ vData.size()) * 0x100000001B3;
+}
+
+std::optional<std::uint16_t> tSamplePack::findContained(
+	const std::vector<std::uint16_t> &vHaystack, const std::vector<std::uint16_t> &vNeedle
+)
+{
+	// Needle's first word gets zeroed on load, so it may only start at
+	// haystack's first word, which gets zeroed too, or at zero word.
+	// Rest of the needle is searched for using rolling hash.
+	const auto ulNeedleSize = vNeedle.size();
+	const auto ulHaystackSize = vHaystack.size();
+	if(ulNeedleSize > ulHaystackSize) {
+		return std::nullopt;
+	}
+
+	static constexpr std::uint64_t s_ullBase = 0x100000001B3;
+	std::uint64_t ullNeedleHash = 0;
+	std::uint64_t ullWindowHash = 0;
+	std::uint64_t ullFirstWeight = 1;
+	for(std::size_t i = 1; i < ulNeedleSize; ++i) {
+		ullNeedleHash = ullNeedleHash * s_ullBase + vNeedle[i];
+		ullWindowHash = ullWindowHash * s_ullBase + vHaystack[i];
+		if(i > 1) {
+			ullFirstWeight *= s_ullBase;
+		}
+	}
+
+	for(std::size_t ulPos = 0; ulPos + ulNeedleSize <= ulHaystackSize; ++ulPos) {
+		if(
+			ullWindowHash == ullNeedleHash && (ulPos == 0 || vHaystack[ulPos] == 0) &&
+			std::equal(vNeedle.begin() + 1, vNeedle.end(), vHaystack.begin() + ulPos + 1)
+		) {
+			return std::uint16_t(ulPos);
+		}
+		if(ulNeedleSize > 1 && ulPos + ulNeedleSize < ulHaystackSize) {
+			ullWindowHash = (
+				(ullWindowHash - vHaystack[ulPos + 1] * ullFirstWeight) * s_ullBase +
+				vHaystack[ulPos + ulNeedleSize]
+			);
+		}
+	}
+	return std::nullopt;
+}
+
+std::uint32_t tSamplePack::addContents(const std::vector<std::uint16_t> &vData)
+{
+	auto ullHash = hash(vData);
+	auto [It, ItEnd] = m_mContentsByHash.equal_range(ullHash);
+	for(; It != ItEnd; ++It) {
+		const auto &vContents = m_vContents[It->second];
+		if(
+			vContents.size() == vData.size() &&
+			std::equal(vContents.begin() + 1, vContents.end(), vData.begin() + 1)
+		) {
+			return It->second;
+		}
+	}
+
+	auto ulContents = std::uint32_t(m_vContents.size());
+	m_vContents.push_back(vData);
+	m_vContentsSamples.emplace_back();
+	m_mContentsByHash.emplace(ullHash, ulContents);
+	return ulContents;
+}
+
+std::vector<tSamplePack::tSource> tSamplePack::getSources(void) const
+{
+	// Process longest contents first, so that containing ones are stored
+	// before the ones which could use their data.
+	std::vector<std::uint32_t> vOrder(m_vContents.size());
+	std::iota(vOrder.begin(), vOrder.end(), 0);
+	std::stable_sort(
+		vOrder.begin(), vOrder.end(), [this](std::uint32_t ulLhs, std::uint32_t ulRhs) {
+			return m_vContents[ulLhs].size() > m_vContents[ulRhs].size();
+		}
+	);
+
+	std::vector<tSource> vSources(m_vSampleContents.size());
+	std::vector<std::uint32_t> vStoredContents;
+	for(auto ulContents: vOrder) {
+		const auto &vIndices = m_vContentsSamples[ulContents];
+		if(vIndices.empty()) {
+			continue;
+		}
+		tSource Source = {vIndices[0], 0};
+		bool isContained = false;
+		for(auto ulStored: vStoredContents) {
+			auto oOffset = findContained(m_vContents[ulStored], m_vContents[ulContents]);
+			if(oOffset) {
+				Source = {m_vContentsSamples[ulStored][0], oOffset.value()};
+				isContained = true;
+				break;
+			}
+		}
+		if(!isContained) {
+			vStoredContents.push_back(ulContents);
+		}
+		for(auto ubIndex: vIndices) {
+			vSources[ubIndex] = Source;
+		}
+	}
+	return vSources;
+}
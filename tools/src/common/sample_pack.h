@@ -0,0 +1,72 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_SAMPLE_PACK_H_
+#define _ACE_TOOLS_COMMON_SAMPLE_PACK_H_
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mod.h"
+
+/**
+ * @brief Sample data shared by mods, deduplicated by contents.
+ *
+ * ptplayer zeroes first word of each sample on mod load, so it's ignored when
+ * comparing samples. Samples found at start or inside other ones (e.g. loops
+ * cut out of longer samples) don't get their own data - they point to data
+ * of the containing sample instead.
+ */
+class tSamplePack {
+public:
+	static constexpr std::uint8_t s_ubMaxSampleCount = 31;
+
+	/**
+	 * @brief Adds samples of given mod to the pack, reusing already stored ones.
+	 * Samples with same data but different volume, finetune or loop within
+	 * single mod get separate pack indices sharing the same data.
+	 *
+	 * @param Mod Mod to be added.
+	 * @return Reorder table for tMod::reorderSamples(), empty if pack
+	 * would exceed max sample count.
+	 */
+	std::vector<std::uint8_t> addMod(const tMod &Mod);
+
+	/**
+	 * @brief Writes sample pack file.
+	 *
+	 * @param szPath Destination path.
+	 * @param isCompressed If set, stored sample data is compressed.
+	 * @return True on success, otherwise false.
+	 */
+	bool toFile(const std::string &szPath, bool isCompressed) const;
+
+	std::uint8_t getSampleCount(void) const;
+
+private:
+	struct tSource {
+		std::uint8_t ubIndex; ///< Pack index holding the data.
+		std::uint16_t uwWordOffset;
+	};
+
+	static std::uint64_t hash(const std::vector<std::uint16_t> &vData);
+
+	static std::optional<std::uint16_t> findContained(
+		const std::vector<std::uint16_t> &vHaystack, const std::vector<std::uint16_t> &vNeedle
+	);
+
+	std::uint32_t addContents(const std::vector<std::uint16_t> &vData);
+
+	std::vector<tSource> getSources(void) const;
+
+	std::vector<std::vector<std::uint16_t>> m_vContents;
+	std::vector<std::vector<std::uint8_t>> m_vContentsSamples; ///< Pack indices using given contents.
+	std::unordered_multimap<std::uint64_t, std::uint32_t> m_mContentsByHash;
+	std::vector<std::uint32_t> m_vSampleContents; ///< Contents index for each pack index.
+	std::uint32_t m_ulAddedSize = 0; ///< Size of all added samples, in bytes.
+};
+
+#endif // _ACE_TOOLS_COMMON_SAMPLE_PACK_H_
@@ -5,21 +5,95 @@
 #include "sfx.h"
 #include <fstream>
 #include <algorithm>
+#include <cmath>
+#include <array>
+#include <cstring>
 #include "logging.h"
 #include "endian.h"
 
+static constexpr std::uint8_t s_ubBlockModeRun = 0;
+static constexpr std::uint8_t s_ubBlockModeDelta2 = 1;
+static constexpr std::uint8_t s_ubBlockModeDelta4 = 2;
+static constexpr std::uint8_t s_ubBlockModeRaw = 3;
+static constexpr std::uint8_t s_ubBlockModeCount = 4;
+static constexpr std::uint32_t s_ulBlockMaxLength = 64;
+
+// Running sums of all deltas packed in given byte, stored as consecutive bytes
+// in memory order so that whole group may be added to previous sample at once.
+static constexpr auto s_pDelta2Sums = []() {
+	std::array<std::array<std::uint8_t, 4>, 256> pSums{};
+	for(std::uint32_t ulPacked = 0; ulPacked < 256; ++ulPacked) {
+		std::int8_t bSum = 0;
+		for(std::uint8_t i = 0; i < 4; ++i) {
+			std::int8_t bDelta = std::int8_t((ulPacked >> (6 - 2 * i)) & 0b11);
+			bSum += (bDelta >= 2) ? bDelta - 4 : bDelta;
+			pSums[ulPacked][i] = std::uint8_t(bSum);
+		}
+	}
+	return pSums;
+}();
+
+static constexpr auto s_pDelta4Sums = []() {
+	std::array<std::array<std::uint8_t, 2>, 256> pSums{};
+	for(std::uint32_t ulPacked = 0; ulPacked < 256; ++ulPacked) {
+		std::int8_t bHi = std::int8_t(ulPacked >> 4);
+		std::int8_t bLo = std::int8_t(ulPacked & 0xF);
+		bHi = (bHi >= 8) ? bHi - 16 : bHi;
+		bLo = (bLo >= 8) ? bLo - 16 : bLo;
+		pSums[ulPacked][0] = std::uint8_t(bHi);
+		pSums[ulPacked][1] = std::uint8_t(bHi + bLo);
+	}
+	return pSums;
+}();
+
+static std::uint32_t blockPayloadSize(std::uint8_t ubMode, std::uint32_t ulLength)
+{
+	switch(ubMode) {
+		case s_ubBlockModeRun: return 0;
+		case s_ubBlockModeDelta2: return (ulLength + 3) / 4;
+		case s_ubBlockModeDelta4: return (ulLength + 1) / 2;
+		default: return ulLength;
+	}
+}
+
+static bool isDeltaFittingMode(std::int8_t bDelta, std::uint8_t ubMode)
+{
+	switch(ubMode) {
+		case s_ubBlockModeRun: return bDelta == 0;
+		case s_ubBlockModeDelta2: return -2 <= bDelta && bDelta <= 1;
+		case s_ubBlockModeDelta4: return -8 <= bDelta && bDelta <= 7;
+		default: return true;
+	}
+}
+
+// Adds bytes of two words separately, without carry between them
+static std::uint32_t addBytes(std::uint32_t ulA, std::uint32_t ulB)
+{
+	return ((ulA & 0x7F7F7F7F) + (ulB & 0x7F7F7F7F)) ^ ((ulA ^ ulB) & 0x80808080);
+}
+
 tSfx::tSfx(void):
 	m_ulFreq(0)
 {
 }
 
-tSfx::tSfx(const tWav &Wav, bool isStrict):
+tSfx::tSfx(const tWav &Wav, bool isStrict, tSfxDither eDither):
 	tSfx()
 {
 	auto vWavData = Wav.getData();
 	m_ulFreq = Wav.getSampleRate();
 	auto BitsPerSample = Wav.getBitsPerSample();
 
+	if(Wav.getChannelCount() != 1) {
+		nLog::warn("Got {} channels, expected mono. Downmixing", Wav.getChannelCount());
+		if(isStrict) {
+			nLog::error("Strict mode - aborting...");
+			return;
+		}
+		*this = tSfx(Wav.getMonoSamples(), m_ulFreq, eDither);
+		return;
+	}
+
 	if(BitsPerSample == 8) {
 		// Convert 8-bit unsigned to signed - https://wiki.multimedia.cx/index.php/PCM#Sign
 		for(const auto &UnsignedSample: vWavData) {
@@ -27,19 +101,52 @@ tSfx::tSfx(const tWav &Wav, bool isStrict):
 			m_vData.push_back(bSample);
 		}
 	}
-	else if(BitsPerSample == 16) {
-		nLog::warn("Got 16bps, expected 8bps. Resample your .wav in proper audio program!");
+	else {
+		nLog::warn("Got {}bps, expected 8bps. Converting with dither", BitsPerSample);
 		if(isStrict) {
 			nLog::error("Strict mode - aborting...");
 			return;
 		}
-		nLog::warn("Resampling data - may result in poor results!");
-		auto DataSize = vWavData.size();
-		for(std::uint32_t i = 0; i < DataSize; i += 2) {
-			std::uint16_t uwRawSample = vWavData[i + 0] | (vWavData[i + 1] << 8);
-			auto *pAsSigned = reinterpret_cast<std::int16_t *>(&uwRawSample);
-			m_vData.push_back(*pAsSigned / 256);
+		*this = tSfx(Wav.getMonoSamples(), m_ulFreq, eDither);
+		return;
+	}
+
+	// Needs even number of bytes - Amiga reads it as words
+	if(m_vData.size() & 1) {
+		m_vData.push_back(0);
+	}
+}
+
+tSfx::tSfx(std::span<const float> Samples, std::uint32_t ulFreq, tSfxDither eDither):
+	m_ulFreq(ulFreq)
+{
+	m_vData.reserve(Samples.size() + 1);
+
+	// Fixed seed, so that conversion gives same result on each run
+	std::uint32_t ulSeed = 0xACE;
+	auto Random = [&ulSeed]() {
+		ulSeed = ulSeed * 1664525u + 1013904223u;
+		return float(ulSeed >> 8) / (1 << 24);
+	};
+
+	float fError = 0;
+	float fPrevError = 0;
+	for(auto fSample: Samples) {
+		float fValue = fSample * 128;
+		float fNoise = 0;
+		if(eDither == tSfxDither::SHAPED) {
+			fValue -= 2 * fError - fPrevError;
+		}
+		if(eDither != tSfxDither::NONE) {
+			fNoise = Random() - Random();
 		}
+
+		// Error is taken before clipping, so that clipped peaks don't
+		// destabilize error feedback.
+		float fQuantized = std::round(fValue + fNoise);
+		fPrevError = fError;
+		fError = fQuantized - fValue;
+		m_vData.push_back(std::int8_t(std::clamp(fQuantized, -128.0f, 127.0f)));
 	}
 
 	// Needs even number of bytes - Amiga reads it as words
@@ -51,7 +158,7 @@ tSfx::tSfx(const tWav &Wav, bool isStrict):
 bool tSfx::toSfx(const std::string &szPath, bool isCompress) const {
 	std::ofstream FileOut(szPath, std::ios::binary);
 
-	const std::uint8_t ubVersion = 2;
+	const std::uint8_t ubVersion = 3;
 	const std::uint16_t uwWordLength = nEndian::toBig16(uint16_t(m_vData.size() / 2));
 	const std::uint16_t uwSampleReateHz = nEndian::toBig16(m_ulFreq);
 
@@ -59,33 +166,38 @@ bool tSfx::toSfx(const std::string &szPath, bool isCompress) const {
 	FileOut.write(reinterpret_cast<const char*>(&uwWordLength), sizeof(uwWordLength));
 	FileOut.write(reinterpret_cast<const char*>(&uwSampleReateHz), sizeof(uwSampleReateHz));
 
+	std::vector<std::uint8_t> vCompressed;
 	if(isCompress) {
-		auto vCompressed = tSfx::compressLosslessDpcm(
+		vCompressed = tSfx::compressBlockDpcm(
 			std::span(m_vData.data(), m_vData.size()
 		));
-
-		std::uint32_t ulCompressedLength = std::uint16_t(vCompressed.size());
-		std::uint32_t ulCompressedLengthBe = nEndian::toBig32(ulCompressedLength);
-		FileOut.write(reinterpret_cast<const char*>(&ulCompressedLengthBe), sizeof(ulCompressedLengthBe));
-		FileOut.write(reinterpret_cast<const char*>(vCompressed.data()), vCompressed.size());
 		fmt::print(
 			FMT_STRING("Compressed: {}/{} ({:.2f}%)\n"),
 			vCompressed.size(), m_vData.size(), (float(vCompressed.size()) / m_vData.size() * 100)
 		);
 
 		// Verify that compression actually works
-		std::vector<std::int8_t> vDecompressed = tSfx::decompressLosslessDpcm(vCompressed, std::uint32_t(m_vData.size()));
-		for(auto i = 0; i < m_vData.size(); ++i) {
-			if(vDecompressed[i] != m_vData[i]) {
-				nLog::error("mismatch on byte {}", i);
-				return false;
-			}
+		std::vector<std::int8_t> vDecompressed(m_vData.size());
+		if(
+			!tSfx::decompressBlockDpcm(vCompressed, vDecompressed) ||
+			vDecompressed != m_vData
+		) {
+			nLog::error("Decompressed data mismatch");
+			return false;
+		}
+
+		if(vCompressed.size() >= m_vData.size()) {
+			nLog::warn("Compression doesn't reduce size, storing uncompressed data");
+			vCompressed.clear();
 		}
+	}
 
+	std::uint32_t ulCompressedLengthBe = nEndian::toBig32(std::uint32_t(vCompressed.size()));
+	FileOut.write(reinterpret_cast<const char*>(&ulCompressedLengthBe), sizeof(ulCompressedLengthBe));
+	if(!vCompressed.empty()) {
+		FileOut.write(reinterpret_cast<const char*>(vCompressed.data()), vCompressed.size());
 	}
 	else {
-		std::uint32_t ulCompressedLength = 0;
-		FileOut.write(reinterpret_cast<const char*>(&ulCompressedLength), sizeof(ulCompressedLength));
 		FileOut.write(reinterpret_cast<const char*>(m_vData.data()), m_vData.size());
 	}
 
@@ -168,6 +280,23 @@ tSfx tSfx::splitAfter(std::uint32_t ulSamples) {
 	return Out;
 }
 
+bool sfxParseDither(const std::string &szDither, tSfxDither &eDither)
+{
+	if(szDither == "none") {
+		eDither = tSfxDither::NONE;
+	}
+	else if(szDither == "tpdf") {
+		eDither = tSfxDither::TPDF;
+	}
+	else if(szDither == "shaped") {
+		eDither = tSfxDither::SHAPED;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
 std::vector<uint8_t> tSfx::compressLosslessDpcm(std::span<const int8_t> Uncompressed)
 {
 	static constexpr auto Sgn = [](std::int8_t bDelta) { return (bDelta > 0) ? 1 : (bDelta < 0) ? -1 : 0;};
@@ -315,3 +444,142 @@ std::vector<int8_t> tSfx::decompressLosslessDpcm(
 		}
 	}
 }
+
+std::vector<uint8_t> tSfx::compressBlockDpcm(std::span<const int8_t> Uncompressed)
+{
+	const auto ulSize = std::uint32_t(Uncompressed.size());
+
+	// Deltas don't depend on chosen blocks, so longest block of each mode
+	// starting at given sample may be found in single backward pass.
+	std::vector<std::array<std::uint8_t, s_ubBlockModeCount>> vMaxLengths(ulSize + 1);
+	for(auto i = ulSize; i--;) {
+		auto bDelta = std::int8_t(Uncompressed[i] - (i ? Uncompressed[i - 1] : 0));
+		for(std::uint8_t ubMode = 0; ubMode < s_ubBlockModeCount; ++ubMode) {
+			vMaxLengths[i][ubMode] = isDeltaFittingMode(bDelta, ubMode) ? std::uint8_t(
+				std::min(s_ulBlockMaxLength, vMaxLengths[i + 1][ubMode] + 1u)
+			) : 0;
+		}
+	}
+
+	// Find optimal parse: cost is byte count in upper half, block count in lower.
+	// Header of best block ending at given sample is stored for backtracking.
+	std::vector<std::uint64_t> vCosts(ulSize + 1, UINT64_MAX);
+	std::vector<std::uint8_t> vHeaders(ulSize + 1);
+	vCosts[0] = 0;
+	for(std::uint32_t i = 0; i < ulSize; ++i) {
+		for(std::uint8_t ubMode = 0; ubMode < s_ubBlockModeCount; ++ubMode) {
+			for(std::uint32_t ulLength = 1; ulLength <= vMaxLengths[i][ubMode]; ++ulLength) {
+				std::uint64_t ullCost = vCosts[i] + (
+					(std::uint64_t(1 + blockPayloadSize(ubMode, ulLength)) << 32) | 1
+				);
+				if(ullCost < vCosts[i + ulLength]) {
+					vCosts[i + ulLength] = ullCost;
+					vHeaders[i + ulLength] = std::uint8_t((ubMode << 6) | (ulLength - 1));
+				}
+			}
+		}
+	}
+
+	// Gather headers in stream order, then write whole output in one go
+	std::vector<std::uint8_t> vBlocks(vCosts[ulSize] & 0xFFFFFFFF);
+	for(auto ulPos = ulSize, ulBlock = std::uint32_t(vBlocks.size()); ulPos; ) {
+		vBlocks[--ulBlock] = vHeaders[ulPos];
+		ulPos -= (vHeaders[ulPos] & 0x3F) + 1;
+	}
+
+	std::vector<std::uint8_t> vCompressed(vCosts[ulSize] >> 32);
+	std::uint8_t *pWrite = vCompressed.data();
+	std::uint32_t ulPos = 0;
+	for(auto ubHeader: vBlocks) {
+		std::uint8_t ubMode = ubHeader >> 6;
+		std::uint32_t ulLength = (ubHeader & 0x3F) + 1;
+		*(pWrite++) = ubHeader;
+		if(ubMode == s_ubBlockModeRaw) {
+			std::memcpy(pWrite, &Uncompressed[ulPos], ulLength);
+			pWrite += ulLength;
+		}
+		else if(ubMode != s_ubBlockModeRun) {
+			std::uint8_t ubBits = (ubMode == s_ubBlockModeDelta2) ? 2 : 4;
+			std::uint8_t ubMask = (1 << ubBits) - 1;
+			std::memset(pWrite, 0, blockPayloadSize(ubMode, ulLength));
+			for(std::uint32_t i = 0; i < ulLength; ++i) {
+				auto ulSample = ulPos + i;
+				auto ubDelta = std::uint8_t(
+					Uncompressed[ulSample] - (ulSample ? Uncompressed[ulSample - 1] : 0)
+				);
+				std::uint8_t ubShift = 8 - ubBits * (1 + i % (8 / ubBits));
+				pWrite[i / (8 / ubBits)] |= (ubDelta & ubMask) << ubShift;
+			}
+			pWrite += blockPayloadSize(ubMode, ulLength);
+		}
+		ulPos += ulLength;
+	}
+
+	return vCompressed;
+}
+
+bool tSfx::decompressBlockDpcm(
+	std::span<const uint8_t> Compressed, std::span<int8_t> Decompressed
+)
+{
+	const std::uint8_t *pRead = Compressed.data();
+	const std::uint8_t *pReadEnd = pRead + Compressed.size();
+	auto *pWrite = reinterpret_cast<std::uint8_t*>(Decompressed.data());
+	const std::uint8_t *pWriteEnd = pWrite + Decompressed.size();
+	std::uint8_t ubSample = 0;
+	while(pWrite < pWriteEnd) {
+		if(pRead >= pReadEnd) {
+			return false;
+		}
+		std::uint8_t ubHeader = *(pRead++);
+		std::uint8_t ubMode = ubHeader >> 6;
+		std::uint32_t ulLength = (ubHeader & 0x3F) + 1;
+		if(
+			ulLength > std::uint32_t(pWriteEnd - pWrite) ||
+			blockPayloadSize(ubMode, ulLength) > std::uint32_t(pReadEnd - pRead)
+		) {
+			return false;
+		}
+
+		if(ubMode == s_ubBlockModeRun) {
+			std::memset(pWrite, ubSample, ulLength);
+			pWrite += ulLength;
+		}
+		else if(ubMode == s_ubBlockModeRaw) {
+			std::memcpy(pWrite, pRead, ulLength);
+			pRead += ulLength;
+			pWrite += ulLength;
+			ubSample = pWrite[-1];
+		}
+		else if(ubMode == s_ubBlockModeDelta2) {
+			// Decode 4 samples at once by adding running sums to previous one
+			for(; ulLength >= 4; ulLength -= 4) {
+				std::uint32_t ulSums;
+				std::memcpy(&ulSums, s_pDelta2Sums[*(pRead++)].data(), sizeof(ulSums));
+				std::uint32_t ulSamples = addBytes(ulSums, ubSample * 0x01010101u);
+				std::memcpy(pWrite, &ulSamples, sizeof(ulSamples));
+				pWrite += 4;
+				ubSample = pWrite[-1];
+			}
+			if(ulLength) {
+				const auto &Sums = s_pDelta2Sums[*(pRead++)];
+				for(std::uint8_t i = 0; i < ulLength; ++i) {
+					*(pWrite++) = std::uint8_t(ubSample + Sums[i]);
+				}
+				ubSample = pWrite[-1];
+			}
+		}
+		else {
+			for(; ulLength >= 2; ulLength -= 2) {
+				const auto &Sums = s_pDelta4Sums[*(pRead++)];
+				pWrite[0] = std::uint8_t(ubSample + Sums[0]);
+				pWrite[1] = ubSample = std::uint8_t(ubSample + Sums[1]);
+				pWrite += 2;
+			}
+			if(ulLength) {
+				*(pWrite++) = ubSample = std::uint8_t(ubSample + s_pDelta4Sums[*(pRead++)][0]);
+			}
+		}
+	}
+	return true;
+}
@@ -8,12 +8,38 @@
 #include "wav.h"
 #include <string>
 #include <span>
+#include <vector>
+
+enum class tSfxDither: std::uint8_t {
+	NONE,
+	TPDF, ///< Triangular noise of 1 LSB amplitude.
+	SHAPED, ///< TPDF with 2nd order error feedback, moving noise to higher frequencies.
+};
+
+bool sfxParseDither(const std::string &szDither, tSfxDither &eDither);
 
 class tSfx {
 public:
 	tSfx(void);
 
-	tSfx(const tWav &Wav, bool isStrict);
+	/**
+	 * @brief Converts WAV file. 8-bit mono data is copied exactly, other formats
+	 * are converted with dither and downmixed.
+	 *
+	 * @param Wav Source WAV file.
+	 * @param isStrict If set, conversion fails on formats other than 8-bit mono.
+	 * @param eDither Dithering used when reducing bit depth.
+	 */
+	tSfx(const tWav &Wav, bool isStrict, tSfxDither eDither = tSfxDither::SHAPED);
+
+	/**
+	 * @brief Converts samples to 8 bits.
+	 *
+	 * @param Samples Source samples in -1..1 range.
+	 * @param ulFreq Sample rate.
+	 * @param eDither Dithering used when reducing bit depth.
+	 */
+	tSfx(std::span<const float> Samples, std::uint32_t ulFreq, tSfxDither eDither);
 
 	bool toSfx(const std::string &szPath, bool isCompress) const;
 
@@ -38,6 +64,31 @@ public:
 	static std::vector<uint8_t> compressLosslessDpcm(std::span<const int8_t> Uncompressed);
 	static std::vector<int8_t> decompressLosslessDpcm(const std::vector<uint8_t> &vCompressed, std::uint32_t ulDecompressedSize);
 
+	/**
+	 * @brief Compresses samples using block DPCM, used by .sfx and sample pack
+	 * format version 3. Each block starts with header byte: upper 2 bits select
+	 * block mode, lower 6 bits hold sample count minus one, so that 68000
+	 * decoder may use it directly as dbf counter. Modes are:
+	 * - 0: repeat previous sample, no payload,
+	 * - 1: 2-bit signed deltas, 4 per byte, starting from the highest bits,
+	 * - 2: 4-bit signed deltas, 2 per byte, starting from the high nibble,
+	 * - 3: raw samples.
+	 * Blocks are chosen to give smallest output, then fewest blocks.
+	 *
+	 * @param Uncompressed Samples to be compressed.
+	 * @return Compressed data.
+	 */
+	static std::vector<uint8_t> compressBlockDpcm(std::span<const int8_t> Uncompressed);
+
+	/**
+	 * @brief Decompresses data created with compressBlockDpcm().
+	 *
+	 * @param Compressed Compressed data.
+	 * @param Decompressed Destination, its size determines sample count.
+	 * @return True on success, false on malformed data.
+	 */
+	static bool decompressBlockDpcm(std::span<const uint8_t> Compressed, std::span<int8_t> Decompressed);
+
 private:
 	std::uint32_t m_ulFreq;
 	std::vector<int8_t> m_vData;
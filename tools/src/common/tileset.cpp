@@ -0,0 +1,88 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "tileset.h"
+
+tChunkyBitmap tileFlip(const tChunkyBitmap &Tile, std::uint8_t ubFlip)
+{
+	tChunkyBitmap Flipped(Tile.m_uwWidth, Tile.m_uwHeight);
+	for(std::uint16_t y = 0; y < Tile.m_uwHeight; ++y) {
+		std::uint16_t uwSrcY = (ubFlip & TILE_FLIP_Y) ? Tile.m_uwHeight - 1 - y : y;
+		for(std::uint16_t x = 0; x < Tile.m_uwWidth; ++x) {
+			std::uint16_t uwSrcX = (ubFlip & TILE_FLIP_X) ? Tile.m_uwWidth - 1 - x : x;
+			Flipped.pixelAt(x, y) = Tile.pixelAt(uwSrcX, uwSrcY);
+		}
+	}
+	return Flipped;
+}
+
+std::optional<tTileMatch> tTileIndex::find(
+	const tChunkyBitmap &Tile, bool isFlip
+) const
+{
+	auto Found = findExact(Tile);
+	if(Found) {
+		return tTileMatch{Found.value(), TILE_FLIP_NONE};
+	}
+	if(isFlip) {
+		static const std::uint8_t pFlips[] = {TILE_FLIP_X, TILE_FLIP_Y, TILE_FLIP_XY};
+		for(auto ubFlip: pFlips) {
+			Found = findExact(tileFlip(Tile, ubFlip));
+			if(Found) {
+				return tTileMatch{Found.value(), ubFlip};
+			}
+		}
+	}
+	return std::nullopt;
+}
+
+std::uint32_t tTileIndex::add(tChunkyBitmap Tile)
+{
+	std::uint32_t ulIndex = std::uint32_t(m_vTiles.size());
+	m_mTilesByHash.emplace(hash(Tile), ulIndex);
+	m_vTiles.push_back(std::move(Tile));
+	return ulIndex;
+}
+
+std::vector<tChunkyBitmap> tTileIndex::releaseTiles(void)
+{
+	m_mTilesByHash.clear();
+	return std::move(m_vTiles);
+}
+
+std::uint64_t tTileIndex::hash(const tChunkyBitmap &Tile)
+{
+	// FNV-1a over dimensions and pixel data
+	std::uint64_t ullHash = 0xCBF29CE484222325;
+	auto Feed = [&ullHash](std::uint8_t ubByte) {
+		ullHash = (ullHash ^ ubByte) * 0x100000001B3;
+	};
+	Feed(std::uint8_t(Tile.m_uwWidth >> 8));
+	Feed(std::uint8_t(Tile.m_uwWidth));
+	Feed(std::uint8_t(Tile.m_uwHeight >> 8));
+	Feed(std::uint8_t(Tile.m_uwHeight));
+	for(const auto &Pixel: Tile.m_vData) {
+		Feed(Pixel.ubR);
+		Feed(Pixel.ubG);
+		Feed(Pixel.ubB);
+	}
+	return ullHash;
+}
+
+std::optional<std::uint32_t> tTileIndex::findExact(const tChunkyBitmap &Tile) const
+{
+	// Multimap doesn't keep insertion order, so pick lowest index of duplicates
+	std::optional<std::uint32_t> Found;
+	auto Range = m_mTilesByHash.equal_range(hash(Tile));
+	for(auto It = Range.first; It != Range.second; ++It) {
+		const auto &Other = m_vTiles[It->second];
+		if(
+			Other.m_uwWidth == Tile.m_uwWidth && Other.m_uwHeight == Tile.m_uwHeight &&
+			Other.m_vData == Tile.m_vData && (!Found || It->second < Found.value())
+		) {
+			Found = It->second;
+		}
+	}
+	return Found;
+}
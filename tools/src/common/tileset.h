@@ -0,0 +1,67 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_COMMON_TILESET_H_
+#define _ACE_TOOLS_COMMON_TILESET_H_
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include "bitmap.h"
+
+enum tTileFlip: std::uint8_t {
+	TILE_FLIP_NONE = 0,
+	TILE_FLIP_X = 1,
+	TILE_FLIP_Y = 2,
+	TILE_FLIP_XY = TILE_FLIP_X | TILE_FLIP_Y,
+};
+
+/**
+ * @brief Result of tile lookup in tTileIndex.
+ */
+struct tTileMatch {
+	std::uint32_t ulIndex;
+	std::uint8_t ubFlip; ///< Mirroring to be applied on found tile, see tTileFlip.
+};
+
+/**
+ * @brief Returns tile mirrored in given directions.
+ */
+tChunkyBitmap tileFlip(const tChunkyBitmap &Tile, std::uint8_t ubFlip);
+
+/**
+ * @brief Collection of unique tiles with hash-based lookup.
+ */
+class tTileIndex {
+public:
+	/**
+	 * @brief Looks for tile with same size and contents.
+	 *
+	 * @param isFlip If set, mirrored tiles are also matched.
+	 * @return Match with lowest index on success, otherwise empty value.
+	 */
+	std::optional<tTileMatch> find(const tChunkyBitmap &Tile, bool isFlip) const;
+
+	/**
+	 * @brief Adds tile to the index, without checking for duplicates.
+	 *
+	 * @return Index of added tile.
+	 */
+	std::uint32_t add(tChunkyBitmap Tile);
+
+	const std::vector<tChunkyBitmap> &getTiles(void) const { return m_vTiles; }
+
+	std::vector<tChunkyBitmap> releaseTiles(void);
+
+private:
+	static std::uint64_t hash(const tChunkyBitmap &Tile);
+
+	std::optional<std::uint32_t> findExact(const tChunkyBitmap &Tile) const;
+
+	std::vector<tChunkyBitmap> m_vTiles;
+	std::unordered_multimap<std::uint64_t, std::uint32_t> m_mTilesByHash;
+};
+
+#endif // _ACE_TOOLS_COMMON_TILESET_H_
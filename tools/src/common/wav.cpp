@@ -6,10 +6,13 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
 #include "logging.h"
 
 enum class tAudioFormat: std::uint16_t {
-	PCM = 1
+	PCM = 1,
+	IEEE_FLOAT = 3,
+	EXTENSIBLE = 0xFFFE,
 };
 
 bool tryRead(std::ifstream &Stream, char *Buffer, std::uint32_t ulSize)
@@ -75,15 +78,28 @@ tWav::tWav(const std::string &szPath)
 	StreamSubchunk.read(reinterpret_cast<char*>(&uwBlockAlign), sizeof(uwBlockAlign));
 	StreamSubchunk.read(reinterpret_cast<char*>(&uwBitsPerSample), sizeof(uwBitsPerSample));
 
-	if(eAudioFormat != tAudioFormat::PCM) {
+	if(eAudioFormat == tAudioFormat::EXTENSIBLE) {
+		// Actual format is in first two bytes of subformat GUID
+		std::uint16_t uwExtensionSize, uwValidBits;
+		std::uint32_t ulChannelMask;
+		StreamSubchunk.read(reinterpret_cast<char*>(&uwExtensionSize), sizeof(uwExtensionSize));
+		StreamSubchunk.read(reinterpret_cast<char*>(&uwValidBits), sizeof(uwValidBits));
+		StreamSubchunk.read(reinterpret_cast<char*>(&ulChannelMask), sizeof(ulChannelMask));
+		StreamSubchunk.read(reinterpret_cast<char*>(&eAudioFormat), sizeof(eAudioFormat));
+	}
+	if(eAudioFormat != tAudioFormat::PCM && eAudioFormat != tAudioFormat::IEEE_FLOAT) {
 		nLog::error("Unrecognized WAV audio format: {}", static_cast<int>(eAudioFormat));
 		return;
 	}
-	if(uwNumChannels != 1) {
+	if(uwNumChannels == 0) {
 		nLog::error("Unsupported WAV channel count: {}", uwNumChannels);
 		return;
 	}
-	if(uwBitsPerSample != 8 && uwBitsPerSample != 16) {
+	if(
+		(eAudioFormat == tAudioFormat::PCM && uwBitsPerSample != 8 &&
+			uwBitsPerSample != 16 && uwBitsPerSample != 24 && uwBitsPerSample != 32) ||
+		(eAudioFormat == tAudioFormat::IEEE_FLOAT && uwBitsPerSample != 32)
+	) {
 		nLog::error("Unsupported WAV bps: {}", uwBitsPerSample);
 		return;
 	}
@@ -95,8 +111,10 @@ tWav::tWav(const std::string &szPath)
 		return;
 	}
 
-	m_ubBitsPerSample = uwBitsPerSample;
+	m_ubBitsPerSample = std::uint8_t(uwBitsPerSample);
 	m_ulSampleRate = ulSampleRate;
+	m_uwChannelCount = uwNumChannels;
+	m_isFloat = (eAudioFormat == tAudioFormat::IEEE_FLOAT);
 	m_vData.resize(pSubchunkData->m_szContents.length());
 	memcpy(m_vData.data(), pSubchunkData->m_szContents.data(), pSubchunkData->m_szContents.length());
 }
@@ -127,3 +145,79 @@ std::uint8_t tWav::getBitsPerSample(void) const
 {
 	return m_ubBitsPerSample;
 }
+
+std::uint16_t tWav::getChannelCount(void) const
+{
+	return m_uwChannelCount;
+}
+
+std::vector<float> tWav::getMonoSamples(void) const
+{
+	std::uint8_t ubBytesPerSample = m_ubBitsPerSample / 8;
+	std::size_t ulFrameSize = ubBytesPerSample * m_uwChannelCount;
+	std::size_t ulFrameCount = ulFrameSize ? m_vData.size() / ulFrameSize : 0;
+	std::vector<float> vSamples(ulFrameCount);
+	float fScale = 1.0f / m_uwChannelCount;
+	const std::uint8_t *pRead = m_vData.data();
+	for(auto &Sample: vSamples) {
+		float fSum = 0;
+		for(std::uint16_t uwChannel = 0; uwChannel < m_uwChannelCount; ++uwChannel) {
+			// WAV is little endian, 8-bit samples are unsigned, others signed
+			if(m_isFloat) {
+				float fValue;
+				std::memcpy(&fValue, pRead, sizeof(fValue));
+				fSum += fValue;
+			}
+			else if(ubBytesPerSample == 1) {
+				fSum += (pRead[0] - 128) / 128.0f;
+			}
+			else {
+				std::uint32_t ulRaw = 0;
+				for(std::uint8_t i = 0; i < ubBytesPerSample; ++i) {
+					ulRaw |= std::uint32_t(pRead[i]) << (32 - 8 * ubBytesPerSample + 8 * i);
+				}
+				fSum += float(std::int32_t(ulRaw) / 2147483648.0);
+			}
+			pRead += ubBytesPerSample;
+		}
+		Sample = fSum * fScale;
+	}
+	return vSamples;
+}
+
+bool tWav::toFile(
+	const std::string &szPath, const std::vector<std::int16_t> &vSamples,
+	std::uint32_t ulSampleRate, std::uint16_t uwChannelCount
+)
+{
+	std::ofstream StreamFile(szPath.c_str(), std::ios::binary);
+	if(!StreamFile.is_open()) {
+		nLog::error("Couldn't open: '{}'", szPath);
+		return false;
+	}
+
+	// Same as reading, assumes little-endian host
+	tAudioFormat eAudioFormat = tAudioFormat::PCM;
+	std::uint16_t uwBitsPerSample = 16;
+	std::uint16_t uwBlockAlign = uwChannelCount * (uwBitsPerSample / 8);
+	std::uint32_t ulByteRate = ulSampleRate * uwBlockAlign;
+	std::uint32_t ulFmtSize = 16;
+	std::uint32_t ulDataSize = std::uint32_t(vSamples.size() * sizeof(vSamples[0]));
+	std::uint32_t ulChunkSize = 4 + (8 + ulFmtSize) + (8 + ulDataSize);
+
+	StreamFile.write("RIFF", 4);
+	StreamFile.write(reinterpret_cast<const char*>(&ulChunkSize), sizeof(ulChunkSize));
+	StreamFile.write("WAVE", 4);
+	StreamFile.write("fmt ", 4);
+	StreamFile.write(reinterpret_cast<const char*>(&ulFmtSize), sizeof(ulFmtSize));
+	StreamFile.write(reinterpret_cast<const char*>(&eAudioFormat), sizeof(eAudioFormat));
+	StreamFile.write(reinterpret_cast<const char*>(&uwChannelCount), sizeof(uwChannelCount));
+	StreamFile.write(reinterpret_cast<const char*>(&ulSampleRate), sizeof(ulSampleRate));
+	StreamFile.write(reinterpret_cast<const char*>(&ulByteRate), sizeof(ulByteRate));
+	StreamFile.write(reinterpret_cast<const char*>(&uwBlockAlign), sizeof(uwBlockAlign));
+	StreamFile.write(reinterpret_cast<const char*>(&uwBitsPerSample), sizeof(uwBitsPerSample));
+	StreamFile.write("data", 4);
+	StreamFile.write(reinterpret_cast<const char*>(&ulDataSize), sizeof(ulDataSize));
+	StreamFile.write(reinterpret_cast<const char*>(vSamples.data()), ulDataSize);
+	return StreamFile.good();
+}
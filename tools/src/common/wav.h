@@ -16,6 +16,28 @@ public:
 	const std::vector<uint8_t> &getData(void) const;
 	std::uint32_t getSampleRate(void) const;
 	std::uint8_t getBitsPerSample(void) const;
+	std::uint16_t getChannelCount(void) const;
+
+	/**
+	 * @brief Converts samples to floats in -1..1 range, averaging channels.
+	 *
+	 * @return Mono samples.
+	 */
+	std::vector<float> getMonoSamples(void) const;
+
+	/**
+	 * @brief Writes 16-bit PCM WAV file.
+	 *
+	 * @param szPath Destination path.
+	 * @param vSamples Samples, interleaved if there's more than one channel.
+	 * @param ulSampleRate Sample rate, in Hz.
+	 * @param uwChannelCount Number of interleaved channels.
+	 * @return True on success, otherwise false.
+	 */
+	static bool toFile(
+		const std::string &szPath, const std::vector<std::int16_t> &vSamples,
+		std::uint32_t ulSampleRate, std::uint16_t uwChannelCount
+	);
 
 private:
 	struct tSubchunk {
@@ -30,6 +52,8 @@ private:
 	std::vector<uint8_t> m_vData;
 	std::uint32_t m_ulSampleRate;
 	std::uint8_t m_ubBitsPerSample;
+	std::uint16_t m_uwChannelCount = 1;
+	bool m_isFloat = false;
 };
 
 #endif // _ACE_TOOLS_COMMON_WAV_H_
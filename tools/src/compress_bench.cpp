@@ -0,0 +1,311 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <span>
+#include <vector>
+#include <string_view>
+#include "common/logging.h"
+#include "common/fs.h"
+#include "common/compress.hpp"
+#include "common/sfx.h"
+
+struct tCorpusEntry {
+	std::string Name;
+	std::vector<std::uint8_t> vData;
+};
+
+struct tBenchResult {
+	std::uint64_t ullSizeIn;
+	std::uint64_t ullSizeOut;
+	std::uint64_t ullSizeTimed; ///< Part of input covered by fSeconds.
+	std::uint32_t ulStoredCount; ///< Entries stored raw, thus not timed.
+	double fSeconds;
+};
+
+// Decoding single sample takes microseconds, so best of many runs is taken
+static constexpr std::uint32_t s_ulDecodeRuns = 32;
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} [inDir] [extraOpts]\n\n", szAppName);
+	print("Optional arguments:\n");
+	print("\tinDir  Path to directory with corpus files. If omitted, built-in corpus is used.\n");
+	print("Extra options:\n");
+	print("\t-nbf   Skip brute-force match finder - useful for big corpora.\n");
+}
+
+static std::uint32_t corpusRand(std::uint32_t *pState) {
+	// Fixed LCG so that built-in corpus is identical on every platform
+	*pState = *pState * 1664525u + 1013904223u;
+	return *pState >> 8;
+}
+
+static std::vector<tCorpusEntry> corpusGenerate(void) {
+	std::vector<tCorpusEntry> vCorpus;
+	std::uint32_t ulSeed = 0xACE;
+
+	// Text-like data built from small dictionary
+	static const char *pWords[] = {
+		"amiga", "copper", "blitter", "sprite", "bitplane", "palette", "tile",
+		"the", "of", "and", "to", "level", "player", "enemy", "score", "chip",
+		"fast", "memory", "frame", "vblank", "\n", ", ", ". ", "load", "pak"
+	};
+	tCorpusEntry Text = {"text", {}};
+	while(Text.vData.size() < 128 * 1024) {
+		std::string_view Word = pWords[corpusRand(&ulSeed) % std::size(pWords)];
+		Text.vData.insert(Text.vData.end(), Word.begin(), Word.end());
+		Text.vData.push_back(' ');
+	}
+	vCorpus.push_back(std::move(Text));
+
+	// Planar bitmap-like data: rows repeating with occasional changes
+	tCorpusEntry Bitmap = {"bitmap", {}};
+	std::vector<std::uint8_t> vRow(40);
+	for(auto &Byte: vRow) {
+		Byte = std::uint8_t(corpusRand(&ulSeed));
+	}
+	while(Bitmap.vData.size() < 128 * 1024) {
+		if(corpusRand(&ulSeed) % 4 == 0) {
+			vRow[corpusRand(&ulSeed) % vRow.size()] = std::uint8_t(corpusRand(&ulSeed));
+		}
+		Bitmap.vData.insert(Bitmap.vData.end(), vRow.begin(), vRow.end());
+	}
+	vCorpus.push_back(std::move(Bitmap));
+
+	// Sparse data with long runs, like empty map layers or padding
+	tCorpusEntry Runs = {"runs", {}};
+	while(Runs.vData.size() < 128 * 1024) {
+		std::uint8_t ubValue = (corpusRand(&ulSeed) % 8 == 0) ? std::uint8_t(corpusRand(&ulSeed)) : 0;
+		Runs.vData.insert(Runs.vData.end(), 1 + corpusRand(&ulSeed) % 300, ubValue);
+	}
+	vCorpus.push_back(std::move(Runs));
+
+	// Audio-like data: smooth waveform with noise
+	tCorpusEntry Audio = {"audio", {}};
+	std::int32_t lSample = 0;
+	while(Audio.vData.size() < 128 * 1024) {
+		lSample += std::int32_t(corpusRand(&ulSeed) % 9) - 4;
+		lSample = std::clamp(lSample, -128, 127);
+		Audio.vData.push_back(std::uint8_t(lSample));
+	}
+	vCorpus.push_back(std::move(Audio));
+
+	// Incompressible data
+	tCorpusEntry Noise = {"noise", {}};
+	while(Noise.vData.size() < 32 * 1024) {
+		Noise.vData.push_back(std::uint8_t(corpusRand(&ulSeed)));
+	}
+	vCorpus.push_back(std::move(Noise));
+
+	return vCorpus;
+}
+
+static std::vector<tCorpusEntry> corpusLoad(const std::string &szDir) {
+	std::vector<tCorpusEntry> vCorpus;
+	for(const auto &DirEntry: std::filesystem::recursive_directory_iterator(szDir)) {
+		if(DirEntry.is_directory()) {
+			continue;
+		}
+		tCorpusEntry Entry;
+		Entry.Name = DirEntry.path().generic_string();
+		Entry.vData.resize(std::filesystem::file_size(DirEntry.path()));
+		std::ifstream FileIn(DirEntry.path(), std::ios::binary);
+		FileIn.read(reinterpret_cast<char*>(Entry.vData.data()), Entry.vData.size());
+		if(!Entry.vData.empty()) {
+			vCorpus.push_back(std::move(Entry));
+		}
+	}
+	return vCorpus;
+}
+
+static bool benchPacker(
+	const std::vector<tCorpusEntry> &vCorpus,
+	const std::function<std::uint32_t(const std::uint8_t*, std::uint32_t, std::uint8_t*)> &cbPack,
+	tBenchResult *pResult
+) {
+	*pResult = {};
+	std::vector<std::uint8_t> vPacked;
+	for(const auto &Entry: vCorpus) {
+		vPacked.resize(Entry.vData.size() * 2);
+		auto TimeStart = std::chrono::steady_clock::now();
+		auto ulPackedSize = cbPack(
+			Entry.vData.data(), std::uint32_t(Entry.vData.size()), vPacked.data()
+		);
+		auto TimeEnd = std::chrono::steady_clock::now();
+
+		std::size_t ulMismatchOffset;
+		if(!compressVerify(
+			vPacked.data(), ulPackedSize, Entry.vData.data(), Entry.vData.size(),
+			&ulMismatchOffset
+		)) {
+			nLog::error("Unpacked data mismatch for '{}' at index {}", Entry.Name, ulMismatchOffset);
+			return false;
+		}
+		pResult->ullSizeIn += Entry.vData.size();
+		pResult->ullSizeTimed += Entry.vData.size();
+		pResult->ullSizeOut += ulPackedSize;
+		pResult->fSeconds += std::chrono::duration<double>(TimeEnd - TimeStart).count();
+	}
+	return true;
+}
+
+static bool benchDpcm(
+	const std::vector<tCorpusEntry> &vCorpus,
+	const std::function<std::vector<std::uint8_t>(std::span<const std::int8_t>)> &cbCompress,
+	const std::function<bool(const std::vector<std::uint8_t>&, std::span<std::int8_t>)> &cbDecompress,
+	tBenchResult *pResult
+) {
+	// Measures decompression time, since it's done on Amiga side
+	*pResult = {};
+	std::vector<std::int8_t> vDecompressed;
+	for(const auto &Entry: vCorpus) {
+		// Samples are stored as words
+		std::span Samples(
+			reinterpret_cast<const std::int8_t*>(Entry.vData.data()), Entry.vData.size() & ~1
+		);
+		auto vCompressed = cbCompress(Samples);
+		pResult->ullSizeIn += Samples.size();
+		if(vCompressed.size() >= Samples.size()) {
+			// Tools store such samples uncompressed
+			pResult->ullSizeOut += Samples.size();
+			++pResult->ulStoredCount;
+			continue;
+		}
+
+		vDecompressed.resize(Samples.size());
+		double fBestSeconds = std::numeric_limits<double>::max();
+		for(std::uint32_t ulRun = 0; ulRun < s_ulDecodeRuns; ++ulRun) {
+			auto TimeStart = std::chrono::steady_clock::now();
+			bool isOk = cbDecompress(vCompressed, vDecompressed);
+			auto TimeEnd = std::chrono::steady_clock::now();
+			if(!isOk || !std::equal(vDecompressed.begin(), vDecompressed.end(), Samples.begin())) {
+				nLog::error("Decompressed samples mismatch for '{}'", Entry.Name);
+				return false;
+			}
+			fBestSeconds = std::min(
+				fBestSeconds, std::chrono::duration<double>(TimeEnd - TimeStart).count()
+			);
+		}
+		pResult->ullSizeOut += vCompressed.size();
+		pResult->ullSizeTimed += Samples.size();
+		pResult->fSeconds += fBestSeconds;
+	}
+	return true;
+}
+
+static void printResult(std::string_view Name, const tBenchResult &Result) {
+	// Speed only counts data which was actually processed in measured time
+	fmt::print(
+		"{:>12}: {:10} -> {:10} bytes, ratio: {:6.2f}%, time: {:8.6f}s, speed: {:8.3f} MB/s",
+		Name, Result.ullSizeIn, Result.ullSizeOut,
+		double(Result.ullSizeOut) / Result.ullSizeIn * 100, Result.fSeconds,
+		Result.fSeconds > 0 ? Result.ullSizeTimed / (1024.0 * 1024.0) / Result.fSeconds : 0.0
+	);
+	if(Result.ulStoredCount) {
+		fmt::print(
+			", stored raw: {} files, {} bytes",
+			Result.ulStoredCount, Result.ullSizeIn - Result.ullSizeTimed
+		);
+	}
+	fmt::print("\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	using namespace std::string_view_literals;
+
+	std::string InPath;
+	bool isBruteForce = true;
+	for(auto ArgIndex = 1; ArgIndex < lArgCount; ++ArgIndex) {
+		std::string_view Arg = pArgs[ArgIndex];
+		if(Arg == "-nbf"sv) {
+			isBruteForce = false;
+		}
+		else if(InPath.empty() && Arg[0] != '-') {
+			InPath = Arg;
+		}
+		else {
+			nLog::error("Unknown arg: '{}'", Arg);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<tCorpusEntry> vCorpus;
+	if(InPath.empty()) {
+		vCorpus = corpusGenerate();
+	}
+	else {
+		if(!nFs::isDir(InPath)) {
+			nLog::error("Path {} isn't a folder", InPath);
+			return EXIT_FAILURE;
+		}
+		vCorpus = corpusLoad(InPath);
+	}
+	fmt::print("Corpus: {} files\n", vCorpus.size());
+
+	tBenchResult Result;
+	if(!benchPacker(
+		vCorpus, [](const std::uint8_t *pSrc, std::uint32_t ulSize, std::uint8_t *pDest) {
+			return compressPack(pSrc, ulSize, pDest, false, COMPRESS_MATCH_FINDER_HASH_CHAIN);
+		}, &Result
+	)) {
+		return EXIT_FAILURE;
+	}
+	printResult("hash chain", Result);
+
+	if(!benchPacker(
+		vCorpus, [](const std::uint8_t *pSrc, std::uint32_t ulSize, std::uint8_t *pDest) {
+			return compressPackOptimal(pSrc, ulSize, pDest);
+		}, &Result
+	)) {
+		return EXIT_FAILURE;
+	}
+	printResult("optimal", Result);
+
+	if(isBruteForce) {
+		if(!benchPacker(
+			vCorpus, [](const std::uint8_t *pSrc, std::uint32_t ulSize, std::uint8_t *pDest) {
+				return compressPack(pSrc, ulSize, pDest, false, COMPRESS_MATCH_FINDER_BRUTE_FORCE);
+			}, &Result
+		)) {
+			return EXIT_FAILURE;
+		}
+		printResult("brute force", Result);
+	}
+
+	if(!benchDpcm(
+		vCorpus, [](std::span<const std::int8_t> Samples) {
+			return tSfx::compressLosslessDpcm(Samples);
+		},
+		[](const std::vector<std::uint8_t> &vCompressed, std::span<std::int8_t> Decompressed) {
+			auto vDecompressed = tSfx::decompressLosslessDpcm(vCompressed, std::uint32_t(Decompressed.size()));
+			std::copy(vDecompressed.begin(), vDecompressed.end(), Decompressed.begin());
+			return true;
+		}, &Result
+	)) {
+		return EXIT_FAILURE;
+	}
+	printResult("dpcm legacy", Result);
+
+	if(!benchDpcm(
+		vCorpus, [](std::span<const std::int8_t> Samples) {
+			return tSfx::compressBlockDpcm(Samples);
+		},
+		[](const std::vector<std::uint8_t> &vCompressed, std::span<std::int8_t> Decompressed) {
+			return tSfx::decompressBlockDpcm(vCompressed, Decompressed);
+		}, &Result
+	)) {
+		return EXIT_FAILURE;
+	}
+	printResult("dpcm block", Result);
+
+	return EXIT_SUCCESS;
+}
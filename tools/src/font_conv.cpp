@@ -56,7 +56,10 @@ void printUsage(const std::string &szAppName) {
 	print("\t-out outPath\tSpecify output path, including file name.\n");
 	print("\t\t\tDefault is same name as input with changed extension\n");
 	// -fc
-	print("\t-fc firstchar\tSpecify first ASCII character idx in ProMotion NG font. Default: 33.");
+	print("\t-fc firstchar\tSpecify first ASCII character idx in ProMotion NG font. Default: 33.\n\n");
+	// -pl, -pf
+	print("\t-pl level\tPNG compression level for dir/png output, 0 (store, fastest) to 9 (smallest). Default: 5\n");
+	print("\t-pf filter\tPNG row filter for dir/png output: none, minsum (default), entropy, brute\n");
 }
 
 static std::uint32_t getCharCodeFromTok(const tJson *pJson, std::uint16_t uwTok) {
@@ -104,6 +107,7 @@ int main(int lArgCount, const char *pArgs[])
 	std::uint8_t ubFirstChar = 33;
 	std::string szRemapPath = "";
 	std::int32_t lSize = -1;
+	tPngEncodeSettings PngSettings;
 
 	// Search for optional args
 	for(auto ArgIndex = ubMandatoryArgCnt+1; ArgIndex < lArgCount; ++ArgIndex) {
@@ -144,6 +148,18 @@ int main(int lArgCount, const char *pArgs[])
 			++ArgIndex;
 			szRemapPath = pArgs[ArgIndex];
 		}
+		else if(pArgs[ArgIndex] == std::string("-pl") && ArgIndex < lArgCount - 1) {
+			++ArgIndex;
+			if(!pngParseLevel(pArgs[ArgIndex], PngSettings.ubLevel)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else if(pArgs[ArgIndex] == std::string("-pf") && ArgIndex < lArgCount - 1) {
+			++ArgIndex;
+			if(!pngParseFilter(pArgs[ArgIndex], PngSettings.eFilter)) {
+				return EXIT_FAILURE;
+			}
+		}
 		else {
 			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
 			printUsage(pArgs[0]);
@@ -230,7 +246,9 @@ int main(int lArgCount, const char *pArgs[])
 		if(szOutPath == szFontPath) {
 			szOutPath += ".dir";
 		}
-		mGlyphs.toDir(szOutPath);
+		if(!mGlyphs.toDir(szOutPath, PngSettings)) {
+			return EXIT_FAILURE;
+		}
 	}
 	else {
 		if(eOutType == tFontFormat::PNG) {
@@ -238,7 +256,7 @@ int main(int lArgCount, const char *pArgs[])
 			if(szOutPath.substr(szOutPath.length() - 4) != ".png") {
 				szOutPath += ".png";
 			}
-			FontChunky.toPng(szOutPath);
+			FontChunky.toPng(szOutPath, PngSettings);
 		}
 		else if(eOutType == tFontFormat::FNT) {
 			if(szOutPath.substr(szOutPath.length() - 4) != ".fnt") {
@@ -0,0 +1,336 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <fstream>
+#include <optional>
+#include "common/bitmap.h"
+#include "common/tileset.h"
+#include "common/logging.h"
+#include "common/parse.h"
+#include "common/fs.h"
+#include "common/exception.h"
+
+// Must match tileBufferLoadMapFromFd()
+static constexpr std::uint8_t s_ubMapVersion = 0;
+
+struct tConfig {
+	std::int32_t m_lTileSize;
+	std::int32_t m_lIndexSize;
+	std::string m_szInPath;
+	std::string m_szOutPath;
+	std::string m_szTilesetPath;
+	std::string m_szTilesetOutPath;
+	std::string m_szPalettePath;
+	bool m_isInterleaved;
+
+	tConfig(const std::vector<const char*> &vArgs);
+};
+
+tConfig::tConfig(const std::vector<const char*> &vArgs)
+{
+	auto ArgCount = vArgs.size();
+	if(ArgCount - 1 < 3) {
+		throw std::runtime_error(fmt::format("Too few arguments, got {}", ArgCount - 1));
+	}
+
+	m_szInPath = vArgs[1];
+	if(!nParse::toInt32(vArgs[2], "tileSize", m_lTileSize)) {
+		throw std::runtime_error(nullptr);
+	}
+	if(m_lTileSize <= 0 || (m_lTileSize & (m_lTileSize - 1))) {
+		throw std::runtime_error("tileSize must be a power of two");
+	}
+	m_szOutPath = vArgs[3];
+	m_lIndexSize = 1;
+	m_isInterleaved = false;
+
+	for(std::size_t ArgIndex = 4; ArgIndex < ArgCount; ++ArgIndex) {
+		if(vArgs[ArgIndex] == std::string("-i")) {
+			m_isInterleaved = true;
+		}
+		else if(vArgs[ArgIndex] == std::string("-plt") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			m_szPalettePath = vArgs[ArgIndex];
+		}
+		else if(vArgs[ArgIndex] == std::string("-ts") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			m_szTilesetPath = vArgs[ArgIndex];
+		}
+		else if(vArgs[ArgIndex] == std::string("-tso") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			m_szTilesetOutPath = vArgs[ArgIndex];
+		}
+		else if(vArgs[ArgIndex] == std::string("-is") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			if(!nParse::toInt32(vArgs[ArgIndex], "-is", m_lIndexSize)) {
+				throw std::runtime_error(nullptr);
+			}
+			if(m_lIndexSize != 1 && m_lIndexSize != 2) {
+				throw std::runtime_error("-is value must be 1 or 2");
+			}
+		}
+		else {
+			throw std::runtime_error(fmt::format(
+				"Unknown arg or missing value: '{}'", vArgs[ArgIndex]
+			));
+		}
+	}
+
+	if(m_szTilesetPath.empty() && m_szTilesetOutPath.empty()) {
+		throw std::runtime_error("Specify existing tileset (-ts), output tileset (-tso) or both");
+	}
+}
+
+static void printUsage(const std::string &szAppName)
+{
+	using fmt::print;
+	print("Usage:\n\t{} inPath tileSize outPath [extraOpts]\n\n", szAppName);
+	print("inPath  \t- path to level image (.png, or .bm with -plt)\n");
+	print("tileSize\t- size of tile's edge, in pixels. Must be a power of two.\n");
+	print("outPath \t- path to output map file\n");
+	print("\nExtra options:\n");
+	print("-ts tilesetPath \t- match level tiles against existing tileset (.png or .bm)\n");
+	print("-tso tilesetPath\t- write tileset extended with level's new tiles (.png or .bm)\n");
+	print("                \t  If omitted, all level tiles must be present in -ts tileset.\n");
+	print("-plt palettePath\t- palette for reading/writing .bm files\n");
+	print("-i              \t- save output tileset as interleaved bitmap\n");
+	print("-is indexSize   \t- tile index size in bytes, must match ACE_TILEBUFFER_TILE_TYPE:\n");
+	print("                \t  1 for UBYTE (default), 2 for UWORD\n");
+	print("\nTilesets have one tile beneath another, same as used by tileBuffer.\n");
+	print("Map file is loaded with tileBufferLoadMapFromFd(). Big-endian header:\n");
+	print("\tUWORD tileCountX, UWORD tileCountY, UBYTE indexSize, UBYTE version,\n");
+	print("\tUBYTE flags, UBYTE reserved,\n");
+	print("followed by big-endian tile indices, column by column, as in pTileData.\n");
+	print("To compress the map, put it in a pak with pak_tool - it still loads in one read.\n");
+}
+
+static tChunkyBitmap readBitmap(
+	const std::string &szPath, const std::optional<tPalette> &Palette
+)
+{
+	tChunkyBitmap Bitmap;
+	auto szExt = nFs::getExt(szPath);
+	if(szExt == "png") {
+		Bitmap = tChunkyBitmap::fromPng(szPath);
+	}
+	else if(szExt == "bm") {
+		if(!Palette.has_value()) {
+			throw std::runtime_error(fmt::format("No palette specified to read '{}'", szPath));
+		}
+		Bitmap = tChunkyBitmap(tPlanarBitmap::fromBm(szPath), Palette.value());
+	}
+	else {
+		throw std::runtime_error(fmt::format("Unsupported extension: '{}'", szExt));
+	}
+
+	if(Bitmap.m_uwHeight == 0) {
+		throw std::runtime_error(fmt::format("Couldn't load '{}'", szPath));
+	}
+	return Bitmap;
+}
+
+static void readTileset(
+	const tConfig &Config, const std::optional<tPalette> &Palette,
+	tTileIndex &Tileset
+)
+{
+	auto In = readBitmap(Config.m_szTilesetPath, Palette);
+	if(In.m_uwWidth != Config.m_lTileSize || In.m_uwHeight % Config.m_lTileSize) {
+		throw std::runtime_error(fmt::format(
+			"Tileset must be {}px wide and have height divisible by it, got {}x{}",
+			Config.m_lTileSize, In.m_uwWidth, In.m_uwHeight
+		));
+	}
+
+	std::uint32_t ulTileCount = In.m_uwHeight / Config.m_lTileSize;
+	for(std::uint32_t i = 0; i < ulTileCount; ++i) {
+		tChunkyBitmap Tile(Config.m_lTileSize, Config.m_lTileSize);
+		In.copyRect(
+			0, i * Config.m_lTileSize, Tile, 0, 0,
+			Config.m_lTileSize, Config.m_lTileSize
+		);
+		// Keep duplicates so that indices match the tileset
+		Tileset.add(std::move(Tile));
+	}
+}
+
+static std::vector<std::uint32_t> convertLevel(
+	const tConfig &Config, const std::optional<tPalette> &Palette,
+	tTileIndex &Tileset, std::uint16_t &uwTileCountX, std::uint16_t &uwTileCountY
+)
+{
+	auto In = readBitmap(Config.m_szInPath, Palette);
+	if(In.m_uwWidth % Config.m_lTileSize || In.m_uwHeight % Config.m_lTileSize) {
+		throw std::runtime_error(fmt::format(
+			"Level size {}x{} isn't divisible by tile size {}",
+			In.m_uwWidth, In.m_uwHeight, Config.m_lTileSize
+		));
+	}
+
+	uwTileCountX = In.m_uwWidth / Config.m_lTileSize;
+	uwTileCountY = In.m_uwHeight / Config.m_lTileSize;
+	bool isTilesetExtendable = !Config.m_szTilesetOutPath.empty();
+
+	// Stored column by column, same as tileBuffer's pTileData
+	std::vector<std::uint32_t> vIndices;
+	vIndices.reserve(uwTileCountX * uwTileCountY);
+	tChunkyBitmap Tile(Config.m_lTileSize, Config.m_lTileSize);
+	for(std::uint16_t x = 0; x < uwTileCountX; ++x) {
+		for(std::uint16_t y = 0; y < uwTileCountY; ++y) {
+			In.copyRect(
+				x * Config.m_lTileSize, y * Config.m_lTileSize, Tile, 0, 0,
+				Config.m_lTileSize, Config.m_lTileSize
+			);
+			auto Match = Tileset.find(Tile, false);
+			if(Match) {
+				vIndices.push_back(Match->ulIndex);
+			}
+			else if(isTilesetExtendable) {
+				vIndices.push_back(Tileset.add(Tile));
+			}
+			else {
+				throw std::runtime_error(fmt::format(
+					"Tile at {},{} isn't in tileset - use -tso to extend it", x, y
+				));
+			}
+		}
+	}
+	return vIndices;
+}
+
+static void writeMap(
+	const tConfig &Config, const std::vector<std::uint32_t> &vIndices,
+	std::uint16_t uwTileCountX, std::uint16_t uwTileCountY
+)
+{
+	std::vector<std::uint8_t> vOut = {
+		std::uint8_t(uwTileCountX >> 8), std::uint8_t(uwTileCountX),
+		std::uint8_t(uwTileCountY >> 8), std::uint8_t(uwTileCountY),
+		std::uint8_t(Config.m_lIndexSize), s_ubMapVersion,
+		0, 0 // Flags, reserved
+	};
+	vOut.reserve(vOut.size() + vIndices.size() * Config.m_lIndexSize);
+	for(auto ulIndex: vIndices) {
+		if(Config.m_lIndexSize == 2) {
+			vOut.push_back(std::uint8_t(ulIndex >> 8));
+		}
+		vOut.push_back(std::uint8_t(ulIndex));
+	}
+
+	std::ofstream FileOut(Config.m_szOutPath, std::ios::out | std::ios::binary);
+	if(!FileOut.is_open()) {
+		throw std::runtime_error(fmt::format("Couldn't write to '{}'", Config.m_szOutPath));
+	}
+	FileOut.write(reinterpret_cast<const char*>(vOut.data()), vOut.size());
+}
+
+static void writeTileset(
+	const tConfig &Config, const std::optional<tPalette> &Palette,
+	const tTileIndex &Tileset
+)
+{
+	const auto &vTiles = Tileset.getTiles();
+	tChunkyBitmap Out(
+		Config.m_lTileSize, std::uint16_t(Config.m_lTileSize * vTiles.size())
+	);
+	for(std::size_t i = 0; i < vTiles.size(); ++i) {
+		if(!vTiles[i].copyRect(
+			0, 0, Out, 0, std::uint16_t(i * Config.m_lTileSize),
+			Config.m_lTileSize, Config.m_lTileSize
+		)) {
+			throw std::runtime_error(fmt::format("Couldn't place tile {} in tileset", i));
+		}
+	}
+
+	auto szExt = nFs::getExt(Config.m_szTilesetOutPath);
+	if(szExt == "png") {
+		if(!Out.toPng(Config.m_szTilesetOutPath)) {
+			throw std::runtime_error(fmt::format(
+				"Couldn't write tileset to '{}'", Config.m_szTilesetOutPath
+			));
+		}
+	}
+	else if(szExt == "bm") {
+		if(!Palette.has_value()) {
+			throw std::runtime_error("No palette specified for .bm tileset");
+		}
+		tPlanarBitmap Planar(Out, Palette.value());
+		if(Planar.m_uwHeight == 0) {
+			throw std::runtime_error("Problem with planar conversion");
+		}
+		if(!Planar.toBm(Config.m_szTilesetOutPath, Config.m_isInterleaved)) {
+			throw std::runtime_error(fmt::format(
+				"Couldn't write tileset to '{}'", Config.m_szTilesetOutPath
+			));
+		}
+	}
+	else {
+		throw std::runtime_error(fmt::format("Unsupported tileset extension: '{}'", szExt));
+	}
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	std::optional<tConfig> Config;
+	try {
+		std::vector<const char*> Args(pArgs, pArgs + lArgCount);
+		Config = std::make_optional<tConfig>(Args);
+	}
+	catch(std::exception &Ex) {
+		exceptionHandle(Ex, "parsing parameters");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::optional<tPalette> Palette;
+	if(!Config->m_szPalettePath.empty()) {
+		Palette = tPalette::fromFile(Config->m_szPalettePath);
+		if(!Palette.value().isValid()) {
+			nLog::error("Couldn't read palette: '{}'", Config->m_szPalettePath);
+			return EXIT_FAILURE;
+		}
+	}
+
+	try {
+		tTileIndex Tileset;
+		if(!Config->m_szTilesetPath.empty()) {
+			readTileset(Config.value(), Palette, Tileset);
+		}
+		auto ulTilesetSizeOld = Tileset.getTiles().size();
+
+		std::uint16_t uwTileCountX, uwTileCountY;
+		auto vIndices = convertLevel(
+			Config.value(), Palette, Tileset, uwTileCountX, uwTileCountY
+		);
+		auto ulTilesetSize = Tileset.getTiles().size();
+		if(ulTilesetSize > (1u << (8 * Config->m_lIndexSize))) {
+			throw std::runtime_error(fmt::format(
+				"Tileset has {} tiles, too many for {}-byte indices",
+				ulTilesetSize, Config->m_lIndexSize
+			));
+		}
+		if(ulTilesetSize * Config->m_lTileSize > 0xFFFF) {
+			// Tileset is stored as single column, its height must fit in UWORD
+			throw std::runtime_error(fmt::format(
+				"Tileset has {} tiles, too many for {}px tiles - max is {}",
+				ulTilesetSize, Config->m_lTileSize, 0xFFFF / Config->m_lTileSize
+			));
+		}
+		fmt::print(
+			"Map: {}x{} tiles, tileset: {} tiles ({} new)\n",
+			uwTileCountX, uwTileCountY, ulTilesetSize, ulTilesetSize - ulTilesetSizeOld
+		);
+
+		writeMap(Config.value(), vIndices, uwTileCountX, uwTileCountY);
+		if(!Config->m_szTilesetOutPath.empty()) {
+			writeTileset(Config.value(), Palette, Tileset);
+		}
+	}
+	catch(std::exception &Ex) {
+		exceptionHandle(Ex, "converting map");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,490 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <bit>
+#include <string_view>
+#include <fmt/format.h>
+#include "common/logging.h"
+#include "common/sfx.h"
+#include "common/wav.h"
+#include <ptplayer_host.h>
+#include <ace/managers/ptplayer.h>
+
+using namespace std::string_view_literals;
+
+// ptplayer's note layout is selected by the build, make sure it matches host
+#if defined(PTPLAYER_HOST_LITTLE_ENDIAN)
+static_assert(std::endian::native == std::endian::little, "PTPLAYER_HOST_LITTLE_ENDIAN set on big-endian host");
+#else
+static_assert(std::endian::native == std::endian::big, "PTPLAYER_HOST_LITTLE_ENDIAN must be set on little-endian host");
+#endif
+
+static constexpr std::uint8_t s_ubSupportedSamplePackVersion = 4;
+static constexpr std::uint32_t s_ulMaxPatternCount = 128;
+static constexpr std::uint32_t s_ulRenderChunkFrames = 1024;
+
+/**
+ * @brief Host-side copy of the mod and its sample data. Pattern data and
+ * headers are converted to native endian, since ptplayer reads them as words,
+ * whereas sample bytes are kept as-is, since they're read by emulated Paula.
+ */
+struct tModData {
+	tPtplayerMod Mod;
+	std::vector<std::uint8_t> vPatterns;
+	std::vector<std::vector<std::uint16_t>> vSamples;
+};
+
+struct tSamplePackData {
+	tPtplayerSamplePack SamplePack;
+	std::vector<std::vector<std::uint16_t>> vSamples;
+};
+
+struct tTickRecord {
+	tPtplayerHostTick Host;
+	tPtplayerTickStats Player;
+};
+
+static std::vector<tTickRecord> s_vTicks;
+static bool s_isSongEnd = false;
+
+static std::vector<std::uint8_t> readFile(const std::string &szPath)
+{
+	std::ifstream File(szPath, std::ios::binary);
+	if(!File.is_open()) {
+		return {};
+	}
+	return std::vector<std::uint8_t>(
+		std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>()
+	);
+}
+
+static std::uint16_t readBig16(const std::uint8_t *pData)
+{
+	return std::uint16_t((pData[0] << 8) | pData[1]);
+}
+
+static std::uint32_t readBig32(const std::uint8_t *pData)
+{
+	return (std::uint32_t(readBig16(&pData[0])) << 16) | readBig16(&pData[2]);
+}
+
+static bool loadMod(const std::string &szPath, tModData &Data)
+{
+	auto vFile = readFile(szPath);
+	auto &Mod = Data.Mod;
+	Mod = {};
+	std::uint32_t ulPos = 0;
+	constexpr std::uint32_t ulHeaderSize = sizeof(Mod.szSongName) +
+		PTPLAYER_MOD_SAMPLE_COUNT * 30 + 2 + sizeof(Mod.pArrangement) +
+		sizeof(Mod.pFileFormatTag);
+	if(vFile.size() < ulHeaderSize) {
+		nLog::error("Couldn't read mod header from '{}'", szPath);
+		return false;
+	}
+
+	std::memcpy(Mod.szSongName, &vFile[ulPos], sizeof(Mod.szSongName));
+	ulPos += sizeof(Mod.szSongName);
+	for(auto &Header: Mod.pSampleHeaders) {
+		std::memcpy(Header.szName, &vFile[ulPos], sizeof(Header.szName));
+		Header.uwLength = readBig16(&vFile[ulPos + 22]);
+		Header.ubFineTune = vFile[ulPos + 24];
+		Header.ubVolume = vFile[ulPos + 25];
+		Header.uwRepeatOffs = readBig16(&vFile[ulPos + 26]);
+		Header.uwRepeatLength = readBig16(&vFile[ulPos + 28]);
+		ulPos += 30;
+	}
+	Mod.ubArrangementLength = vFile[ulPos++];
+	Mod.ubSongEndPos = vFile[ulPos++];
+	std::memcpy(Mod.pArrangement, &vFile[ulPos], sizeof(Mod.pArrangement));
+	ulPos += sizeof(Mod.pArrangement);
+	std::memcpy(Mod.pFileFormatTag, &vFile[ulPos], sizeof(Mod.pFileFormatTag));
+	ulPos += sizeof(Mod.pFileFormatTag);
+
+	// Same as ptplayer: last arrangement entry isn't used for pattern count
+	std::uint32_t ulPatternCount = *std::max_element(
+		&Mod.pArrangement[0], &Mod.pArrangement[s_ulMaxPatternCount - 1]
+	) + 1;
+
+	Mod.isPatternsPacked = !std::memcmp(Mod.pFileFormatTag, "ACEP", sizeof(Mod.pFileFormatTag));
+	if(Mod.isPatternsPacked) {
+		if(vFile.size() < ulPos + sizeof(std::uint32_t)) {
+			nLog::error("Couldn't read packed pattern data size");
+			return false;
+		}
+		Mod.ulPatternsSize = readBig32(&vFile[ulPos]);
+		ulPos += sizeof(std::uint32_t);
+		if(Mod.ulPatternsSize < ulPatternCount * sizeof(std::uint32_t)) {
+			nLog::error("Packed pattern data too short: {}", Mod.ulPatternsSize);
+			return false;
+		}
+	}
+	else {
+		Mod.ulPatternsSize = ulPatternCount * 64 * 4 * 4;
+	}
+	if(vFile.size() < ulPos + Mod.ulPatternsSize) {
+		nLog::error("Pattern data too short: {}", vFile.size() - ulPos);
+		return false;
+	}
+
+	Data.vPatterns.assign(&vFile[ulPos], &vFile[ulPos] + Mod.ulPatternsSize);
+	if(Mod.isPatternsPacked) {
+		// Only the pattern offset table is accessed as native longs
+		for(std::uint32_t i = 0; i < ulPatternCount; ++i) {
+			std::uint32_t ulOffset = readBig32(&Data.vPatterns[i * sizeof(ulOffset)]);
+			std::memcpy(&Data.vPatterns[i * sizeof(ulOffset)], &ulOffset, sizeof(ulOffset));
+		}
+	}
+	else {
+		for(std::uint32_t i = 0; i < Mod.ulPatternsSize; i += sizeof(std::uint16_t)) {
+			std::uint16_t uwWord = readBig16(&Data.vPatterns[i]);
+			std::memcpy(&Data.vPatterns[i], &uwWord, sizeof(uwWord));
+		}
+	}
+	Mod.pPatterns = Data.vPatterns.data();
+	ulPos += Mod.ulPatternsSize;
+
+	// Truncated file leaves the rest of sample zeroed
+	Data.vSamples.resize(PTPLAYER_MOD_SAMPLE_COUNT);
+	if(ulPos < vFile.size()) {
+		for(std::uint8_t i = 0; i < PTPLAYER_MOD_SAMPLE_COUNT; ++i) {
+			std::uint32_t ulSampleSize = Mod.pSampleHeaders[i].uwLength * sizeof(std::uint16_t);
+			if(ulSampleSize) {
+				Data.vSamples[i].resize(Mod.pSampleHeaders[i].uwLength);
+				auto CopySize = std::min<std::size_t>(ulSampleSize, vFile.size() - ulPos);
+				std::memcpy(Data.vSamples[i].data(), &vFile[ulPos], CopySize);
+				ulPos += std::uint32_t(CopySize);
+				Mod.pSampleStarts[i] = Data.vSamples[i].data();
+			}
+		}
+	}
+
+	fmt::print(
+		"Loaded '{}': {} {} patterns, arrangement length: {}\n",
+		std::string(Mod.szSongName, strnlen(Mod.szSongName, sizeof(Mod.szSongName))),
+		ulPatternCount, Mod.isPatternsPacked ? "packed" : "raw", Mod.ubArrangementLength
+	);
+	return true;
+}
+
+static bool hasSampleData(const tModData &Data)
+{
+	for(std::uint8_t i = 0; i < PTPLAYER_MOD_SAMPLE_COUNT; ++i) {
+		if(Data.Mod.pSampleHeaders[i].uwLength && !Data.Mod.pSampleStarts[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool loadSamplePack(const std::string &szPath, tSamplePackData &Data)
+{
+	auto vFile = readFile(szPath);
+	auto &SamplePack = Data.SamplePack;
+	SamplePack = {};
+	if(vFile.size() < 2) {
+		nLog::error("Couldn't read sample pack header from '{}'", szPath);
+		return false;
+	}
+	if(vFile[0] != s_ubSupportedSamplePackVersion) {
+		nLog::error(
+			"Unsupported sample pack version: {}, expected {}",
+			vFile[0], s_ubSupportedSamplePackVersion
+		);
+		return false;
+	}
+	SamplePack.ubSampleCount = vFile[1];
+	if(SamplePack.ubSampleCount > PTPLAYER_MOD_SAMPLE_COUNT) {
+		nLog::error("Too many samples: {}", SamplePack.ubSampleCount);
+		return false;
+	}
+
+	std::uint32_t ulPos = 2;
+	std::uint8_t pSourceIndices[PTPLAYER_MOD_SAMPLE_COUNT];
+	std::uint16_t pSourceOffsets[PTPLAYER_MOD_SAMPLE_COUNT];
+	Data.vSamples.resize(SamplePack.ubSampleCount);
+	for(std::uint8_t i = 0; i < SamplePack.ubSampleCount; ++i) {
+		auto &Sample = SamplePack.pSamples[i];
+		if(vFile.size() < ulPos + 3) {
+			nLog::error("Sample pack truncated at sample {}", i);
+			return false;
+		}
+		Sample.uwWordLength = readBig16(&vFile[ulPos]);
+		pSourceIndices[i] = vFile[ulPos + 2];
+		ulPos += 3;
+		if(pSourceIndices[i] != i) {
+			if(pSourceIndices[i] >= SamplePack.ubSampleCount || vFile.size() < ulPos + 2) {
+				nLog::error("Sample {} uses data of invalid index: {}", i, pSourceIndices[i]);
+				return false;
+			}
+			pSourceOffsets[i] = readBig16(&vFile[ulPos]);
+			ulPos += 2;
+			SamplePack.ulSharedMask |= 1u << i;
+			continue;
+		}
+
+		if(vFile.size() < ulPos + 4) {
+			nLog::error("Sample pack truncated at sample {}", i);
+			return false;
+		}
+		std::uint32_t ulCompressedLength = readBig32(&vFile[ulPos]);
+		ulPos += 4;
+		std::uint32_t ulSize = Sample.uwWordLength * sizeof(std::uint16_t);
+		std::uint32_t ulStoredSize = ulCompressedLength ? ulCompressedLength : ulSize;
+		if(vFile.size() < ulPos + ulStoredSize) {
+			nLog::error("Sample pack truncated at sample {}", i);
+			return false;
+		}
+		Data.vSamples[i].resize(Sample.uwWordLength);
+		auto Decompressed = std::span(reinterpret_cast<std::int8_t*>(Data.vSamples[i].data()), ulSize);
+		if(ulCompressedLength) {
+			if(!tSfx::decompressBlockDpcm(std::span(&vFile[ulPos], ulCompressedLength), Decompressed)) {
+				nLog::error("Couldn't decompress sample {}", i);
+				return false;
+			}
+		}
+		else {
+			std::memcpy(Decompressed.data(), &vFile[ulPos], ulSize);
+		}
+		ulPos += ulStoredSize;
+		Sample.pData = Data.vSamples[i].data();
+	}
+
+	for(std::uint8_t i = 0; i < SamplePack.ubSampleCount; ++i) {
+		if(SamplePack.ulSharedMask & (1u << i)) {
+			const auto &Source = SamplePack.pSamples[pSourceIndices[i]];
+			if(
+				(SamplePack.ulSharedMask & (1u << pSourceIndices[i])) ||
+				pSourceOffsets[i] + SamplePack.pSamples[i].uwWordLength > Source.uwWordLength
+			) {
+				nLog::error("Sample {} has invalid data source", i);
+				return false;
+			}
+			SamplePack.pSamples[i].pData = &Source.pData[pSourceOffsets[i]];
+		}
+	}
+	return true;
+}
+
+static void onTick(const tPtplayerHostTick *pTick)
+{
+	s_vTicks.push_back({*pTick, *ptplayerGetTickStats()});
+}
+
+static void onSongEnd(void)
+{
+	s_isSongEnd = true;
+}
+
+static bool writeStats(const std::string &szPath)
+{
+	std::ofstream FileStats(szPath);
+	if(!FileStats.is_open()) {
+		return false;
+	}
+
+	FileStats << "tick,time,rows,notes,effects,interrupts,dma_starts,dma_stops,register_changes\n";
+	for(const auto &Tick: s_vTicks) {
+		FileStats << fmt::format(
+			FMT_STRING("{},{:.6f},{},{},{},{},{},{},{}\n"), Tick.Host.ulIndex,
+			Tick.Host.dTime, Tick.Player.ubRows, Tick.Player.ubNotes,
+			Tick.Player.ubEffects, Tick.Host.ubInterrupts, Tick.Host.ubDmaStarts,
+			Tick.Host.ubDmaStops, Tick.Host.ubRegisterChanges
+		);
+	}
+	return FileStats.good();
+}
+
+static void printStatsSummary(void)
+{
+	struct tColumn {
+		std::string_view szName;
+		std::uint8_t (*cbGet)(const tTickRecord &Tick);
+	};
+	static constexpr tColumn s_pColumns[] = {
+		{"Notes", [](const tTickRecord &Tick) { return Tick.Player.ubNotes; }},
+		{"Effects", [](const tTickRecord &Tick) { return Tick.Player.ubEffects; }},
+		{"Interrupts", [](const tTickRecord &Tick) { return Tick.Host.ubInterrupts; }},
+		{"DMA starts", [](const tTickRecord &Tick) { return Tick.Host.ubDmaStarts; }},
+		{"DMA stops", [](const tTickRecord &Tick) { return Tick.Host.ubDmaStops; }},
+		{"Reg changes", [](const tTickRecord &Tick) { return Tick.Host.ubRegisterChanges; }},
+	};
+
+	std::uint32_t ulRowCount = 0;
+	for(const auto &Tick: s_vTicks) {
+		ulRowCount += Tick.Player.ubRows;
+	}
+	fmt::print("Ticks: {}, rows: {}\n", s_vTicks.size(), ulRowCount);
+	if(s_vTicks.empty()) {
+		return;
+	}
+
+	fmt::print("{:<12} {:>8} {:>5} {:>12}\n", "Per tick", "avg", "max", "max at");
+	for(const auto &Column: s_pColumns) {
+		std::uint32_t ulSum = 0;
+		const tTickRecord *pMax = &s_vTicks.front();
+		for(const auto &Tick: s_vTicks) {
+			ulSum += Column.cbGet(Tick);
+			if(Column.cbGet(Tick) > Column.cbGet(*pMax)) {
+				pMax = &Tick;
+			}
+		}
+		fmt::print(
+			FMT_STRING("{:<12} {:>8.2f} {:>5} {:>11.3f}s\n"), Column.szName,
+			double(ulSum) / s_vTicks.size(), Column.cbGet(*pMax), pMax->Host.dTime
+		);
+	}
+}
+
+static void printUsage(const std::string &szAppName)
+{
+	using fmt::print;
+	print("Usage:\n\t{} -i inPath -o outPath [extraOpts]\n\n", szAppName);
+	print("Renders mod as played by ptplayer on emulated Paula.\n\n");
+	print("Required arguments:\n");
+	print("\t-i inPath     Path to mod file, optionally processed by mod_tool\n");
+	print("\t-o outPath    Path to output 16-bit stereo .wav file\n");
+	print("Extra options:\n");
+	print("\t-sp path      Sample pack to be used with mod stripped of samples\n");
+	print("\t-r N          Output sample rate. Default: 44100\n");
+	print("\t-ntsc         Use NTSC clocks. Default: PAL\n");
+	print("\t-t N          Max rendered length, in seconds. Default: 600\n");
+	print("\t-stats path   Write per-tick player workload to .csv file\n");
+	print("\t-v            Print ptplayer's log\n");
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount <= 1) {
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szModPath, szOutPath, szSamplePackPath, szStatsPath;
+	std::uint32_t ulOutputRate = 44100;
+	std::uint32_t ulMaxSeconds = 600;
+	bool isPal = true;
+	bool isVerbose = false;
+	for(auto ArgIndex = 1; ArgIndex < lArgCount; ++ArgIndex) {
+		bool isLast = (ArgIndex == lArgCount - 1);
+		if(pArgs[ArgIndex] == "-i"sv && !isLast) {
+			szModPath = pArgs[++ArgIndex];
+		}
+		else if(pArgs[ArgIndex] == "-o"sv && !isLast) {
+			szOutPath = pArgs[++ArgIndex];
+		}
+		else if(pArgs[ArgIndex] == "-sp"sv && !isLast) {
+			szSamplePackPath = pArgs[++ArgIndex];
+		}
+		else if(pArgs[ArgIndex] == "-r"sv && !isLast) {
+			ulOutputRate = std::strtoul(pArgs[++ArgIndex], nullptr, 10);
+		}
+		else if(pArgs[ArgIndex] == "-t"sv && !isLast) {
+			ulMaxSeconds = std::strtoul(pArgs[++ArgIndex], nullptr, 10);
+		}
+		else if(pArgs[ArgIndex] == "-stats"sv && !isLast) {
+			szStatsPath = pArgs[++ArgIndex];
+		}
+		else if(pArgs[ArgIndex] == "-ntsc"sv) {
+			isPal = false;
+		}
+		else if(pArgs[ArgIndex] == "-v"sv) {
+			isVerbose = true;
+		}
+		else {
+			nLog::error("Unknown argument: '{}'", pArgs[ArgIndex]);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if(szModPath.empty() || szOutPath.empty()) {
+		nLog::error("Input and output paths must be specified");
+		return EXIT_FAILURE;
+	}
+	if(ulOutputRate == 0) {
+		nLog::error("Invalid output sample rate");
+		return EXIT_FAILURE;
+	}
+
+	tModData ModData;
+	if(!loadMod(szModPath, ModData)) {
+		return EXIT_FAILURE;
+	}
+	tSamplePackData SamplePackData;
+	tPtplayerSamplePack *pSamplePack = nullptr;
+	if(!szSamplePackPath.empty()) {
+		if(!loadSamplePack(szSamplePackPath, SamplePackData)) {
+			return EXIT_FAILURE;
+		}
+		pSamplePack = &SamplePackData.SamplePack;
+	}
+	else if(!hasSampleData(ModData)) {
+		nLog::error("Mod has no sample data, specify sample pack with -sp");
+		return EXIT_FAILURE;
+	}
+
+	ptplayerHostSetLogging(isVerbose);
+	ptplayerHostCreate(isPal, ulOutputRate, onTick);
+	ptplayerCreate(isPal);
+	ptplayerConfigureSongRepeat(0, onSongEnd);
+	ptplayerLoadMod(&ModData.Mod, pSamplePack, 0);
+	ptplayerEnableMusic(1);
+
+	// Render whole chunks, leaving a bit of tail after song end
+	std::vector<float> vMixed;
+	std::uint64_t ullMaxFrames = std::uint64_t(ulMaxSeconds) * ulOutputRate;
+	while(!s_isSongEnd && vMixed.size() / 2 < ullMaxFrames) {
+		auto PrevSize = vMixed.size();
+		vMixed.resize(PrevSize + s_ulRenderChunkFrames * 2);
+		ptplayerHostRender(&vMixed[PrevSize], s_ulRenderChunkFrames);
+	}
+	if(!s_isSongEnd) {
+		nLog::warn("Song didn't end in {} seconds, output is truncated", ulMaxSeconds);
+	}
+
+	ptplayerStop();
+	ptplayerDestroy();
+	ptplayerHostDestroy();
+
+	std::vector<std::int16_t> vSamples(vMixed.size());
+	std::uint32_t ulClipCount = 0;
+	for(std::size_t i = 0; i < vMixed.size(); ++i) {
+		float fSample = std::round(vMixed[i] * 32767.0f);
+		if(fSample < -32768.0f || fSample > 32767.0f) {
+			++ulClipCount;
+		}
+		vSamples[i] = std::int16_t(std::clamp(fSample, -32768.0f, 32767.0f));
+	}
+	if(ulClipCount) {
+		nLog::warn("{} samples clipped", ulClipCount);
+	}
+
+	fmt::print(
+		"Writing {:.2f}s to {}...\n",
+		double(vMixed.size() / 2) / ulOutputRate, szOutPath
+	);
+	if(!tWav::toFile(szOutPath, vSamples, ulOutputRate, 2)) {
+		nLog::error("Couldn't write {}", szOutPath);
+		return EXIT_FAILURE;
+	}
+
+	printStatsSummary();
+	if(!szStatsPath.empty()) {
+		fmt::print("Writing tick stats to {}...\n", szStatsPath);
+		if(!writeStats(szStatsPath)) {
+			nLog::error("Couldn't write {}", szStatsPath);
+			return EXIT_FAILURE;
+		}
+	}
+
+	fmt::print("All done!\n");
+	return EXIT_SUCCESS;
+}
@@ -3,23 +3,54 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
 #include <map>
+#include <atomic>
+#include <thread>
 #include <fstream>
 #include <filesystem>
 #include <vector>
 #include <algorithm>
+#include <limits>
 #include "common/logging.h"
 #include "common/fs.h"
 #include "common/endian.h"
 #include "common/compress.hpp"
+#include "common/parse.h"
+
+// Keep in sync with tPakFileCodec in pak_file.h
+enum tPakCodec: std::uint8_t {
+	PAK_CODEC_NONE,
+	PAK_CODEC_LZSS,
+	PAK_CODEC_LZ4,
+};
+
+enum tPakCodecPolicy {
+	PAK_CODEC_POLICY_LZSS,
+	PAK_CODEC_POLICY_LZ4,
+	PAK_CODEC_POLICY_AUTO,
+};
 
 struct tPakEntry {
 	std::string ShortPath;
 	std::string Path;
 	std::uint32_t ulChecksum;
 	std::uint32_t ulUncompressedSize;
+	std::uint32_t ulOffset;
+	std::uint32_t ulSizeGreedy;
+	std::uint32_t ulSizeOptimal;
+	tPakCodec eCodec;
+	bool isCached;
 	std::vector<std::uint8_t> vData;
 };
 
+struct tPakSettings {
+	bool isCompressed;
+	bool isOptimal;
+	tPakCodecPolicy eCodecPolicy;
+	std::uint8_t ubLz4MaxGrowth; ///< Max size increase of LZ4 vs LZSS in auto mode, in percent.
+	std::uint32_t ulRestartInterval;
+	std::string CacheDir;
+};
+
 static std::uint32_t adler32Buffer(const std::uint8_t *pData, std::uint32_t ulDataSize) {
 	constexpr std::uint32_t modulo = 65521;
 	std::uint32_t a = 1, b = 0;
@@ -36,6 +67,306 @@ static std::uint32_t adler32Buffer(const std::uint8_t *pData, std::uint32_t ulDa
 	return (b << 16) | a;
 }
 
+// Keep in sync with pak_file.c
+static constexpr std::uint16_t s_PakVersion = 2;
+static constexpr std::uint16_t s_PakFlagSorted = 1 << 0;
+static constexpr std::uint16_t s_PakFlagRestartPoints = 1 << 1;
+// Checksum, offset, uncompressed & data size, codec and 3 reserved bytes
+static constexpr std::uint32_t s_PakEntrySize = 4 * sizeof(std::uint32_t) + 4;
+
+// Restart points must be aligned to unpacker's lookup table size, so that
+// lookup positions of blocks packed separately match the ones of whole file
+static constexpr std::uint32_t s_RestartAlignment = 0x1000;
+
+// Each LZ4 block is packed separately, so that no lookup table is needed
+// and unpacker's buffer may be limited to block size
+static constexpr std::uint32_t s_Lz4BlockSize = 0x1000;
+
+static const char *pakCodecGetName(tPakCodec eCodec) {
+	switch(eCodec) {
+		case PAK_CODEC_LZSS: return "lzss";
+		case PAK_CODEC_LZ4: return "lz4";
+		default: return "none";
+	}
+}
+
+// Bump when compressor output changes to invalidate old cache entries
+static constexpr std::uint32_t s_CacheVersion = 3;
+
+static std::uint64_t fnv1a64Buffer(
+	const std::uint8_t *pData, std::size_t ulDataSize,
+	std::uint64_t ullHash = 0xCBF29CE484222325
+) {
+	for(std::size_t i = 0; i < ulDataSize; ++i) {
+		ullHash ^= pData[i];
+		ullHash *= 0x100000001B3;
+	}
+	return ullHash;
+}
+
+static std::filesystem::path pakCacheGetPath(
+	const tPakSettings &Settings, const std::vector<std::uint8_t> &vFileContents
+) {
+	// Key consists of file contents, its size and all compressor settings
+	std::uint64_t ullHash = fnv1a64Buffer(vFileContents.data(), vFileContents.size());
+	std::uint32_t ulRestartIntervalBe = nEndian::toBig32(Settings.ulRestartInterval);
+	std::uint8_t pSettings[] = {
+		std::uint8_t(s_CacheVersion), Settings.isCompressed, Settings.isOptimal,
+		std::uint8_t(Settings.eCodecPolicy), Settings.ubLz4MaxGrowth,
+		std::uint8_t(ulRestartIntervalBe), std::uint8_t(ulRestartIntervalBe >> 8),
+		std::uint8_t(ulRestartIntervalBe >> 16), std::uint8_t(ulRestartIntervalBe >> 24)
+	};
+	ullHash = fnv1a64Buffer(pSettings, sizeof(pSettings), ullHash);
+	return std::filesystem::path(Settings.CacheDir) / fmt::format(
+		"{:016x}_{}.pakc", ullHash, vFileContents.size()
+	);
+}
+
+static bool pakCacheRead(
+	const std::filesystem::path &CachePath, std::uint32_t ulContentsChecksum, tPakEntry &Entry
+) {
+	std::ifstream FileCache(CachePath, std::ios::binary);
+	if(FileCache.fail()) {
+		return false;
+	}
+
+	std::uint32_t ulSizeGreedyBe, ulSizeOptimalBe, ulUncompressedSizeBe, ulChecksumBe;
+	std::uint8_t ubCodec;
+	constexpr std::uintmax_t HeaderSize = 4 * sizeof(std::uint32_t) + sizeof(ubCodec);
+	std::error_code ErrorCode;
+	auto FileSize = std::filesystem::file_size(CachePath, ErrorCode);
+	if(ErrorCode || FileSize < HeaderSize) {
+		nLog::warn("Ignoring truncated cache file {}", CachePath.generic_string());
+		return false;
+	}
+
+	FileCache.read(reinterpret_cast<char*>(&ulSizeGreedyBe), sizeof(ulSizeGreedyBe));
+	FileCache.read(reinterpret_cast<char*>(&ulSizeOptimalBe), sizeof(ulSizeOptimalBe));
+	FileCache.read(reinterpret_cast<char*>(&ubCodec), sizeof(ubCodec));
+	FileCache.read(reinterpret_cast<char*>(&ulUncompressedSizeBe), sizeof(ulUncompressedSizeBe));
+	FileCache.read(reinterpret_cast<char*>(&ulChecksumBe), sizeof(ulChecksumBe));
+	if(FileCache.fail()) {
+		return false;
+	}
+
+	// Key is only a hash, so make sure that entry was made from same contents
+	if(
+		nEndian::fromBig32(ulUncompressedSizeBe) != Entry.ulUncompressedSize ||
+		nEndian::fromBig32(ulChecksumBe) != ulContentsChecksum || ubCodec > PAK_CODEC_LZ4
+	) {
+		nLog::warn("Ignoring mismatched cache file {}", CachePath.generic_string());
+		return false;
+	}
+
+	auto DataSize = FileSize - HeaderSize;
+	Entry.vData.resize(DataSize);
+	FileCache.read(reinterpret_cast<char*>(Entry.vData.data()), DataSize);
+	if(FileCache.fail()) {
+		return false;
+	}
+	Entry.ulSizeGreedy = nEndian::fromBig32(ulSizeGreedyBe);
+	Entry.ulSizeOptimal = nEndian::fromBig32(ulSizeOptimalBe);
+	Entry.eCodec = tPakCodec(ubCodec);
+	return true;
+}
+
+static void pakCacheWrite(
+	const std::filesystem::path &CachePath, std::uint32_t ulContentsChecksum,
+	const tPakEntry &Entry
+) {
+	// Write to unique temp file first, so that concurrent writers or partial
+	// writes never leave a broken cache entry under the final name
+	auto TempPath = CachePath;
+	TempPath += fmt::format(".{}.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+	std::ofstream FileCache(TempPath, std::ios::binary);
+	if(FileCache.fail()) {
+		nLog::warn("Can't write cache file {}", TempPath.generic_string());
+		return;
+	}
+
+	std::uint32_t ulSizeGreedyBe = nEndian::toBig32(Entry.ulSizeGreedy);
+	std::uint32_t ulSizeOptimalBe = nEndian::toBig32(Entry.ulSizeOptimal);
+	std::uint8_t ubCodec = std::uint8_t(Entry.eCodec);
+	std::uint32_t ulUncompressedSizeBe = nEndian::toBig32(Entry.ulUncompressedSize);
+	std::uint32_t ulChecksumBe = nEndian::toBig32(ulContentsChecksum);
+	FileCache.write(reinterpret_cast<char*>(&ulSizeGreedyBe), sizeof(ulSizeGreedyBe));
+	FileCache.write(reinterpret_cast<char*>(&ulSizeOptimalBe), sizeof(ulSizeOptimalBe));
+	FileCache.write(reinterpret_cast<char*>(&ubCodec), sizeof(ubCodec));
+	FileCache.write(reinterpret_cast<char*>(&ulUncompressedSizeBe), sizeof(ulUncompressedSizeBe));
+	FileCache.write(reinterpret_cast<char*>(&ulChecksumBe), sizeof(ulChecksumBe));
+	FileCache.write(reinterpret_cast<const char*>(Entry.vData.data()), Entry.vData.size());
+	FileCache.close();
+
+	std::error_code ErrorCode;
+	std::filesystem::rename(TempPath, CachePath, ErrorCode);
+	if(ErrorCode) {
+		std::filesystem::remove(TempPath, ErrorCode);
+	}
+}
+
+static bool pakEntryCompress(
+	const tPakEntry &Entry, const std::vector<std::uint8_t> &vFileContents,
+	const tPakSettings &Settings, bool isOptimal, std::vector<std::uint8_t> &vOut
+) {
+	// If file is larger than restart interval, it's split into blocks which
+	// are packed separately, so that unpacker may start at any of them.
+	std::uint32_t ulSrcSize = Entry.ulUncompressedSize;
+	std::uint32_t ulRestartInterval = 0;
+	std::uint32_t ulBlockSize = ulSrcSize;
+	if(Settings.ulRestartInterval && ulSrcSize > Settings.ulRestartInterval) {
+		ulRestartInterval = Settings.ulRestartInterval;
+		ulBlockSize = ulRestartInterval;
+	}
+
+	// Restart index: interval followed by packed offset of each restart point
+	std::vector<std::uint32_t> vIndex;
+	if(Settings.ulRestartInterval) {
+		vIndex.push_back(nEndian::toBig32(ulRestartInterval));
+	}
+	std::uint32_t ulRestartCount = ulRestartInterval ? (ulSrcSize - 1) / ulRestartInterval : 0;
+	if(ulRestartCount > std::numeric_limits<std::uint16_t>::max()) {
+		nLog::error("{}: too many restart points: {}", Entry.ShortPath, ulRestartCount);
+		return false;
+	}
+	std::uint32_t ulIndexSize = std::uint32_t(sizeof(std::uint32_t) * (vIndex.size() + ulRestartCount));
+	vOut.resize(ulIndexSize + ulSrcSize * 2);
+
+	std::uint32_t ulPackedSize = 0;
+	for(std::uint32_t ulBlockStart = 0; ulBlockStart < ulSrcSize; ulBlockStart += ulBlockSize) {
+		if(ulBlockStart) {
+			vIndex.push_back(nEndian::toBig32(ulPackedSize));
+		}
+		auto ulBlockSrcSize = std::min(ulBlockSize, ulSrcSize - ulBlockStart);
+		auto *pBlockSrc = &vFileContents[ulBlockStart];
+		auto *pBlockDest = &vOut[ulIndexSize + ulPackedSize];
+		auto ulBlockPackedSize = isOptimal ?
+			compressPackOptimal(pBlockSrc, ulBlockSrcSize, pBlockDest) :
+			compressPack(pBlockSrc, ulBlockSrcSize, pBlockDest);
+
+		std::size_t ulMismatchOffset;
+		if(!compressVerify(
+			pBlockDest, ulBlockPackedSize, pBlockSrc, ulBlockSrcSize, &ulMismatchOffset
+		)) {
+			nLog::error("{}: mismatch at index {}", Entry.ShortPath, ulBlockStart + ulMismatchOffset);
+			return false;
+		}
+		ulPackedSize += ulBlockPackedSize;
+	}
+
+	std::copy_n(reinterpret_cast<std::uint8_t*>(vIndex.data()), ulIndexSize, vOut.begin());
+	vOut.resize(ulIndexSize + ulPackedSize);
+	return true;
+}
+
+static bool pakEntryCompressLz4(
+	const tPakEntry &Entry, const std::vector<std::uint8_t> &vFileContents,
+	std::vector<std::uint8_t> &vOut
+) {
+	// Each block: UWORD packed size, followed by its data. Blocks which
+	// don't get smaller are stored raw, marked by size equal to unpacked one.
+	std::uint32_t ulSrcSize = Entry.ulUncompressedSize;
+	std::vector<std::uint8_t> vBlockPacked(compressLz4GetMaxPackedSize(s_Lz4BlockSize));
+	std::vector<std::uint8_t> vBlockUnpacked(s_Lz4BlockSize);
+	vOut.clear();
+	for(std::uint32_t ulBlockStart = 0; ulBlockStart < ulSrcSize; ulBlockStart += s_Lz4BlockSize) {
+		auto ulBlockSrcSize = std::min(s_Lz4BlockSize, ulSrcSize - ulBlockStart);
+		auto *pBlockSrc = &vFileContents[ulBlockStart];
+		auto ulBlockPackedSize = compressLz4Pack(pBlockSrc, ulBlockSrcSize, vBlockPacked.data());
+
+		auto lUnpackedSize = compressLz4Unpack(
+			vBlockPacked.data(), ulBlockPackedSize, vBlockUnpacked.data(), ulBlockSrcSize
+		);
+		if(
+			lUnpackedSize != std::int32_t(ulBlockSrcSize) ||
+			!std::equal(pBlockSrc, pBlockSrc + ulBlockSrcSize, vBlockUnpacked.begin())
+		) {
+			nLog::error("{}: LZ4 mismatch in block at {}", Entry.ShortPath, ulBlockStart);
+			return false;
+		}
+
+		const std::uint8_t *pBlockData = vBlockPacked.data();
+		if(ulBlockPackedSize >= ulBlockSrcSize) {
+			pBlockData = pBlockSrc;
+			ulBlockPackedSize = ulBlockSrcSize;
+		}
+		vOut.push_back(std::uint8_t(ulBlockPackedSize >> 8));
+		vOut.push_back(std::uint8_t(ulBlockPackedSize));
+		vOut.insert(vOut.end(), pBlockData, pBlockData + ulBlockPackedSize);
+	}
+	return true;
+}
+
+static bool pakEntryProcess(tPakEntry &Entry, const tPakSettings &Settings) {
+	std::ifstream FileIn;
+	FileIn.open(Entry.Path, std::ios::binary);
+	if(FileIn.fail()) {
+		nLog::error("Can't open the file {}", Entry.Path);
+		return false;
+	}
+	std::vector<std::uint8_t> vFileContents(Entry.ulUncompressedSize);
+	FileIn.read(reinterpret_cast<char*>(vFileContents.data()), Entry.ulUncompressedSize);
+
+	if(!Settings.isCompressed) {
+		Entry.vData = std::move(vFileContents);
+		return true;
+	}
+
+	std::filesystem::path CachePath;
+	std::uint32_t ulContentsChecksum = 0;
+	if(!Settings.CacheDir.empty()) {
+		CachePath = pakCacheGetPath(Settings, vFileContents);
+		ulContentsChecksum = adler32Buffer(vFileContents.data(), Entry.ulUncompressedSize);
+		if(pakCacheRead(CachePath, ulContentsChecksum, Entry)) {
+			Entry.isCached = true;
+			return true;
+		}
+	}
+
+	std::vector<std::uint8_t> vPackLzss;
+	if(Settings.eCodecPolicy != PAK_CODEC_POLICY_LZ4) {
+		if(!pakEntryCompress(Entry, vFileContents, Settings, false, vPackLzss)) {
+			return false;
+		}
+		if(Settings.isOptimal) {
+			Entry.ulSizeGreedy = std::uint32_t(vPackLzss.size());
+			if(!pakEntryCompress(Entry, vFileContents, Settings, true, vPackLzss)) {
+				return false;
+			}
+			Entry.ulSizeOptimal = std::uint32_t(vPackLzss.size());
+		}
+	}
+
+	std::vector<std::uint8_t> vPackLz4;
+	if(Settings.eCodecPolicy != PAK_CODEC_POLICY_LZSS) {
+		if(!pakEntryCompressLz4(Entry, vFileContents, vPackLz4)) {
+			return false;
+		}
+	}
+
+	// LZ4 decodes much faster, so in auto mode it's preferred unless it's
+	// noticeably bigger than LZSS
+	bool isLz4 = (
+		Settings.eCodecPolicy == PAK_CODEC_POLICY_LZ4 ||
+		(
+			Settings.eCodecPolicy == PAK_CODEC_POLICY_AUTO &&
+			vPackLz4.size() * 100 <= vPackLzss.size() * (100 + Settings.ubLz4MaxGrowth)
+		)
+	);
+	auto &vPackBuffer = isLz4 ? vPackLz4 : vPackLzss;
+	if(vPackBuffer.size() + 10 < vFileContents.size()) {
+		Entry.vData = std::move(vPackBuffer);
+		Entry.eCodec = isLz4 ? PAK_CODEC_LZ4 : PAK_CODEC_LZSS;
+	}
+	else {
+		Entry.vData = std::move(vFileContents);
+	}
+
+	if(!CachePath.empty()) {
+		pakCacheWrite(CachePath, ulContentsChecksum, Entry);
+	}
+	return true;
+}
+
 static void printUsage(const std::string &szAppName) {
 	using fmt::print;
 	print("Usage:\n\t{} inDir outPak [extraOpts]\n\n", szAppName);
@@ -44,7 +375,13 @@ static void printUsage(const std::string &szAppName) {
 	print("\toutPak  Path to output pak file.\n");
 	print("Extra options:\n");
 	print("\t-c                Enable compression.\n");
+	print("\t-c9, --optimal    Enable compression with optimal parsing - slower, but gives smaller files.\n");
+	print("\t-codec name       Compression codec: lzss (best ratio), lz4 (fastest decoding) or auto (default).\n");
+	print("\t-lz4max percent   In auto mode, use lz4 if it's at most given percent bigger than lzss. Defaults to 10.\n");
+	print("\t-rp kib           Add restart point every given KiB of compressed files, allowing fast seeking. Must be multiple of 4.\n");
 	print("\t-r orderfile.txt  Reorder files with list file - one path per line. Omitted files will be appended at the end.\n");
+	print("\t-j threads        Number of threads used for compression. Defaults to CPU core count.\n");
+	print("\t-cache cacheDir   Reuse compressed data of unchanged files stored in given directory.\n");
 }
 
 int main(int lArgCount, const char *pArgs[])
@@ -61,16 +398,85 @@ int main(int lArgCount, const char *pArgs[])
 	std::string InPath(pArgs[1]);
 	std::string OutPath(pArgs[2]);
 	std::string OrderPath;
-	bool isCompressed = false;
+	tPakSettings Settings = {
+		.isCompressed = false, .isOptimal = false,
+		.eCodecPolicy = PAK_CODEC_POLICY_AUTO, .ubLz4MaxGrowth = 10,
+		.ulRestartInterval = 0, .CacheDir = ""
+	};
+	std::uint32_t ulThreadCount = 0;
 
 	for(auto ArgIndex = 3; ArgIndex < lArgCount; ++ArgIndex) {
 		std::string_view Arg = pArgs[ArgIndex];
 		if(Arg == "-c"sv) {
-			isCompressed = true;
+			Settings.isCompressed = true;
+		}
+		else if(Arg == "-c9"sv || Arg == "--optimal"sv) {
+			Settings.isCompressed = true;
+			Settings.isOptimal = true;
+		}
+		else if(Arg == "-codec"sv && ArgIndex + 1 < lArgCount) {
+			std::string_view Codec = pArgs[++ArgIndex];
+			if(Codec == "lzss"sv) {
+				Settings.eCodecPolicy = PAK_CODEC_POLICY_LZSS;
+			}
+			else if(Codec == "lz4"sv) {
+				Settings.eCodecPolicy = PAK_CODEC_POLICY_LZ4;
+			}
+			else if(Codec == "auto"sv) {
+				Settings.eCodecPolicy = PAK_CODEC_POLICY_AUTO;
+			}
+			else {
+				nLog::error("Unknown codec: '{}'", Codec);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(Arg == "-lz4max"sv && ArgIndex + 1 < lArgCount) {
+			std::int32_t lLz4MaxGrowth;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "lz4 max growth", lLz4MaxGrowth)) {
+				printUsage(pArgs[0]);
+				return EXIT_FAILURE;
+			}
+			if(lLz4MaxGrowth < 0 || lLz4MaxGrowth > std::numeric_limits<std::uint8_t>::max()) {
+				nLog::error(
+					"LZ4 max growth must be between 0 and {} percent",
+					std::numeric_limits<std::uint8_t>::max()
+				);
+				return EXIT_FAILURE;
+			}
+			Settings.ubLz4MaxGrowth = std::uint8_t(lLz4MaxGrowth);
+		}
+		else if(Arg == "-rp"sv && ArgIndex + 1 < lArgCount) {
+			std::int32_t lRestartKib;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "restart interval", lRestartKib)) {
+				printUsage(pArgs[0]);
+				return EXIT_FAILURE;
+			}
+			// Check range in KiB, so that conversion to bytes can't overflow
+			constexpr std::int32_t lMaxRestartKib = std::numeric_limits<std::uint32_t>::max() / 1024;
+			if(lRestartKib <= 0 || lRestartKib > lMaxRestartKib) {
+				nLog::error("Restart interval must be between 1 and {} KiB", lMaxRestartKib);
+				return EXIT_FAILURE;
+			}
+			Settings.ulRestartInterval = std::uint32_t(lRestartKib) * 1024;
+			if(Settings.ulRestartInterval % s_RestartAlignment) {
+				nLog::error("Restart interval must be a non-zero multiple of {} KiB", s_RestartAlignment / 1024);
+				return EXIT_FAILURE;
+			}
 		}
 		else if(Arg == "-r"sv && ArgIndex + 1 < lArgCount) {
 			OrderPath = pArgs[++ArgIndex];
 		}
+		else if(Arg == "-j"sv && ArgIndex + 1 < lArgCount) {
+			std::int32_t lThreadCount;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "thread count", lThreadCount)) {
+				printUsage(pArgs[0]);
+				return EXIT_FAILURE;
+			}
+			ulThreadCount = std::uint32_t(std::max(lThreadCount, 1));
+		}
+		else if(Arg == "-cache"sv && ArgIndex + 1 < lArgCount) {
+			Settings.CacheDir = pArgs[++ArgIndex];
+		}
 		else {
 			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
 			printUsage(pArgs[0]);
@@ -83,6 +489,15 @@ int main(int lArgCount, const char *pArgs[])
 		return EXIT_FAILURE;
 	}
 
+	if(!Settings.CacheDir.empty()) {
+		std::error_code ErrorCode;
+		std::filesystem::create_directories(Settings.CacheDir, ErrorCode);
+		if(!nFs::isDir(Settings.CacheDir)) {
+			nLog::error("Can't create cache directory {}", Settings.CacheDir);
+			return EXIT_FAILURE;
+		}
+	}
+
 	std::ofstream FilePak;
 	FilePak.open(OutPath, std::ios::binary);
 	if(FilePak.fail()) {
@@ -93,15 +508,16 @@ int main(int lArgCount, const char *pArgs[])
 
 	auto AbsoluteBasePath = std::filesystem::absolute(InPath);
 	bool isCollided = false;
-	std::vector<std::uint8_t> vFileContents;
-	std::vector<std::uint8_t> vPackBuffer;
-	std::vector<std::uint8_t> vDecompressed;
   for (std::filesystem::recursive_directory_iterator i(InPath), end; i != end; ++i) {
     if (!is_directory(i->path())) {
 			tPakEntry Entry;
 			Entry.ShortPath = std::filesystem::relative(i->path(), AbsoluteBasePath).generic_string();
 			Entry.Path = i->path().generic_string();
 			Entry.ulUncompressedSize = std::uint32_t(std::filesystem::file_size(Entry.Path));
+			Entry.ulSizeGreedy = 0;
+			Entry.ulSizeOptimal = 0;
+			Entry.eCodec = PAK_CODEC_NONE;
+			Entry.isCached = false;
 			Entry.ulChecksum = adler32Buffer(
 				reinterpret_cast<const std::uint8_t*>(Entry.ShortPath.c_str()),
 				std::uint32_t(Entry.ShortPath.size())
@@ -113,59 +529,65 @@ int main(int lArgCount, const char *pArgs[])
 				}
 			}
 
-			std::ifstream FileIn;
-			FileIn.open(Entry.Path, std::ios::binary);
-			if(FileIn.fail()) {
-				nLog::error("Can't open the file");
-				return EXIT_FAILURE;
-			}
-			vFileContents.resize(Entry.ulUncompressedSize);
-			FileIn.read(reinterpret_cast<char*>(vFileContents.data()), Entry.ulUncompressedSize);
-
-			if(isCompressed) {
-				if(vPackBuffer.size() < Entry.ulUncompressedSize * 2) {
-					vPackBuffer.resize(Entry.ulUncompressedSize * 2);
-				}
-				auto CompressedSize = (std::uint32_t)compressPack(
-					vFileContents.data(), Entry.ulUncompressedSize, vPackBuffer.data()
-				);
-
-				vDecompressed.resize(Entry.ulUncompressedSize);
-				tCompressUnpacker UnpackState;
-				compressUnpackerInit(&UnpackState, vPackBuffer.data(), CompressedSize, Entry.ulUncompressedSize);
-				while(true) {
-					std::uint8_t ubRead;
-					tCompressUnpackResult eResult = compressUnpackerProcess(&UnpackState, &ubRead);
-					if(eResult == COMPRESS_UNPACK_RESULT_DONE) {
-						break;
-					}
-					if(eResult == COMPRESS_UNPACK_RESULT_BUSY_WROTE_BYTE) {
-						vDecompressed[UnpackState.ulWriteOffset - 1] = ubRead;
-					}
-				}
-
-				for(std::size_t i = 0; i < Entry.ulUncompressedSize; ++i) {
-					if(vDecompressed[i] != vFileContents[i]) {
-						nLog::error("mismatch at index {}", i);
-						return EXIT_FAILURE;
-					}
-				}
+			vEntries.push_back(Entry);
+		}
+	}
 
-				if(CompressedSize < vFileContents.size() - 10) {
-					Entry.vData = std::vector(&vPackBuffer[0], &vPackBuffer[CompressedSize]);
-				}
-				else {
-					Entry.vData = vFileContents;
+	// Entries are independent, so process them on all available threads.
+	// Only writing the pak needs to be done in order, after that.
+	if(!ulThreadCount) {
+		ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	ulThreadCount = std::min<std::uint32_t>(ulThreadCount, std::max<std::size_t>(1, vEntries.size()));
+	std::atomic<std::size_t> NextEntryIndex = 0;
+	std::atomic<bool> isFailed = false;
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t ulThread = 0; ulThread < ulThreadCount; ++ulThread) {
+		vThreads.emplace_back([&]() {
+			std::size_t EntryIndex;
+			while(!isFailed && (EntryIndex = NextEntryIndex++) < vEntries.size()) {
+				if(!pakEntryProcess(vEntries[EntryIndex], Settings)) {
+					isFailed = true;
 				}
 			}
-			else {
-				Entry.vData = vFileContents;
-			}
+		});
+	}
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	if(isFailed) {
+		return EXIT_FAILURE;
+	}
 
-			vEntries.push_back(Entry);
+	std::uint64_t ullSizeGreedy = 0, ullSizeOptimal = 0;
+	std::size_t CachedCount = 0;
+	std::size_t pCodecCounts[PAK_CODEC_LZ4 + 1] = {0};
+	for(const auto &Entry: vEntries) {
+		++pCodecCounts[Entry.eCodec];
+		if(Entry.ulSizeGreedy) {
+			ullSizeGreedy += Entry.ulSizeGreedy;
+			ullSizeOptimal += Entry.ulSizeOptimal;
+		}
+		if(Entry.isCached) {
+			++CachedCount;
 		}
 	}
 	fmt::print("Discovered {} files\n", vEntries.size());
+	if(!Settings.CacheDir.empty()) {
+		fmt::print("Reused {} cached files\n", CachedCount);
+	}
+	if(Settings.isCompressed) {
+		fmt::print(
+			"Codecs used: none: {}, lzss: {}, lz4: {}\n",
+			pCodecCounts[PAK_CODEC_NONE], pCodecCounts[PAK_CODEC_LZSS], pCodecCounts[PAK_CODEC_LZ4]
+		);
+	}
+	if(Settings.isOptimal && ullSizeGreedy) {
+		fmt::print(
+			"Optimal parse: {} bytes, greedy: {} bytes, ratio vs greedy: {:.2f}\n",
+			ullSizeOptimal, ullSizeGreedy, float(ullSizeOptimal) / ullSizeGreedy * 100
+		);
+	}
 	if(isCollided) {
 		nLog::error("Aborting due to checksum collisions! Report an issue and/or change your file names a bit.");
 		return EXIT_FAILURE;
@@ -203,33 +625,62 @@ int main(int lArgCount, const char *pArgs[])
 		vEntries = vOrderedEntries;
 	}
 
+	if(vEntries.size() > std::numeric_limits<std::uint16_t>::max()) {
+		nLog::error("Too many files: {}", vEntries.size());
+		return EXIT_FAILURE;
+	}
+
+	// Header: zero marks versioned header, followed by version, flags & file count
 	std::uint16_t uwFileCount = std::uint16_t(vEntries.size());
-	std::uint16_t uwFileCountBe = nEndian::toBig16(uwFileCount);
-	FilePak.write(reinterpret_cast<char*>(&uwFileCountBe), sizeof(uwFileCountBe));
-	std::uint32_t ulNextFileOffs = sizeof(uwFileCount) + (uwFileCount * 4 * sizeof(std::uint32_t));
+	std::uint16_t uwFlags = s_PakFlagSorted;
+	if(Settings.isCompressed && Settings.ulRestartInterval) {
+		uwFlags |= s_PakFlagRestartPoints;
+	}
+	std::uint16_t pHeaderBe[] = {
+		0, nEndian::toBig16(s_PakVersion), nEndian::toBig16(uwFlags),
+		nEndian::toBig16(uwFileCount)
+	};
+	FilePak.write(reinterpret_cast<char*>(pHeaderBe), sizeof(pHeaderBe));
+
+	// Data is stored in discovery/reorder order
+	std::uint32_t ulNextFileOffs = sizeof(pHeaderBe) + (uwFileCount * s_PakEntrySize);
 	std::uint16_t i = 0;
-	for(const auto &Entry: vEntries) {
+	for(auto &Entry: vEntries) {
+		Entry.ulOffset = ulNextFileOffs;
 		fmt::print(
-			"Writing subfile {:4d}: '{}', offset: {}, uncompressed: {}, size: {}, ratio: {:.2f}, checksum: {:08X}...\n",
+			"Writing subfile {:4d}: '{}', offset: {}, uncompressed: {}, size: {}, ratio: {:.2f}, codec: {}, checksum: {:08X}...\n",
 			i++, Entry.ShortPath, ulNextFileOffs, Entry.ulUncompressedSize,
-			Entry.vData.size(), float(Entry.vData.size()) / Entry.ulUncompressedSize * 100, Entry.ulChecksum
+			Entry.vData.size(), float(Entry.vData.size()) / Entry.ulUncompressedSize * 100,
+			pakCodecGetName(Entry.eCodec), Entry.ulChecksum
 		);
+		ulNextFileOffs += std::uint32_t(Entry.vData.size());
+	}
 
-		std::uint32_t ulChecksumBe = nEndian::toBig32(Entry.ulChecksum);
-		std::uint32_t ulOffsBe = nEndian::toBig32(ulNextFileOffs);
-		std::uint32_t ulUncompressedSizeBe = nEndian::toBig32(Entry.ulUncompressedSize);
-		std::uint32_t ulDataSizeBe = nEndian::toBig32(std::uint32_t(Entry.vData.size()));
+	// Entry table is sorted by checksum so that the engine can binary search it
+	std::vector<const tPakEntry*> vSortedEntries;
+	for(const auto &Entry: vEntries) {
+		vSortedEntries.push_back(&Entry);
+	}
+	std::sort(
+		vSortedEntries.begin(), vSortedEntries.end(),
+		[](const tPakEntry *pA, const tPakEntry *pB) { return pA->ulChecksum < pB->ulChecksum; }
+	);
+	for(const auto *pEntry: vSortedEntries) {
+		std::uint32_t ulChecksumBe = nEndian::toBig32(pEntry->ulChecksum);
+		std::uint32_t ulOffsBe = nEndian::toBig32(pEntry->ulOffset);
+		std::uint32_t ulUncompressedSizeBe = nEndian::toBig32(pEntry->ulUncompressedSize);
+		std::uint32_t ulDataSizeBe = nEndian::toBig32(std::uint32_t(pEntry->vData.size()));
 
 		FilePak.write(reinterpret_cast<char*>(&ulChecksumBe), sizeof(ulChecksumBe));
 		FilePak.write(reinterpret_cast<char*>(&ulOffsBe), sizeof(ulOffsBe));
 		FilePak.write(reinterpret_cast<const char*>(&ulUncompressedSizeBe), sizeof(ulUncompressedSizeBe));
 		FilePak.write(reinterpret_cast<char*>(&ulDataSizeBe), sizeof(ulDataSizeBe));
-
-		ulNextFileOffs += std::uint32_t(Entry.vData.size());
+		std::uint8_t pCodec[] = {pEntry->eCodec, 0, 0, 0};
+		FilePak.write(reinterpret_cast<char*>(pCodec), sizeof(pCodec));
 	}
 
 	for(const auto &Entry: vEntries) {
-		std::uint32_t UncompressedSizeBe = isCompressed ? nEndian::toBig32(Entry.ulUncompressedSize) : 0;
+		std::uint32_t UncompressedSizeBe = Settings.isCompressed ? nEndian::toBig32(Entry.ulUncompressedSize) : 0;
 		FilePak.write(reinterpret_cast<const char *>(Entry.vData.data()), Entry.vData.size());
 	}
 
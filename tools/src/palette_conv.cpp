@@ -2,10 +2,16 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 #include "common/logging.h"
 #include "common/fs.h"
 #include "common/palette.h"
 #include "common/bitmap.h"
+#include "common/parse.h"
+#include "common/quantize.h"
 
 void printUsage(const std::string &szAppName) {
 	using fmt::print;
@@ -18,6 +24,167 @@ void printUsage(const std::string &szAppName) {
 	print("\tpal\tProMotion palette\n");
 	print("\tplt\tACE palette (default)\n");
 	print("\tpng\tPalette preview\n");
+	print("\nShared palette generation:\n");
+	print(
+		"\t{} -g outPath.ext colorCount inPath1.png [inPath2.png ...] [-ehb] [-mc #RRGGBB]\n"
+		"\t\t[-ro outDir] [-d none|ordered|fs] [-j threadCount]\n", szAppName
+	);
+	print("\noutPath\t\t- path to generated 12-bit palette, format deduced from ext\n");
+	print("colorCount\t- max number of palette colors, at most 32 for EHB\n");
+	print("inPathN\t\t- images which should share the palette\n");
+	print("-ehb\t\t- generate EHB base colors, remap images with half-bright ones too\n");
+	print("-mc\t\t- mask color, excluded from palette and left as-is in images\n");
+	print("-ro\t\t- directory for remapped images. Default: next to inputs, with _remap suffix\n");
+	print("-d\t\t- dithering used for remapped images. Default: none\n");
+	print("-j\t\t- number of threads. Default: number of CPU cores\n");
+}
+
+static std::string getRemapPath(
+	const std::string &szPathIn, const std::string &szDirOut
+)
+{
+	if(szDirOut.empty()) {
+		return nFs::removeExt(szPathIn) + "_remap.png";
+	}
+	auto szName = nFs::getBaseName(szPathIn);
+	if(!szName.empty() && (szName[0] == '/' || szName[0] == '\\')) {
+		szName = szName.substr(1);
+	}
+	return szDirOut + "/" + szName;
+}
+
+static int generatePalette(int lArgCount, const char *pArgs[])
+{
+	if(lArgCount - 1 < 4) {
+		nLog::error("Too few arguments for palette generation");
+		printUsage(pArgs[0]);
+		return EXIT_FAILURE;
+	}
+
+	std::string szPathOut = pArgs[2];
+	std::int32_t lColorCount;
+	if(!nParse::toInt32(pArgs[3], "colorCount", lColorCount)) {
+		return EXIT_FAILURE;
+	}
+
+	std::vector<std::string> vPathsIn;
+	bool isEhb = false;
+	std::optional<tRgb> MaskColor;
+	std::string szDirOut;
+	auto eDither = QUANTIZE_DITHER_NONE;
+	std::uint32_t ulThreadCount = std::max(1u, std::thread::hardware_concurrency());
+	for(auto ArgIndex = 4; ArgIndex < lArgCount; ++ArgIndex) {
+		if(pArgs[ArgIndex] == std::string("-ehb")) {
+			isEhb = true;
+		}
+		else if(pArgs[ArgIndex] == std::string("-mc") && ArgIndex < lArgCount - 1) {
+			MaskColor = tRgb(pArgs[++ArgIndex]);
+		}
+		else if(pArgs[ArgIndex] == std::string("-ro") && ArgIndex < lArgCount - 1) {
+			szDirOut = pArgs[++ArgIndex];
+		}
+		else if(pArgs[ArgIndex] == std::string("-d") && ArgIndex < lArgCount - 1) {
+			if(!quantizeParseDither(pArgs[++ArgIndex], eDither)) {
+				nLog::error("Unknown dithering method: '{}'", pArgs[ArgIndex]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if(pArgs[ArgIndex] == std::string("-j") && ArgIndex < lArgCount - 1) {
+			std::int32_t lThreadCount;
+			if(!nParse::toInt32(pArgs[++ArgIndex], "thread count", lThreadCount)) {
+				return EXIT_FAILURE;
+			}
+			ulThreadCount = std::uint32_t(std::max(lThreadCount, 1));
+		}
+		else if(pArgs[ArgIndex][0] == '-') {
+			nLog::error("Unknown arg or missing value: '{}'", pArgs[ArgIndex]);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+		else {
+			vPathsIn.push_back(pArgs[ArgIndex]);
+		}
+	}
+
+	if(lColorCount < 1 || lColorCount > (isEhb ? 32 : 256)) {
+		nLog::error("Color count must be in range 1..{}", isEhb ? 32 : 256);
+		return EXIT_FAILURE;
+	}
+	if(vPathsIn.empty()) {
+		nLog::error("No input images given");
+		return EXIT_FAILURE;
+	}
+
+	// Load all images concurrently
+	std::vector<tChunkyBitmap> vBitmaps(vPathsIn.size());
+	std::atomic<std::size_t> NextImage = 0;
+	std::atomic<bool> isLoadOk = true;
+	auto Loader = [&]() {
+		for(auto i = NextImage++; i < vPathsIn.size(); i = NextImage++) {
+			vBitmaps[i] = tChunkyBitmap::fromPng(vPathsIn[i]);
+			if(!vBitmaps[i].m_uwWidth) {
+				nLog::error("Couldn't read image '{}'", vPathsIn[i]);
+				isLoadOk = false;
+			}
+		}
+	};
+	auto ulWorkerCount = std::min(ulThreadCount, std::uint32_t(vPathsIn.size()));
+	std::vector<std::thread> vThreads;
+	for(std::uint32_t i = 1; i < ulWorkerCount; ++i) {
+		vThreads.emplace_back(Loader);
+	}
+	Loader();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	if(!isLoadOk) {
+		return EXIT_FAILURE;
+	}
+	fmt::print("Loaded {} images\n", vBitmaps.size());
+
+	// OCS can't display anything above 12-bit, so optimize for it directly
+	auto Palette = quantizeGeneratePalette(
+		vBitmaps, std::uint16_t(lColorCount), isEhb, true, MaskColor, ulThreadCount
+	);
+	if(!Palette.toFile(szPathOut)) {
+		nLog::error("Couldn't write palette to '{}'", szPathOut);
+		return EXIT_FAILURE;
+	}
+	fmt::print(
+		"Generated palette with {} colors: '{}'\n", Palette.m_vColors.size(), szPathOut
+	);
+
+	if(isEhb) {
+		Palette.convertToEhb();
+	}
+
+	// Remap images in parallel, single thread each
+	NextImage = 0;
+	std::atomic<bool> isRemapOk = true;
+	auto Remapper = [&]() {
+		for(auto i = NextImage++; i < vBitmaps.size(); i = NextImage++) {
+			auto Remapped = quantizeRemap(vBitmaps[i], Palette, eDither, MaskColor, 1);
+			auto szPathRemap = getRemapPath(vPathsIn[i], szDirOut);
+			if(!Remapped.toPng(szPathRemap)) {
+				nLog::error("Couldn't write remapped image to '{}'", szPathRemap);
+				isRemapOk = false;
+			}
+		}
+	};
+	vThreads.clear();
+	for(std::uint32_t i = 1; i < ulWorkerCount; ++i) {
+		vThreads.emplace_back(Remapper);
+	}
+	Remapper();
+	for(auto &Thread: vThreads) {
+		Thread.join();
+	}
+	if(!isRemapOk) {
+		return EXIT_FAILURE;
+	}
+	fmt::print("Remapped {} images\n", vBitmaps.size());
+
+	return EXIT_SUCCESS;
 }
 
 int main(int lArgCount, const char *pArgs[])
@@ -30,6 +197,10 @@ int main(int lArgCount, const char *pArgs[])
 		return EXIT_FAILURE;
 	}
 
+	if(pArgs[1] == std::string("-g")) {
+		return generatePalette(lArgCount, pArgs);
+	}
+
 	std::string szPathIn = pArgs[1];
 
 	// Optional args' default values
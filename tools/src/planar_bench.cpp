@@ -0,0 +1,131 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include <chrono>
+#include <vector>
+#include <string_view>
+#include "common/logging.h"
+#include "common/parse.h"
+#include "common/planar.h"
+
+static void printUsage(const std::string &szAppName) {
+	using fmt::print;
+	print("Usage:\n\t{} [extraOpts]\n\n", szAppName);
+	print("Extra options:\n");
+	print("\t-px count  Number of pixels converted per pass, rounded to multiple of 16. Default: 4194304.\n");
+	print("\t-n count   Number of passes per measurement. Default: 10.\n");
+}
+
+struct tBenchPlanes {
+	std::vector<std::uint16_t> vPlanes[8];
+	std::uint16_t *pPlanes[8];
+
+	tBenchPlanes(std::uint32_t ulPixelCount) {
+		for(std::uint8_t i = 0; i < 8; ++i) {
+			vPlanes[i].resize(ulPixelCount / 16);
+			pPlanes[i] = vPlanes[i].data();
+		}
+	}
+};
+
+template<typename t_tFn>
+static double benchMpixels(std::uint32_t ulPixelCount, std::uint32_t ulPasses, t_tFn &&Fn) {
+	auto TimeStart = std::chrono::steady_clock::now();
+	for(std::uint32_t i = 0; i < ulPasses; ++i) {
+		Fn();
+	}
+	auto TimeEnd = std::chrono::steady_clock::now();
+	double fSeconds = std::chrono::duration<double>(TimeEnd - TimeStart).count();
+	return (double(ulPixelCount) * ulPasses / 1000000.0) / fSeconds;
+}
+
+int main(int lArgCount, const char *pArgs[])
+{
+	using namespace std::string_view_literals;
+
+	std::int32_t lPixelCount = 4 * 1024 * 1024;
+	std::int32_t lPasses = 10;
+	for(auto ArgIndex = 1; ArgIndex < lArgCount; ++ArgIndex) {
+		std::string_view Arg = pArgs[ArgIndex];
+		if(Arg == "-px"sv && ArgIndex + 1 < lArgCount) {
+			if(!nParse::toInt32(pArgs[++ArgIndex], "px", lPixelCount)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else if(Arg == "-n"sv && ArgIndex + 1 < lArgCount) {
+			if(!nParse::toInt32(pArgs[++ArgIndex], "n", lPasses)) {
+				return EXIT_FAILURE;
+			}
+		}
+		else {
+			nLog::error("Unknown arg: '{}'", Arg);
+			printUsage(pArgs[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if(lPixelCount < 16 || lPasses <= 0) {
+		nLog::error("Pixel count must be at least 16 and pass count must be positive");
+		return EXIT_FAILURE;
+	}
+	std::uint32_t ulPixelCount = std::uint32_t(lPixelCount) & ~15u;
+	std::uint32_t ulPasses = std::uint32_t(lPasses);
+
+	// Fixed LCG so that results are comparable between runs
+	std::vector<std::uint8_t> vIndices(ulPixelCount), vIndicesOut(ulPixelCount);
+	std::uint32_t ulSeed = 0xACE;
+	for(auto &ubIndex: vIndices) {
+		ulSeed = ulSeed * 1664525u + 1013904223u;
+		ubIndex = std::uint8_t(ulSeed >> 24);
+	}
+
+	tBenchPlanes Reference(ulPixelCount), Planes(ulPixelCount);
+	fmt::print("Pixels per pass: {}, passes: {}\n", ulPixelCount, ulPasses);
+	fmt::print("{:>8} {:>6} {:>18} {:>18}\n", "kernel", "planes", "to planar Mpx/s", "to chunky Mpx/s");
+	for(auto eKernel: {PLANAR_KERNEL_SCALAR, PLANAR_KERNEL_SSE2, PLANAR_KERNEL_AVX2}) {
+		if(!planarIsKernelSupported(eKernel)) {
+			fmt::print("{:>8} not supported\n", planarGetKernelName(eKernel));
+			continue;
+		}
+		for(std::uint8_t ubDepth = 1; ubDepth <= 8; ++ubDepth) {
+			double fToPlanar = benchMpixels(ulPixelCount, ulPasses, [&]() {
+				planarFromChunky(vIndices.data(), ulPixelCount, ubDepth, Planes.pPlanes, eKernel);
+			});
+			double fToChunky = benchMpixels(ulPixelCount, ulPasses, [&]() {
+				planarToChunky(Planes.pPlanes, ubDepth, ulPixelCount, vIndicesOut.data(), eKernel);
+			});
+
+			// Verify against scalar kernel
+			planarFromChunky(
+				vIndices.data(), ulPixelCount, ubDepth, Reference.pPlanes,
+				PLANAR_KERNEL_SCALAR
+			);
+			std::uint8_t ubMask = std::uint8_t((1 << ubDepth) - 1);
+			for(std::uint8_t ubPlane = 0; ubPlane < ubDepth; ++ubPlane) {
+				if(Planes.vPlanes[ubPlane] != Reference.vPlanes[ubPlane]) {
+					nLog::error(
+						"{} planar output mismatch at plane {}",
+						planarGetKernelName(eKernel), ubPlane
+					);
+					return EXIT_FAILURE;
+				}
+			}
+			for(std::uint32_t i = 0; i < ulPixelCount; ++i) {
+				if(vIndicesOut[i] != (vIndices[i] & ubMask)) {
+					nLog::error(
+						"{} chunky output mismatch at pixel {}",
+						planarGetKernelName(eKernel), i
+					);
+					return EXIT_FAILURE;
+				}
+			}
+
+			fmt::print(
+				"{:>8} {:>6} {:>18.1f} {:>18.1f}\n", planarGetKernelName(eKernel),
+				ubDepth, fToPlanar, fToChunky
+			);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
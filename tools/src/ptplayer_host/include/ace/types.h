@@ -0,0 +1,39 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TYPES_H_
+#define _ACE_TYPES_H_
+
+// Host replacement of ACE's types.h, used for building ptplayer in tools.
+
+#include <stdint.h>
+
+typedef uint8_t  UBYTE;
+typedef uint16_t UWORD;
+typedef uint32_t ULONG;
+
+typedef int8_t  BYTE;
+typedef int16_t WORD;
+typedef int32_t LONG;
+
+#define UWORD_MAX 0xFFFFu
+#define UBYTE_MAX 0xFFu
+
+#define INTERRUPT
+#define INTERRUPT_END do {} while(0)
+#define HWINTERRUPT
+#define REGARG(arg, reg) arg
+#define CHIP
+#define FAR
+#define FN_HOTSPOT
+#define FN_COLDSPOT
+#define BITFIELD_STRUCT struct
+
+#if defined(__GNUC__)
+#define UNUSED_ARG __attribute__((unused))
+#else
+#define UNUSED_ARG
+#endif
+
+#endif // _ACE_TYPES_H_
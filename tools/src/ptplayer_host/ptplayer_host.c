@@ -0,0 +1,362 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "ptplayer_host.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Paula's clock, CIA ticks once every 5 of its cycles
+#define CLOCK_PAL 3546895.0
+#define CLOCK_NTSC 3579545.0
+#define CIA_CLOCK_DIVIDER 5
+// Paula can't fetch samples faster than that
+#define PAULA_MIN_PERIOD 124
+#define INT_COUNT 16
+
+typedef struct _tHostChannel {
+	const BYTE *pData; ///< Next sample to be played.
+	ULONG ulBytesLeft; ///< Bytes left in current buffer.
+	double dClocksLeft; ///< Clocks left until next sample.
+	BYTE bValue; ///< Currently played sample.
+} tHostChannel;
+
+typedef struct _tHostTimer {
+	UWORD uwLatch;
+	UBYTE isRunning;
+	UBYTE isOneShot;
+	double dNext; ///< Clock of next underflow.
+	tAceIntHandler cbHandler;
+	void *pData;
+} tHostTimer;
+
+struct _tFile {
+	FILE *pHandle;
+};
+
+static tCustom s_sCustom;
+static tCia s_pCias[CIA_COUNT];
+volatile tCustom *const g_pCustom = &s_sCustom;
+tCia *const g_pCia[CIA_COUNT] = {&s_pCias[CIA_A], &s_pCias[CIA_B]};
+
+static tHostChannel s_pChannels[4];
+static tHostTimer s_pTimers[2]; ///< CIA-B Timers A & B.
+static tAceIntHandler s_pIntHandlers[INT_COUNT];
+static void *s_pIntData[INT_COUNT];
+static double s_dClock;
+static double s_dNow; ///< Current clock, for scheduling timers.
+static double s_dClocksPerFrame;
+static tPtplayerHostCbTick s_cbTick;
+static tPtplayerHostTick s_sTick;
+static UBYTE s_isTickStarted;
+static UBYTE s_isLogging;
+
+//------------------------------------------------------------------ PRIVATE
+
+static void callHandler(tAceIntHandler cbHandler, void *pData) {
+	struct AudChannel pBefore[4];
+	memcpy(pBefore, (const void*)s_sCustom.aud, sizeof(pBefore));
+	s_sCustom.intreq = 0;
+
+	++s_sTick.ubInterrupts;
+	cbHandler(g_pCustom, pData);
+
+	// Apply intreq write, if any
+	UWORD uwIntReq = s_sCustom.intreq;
+	if(uwIntReq & INTF_SETCLR) {
+		s_sCustom.intreqr |= uwIntReq & ~INTF_SETCLR;
+	}
+	else {
+		s_sCustom.intreqr &= ~uwIntReq;
+	}
+
+	for(UBYTE i = 0; i < 4; ++i) {
+		const struct AudChannel *pAfter = &s_sCustom.aud[i];
+		s_sTick.ubRegisterChanges += (
+			(pBefore[i].ac_ptr != pAfter->ac_ptr) + (pBefore[i].ac_len != pAfter->ac_len) +
+			(pBefore[i].ac_per != pAfter->ac_per) + (pBefore[i].ac_vol != pAfter->ac_vol)
+		);
+	}
+}
+
+static void channelReload(UBYTE ubChannel) {
+	// Paula latches next buffer and signals that registers may be changed
+	tHostChannel *pChannel = &s_pChannels[ubChannel];
+	const struct AudChannel *pRegs = &s_sCustom.aud[ubChannel];
+	pChannel->pData = (const BYTE*)pRegs->ac_ptr;
+	pChannel->ulBytesLeft = (pRegs->ac_len ? pRegs->ac_len : 0x10000) * sizeof(UWORD);
+	s_sCustom.intreqr |= INTF_AUD0 << ubChannel;
+	if(s_pIntHandlers[INTB_AUD0 + ubChannel]) {
+		callHandler(s_pIntHandlers[INTB_AUD0 + ubChannel], s_pIntData[INTB_AUD0 + ubChannel]);
+	}
+}
+
+static float channelMix(UBYTE ubChannel, double dClocks) {
+	tHostChannel *pChannel = &s_pChannels[ubChannel];
+	if(!(s_sCustom.dmaconr & (DMAF_AUD0 << ubChannel))) {
+		return 0;
+	}
+
+	// Integrate channel output over the frame's duration
+	double dSum = 0;
+	while(pChannel->dClocksLeft <= dClocks) {
+		dSum += pChannel->bValue * pChannel->dClocksLeft;
+		dClocks -= pChannel->dClocksLeft;
+		if(!pChannel->ulBytesLeft) {
+			channelReload(ubChannel);
+		}
+		pChannel->bValue = pChannel->pData ? *(pChannel->pData++) : 0;
+		--pChannel->ulBytesLeft;
+		pChannel->dClocksLeft = MAX(s_sCustom.aud[ubChannel].ac_per, PAULA_MIN_PERIOD);
+	}
+	dSum += pChannel->bValue * dClocks;
+	pChannel->dClocksLeft -= dClocks;
+	return (float)dSum * MIN(s_sCustom.aud[ubChannel].ac_vol, 64);
+}
+
+static void finishTick(void) {
+	if(s_isTickStarted && s_cbTick) {
+		s_cbTick(&s_sTick);
+	}
+}
+
+static void timerUnderflow(UBYTE ubTimer) {
+	tHostTimer *pTimer = &s_pTimers[ubTimer];
+	s_dNow = pTimer->dNext;
+	if(pTimer->isOneShot) {
+		pTimer->isRunning = 0;
+	}
+	else {
+		pTimer->dNext += MAX(pTimer->uwLatch, 1) * CIA_CLOCK_DIVIDER;
+	}
+
+	if(ubTimer == CIAICRB_TIMER_A && pTimer->cbHandler) {
+		finishTick();
+		ULONG ulIndex = s_isTickStarted ? s_sTick.ulIndex + 1 : 0;
+		memset(&s_sTick, 0, sizeof(s_sTick));
+		s_sTick.ulIndex = ulIndex;
+		s_sTick.dTime = s_dNow / s_dClock;
+		s_isTickStarted = 1;
+	}
+	if(pTimer->cbHandler) {
+		callHandler(pTimer->cbHandler, pTimer->pData);
+	}
+}
+
+//------------------------------------------------------------------- PUBLIC
+
+void ptplayerHostCreate(UBYTE isPal, ULONG ulOutputRate, tPtplayerHostCbTick cbTick) {
+	memset(&s_sCustom, 0, sizeof(s_sCustom));
+	memset(s_pCias, 0, sizeof(s_pCias));
+	memset(s_pChannels, 0, sizeof(s_pChannels));
+	memset(s_pTimers, 0, sizeof(s_pTimers));
+	memset(s_pIntHandlers, 0, sizeof(s_pIntHandlers));
+	s_dClock = isPal ? CLOCK_PAL : CLOCK_NTSC;
+	s_dClocksPerFrame = s_dClock / ulOutputRate;
+	s_dNow = 0;
+	s_cbTick = cbTick;
+	s_isTickStarted = 0;
+}
+
+void ptplayerHostDestroy(void) {
+	finishTick();
+	s_isTickStarted = 0;
+}
+
+void ptplayerHostRender(float *pOut, ULONG ulFrameCount) {
+	// Two channels per side, each up to 128 * 64
+	static const float fScale = 1.0f / (2 * 128 * 64);
+	double dFrameStart = s_dNow;
+	for(ULONG ulFrame = 0; ulFrame < ulFrameCount; ++ulFrame) {
+		double dFrameEnd = dFrameStart + s_dClocksPerFrame;
+		for(;;) {
+			// Handle due timers in order of their underflows
+			UBYTE ubNext = 0xFF;
+			for(UBYTE i = 0; i < 2; ++i) {
+				if(
+					s_pTimers[i].isRunning && s_pTimers[i].dNext < dFrameEnd &&
+					(ubNext == 0xFF || s_pTimers[i].dNext < s_pTimers[ubNext].dNext)
+				) {
+					ubNext = i;
+				}
+			}
+			if(ubNext == 0xFF) {
+				break;
+			}
+			timerUnderflow(ubNext);
+		}
+
+		float fNorm = fScale / (float)s_dClocksPerFrame;
+		*(pOut++) = (channelMix(0, s_dClocksPerFrame) + channelMix(3, s_dClocksPerFrame)) * fNorm;
+		*(pOut++) = (channelMix(1, s_dClocksPerFrame) + channelMix(2, s_dClocksPerFrame)) * fNorm;
+		dFrameStart = dFrameEnd;
+		s_dNow = dFrameStart;
+	}
+}
+
+void ptplayerHostSetLogging(UBYTE isEnabled) {
+	s_isLogging = isEnabled;
+}
+
+void systemUse(void) {
+}
+
+void systemUnuse(void) {
+}
+
+void systemSetInt(UBYTE ubIntNumber, tAceIntHandler pHandler, void *pIntData) {
+	s_pIntHandlers[ubIntNumber] = pHandler;
+	s_pIntData[ubIntNumber] = pIntData;
+}
+
+void systemSetCiaInt(
+	UBYTE ubCia, UBYTE ubIntBit, tAceIntHandler cbHandler, void *pIntData
+) {
+	if(ubCia == CIA_B && ubIntBit <= CIAICRB_TIMER_B) {
+		s_pTimers[ubIntBit].cbHandler = cbHandler;
+		s_pTimers[ubIntBit].pData = pIntData;
+	}
+}
+
+void systemSetCiaCr(UBYTE ubCia, UBYTE isCrB, UBYTE ubCrValue) {
+	if(ubCia != CIA_B) {
+		return;
+	}
+	tHostTimer *pTimer = &s_pTimers[isCrB];
+	pTimer->isOneShot = (ubCrValue & CIACRB_RUNMODE) != 0;
+	if(ubCrValue & CIACRB_START) {
+		pTimer->isRunning = 1;
+		pTimer->dNext = s_dNow + MAX(pTimer->uwLatch, 1) * CIA_CLOCK_DIVIDER;
+	}
+	else {
+		pTimer->isRunning = 0;
+	}
+}
+
+void systemSetDmaMask(UWORD uwDmaMask, UBYTE isEnabled) {
+	for(UBYTE i = 0; i < 4; ++i) {
+		UWORD uwFlag = DMAF_AUD0 << i;
+		if(!(uwDmaMask & uwFlag)) {
+			continue;
+		}
+		UBYTE isOn = (s_sCustom.dmaconr & uwFlag) != 0;
+		if(isEnabled && !isOn) {
+			s_sCustom.dmaconr |= uwFlag;
+			s_pChannels[i].ulBytesLeft = 0;
+			s_pChannels[i].dClocksLeft = 0;
+			++s_sTick.ubDmaStarts;
+		}
+		else if(!isEnabled && isOn) {
+			s_sCustom.dmaconr &= ~uwFlag;
+			s_pChannels[i].bValue = 0;
+			++s_sTick.ubDmaStops;
+		}
+	}
+}
+
+void systemSetTimer(UBYTE ubCia, UBYTE ubTimer, UWORD uwTicks) {
+	if(ubCia == CIA_B) {
+		s_pTimers[ubTimer].uwLatch = uwTicks;
+	}
+}
+
+ULONG timerGet(void) {
+	// Frame counter, as in ACE
+	return (ULONG)(s_dNow / s_dClock * 50);
+}
+
+void *memAlloc(ULONG ulSize, ULONG ulFlags) {
+	return (ulFlags & MEMF_CLEAR) ? calloc(1, ulSize) : malloc(ulSize);
+}
+
+void memFree(void *pMem, UNUSED_ARG ULONG ulSize) {
+	free(pMem);
+}
+
+UBYTE memType(UNUSED_ARG const void *pMem) {
+	// All host memory is accessible by emulated Paula
+	return MEMF_CHIP;
+}
+
+tFile *diskFileOpen(
+	const char *szPath, tDiskFileMode eMode, UNUSED_ARG UBYTE isUninterrupted
+) {
+	FILE *pHandle = fopen(szPath, eMode == DISK_FILE_MODE_WRITE ? "wb" : (
+		eMode == DISK_FILE_MODE_APPEND ? "ab" : "rb"
+	));
+	if(!pHandle) {
+		return 0;
+	}
+	tFile *pFile = malloc(sizeof(*pFile));
+	pFile->pHandle = pHandle;
+	return pFile;
+}
+
+void fileClose(tFile *pFile) {
+	if(pFile) {
+		fclose(pFile->pHandle);
+		free(pFile);
+	}
+}
+
+ULONG fileRead(tFile *pFile, void *pDest, ULONG ulSize) {
+	return (ULONG)fread(pDest, 1, ulSize, pFile->pHandle);
+}
+
+ULONG fileGetPos(tFile *pFile) {
+	return (ULONG)ftell(pFile->pHandle);
+}
+
+LONG fileGetSize(tFile *pFile) {
+	if(!pFile) {
+		return -1;
+	}
+	long lPos = ftell(pFile->pHandle);
+	fseek(pFile->pHandle, 0, SEEK_END);
+	long lSize = ftell(pFile->pHandle);
+	fseek(pFile->pHandle, lPos, SEEK_SET);
+	return (LONG)lSize;
+}
+
+UBYTE fileIsResident(UNUSED_ARG tFile *pFile) {
+	return 0;
+}
+
+const UBYTE *fileReadAll(UNUSED_ARG tFile *pFile, ULONG *pSize) {
+	*pSize = 0;
+	return 0;
+}
+
+void fileReadAllFree(
+	UNUSED_ARG tFile *pFile, UNUSED_ARG const UBYTE *pData, UNUSED_ARG ULONG ulSize
+) {
+}
+
+void logWrite(const char *szFormat, ...) {
+	if(!s_isLogging) {
+		return;
+	}
+	va_list vaArgs;
+	va_start(vaArgs, szFormat);
+	vfprintf(stderr, szFormat, vaArgs);
+	va_end(vaArgs);
+}
+
+void logBlockBegin(const char *szBlockName, ...) {
+	if(!s_isLogging) {
+		return;
+	}
+	va_list vaArgs;
+	va_start(vaArgs, szBlockName);
+	fprintf(stderr, "Block begin: ");
+	vfprintf(stderr, szBlockName, vaArgs);
+	fprintf(stderr, "\n");
+	va_end(vaArgs);
+}
+
+void logBlockEnd(const char *szBlockName) {
+	if(s_isLogging) {
+		fprintf(stderr, "Block end: %s\n", szBlockName);
+	}
+}
@@ -0,0 +1,211 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef _ACE_TOOLS_PTPLAYER_HOST_H_
+#define _ACE_TOOLS_PTPLAYER_HOST_H_
+
+/**
+ * Host replacements of ACE and NDK parts used by ptplayer.c, along with
+ * emulation of Paula and CIA-B timers driving the player. This allows building
+ * ptplayer.c as-is for tools, with headers in include/ taking the place of
+ * ACE's ones.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <ace/types.h>
+#include <ace/macros.h>
+#include <string.h>
+
+//---------------------------------------------------------------- CHIP REGS
+
+#define INTB_SETCLR 15
+#define INTB_INTEN 14
+#define INTB_EXTER 13
+#define INTB_AUD3 10
+#define INTB_AUD2 9
+#define INTB_AUD1 8
+#define INTB_AUD0 7
+#define INTB_VERTB 5
+
+#define INTF_SETCLR BV(INTB_SETCLR)
+#define INTF_INTEN BV(INTB_INTEN)
+#define INTF_EXTER BV(INTB_EXTER)
+#define INTF_AUD3 BV(INTB_AUD3)
+#define INTF_AUD2 BV(INTB_AUD2)
+#define INTF_AUD1 BV(INTB_AUD1)
+#define INTF_AUD0 BV(INTB_AUD0)
+#define INTF_VERTB BV(INTB_VERTB)
+
+#define DMAB_SETCLR 15
+#define DMAB_AUD3 3
+#define DMAB_AUD2 2
+#define DMAB_AUD1 1
+#define DMAB_AUD0 0
+
+#define DMAF_SETCLR BV(DMAB_SETCLR)
+#define DMAF_AUD3 BV(DMAB_AUD3)
+#define DMAF_AUD2 BV(DMAB_AUD2)
+#define DMAF_AUD1 BV(DMAB_AUD1)
+#define DMAF_AUD0 BV(DMAB_AUD0)
+#define DMAF_AUDIO (DMAF_AUD0 | DMAF_AUD1 | DMAF_AUD2 | DMAF_AUD3)
+
+#define CIA_A 0
+#define CIA_B 1
+#define CIA_COUNT 2
+
+#define CIAICRB_TIMER_A 0
+#define CIAICRB_TIMER_B 1
+
+#define CIACRA_START BV(0)
+#define CIACRA_LOAD BV(4)
+#define CIACRB_START BV(0)
+#define CIACRB_RUNMODE BV(3)
+#define CIACRB_LOAD BV(4)
+
+struct AudChannel {
+	UWORD *ac_ptr;
+	UWORD ac_len; ///< In words.
+	UWORD ac_per;
+	UWORD ac_vol;
+	UWORD ac_dat;
+};
+
+/**
+ * @brief Registers used by ptplayer. Writes to intreq are applied after each
+ * interrupt handler returns, writes to intena are ignored.
+ */
+struct Custom {
+	UWORD dmaconr;
+	UWORD intreqr;
+	UWORD intena;
+	UWORD intreq;
+	struct AudChannel aud[4];
+};
+
+typedef struct Custom tCustom;
+
+typedef struct _tCia {
+	volatile UBYTE pra;
+} tCia;
+
+extern volatile tCustom *const g_pCustom;
+extern tCia *const g_pCia[CIA_COUNT];
+
+//------------------------------------------------------------------- SYSTEM
+
+typedef void (*tAceIntHandler)(
+	REGARG(volatile tCustom *pCustom, "a0"), REGARG(volatile void *pData, "a1")
+);
+
+void systemUse(void);
+void systemUnuse(void);
+void systemSetInt(UBYTE ubIntNumber, tAceIntHandler pHandler, void *pIntData);
+void systemSetCiaInt(
+	UBYTE ubCia, UBYTE ubIntBit, tAceIntHandler cbHandler, void *pIntData
+);
+void systemSetCiaCr(UBYTE ubCia, UBYTE isCrB, UBYTE ubCrValue);
+void systemSetDmaMask(UWORD uwDmaMask, UBYTE isEnabled);
+void systemSetTimer(UBYTE ubCia, UBYTE ubTimer, UWORD uwTicks);
+ULONG timerGet(void);
+
+//------------------------------------------------------------------- MEMORY
+
+#define MEMF_ANY 0
+#define MEMF_CHIP BV(1)
+#define MEMF_FAST BV(2)
+#define MEMF_CLEAR BV(16)
+
+void *memAlloc(ULONG ulSize, ULONG ulFlags);
+void memFree(void *pMem, ULONG ulSize);
+UBYTE memType(const void *pMem);
+
+#define memAllocFast(ulSize) memAlloc(ulSize, MEMF_ANY)
+#define memAllocChip(ulSize) memAlloc(ulSize, MEMF_CHIP)
+#define memAllocFastClear(ulSize) memAlloc(ulSize, MEMF_ANY | MEMF_CLEAR)
+#define memAllocChipClear(ulSize) memAlloc(ulSize, MEMF_CHIP | MEMF_CLEAR)
+
+//--------------------------------------------------------------------- FILE
+
+typedef struct _tFile tFile;
+
+typedef enum tDiskFileMode {
+	DISK_FILE_MODE_READ,
+	DISK_FILE_MODE_WRITE,
+	DISK_FILE_MODE_APPEND,
+	DISK_FILE_MODE_READ_STREAM,
+} tDiskFileMode;
+
+tFile *diskFileOpen(const char *szPath, tDiskFileMode eMode, UBYTE isUninterrupted);
+void fileClose(tFile *pFile);
+ULONG fileRead(tFile *pFile, void *pDest, ULONG ulSize);
+ULONG fileGetPos(tFile *pFile);
+LONG fileGetSize(tFile *pFile);
+UBYTE fileIsResident(tFile *pFile);
+const UBYTE *fileReadAll(tFile *pFile, ULONG *pSize);
+void fileReadAllFree(tFile *pFile, const UBYTE *pData, ULONG ulSize);
+
+//---------------------------------------------------------------------- LOG
+
+void logWrite(const char *szFormat, ...);
+void logBlockBegin(const char *szBlockName, ...);
+void logBlockEnd(const char *szBlockName);
+
+//---------------------------------------------------------------- EMULATION
+
+/**
+ * @brief Hardware activity caused by the player between consecutive
+ * CIA-B Timer A interrupts.
+ */
+typedef struct _tPtplayerHostTick {
+	ULONG ulIndex; ///< Tick number, starting from 0.
+	double dTime; ///< Tick start, in seconds.
+	UBYTE ubInterrupts; ///< Handled CIA and audio interrupts.
+	UBYTE ubDmaStarts; ///< Channels which had their DMA turned on.
+	UBYTE ubDmaStops; ///< Channels which had their DMA turned off.
+	UBYTE ubRegisterChanges; ///< Audio pointer, length, period and volume changes.
+} tPtplayerHostTick;
+
+/**
+ * @brief Called when tick is finished, right before next Timer A interrupt.
+ * Stats returned by ptplayerGetTickStats() still refer to the finished tick.
+ */
+typedef void (*tPtplayerHostCbTick)(const tPtplayerHostTick *pTick);
+
+/**
+ * @brief Resets emulated hardware. Must be called before ptplayerCreate().
+ *
+ * @param isPal Selects Paula and CIA clocks.
+ * @param ulOutputRate Sample rate of rendered audio, in Hz.
+ * @param cbTick Called on each finished tick. Set to zero if not needed.
+ */
+void ptplayerHostCreate(UBYTE isPal, ULONG ulOutputRate, tPtplayerHostCbTick cbTick);
+
+/**
+ * @brief Reports the unfinished tick, if any.
+ */
+void ptplayerHostDestroy(void);
+
+/**
+ * @brief Advances emulated time, running interrupt handlers when due and
+ * mixing Paula output.
+ *
+ * @param pOut Destination of interleaved stereo samples in -1..1 range.
+ * Channels 0 and 3 go left, 1 and 2 go right, as on Amiga.
+ * @param ulFrameCount Number of stereo frames to render.
+ */
+void ptplayerHostRender(float *pOut, ULONG ulFrameCount);
+
+/**
+ * @brief Enables printing of ptplayer's log to stderr. Disabled by default.
+ */
+void ptplayerHostSetLogging(UBYTE isEnabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ACE_TOOLS_PTPLAYER_HOST_H_
@@ -2,8 +2,14 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
 
+#include <atomic>
+#include <mutex>
 #include <optional>
+#include <fstream>
+#include <thread>
 #include "common/bitmap.h"
+#include "common/png.h"
+#include "common/tileset.h"
 #include "common/logging.h"
 #include "common/parse.h"
 #include "common/fs.h"
@@ -21,6 +27,10 @@ struct tConfig {
 	std::optional<int32_t> m_lColumnWidth;
 	bool m_isVaryingHeight;
 	bool m_isHeightOverride;
+	bool m_isDedup;
+	bool m_isDedupFlip;
+	std::string m_szRemapPath;
+	tPngEncodeSettings m_PngSettings;
 
 	tConfig(const std::vector<const char*> &vArgs);
 };
@@ -43,6 +53,8 @@ tConfig::tConfig(const std::vector<const char*> &vArgs)
 	m_lColumns = 1;
 	m_isVaryingHeight = false;
 	m_isHeightOverride = false;
+	m_isDedup = false;
+	m_isDedupFlip = false;
 
 	for(auto ArgIndex = 4; ArgIndex < ArgCount; ++ArgIndex) {
 		if(vArgs[ArgIndex] == std::string("-i")) {
@@ -86,6 +98,35 @@ tConfig::tConfig(const std::vector<const char*> &vArgs)
 			m_isHeightOverride = true;
 			fmt::print("Override tile height to {}\n", m_lTileHeight);
 		}
+		else if(vArgs[ArgIndex] == std::string("-dedup")) {
+			m_isDedup = true;
+		}
+		else if(vArgs[ArgIndex] == std::string("-dedupflip")) {
+			m_isDedup = true;
+			m_isDedupFlip = true;
+		}
+		else if(vArgs[ArgIndex] == std::string("-remap") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			m_szRemapPath = vArgs[ArgIndex];
+		}
+		else if(vArgs[ArgIndex] == std::string("-pl") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			if(!pngParseLevel(vArgs[ArgIndex], m_PngSettings.ubLevel)) {
+				throw std::runtime_error(nullptr);
+			}
+		}
+		else if(vArgs[ArgIndex] == std::string("-pf") && ArgIndex < ArgCount - 1) {
+			++ArgIndex;
+			if(!pngParseFilter(vArgs[ArgIndex], m_PngSettings.eFilter)) {
+				throw std::runtime_error(nullptr);
+			}
+		}
+	}
+
+	if(m_isDedup && m_szRemapPath.empty()) {
+		auto szOutExt = nFs::getExt(m_szOutPath);
+		auto szOutBase = szOutExt.empty() ? m_szOutPath : nFs::removeExt(m_szOutPath);
+		m_szRemapPath = szOutBase + "_remap.json";
 	}
 
 	if(m_isVaryingHeight && m_isHeightOverride) {
@@ -114,6 +155,57 @@ static void printUsage(const std::string &szAppName)
 	print("-cw          \t- override tile column width, useful for tiles of width not equal to multiple of 16px\n");
 	print("-h tileHeight\t- override height for rectangular tiles\n");
 	print("-vh          \t- enable varying height (can't be used with -h and -cols)\n");
+	print("-dedup       \t- remove duplicate tiles and write remap table\n");
+	print("-dedupflip   \t- same as -dedup, but also remove horizontally/vertically mirrored tiles\n");
+	print("-remap path  \t- remap table path (default: outPath with \"_remap.json\" suffix)\n");
+	print("\nWhen using .png or directory as output:\n");
+	print("-pl level    \t- compression level, 0 (store, fastest) to 9 (smallest). Default: 5\n");
+	print("-pf filter   \t- row filter: none, minsum (default), entropy, brute\n");
+	print("\nRemap table is JSON with old tile count and, for each old tile index, new index\n");
+	print("in \"tiles\" array and mirroring needed to restore it in \"flips\" array:\n");
+	print("bit 0 - horizontal, bit 1 - vertical.\n");
+}
+
+struct tTileRemap {
+	std::vector<std::uint16_t> vIndices; ///< New tile index for each old one.
+	std::vector<std::uint8_t> vFlips; ///< See tTileFlip.
+};
+
+/**
+ * @brief Removes duplicate tiles, keeping first occurrence of each one.
+ *
+ * @param vTiles Tiles to be compacted. Receives unique tiles on return.
+ * @param isFlip If set, mirrored tiles are also treated as duplicates.
+ * @return Remap table from old tile indices to new ones.
+ */
+static tTileRemap dedupTiles(std::vector<tChunkyBitmap> &vTiles, bool isFlip)
+{
+	tTileRemap Remap;
+	tTileIndex Unique;
+	for(auto &Tile: vTiles) {
+		auto Match = Unique.find(Tile, isFlip);
+		if(!Match) {
+			Match = tTileMatch{Unique.add(std::move(Tile)), TILE_FLIP_NONE};
+		}
+		Remap.vIndices.push_back(std::uint16_t(Match->ulIndex));
+		Remap.vFlips.push_back(Match->ubFlip);
+	}
+
+	vTiles = Unique.releaseTiles();
+	return Remap;
+}
+
+static void saveRemap(const tTileRemap &Remap, const std::string &szPath)
+{
+	std::ofstream FileOut(szPath, std::ios::out);
+	if(!FileOut.is_open()) {
+		throw std::runtime_error(fmt::format("Couldn't write remap table to '{}'", szPath));
+	}
+	FileOut << fmt::format(
+		"{{\n\t\"tileCount\": {},\n\t\"tiles\": [{}],\n\t\"flips\": [{}]\n}}\n",
+		Remap.vIndices.size(), fmt::join(Remap.vIndices.begin(), Remap.vIndices.end(), ", "),
+		fmt::join(Remap.vFlips.begin(), Remap.vFlips.end(), ", ")
+	);
 }
 
 /**
@@ -132,9 +224,19 @@ static std::vector<tChunkyBitmap> readTiles(
 	std::string szInExt = nFs::getExt(Config.m_szInPath);
 	if(szInExt == "png" || szInExt == "bm") {
 		tChunkyBitmap In;
+		std::optional<tPngReader> Reader;
 		auto ColumnWidth = Config.m_lColumnWidth.has_value() ? Config.m_lColumnWidth.value() : Config.m_lTileSize;
 		if(szInExt == "png") {
-			In = tChunkyBitmap::fromPng(Config.m_szInPath);
+			// Decode png one row of tiles at a time, unless it's interlaced
+			Reader.emplace(Config.m_szInPath);
+			if(Reader->isOpen()) {
+				In.m_uwWidth = std::uint16_t(Reader->getWidth());
+				In.m_uwHeight = std::uint16_t(Reader->getHeight());
+			}
+			else {
+				Reader.reset();
+				In = tChunkyBitmap::fromPng(Config.m_szInPath);
+			}
 		}
 		else if(szInExt == "bm") {
 			if(!Palette.has_value()) {
@@ -161,11 +263,23 @@ static std::vector<tChunkyBitmap> readTiles(
 		std::uint16_t TileCountVert = In.m_uwHeight / Config.m_lTileHeight;
 
 		vTiles.reserve(TileCountHoriz * TileCountVert);
+		tChunkyBitmap Strip(In.m_uwWidth, Config.m_lTileHeight);
 		for(std::uint16_t y = 0; y < TileCountVert; ++y) {
+			if(Reader) {
+				for(std::int32_t lRow = 0; lRow < Config.m_lTileHeight; ++lRow) {
+					if(!Reader->readRow(&Strip.m_vData[lRow * Strip.m_uwWidth])) {
+						throw std::runtime_error(fmt::format("Couldn't decode input file: '{}'", Config.m_szInPath));
+					}
+				}
+			}
+			else {
+				In.copyRect(0, y * Config.m_lTileHeight, Strip, 0, 0, In.m_uwWidth, Config.m_lTileHeight);
+			}
+
 			for(std::uint16_t x = 0; x < TileCountHoriz; ++x) {
 				tChunkyBitmap Tile(Config.m_lTileSize, Config.m_lTileHeight);
-				In.copyRect(
-					x * ColumnWidth, y * Config.m_lTileHeight, Tile, 0, 0,
+				Strip.copyRect(
+					x * ColumnWidth, 0, Tile, 0, 0,
 					Config.m_lTileSize, Config.m_lTileHeight
 				);
 				vTiles.push_back(std::move(Tile));
@@ -258,7 +372,7 @@ static void saveTiles(
 			}
 		}
 
-		if(szOutExt == "png" && !Out.value().toPng(Config.m_szOutPath)) {
+		if(szOutExt == "png" && !Out.value().toPng(Config.m_szOutPath, Config.m_PngSettings)) {
 			throw std::runtime_error(fmt::format("Couldn't write output to '{}'", Config.m_szOutPath));
 		}
 		else if(szOutExt == "bm") {
@@ -275,16 +389,38 @@ static void saveTiles(
 		}
 	}
 	else if(szOutExt == "") {
-		// Tile directory
+		// Tile directory - encode tiles in parallel
 		nFs::dirCreate(Config.m_szOutPath);
-		for(std::uint16_t i = 0; i < TileCount; ++i) {
-			auto &Tile = vTiles.at(i);
-			if(Tile.m_uwHeight != 0) {
-				std::string szTilePath = fmt::format("{}/{}.png", Config.m_szOutPath, i);
-				if(!Tile.toPng(szTilePath)) {
-					throw std::runtime_error(fmt::format("Couldn't write tile to '{}'", szTilePath));
+		std::atomic<std::size_t> NextTile = 0;
+		std::atomic<bool> isOk = true;
+		std::string szFailedPath;
+		std::mutex MutexFailedPath;
+		auto Worker = [&]() {
+			for(auto i = NextTile++; i < TileCount && isOk; i = NextTile++) {
+				auto &Tile = vTiles.at(i);
+				if(Tile.m_uwHeight != 0) {
+					std::string szTilePath = fmt::format("{}/{}.png", Config.m_szOutPath, i);
+					if(!Tile.toPng(szTilePath, Config.m_PngSettings)) {
+						std::lock_guard Lock(MutexFailedPath);
+						szFailedPath = szTilePath;
+						isOk = false;
+					}
 				}
 			}
+		};
+		std::vector<std::thread> vThreads;
+		auto ThreadCount = std::min<std::size_t>(
+			std::max(1u, std::thread::hardware_concurrency()), TileCount
+		);
+		for(std::size_t i = 1; i < ThreadCount; ++i) {
+			vThreads.emplace_back(Worker);
+		}
+		Worker();
+		for(auto &Thread: vThreads) {
+			Thread.join();
+		}
+		if(!isOk) {
+			throw std::runtime_error(fmt::format("Couldn't write tile to '{}'", szFailedPath));
 		}
 	}
 	else {
@@ -328,6 +464,22 @@ int main(int lArgCount, const char *pArgs[])
 		return EXIT_FAILURE;
 	}
 
+	if(Config->m_isDedup) {
+		try {
+			auto Remap = dedupTiles(vTiles, Config->m_isDedupFlip);
+			fmt::print(
+				"Removed {} duplicate tiles, {} left\n",
+				Remap.vIndices.size() - vTiles.size(), vTiles.size()
+			);
+			saveRemap(Remap, Config->m_szRemapPath);
+			fmt::print("Wrote remap table to '{}'\n", Config->m_szRemapPath);
+		}
+		catch(std::exception &Ex) {
+			exceptionHandle(Ex, "removing duplicate tiles");
+			return EXIT_FAILURE;
+		}
+	}
+
 	try {
 		saveTiles(vTiles, Palette, Config.value());
 	}